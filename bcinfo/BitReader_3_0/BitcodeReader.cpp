@@ -13,6 +13,7 @@
 
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "BitReader_3_0.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/SmallVector.h"
@@ -340,7 +341,8 @@ class BitcodeReaderValueList {
   /// ResolveConstantForwardRefs for more information about this.
   ///
   /// The key of this vector is the placeholder constant, the value is the slot
-  /// number that holds the resolved value.
+  /// number that holds the resolved value.  Entries are in the order the
+  /// slots were assigned.
   typedef std::vector<std::pair<Constant*, unsigned> > ResolveConstantsTy;
   ResolveConstantsTy ResolveConstants;
   LLVMContext &Context;
@@ -353,6 +355,7 @@ public:
   // vector compatibility methods
   unsigned size() const { return ValuePtrs.size(); }
   void resize(unsigned N) { ValuePtrs.resize(N); }
+  void reserve(unsigned N) { ValuePtrs.reserve(N); }
   void push_back(Value *V) {
     ValuePtrs.push_back(V);
   }
@@ -403,6 +406,7 @@ public:
   // vector compatibility methods
   unsigned size() const       { return MDValuePtrs.size(); }
   void resize(unsigned N)     { MDValuePtrs.resize(N); }
+  void reserve(unsigned N)    { MDValuePtrs.reserve(N); }
   void push_back(Metadata *MD) { MDValuePtrs.emplace_back(MD); }
   void clear()                { MDValuePtrs.clear();  }
   Metadata *back() const      { return MDValuePtrs.back(); }
@@ -920,16 +924,17 @@ Value *BitcodeReaderValueList::getValueFwdRef(unsigned Idx, Type *Ty) {
 /// uses and rewrite all the place holders at once for any constant that uses
 /// a placeholder.
 void BitcodeReaderValueList::ResolveConstantForwardRefs() {
-  // Sort the values by-pointer so that they are efficient to look up with a
-  // binary search.
-  std::sort(ResolveConstants.begin(), ResolveConstants.end());
+  // Index the placeholders by pointer, so that a constant using several of
+  // them finds the others without a search.
+  DenseMap<Constant*, unsigned> PlaceholderSlots;
+  PlaceholderSlots.reserve(ResolveConstants.size());
+  PlaceholderSlots.insert(ResolveConstants.begin(), ResolveConstants.end());
 
   SmallVector<Constant*, 64> NewOps;
 
-  while (!ResolveConstants.empty()) {
-    Value *RealVal = operator[](ResolveConstants.back().second);
-    Constant *Placeholder = ResolveConstants.back().first;
-    ResolveConstants.pop_back();
+  for (const auto &Resolve : ResolveConstants) {
+    Constant *Placeholder = Resolve.first;
+    Value *RealVal = operator[](Resolve.second);
 
     // Loop over all users of the placeholder, updating them to reference the
     // new value.  If they reference more than one placeholder, update them all
@@ -958,12 +963,10 @@ void BitcodeReaderValueList::ResolveConstantForwardRefs() {
           // Common case is that it just references this one placeholder.
           NewOp = RealVal;
         } else {
-          // Otherwise, look up the placeholder in ResolveConstants.
-          ResolveConstantsTy::iterator It =
-            std::lower_bound(ResolveConstants.begin(), ResolveConstants.end(),
-                             std::pair<Constant*, unsigned>(cast<Constant>(*I),
-                                                            0));
-          assert(It != ResolveConstants.end() && It->first == *I);
+          // Otherwise, look up the placeholder in PlaceholderSlots.
+          DenseMap<Constant*, unsigned>::iterator It =
+            PlaceholderSlots.find(cast<Constant>(*I));
+          assert(It != PlaceholderSlots.end());
           NewOp = operator[](It->second);
         }
 
@@ -990,8 +993,10 @@ void BitcodeReaderValueList::ResolveConstantForwardRefs() {
 
     // Update all ValueHandles, they should be the only users at this point.
     Placeholder->replaceAllUsesWith(RealVal);
+    PlaceholderSlots.erase(Placeholder);
     delete Placeholder;
   }
+  ResolveConstants.clear();
 }
 
 void BitcodeReaderMDValueList::AssignValue(Metadata *MD, unsigned Idx) {
@@ -1716,9 +1721,15 @@ std::error_code BitcodeReader::ParseValueSymbolTable() {
 std::error_code BitcodeReader::ParseMetadata() {
   unsigned NextMDValueNo = MDValueList.size();
 
-  if (Stream.EnterSubBlock(bitc::METADATA_BLOCK_ID))
+  unsigned NumWords;
+  if (Stream.EnterSubBlock(bitc::METADATA_BLOCK_ID, &NumWords))
     return Error("Invalid record");
 
+  // Records take about a word each, so size the table from the length of the
+  // block rather than reallocating it (and re-registering every tracking
+  // reference) over and over while the block is read.
+  MDValueList.reserve(MDValueList.size() + NumWords);
+
   SmallVector<uint64_t, 64> Record;
 
   // Read all the records.
@@ -1916,9 +1927,14 @@ static APInt ReadWideAPInt(ArrayRef<uint64_t> Vals, unsigned TypeBits) {
 }
 
 std::error_code BitcodeReader::ParseConstants() {
-  if (Stream.EnterSubBlock(bitc::CONSTANTS_BLOCK_ID))
+  unsigned NumWords;
+  if (Stream.EnterSubBlock(bitc::CONSTANTS_BLOCK_ID, &NumWords))
     return Error("Invalid record");
 
+  // As for metadata, size the value table for the block up front rather
+  // than moving its value handles around on every reallocation.
+  ValueList.reserve(ValueList.size() + NumWords);
+
   SmallVector<uint64_t, 64> Record;
 
   // Read all the records for this value table.
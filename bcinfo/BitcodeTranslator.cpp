@@ -78,7 +78,8 @@ static void stripUnknownAttributes(llvm::Module *M) {
 BitcodeTranslator::BitcodeTranslator(const char *bitcode, size_t bitcodeSize,
                                      unsigned int version)
     : mBitcode(bitcode), mBitcodeSize(bitcodeSize), mTranslatedBitcode(nullptr),
-      mTranslatedBitcodeSize(0), mVersion(version) {
+      mTranslatedBitcodeSize(0), mDecompressedBitcode(nullptr),
+      mVersion(version) {
   return;
 }
 
@@ -90,10 +91,17 @@ BitcodeTranslator::~BitcodeTranslator() {
     delete [] mTranslatedBitcode;
   }
   mTranslatedBitcode = nullptr;
+  delete [] mDecompressedBitcode;
+  mDecompressedBitcode = nullptr;
   return;
 }
 
 
+bool BitcodeTranslator::needsTranslation() const {
+  return mVersion < kMinimumUntranslatedVersion;
+}
+
+
 bool BitcodeTranslator::translate() {
   if (!mBitcode || !mBitcodeSize) {
     ALOGE("Invalid/empty bitcode");
@@ -115,11 +123,44 @@ bool BitcodeTranslator::translate() {
     return false;
   }
 
+  const char *bitcode = mBitcode;
+  size_t bitcodeSize = mBitcodeSize;
+
+  // Replace a compressed payload by a regular wrapper followed by the raw
+  // bitcode, so that neither the readers below nor any consumer of the
+  // translated bitcode needs to know about compression.
+  if (BCWrapper.isCompressed()) {
+    // Don't trust the uncompressed size in the header for the allocation.
+    if (!BCWrapper.hasValidCompressedPayload()) {
+      return false;
+    }
+
+    AndroidBitcodeWrapper wrapper;
+    size_t actualWrapperLen = writeAndroidBitcodeWrapper(
+        &wrapper, BCWrapper.getUncompressedSize(), BCWrapper.getTargetAPI(),
+        BCWrapper.getCompilerVersion(), BCWrapper.getOptimizationLevel());
+    if (!actualWrapperLen) {
+      ALOGE("Couldn't produce bitcode wrapper!");
+      return false;
+    }
+
+    bitcodeSize = actualWrapperLen + BCWrapper.getUncompressedSize();
+    char *c = new char[bitcodeSize];
+    memcpy(c, &wrapper, actualWrapperLen);
+    if (!BCWrapper.decompress(c + actualWrapperLen,
+                              BCWrapper.getUncompressedSize())) {
+      delete [] c;
+      return false;
+    }
+
+    mDecompressedBitcode = bitcode = c;
+  }
+
   // We currently don't need to transcode any API version higher than 14 or
   // the current API version (i.e. 10000)
   if (mVersion >= kMinimumUntranslatedVersion) {
-    mTranslatedBitcode = mBitcode;
-    mTranslatedBitcodeSize = mBitcodeSize;
+    mTranslatedBitcode = bitcode;
+    mTranslatedBitcodeSize = bitcodeSize;
     return true;
   }
 
@@ -128,7 +169,7 @@ bool BitcodeTranslator::translate() {
   std::unique_ptr<llvm::LLVMContext> mContext(new llvm::LLVMContext());
   std::unique_ptr<llvm::MemoryBuffer> MEM(
     llvm::MemoryBuffer::getMemBuffer(
-      llvm::StringRef(mBitcode, mBitcodeSize), "", false));
+      llvm::StringRef(bitcode, bitcodeSize), "", false));
   std::string error;
   llvm::ErrorOr<llvm::MemoryBufferRef> MBOrErr = MEM->getMemBufferRef();
 
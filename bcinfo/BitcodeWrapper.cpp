@@ -20,6 +20,11 @@
 
 #include "llvm/Bitcode/ReaderWriter.h"
 
+#define LOG_TAG "bcinfo"
+#include <log/log.h>
+
+#include <zstd.h>
+
 #include <cstdlib>
 #include <cstring>
 
@@ -29,7 +34,8 @@ BitcodeWrapper::BitcodeWrapper(const char *bitcode, size_t bitcodeSize)
     : mFileType(BC_NOT_BC), mBitcode(bitcode),
       mBitcodeSize(bitcodeSize),
       mHeaderVersion(0), mTargetAPI(0), mCompilerVersion(0),
-      mOptimizationLevel(3) {
+      mOptimizationLevel(3), mCompression(BC_COMPRESSION_NONE),
+      mUncompressedSize(0), mPayloadOffset(0), mPayloadSize(bitcodeSize) {
   InMemoryWrapperInput inMem(mBitcode, mBitcodeSize);
   BitcodeWrapperer wrapperer(&inMem, nullptr);
   if (wrapperer.IsInputBitcodeWrapper()) {
@@ -38,6 +44,10 @@ BitcodeWrapper::BitcodeWrapper(const char *bitcode, size_t bitcodeSize)
     mTargetAPI = wrapperer.getAndroidTargetAPI();
     mCompilerVersion = wrapperer.getAndroidCompilerVersion();
     mOptimizationLevel = wrapperer.getAndroidOptimizationLevel();
+    mCompression = wrapperer.getAndroidCompression();
+    mUncompressedSize = wrapperer.getAndroidUncompressedSize();
+    mPayloadOffset = wrapperer.getBitcodeOffset();
+    mPayloadSize = wrapperer.getBitcodeSize();
   } else if (wrapperer.IsInputBitcodeFile()) {
     mFileType = BC_RAW;
   }
@@ -53,5 +63,110 @@ bool BitcodeWrapper::unwrap() {
   return mFileType != BC_NOT_BC;
 }
 
+
+bool BitcodeWrapper::hasValidCompressedPayload() const {
+  if (mCompression != BC_COMPRESSION_ZSTD) {
+    ALOGE("Unsupported bitcode compression algorithm %u", mCompression);
+    return false;
+  }
+
+  if ((mPayloadOffset > mBitcodeSize) ||
+      (mPayloadSize > mBitcodeSize - mPayloadOffset) ||
+      (static_cast<uint64_t>(mUncompressedSize) >
+       static_cast<uint64_t>(mPayloadSize) * kMaxCompressionRatio)) {
+    ALOGE("Invalid compressed bitcode (payload %u bytes at offset %u, "
+          "uncompressed %u bytes)", mPayloadSize, mPayloadOffset,
+          mUncompressedSize);
+    return false;
+  }
+
+  // The frame records the content size unless the producer streamed it.
+  unsigned long long frameSize =
+      ZSTD_getFrameContentSize(mBitcode + mPayloadOffset, mPayloadSize);
+  if (frameSize == ZSTD_CONTENTSIZE_ERROR) {
+    ALOGE("Invalid compressed bitcode (not a zstd frame)");
+    return false;
+  }
+  if ((frameSize != ZSTD_CONTENTSIZE_UNKNOWN) &&
+      (frameSize != mUncompressedSize)) {
+    ALOGE("Invalid compressed bitcode (uncompressed %u bytes, frame holds "
+          "%llu bytes)", mUncompressedSize, frameSize);
+    return false;
+  }
+
+  return true;
+}
+
+
+bool BitcodeWrapper::decompress(char *dst, size_t dstSize) const {
+  if ((dst == nullptr) || (dstSize != mUncompressedSize) ||
+      !hasValidCompressedPayload()) {
+    return false;
+  }
+
+  ZSTD_DStream *stream = ZSTD_createDStream();
+  if (stream == nullptr) {
+    ALOGE("Unable to allocate bitcode decompression stream");
+    return false;
+  }
+
+  // Decode straight into the destination buffer; zstd only keeps its
+  // window in the stream state, so no intermediate copy of either the
+  // compressed or the decompressed data is made.
+  ZSTD_inBuffer in = { mBitcode + mPayloadOffset, mPayloadSize, 0 };
+  ZSTD_outBuffer out = { dst, dstSize, 0 };
+  size_t ret = ZSTD_initDStream(stream);
+  while (!ZSTD_isError(ret) && ret != 0) {
+    size_t inPos = in.pos, outPos = out.pos;
+    ret = ZSTD_decompressStream(stream, &out, &in);
+    if (in.pos == inPos && out.pos == outPos) {
+      // No progress: the payload is truncated or larger than advertised.
+      break;
+    }
+  }
+  ZSTD_freeDStream(stream);
+
+  if (ZSTD_isError(ret)) {
+    ALOGE("Failed to decompress bitcode (%s)", ZSTD_getErrorName(ret));
+    return false;
+  }
+
+  if (ret != 0 || out.pos != dstSize) {
+    ALOGE("Truncated compressed bitcode (%zu of %zu bytes decompressed)",
+          out.pos, dstSize);
+    return false;
+  }
+
+  return true;
+}
+
+
+bool writeCompressedBitcode(const char *bitcode, size_t bitcodeSize,
+                            uint32_t targetAPI, uint32_t compilerVersion,
+                            uint32_t optimizationLevel,
+                            std::vector<char> &out) {
+  std::vector<char> payload(ZSTD_compressBound(bitcodeSize));
+  size_t payloadSize = ZSTD_compress(payload.data(), payload.size(), bitcode,
+                                     bitcodeSize, ZSTD_maxCLevel());
+  if (ZSTD_isError(payloadSize)) {
+    ALOGE("Failed to compress bitcode (%s)", ZSTD_getErrorName(payloadSize));
+    return false;
+  }
+
+  AndroidCompressedBitcodeWrapper wrapper;
+  size_t wrapperSize = writeAndroidCompressedBitcodeWrapper(
+      &wrapper, payloadSize, bitcodeSize, BC_COMPRESSION_ZSTD, targetAPI,
+      compilerVersion, optimizationLevel);
+  if (!wrapperSize) {
+    ALOGE("Couldn't produce compressed bitcode wrapper!");
+    return false;
+  }
+
+  const char *header = reinterpret_cast<const char *>(&wrapper);
+  out.insert(out.end(), header, header + wrapperSize);
+  out.insert(out.end(), payload.begin(), payload.begin() + payloadSize);
+  return true;
+}
+
 }  // namespace bcinfo
 
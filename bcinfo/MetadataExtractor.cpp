@@ -398,6 +398,7 @@ uint32_t MetadataExtractor::calculateNumInputs(const llvm::Function *Function,
     OtherCount += hasForEachSignatureCtxt(Signature);
     OtherCount += hasForEachSignatureOut(Signature) &&
                   Function->getReturnType()->isVoidTy();
+    OtherCount += getForEachSignatureExtraOutCount(Signature);
 
     return Function->arg_size() - OtherCount;
 
@@ -47,6 +47,7 @@ static const uint32_t kAndroidHeaderVersion = 0;
 static const uint32_t kAndroidTargetAPI = 0;
 static const uint32_t kAndroidDefaultCompilerVersion = 0;
 static const uint32_t kAndroidDefaultOptimizationLevel = 3;
+static const uint32_t kAndroidDefaultCompression = 0;
 
 // PNaCl bitcode version number.
 static const uint32_t kPnaclBitcodeVersion = 0;
@@ -68,6 +69,8 @@ BitcodeWrapperer::BitcodeWrapperer(WrapperInput* infile, WrapperOutput* outfile)
       android_target_api_(kAndroidTargetAPI),
       android_compiler_version_(kAndroidDefaultCompilerVersion),
       android_optimization_level_(kAndroidDefaultOptimizationLevel),
+      android_compression_(kAndroidDefaultCompression),
+      android_uncompressed_size_(0),
       pnacl_bc_version_(0),
       error_(false) {
   buffer_.resize(kBitcodeWrappererBufferSize);
@@ -237,6 +240,14 @@ bool BitcodeWrapperer::ParseWrapperHeader() {
       };
       IntFieldHelper tempIntField;
 
+      struct CompressionFieldHelper {
+        BCHeaderField::FixedSubfield tag;
+        uint16_t len;
+        uint32_t algorithm;
+        uint32_t uncompressed_size;
+      };
+      CompressionFieldHelper tempCompressionField;
+
       switch (field.getID()) {
         case BCHeaderField::kAndroidCompilerVersion:
           if (field.Write((uint8_t*)&tempIntField,
@@ -250,6 +261,14 @@ bool BitcodeWrapperer::ParseWrapperHeader() {
             android_optimization_level_ = tempIntField.val;
           }
           break;
+        case BCHeaderField::kAndroidCompression:
+          if (field.Write((uint8_t*)&tempCompressionField,
+                          sizeof(tempCompressionField))) {
+            android_compression_ = tempCompressionField.algorithm;
+            android_uncompressed_size_ =
+                tempCompressionField.uncompressed_size;
+          }
+          break;
         default:
           // Ignore other field types for now
           break;
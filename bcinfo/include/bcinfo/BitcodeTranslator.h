@@ -27,6 +27,8 @@ class BitcodeTranslator {
   size_t mBitcodeSize;
   const char *mTranslatedBitcode;
   size_t mTranslatedBitcodeSize;
+  // Uncompressed copy of mBitcode if its payload was compressed (owned).
+  const char *mDecompressedBitcode;
   unsigned int mVersion;
 
  public:
@@ -50,6 +52,13 @@ class BitcodeTranslator {
    */
   bool translate();
 
+  /**
+   * \return true if bitcode of the supplied version has to go through one of
+   *         the legacy bitcode readers, i.e. if translate() does more than
+   *         unwrapping it.
+   */
+  bool needsTranslation() const;
+
   /**
    * \return translated bitcode.
    */
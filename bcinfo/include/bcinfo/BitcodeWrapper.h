@@ -21,6 +21,7 @@
 
 #include <cstddef>
 #include <stdint.h>
+#include <vector>
 
 namespace bcinfo {
 
@@ -40,12 +41,37 @@ struct AndroidBitcodeWrapper {
   uint32_t OptimizationLevel;
 };
 
+/**
+ * Wrapper for bitcode whose payload is compressed. The bitcode offset and
+ * size describe the compressed payload; UncompressedSize is the size of the
+ * raw bitcode once decompressed.
+ */
+struct AndroidCompressedBitcodeWrapper {
+  AndroidBitcodeWrapper Base;
+  uint16_t CompressionTag;
+  uint16_t CompressionLen;
+  uint32_t CompressionAlgorithm;
+  uint32_t UncompressedSize;
+};
+
 enum BCFileType {
   BC_NOT_BC = 0,
   BC_WRAPPER = 1,
   BC_RAW = 2
 };
 
+enum BCCompression {
+  BC_COMPRESSION_NONE = 0,
+  BC_COMPRESSION_ZSTD = 1
+};
+
+/**
+ * Largest ratio of uncompressed to compressed bitcode size that is accepted.
+ * zstd compresses bitcode about 4:1; anything far beyond that comes from a
+ * corrupt or malicious header.
+ */
+static const uint32_t kMaxCompressionRatio = 64;
+
 class BitcodeWrapper {
  private:
   enum BCFileType mFileType;
@@ -56,6 +82,10 @@ class BitcodeWrapper {
   uint32_t mTargetAPI;
   uint32_t mCompilerVersion;
   uint32_t mOptimizationLevel;
+  uint32_t mCompression;
+  uint32_t mUncompressedSize;
+  uint32_t mPayloadOffset;
+  uint32_t mPayloadSize;
 
  public:
   /**
@@ -110,6 +140,59 @@ class BitcodeWrapper {
     return mOptimizationLevel;
   }
 
+  /**
+   * \return compression algorithm (BCCompression) of the bitcode payload.
+   */
+  uint32_t getCompression() const {
+    return mCompression;
+  }
+
+  /**
+   * \return true if the bitcode payload has to be decompressed before use.
+   */
+  bool isCompressed() const {
+    return mCompression != BC_COMPRESSION_NONE;
+  }
+
+  /**
+   * \return offset of the (possibly compressed) bitcode payload.
+   */
+  uint32_t getPayloadOffset() const {
+    return mPayloadOffset;
+  }
+
+  /**
+   * \return size of the (possibly compressed) bitcode payload (in bytes).
+   */
+  uint32_t getPayloadSize() const {
+    return mPayloadSize;
+  }
+
+  /**
+   * \return size of the raw bitcode after decompression (in bytes).
+   */
+  uint32_t getUncompressedSize() const {
+    return mUncompressedSize;
+  }
+
+  /**
+   * Check that the compressed payload lies within the bitcode and that
+   * getUncompressedSize() is consistent with it: it has to match the size
+   * recorded in the compressed frame (if any), and can't exceed the payload
+   * size by more than kMaxCompressionRatio.  Callers check this before
+   * allocating getUncompressedSize() bytes for decompress().
+   *
+   * \return true if the payload can be decompressed.
+   */
+  bool hasValidCompressedPayload() const;
+
+  /**
+   * Decompress the bitcode payload into \p dst, which must be exactly
+   * getUncompressedSize() bytes long. The result is raw (unwrapped) bitcode.
+   *
+   * \return true on success and false if an error occurred.
+   */
+  bool decompress(char *dst, size_t dstSize) const;
 };
 
 /**
@@ -148,6 +231,57 @@ static inline size_t writeAndroidBitcodeWrapper(AndroidBitcodeWrapper *wrapper,
   return sizeof(*wrapper);
 }
 
+/**
+ * Helper function to emit the bitcode wrapper for a compressed payload
+ * returning the number of bytes that were written.
+ *
+ * \param wrapper - where to write header information into.
+ * \param compressedSize - size of the compressed payload in bytes.
+ * \param uncompressedSize - size of the raw bitcode in bytes.
+ * \param compression - compression algorithm (BCCompression) of the payload.
+ * \param targetAPI - target API version for this bitcode.
+ * \param compilerVersion - compiler version that generated this bitcode.
+ * \param optimizationLevel - compiler optimization level for this bitcode.
+ *
+ * \return number of wrapper bytes written into the \p buffer.
+ */
+static inline size_t writeAndroidCompressedBitcodeWrapper(
+    AndroidCompressedBitcodeWrapper *wrapper, size_t compressedSize,
+    size_t uncompressedSize, uint32_t compression, uint32_t targetAPI,
+    uint32_t compilerVersion, uint32_t optimizationLevel) {
+  if (!wrapper ||
+      !writeAndroidBitcodeWrapper(&wrapper->Base, compressedSize, targetAPI,
+                                  compilerVersion, optimizationLevel)) {
+    return 0;
+  }
+
+  wrapper->Base.BitcodeOffset = sizeof(*wrapper);
+  wrapper->CompressionTag = BCHeaderField::kAndroidCompression;
+  wrapper->CompressionLen = 8;
+  wrapper->CompressionAlgorithm = compression;
+  wrapper->UncompressedSize = uncompressedSize;
+
+  return sizeof(*wrapper);
+}
+
+/**
+ * Compress raw (unwrapped) bitcode with zstd and append it to \p out,
+ * preceded by its compressed bitcode wrapper.
+ *
+ * \param bitcode - raw bitcode to compress.
+ * \param bitcodeSize - size of \p bitcode in bytes.
+ * \param targetAPI - target API version for this bitcode.
+ * \param compilerVersion - compiler version that generated this bitcode.
+ * \param optimizationLevel - compiler optimization level for this bitcode.
+ * \param out - where to append the wrapped, compressed bitcode.
+ *
+ * \return true on success and false if an error occurred.
+ */
+bool writeCompressedBitcode(const char *bitcode, size_t bitcodeSize,
+                            uint32_t targetAPI, uint32_t compilerVersion,
+                            uint32_t optimizationLevel,
+                            std::vector<char> &out);
+
 }  // namespace bcinfo
 
 #endif  // __ANDROID_BCINFO_BITCODEWRAPPER_H__
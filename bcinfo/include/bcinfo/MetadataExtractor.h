@@ -45,8 +45,13 @@ enum MetadataSignatureBitval {
   MD_SIG_Kernel      = 0x000020,
   MD_SIG_Z           = 0x000040,
   MD_SIG_Ctxt        = 0x000080,
+  // 3-bit count of the outputs a kernel writes in addition to its return
+  // value (or its first out-pointer parameter).
+  MD_SIG_ExtraOut    = 0x000700,
 };
 
+static const uint32_t MD_SIG_ExtraOutShift = 8;
+
 class MetadataExtractor {
  public:
   struct Reduce {
@@ -372,6 +377,28 @@ class MetadataExtractor {
     return sig & MD_SIG_Ctxt;
   }
 
+  /**
+   * \return the number of additional outputs of this ForEach function
+   * signature.  A multi-output kernel has an "Out" return value (or first
+   * out-pointer parameter) for the allocation in output slot 0, followed after
+   * its inputs by one out-pointer parameter for each additional output slot.
+   *
+   * \param sig - ForEach function signature to check.
+   */
+  static uint32_t getForEachSignatureExtraOutCount(uint32_t sig) {
+    return (sig & MD_SIG_ExtraOut) >> MD_SIG_ExtraOutShift;
+  }
+
+  /**
+   * \return the total number of outputs of this ForEach function signature.
+   *
+   * \param sig - ForEach function signature to check.
+   */
+  static uint32_t getForEachSignatureOutCount(uint32_t sig) {
+    return hasForEachSignatureOut(sig) ? 1 + getForEachSignatureExtraOutCount(sig)
+                                       : 0;
+  }
+
   /**
    * \return whether "Kernels" in this script can be processed
    * by multiple threads
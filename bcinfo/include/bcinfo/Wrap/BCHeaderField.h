@@ -34,7 +34,10 @@ class BCHeaderField {
     kInvalid = 0,
     kBitcodeHash = 1,
     kAndroidCompilerVersion = 0x4001,
-    kAndroidOptimizationLevel = 0x4002
+    kAndroidOptimizationLevel = 0x4002,
+    // Payload compression: 32-bit algorithm followed by the 32-bit size of
+    // the bitcode after decompression.
+    kAndroidCompression = 0x4003
   } Tag;
   typedef uint16_t FixedSubfield;
 
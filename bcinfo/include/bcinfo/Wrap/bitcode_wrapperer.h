@@ -91,6 +91,23 @@ class BitcodeWrapperer {
     return android_optimization_level_;
   }
 
+  uint32_t getAndroidCompression() {
+    return android_compression_;
+  }
+
+  uint32_t getAndroidUncompressedSize() {
+    return android_uncompressed_size_;
+  }
+
+  // Offset and size of the (possibly compressed) bitcode in the input file.
+  uint32_t getBitcodeOffset() {
+    return infile_bc_offset_;
+  }
+
+  uint32_t getBitcodeSize() {
+    return wrapper_bc_size_;
+  }
+
   ~BitcodeWrapperer();
 
  private:
@@ -205,6 +222,10 @@ class BitcodeWrapperer {
   uint32_t android_compiler_version_;
   uint32_t android_optimization_level_;
 
+  // Compression algorithm of the wrapped bitcode and its uncompressed size
+  uint32_t android_compression_;
+  uint32_t android_uncompressed_size_;
+
   // PNaCl bitcode version
   uint32_t pnacl_bc_version_;
 
@@ -0,0 +1,333 @@
+/*
+ * Copyright 2026, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Scan.h"
+
+#include <bcinfo/BitcodeTranslator.h>
+#include <bcinfo/BitcodeWrapper.h>
+#include <bcinfo/MetadataExtractor.h>
+
+#include <llvm/Support/ErrorOr.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+#include <stdio.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The scan mode of the bcinfo tool.  The directory walk feeds paths to the
+// workers through a bounded queue, and each worker writes out the record of
+// a file as soon as it is done with it, so that memory use doesn't grow with
+// the size of the corpus.  Every worker parses with its own LLVMContext (the
+// translator and the metadata extractor create one per call).
+
+namespace {
+
+// Bound on the number of paths waiting for a worker, so that the directory
+// walk doesn't run arbitrarily far ahead of the workers.
+const size_t kMaxPendingFiles = 1024;
+
+class WorkQueue {
+ private:
+  std::mutex mMutex;
+  std::condition_variable mNotEmpty;
+  std::condition_variable mNotFull;
+  std::deque<std::string> mPaths;
+  bool mClosed;
+
+ public:
+  WorkQueue() : mClosed(false) {}
+
+  void push(std::string path) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mNotFull.wait(lock, [this] { return mPaths.size() < kMaxPendingFiles; });
+    mPaths.push_back(std::move(path));
+    mNotEmpty.notify_one();
+  }
+
+  // Signal that no more paths will be pushed.
+  void close() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mClosed = true;
+    mNotEmpty.notify_all();
+  }
+
+  // Return false once the queue is closed and drained.
+  bool pop(std::string *path) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mNotEmpty.wait(lock, [this] { return !mPaths.empty() || mClosed; });
+    if (mPaths.empty()) {
+      return false;
+    }
+    *path = std::move(mPaths.front());
+    mPaths.pop_front();
+    mNotFull.notify_one();
+    return true;
+  }
+};
+
+// Serializes the records of the workers, which are written whole.
+std::mutex gOutputMutex;
+
+void appendString(std::string *out, const char *str) {
+  static const char kHexDigits[] = "0123456789abcdef";
+
+  out->push_back('"');
+  for (const char *c = str ? str : ""; *c; ++c) {
+    unsigned char ch = *c;
+    if (ch == '"' || ch == '\\') {
+      out->push_back('\\');
+      out->push_back(ch);
+    } else if (ch < 0x20) {
+      out->append("\\u00");
+      out->push_back(kHexDigits[ch >> 4]);
+      out->push_back(kHexDigits[ch & 0xf]);
+    } else {
+      out->push_back(ch);
+    }
+  }
+  out->push_back('"');
+}
+
+void appendKey(std::string *out, const char *key) {
+  out->append(", ");
+  appendString(out, key);
+  out->append(": ");
+}
+
+void appendNumber(std::string *out, uint64_t value) {
+  out->append(std::to_string(value));
+}
+
+void appendNameList(std::string *out, const char *key, const char **names,
+                    size_t count) {
+  appendKey(out, key);
+  out->push_back('[');
+  for (size_t i = 0; i < count; i++) {
+    if (i) {
+      out->append(", ");
+    }
+    appendString(out, names[i]);
+  }
+  out->push_back(']');
+}
+
+void formatJSON(std::string *out, const std::string &path,
+                const bcinfo::BitcodeWrapper &wrapper, unsigned version,
+                bool translated, const bcinfo::MetadataExtractor &ME) {
+  out->append("{\"file\": ");
+  appendString(out, path.c_str());
+  appendKey(out, "wrapper");
+  out->append(wrapper.getBCFileType() == bcinfo::BC_WRAPPER ? "true"
+                                                            : "false");
+  appendKey(out, "targetAPI");
+  appendNumber(out, version);
+  appendKey(out, "compilerVersion");
+  appendNumber(out, ME.getCompilerVersion());
+  appendKey(out, "optimizationLevel");
+  appendNumber(out, ME.getOptimizationLevel());
+  appendKey(out, "translated");
+  out->append(translated ? "true" : "false");
+  appendKey(out, "floatPrecision");
+  appendString(out, ME.getRSFloatPrecision() == bcinfo::RS_FP_Relaxed ?
+                    "relaxed" : "full");
+
+  appendNameList(out, "exportVars", ME.getExportVarNameList(),
+                 ME.getExportVarCount());
+  appendNameList(out, "exportFuncs", ME.getExportFuncNameList(),
+                 ME.getExportFuncCount());
+
+  appendKey(out, "exportForEach");
+  out->push_back('[');
+  const char **nameList = ME.getExportForEachNameList();
+  const uint32_t *sigList = ME.getExportForEachSignatureList();
+  const uint32_t *inputCountList = ME.getExportForEachInputCountList();
+  for (size_t i = 0; i < ME.getExportForEachSignatureCount(); i++) {
+    out->append(i ? ", {\"name\": " : "{\"name\": ");
+    appendString(out, nameList[i]);
+    appendKey(out, "signature");
+    appendNumber(out, sigList[i]);
+    appendKey(out, "inputs");
+    appendNumber(out, inputCountList[i]);
+    out->push_back('}');
+  }
+  out->push_back(']');
+
+  appendKey(out, "exportReduce");
+  out->push_back('[');
+  const bcinfo::MetadataExtractor::Reduce *reduceList =
+      ME.getExportReduceList();
+  for (size_t i = 0; i < ME.getExportReduceCount(); i++) {
+    const bcinfo::MetadataExtractor::Reduce &reduce = reduceList[i];
+    out->append(i ? ", {\"name\": " : "{\"name\": ");
+    appendString(out, reduce.mReduceName);
+    appendKey(out, "signature");
+    appendNumber(out, reduce.mSignature);
+    appendKey(out, "inputs");
+    appendNumber(out, reduce.mInputCount);
+    appendKey(out, "accumulatorDataSize");
+    appendNumber(out, reduce.mAccumulatorDataSize);
+    out->push_back('}');
+  }
+  out->push_back(']');
+
+  // Pragmas are kept as pairs, since a key may appear more than once.
+  appendKey(out, "pragmas");
+  out->push_back('[');
+  const char **keyList = ME.getPragmaKeyList();
+  const char **valueList = ME.getPragmaValueList();
+  for (size_t i = 0; i < ME.getPragmaCount(); i++) {
+    out->append(i ? ", [" : "[");
+    appendString(out, keyList[i]);
+    out->append(", ");
+    appendString(out, valueList[i]);
+    out->push_back(']');
+  }
+  out->push_back(']');
+
+  appendKey(out, "objectSlotCount");
+  appendNumber(out, ME.getObjectSlotCount());
+  out->append("}\n");
+}
+
+void formatSummary(std::string *out, const std::string &path,
+                   unsigned version, bool translated,
+                   const bcinfo::MetadataExtractor &ME) {
+  char buf[256];
+  snprintf(buf, sizeof(buf),
+           ": targetAPI %u, %zu vars, %zu funcs, %zu forEach, %zu reduce, "
+           "%zu pragmas%s\n",
+           version, ME.getExportVarCount(), ME.getExportFuncCount(),
+           ME.getExportForEachSignatureCount(), ME.getExportReduceCount(),
+           ME.getPragmaCount(), translated ? ", translated" : "");
+  out->append(path);
+  out->append(buf);
+}
+
+void formatError(std::string *out, const std::string &path, bool json,
+                 const char *error) {
+  if (json) {
+    out->append("{\"file\": ");
+    appendString(out, path.c_str());
+    appendKey(out, "error");
+    appendString(out, error);
+    out->append("}\n");
+  } else {
+    out->append(path);
+    out->append(": error: ");
+    out->append(error);
+    out->push_back('\n');
+  }
+}
+
+// Scan the file at path and append its record to out.  Returns false if the
+// file is bitcode that couldn't be scanned; out is left empty for files that
+// aren't bitcode.
+bool scanFile(const std::string &path, bool json, unsigned rawVersion,
+              std::string *out) {
+  // Large files are mapped rather than read.
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer =
+      llvm::MemoryBuffer::getFile(path, -1, false);
+  if (std::error_code ec = buffer.getError()) {
+    formatError(out, path, json, ec.message().c_str());
+    return false;
+  }
+
+  const char *bitcode = (*buffer)->getBufferStart();
+  size_t bitcodeSize = (*buffer)->getBufferSize();
+
+  bcinfo::BitcodeWrapper wrapper(bitcode, bitcodeSize);
+  if (wrapper.getBCFileType() == bcinfo::BC_NOT_BC) {
+    return true;
+  }
+
+  unsigned version = wrapper.getBCFileType() == bcinfo::BC_WRAPPER ?
+                         wrapper.getTargetAPI() : rawVersion;
+
+  bcinfo::BitcodeTranslator BT(bitcode, bitcodeSize, version);
+  if (!BT.translate()) {
+    formatError(out, path, json, "failed to translate bitcode");
+    return false;
+  }
+
+  bcinfo::MetadataExtractor ME(BT.getTranslatedBitcode(),
+                               BT.getTranslatedBitcodeSize());
+  if (!ME.extract()) {
+    formatError(out, path, json, "failed to get metadata");
+    return false;
+  }
+
+  if (json) {
+    formatJSON(out, path, wrapper, version, BT.needsTranslation(), ME);
+  } else {
+    formatSummary(out, path, version, BT.needsTranslation(), ME);
+  }
+  return true;
+}
+
+}  // end anonymous namespace
+
+size_t scanCorpus(const std::string &dir, unsigned numThreads, bool json,
+                  unsigned rawVersion) {
+  WorkQueue queue;
+  std::atomic<size_t> numFailed(0);
+
+  std::vector<std::thread> workers;
+  for (unsigned i = 0; i < numThreads; i++) {
+    workers.emplace_back([&] {
+      std::string path;
+      std::string record;
+      while (queue.pop(&path)) {
+        record.clear();
+        if (!scanFile(path, json, rawVersion, &record)) {
+          ++numFailed;
+        }
+        if (!record.empty()) {
+          std::lock_guard<std::mutex> lock(gOutputMutex);
+          fwrite(record.data(), 1, record.size(), stdout);
+        }
+      }
+    });
+  }
+
+  std::error_code ec;
+  for (llvm::sys::fs::recursive_directory_iterator it(dir, ec), end;
+       it != end && !ec; it.increment(ec)) {
+    llvm::sys::fs::file_status status;
+    if (!it->status(status) && llvm::sys::fs::is_regular_file(status)) {
+      queue.push(it->path());
+    }
+  }
+  if (ec) {
+    fprintf(stderr, "Could not scan %s: %s\n", dir.c_str(),
+            ec.message().c_str());
+    ++numFailed;
+  }
+
+  queue.close();
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+  fflush(stdout);
+
+  return numFailed;
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright 2026, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ANDROID_BCINFO_TOOLS_SCAN_H__
+#define __ANDROID_BCINFO_TOOLS_SCAN_H__
+
+#include <string>
+
+/**
+ * Scan every bitcode file below \p dir (recursively) on \p numThreads worker
+ * threads, and print one record per file to stdout as soon as it is done:
+ * a JSON object per line if \p json is set, a one-line summary otherwise.
+ * Files that aren't bitcode are skipped.
+ *
+ * \param rawVersion - target API assumed for bitcode without a wrapper.
+ *
+ * \return the number of bitcode files that could not be scanned.
+ */
+size_t scanCorpus(const std::string &dir, unsigned numThreads, bool json,
+                  unsigned rawVersion);
+
+#endif  // __ANDROID_BCINFO_TOOLS_SCAN_H__
@@ -18,6 +18,8 @@
 #include <bcinfo/BitcodeWrapper.h>
 #include <bcinfo/MetadataExtractor.h>
 
+#include "Scan.h"
+
 #include <llvm/ADT/StringRef.h>
 #include <llvm/Bitcode/ReaderWriter.h>
 #include <llvm/IR/AssemblyAnnotationWriter.h>
@@ -43,15 +45,22 @@
 
 #include <unistd.h>
 
+#include <algorithm>
 #include <string>
+#include <thread>
 #include <vector>
 
 // This file corresponds to the standalone bcinfo tool. It prints a variety of
-// information about a supplied bitcode input file.
+// information about a supplied bitcode input file, or, with --scan, a summary
+// of every bitcode file in a directory tree (see Scan.cpp).  With --compress,
+// it writes a copy of the wrapped input bitcode with a zstd-compressed payload
+// instead.
 
 std::string inFile;
 std::string outFile;
 std::string infoFile;
+std::string scanDir;
+std::string compressFile;
 
 extern int opterr;
 extern int optind;
@@ -59,10 +68,25 @@ extern int optind;
 bool translateFlag = false;
 bool infoFlag = false;
 bool verbose = true;
+bool jsonFlag = false;
+unsigned scanThreads = 0;
+
+enum {
+  OPT_SCAN = 256,
+  OPT_JSON,
+  OPT_COMPRESS,
+};
+
+static const struct option longOptions[] = {
+  {"scan", required_argument, nullptr, OPT_SCAN},
+  {"json", no_argument, nullptr, OPT_JSON},
+  {"compress", required_argument, nullptr, OPT_COMPRESS},
+  {nullptr, 0, nullptr, 0},
+};
 
 static int parseOption(int argc, char** argv) {
   int c;
-  while ((c = getopt(argc, argv, "itv")) != -1) {
+  while ((c = getopt_long(argc, argv, "itvj:", longOptions, nullptr)) != -1) {
     opterr = 0;
 
     switch(c) {
@@ -70,6 +94,22 @@ static int parseOption(int argc, char** argv) {
         // ignore any error
         break;
 
+      case OPT_SCAN:
+        scanDir = optarg;
+        break;
+
+      case OPT_JSON:
+        jsonFlag = true;
+        break;
+
+      case OPT_COMPRESS:
+        compressFile = optarg;
+        break;
+
+      case 'j':
+        scanThreads = atoi(optarg);
+        break;
+
       case 't':
         translateFlag = true;
         break;
@@ -91,6 +131,13 @@ static int parseOption(int argc, char** argv) {
     }
   }
 
+  if (!scanDir.empty()) {
+    if (scanThreads == 0) {
+      scanThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    return 1;
+  }
+
   if(optind >= argc) {
     fprintf(stderr, "input file required\n");
     return 0;
@@ -285,6 +332,41 @@ static size_t readBitcode(const char **bitcode) {
 }
 
 
+static int compressBitcode(const char *bitcode, size_t bitcodeSize) {
+  // The header fields of the wrapper are carried over.
+  bcinfo::BitcodeWrapper bcWrapper(bitcode, bitcodeSize);
+  if (bcWrapper.getBCFileType() != bcinfo::BC_WRAPPER ||
+      bcWrapper.isCompressed() ||
+      bcWrapper.getPayloadOffset() > bitcodeSize ||
+      bcWrapper.getPayloadSize() > bitcodeSize - bcWrapper.getPayloadOffset()) {
+    fprintf(stderr, "Only uncompressed wrapped bitcode can be compressed\n");
+    return 8;
+  }
+
+  std::vector<char> compressed;
+  if (!bcinfo::writeCompressedBitcode(
+          bitcode + bcWrapper.getPayloadOffset(), bcWrapper.getPayloadSize(),
+          bcWrapper.getTargetAPI(), bcWrapper.getCompilerVersion(),
+          bcWrapper.getOptimizationLevel(), compressed)) {
+    fprintf(stderr, "Failed to compress bitcode\n");
+    return 8;
+  }
+
+  FILE *out = fopen(compressFile.c_str(), "w");
+  if (!out) {
+    fprintf(stderr, "Could not open output file %s\n", compressFile.c_str());
+    return 8;
+  }
+  size_t nwritten = fwrite(compressed.data(), 1, compressed.size(), out);
+  fclose(out);
+  if (nwritten != compressed.size()) {
+    fprintf(stderr, "Could not write all of file %s\n", compressFile.c_str());
+    return 8;
+  }
+  return 0;
+}
+
+
 static void releaseBitcode(const char **bitcode) {
   if (bitcode && *bitcode) {
     free((void*) *bitcode);
@@ -300,9 +382,26 @@ int main(int argc, char** argv) {
     return 1;
   }
 
+  if (!scanDir.empty()) {
+    // Bitcode without a wrapper is handled as in the single file mode.
+    size_t numFailed = scanCorpus(scanDir, scanThreads, jsonFlag,
+                                  translateFlag ? 12 : 0);
+    if (numFailed) {
+      fprintf(stderr, "%zu files could not be scanned\n", numFailed);
+      return 7;
+    }
+    return 0;
+  }
+
   const char *bitcode = nullptr;
   size_t bitcodeSize = readBitcode(&bitcode);
 
+  if (!compressFile.empty()) {
+    int result = compressBitcode(bitcode, bitcodeSize);
+    releaseBitcode(&bitcode);
+    return result;
+  }
+
   unsigned int version = 0;
 
   bcinfo::BitcodeWrapper bcWrapper((const char *)bitcode, bitcodeSize);
@@ -318,7 +417,12 @@ int main(int argc, char** argv) {
   if (verbose) {
     printf("targetAPI: %u\n", version);
     printf("compilerVersion: %u\n", bcWrapper.getCompilerVersion());
-    printf("optimizationLevel: %u\n\n", bcWrapper.getOptimizationLevel());
+    printf("optimizationLevel: %u\n", bcWrapper.getOptimizationLevel());
+    if (bcWrapper.isCompressed()) {
+      printf("compression: %u (uncompressed size %u)\n",
+             bcWrapper.getCompression(), bcWrapper.getUncompressedSize());
+    }
+    printf("\n");
   }
 
   std::unique_ptr<bcinfo::BitcodeTranslator> BT;
@@ -17,11 +17,16 @@
 #ifndef BCC_COMPILER_H
 #define BCC_COMPILER_H
 
+#include <set>
+#include <string>
+
 namespace llvm {
 
 class raw_ostream;
 class raw_pwrite_stream;
 class DataLayout;
+class Module;
+class TargetLibraryInfoImpl;
 class TargetMachine;
 
 namespace legacy {
@@ -79,14 +84,45 @@ private:
   // Optimization is enabled by default.
   bool mEnableOpt;
 
-  enum ErrorCode runPasses(Script &pScript, llvm::raw_pwrite_stream &pResult);
-
-  bool addInternalizeSymbolsPass(Script &pScript, llvm::legacy::PassManager &pPM);
-  void addExpandKernelPass(llvm::legacy::PassManager &pPM);
+  enum ErrorCode runTransformPasses(Script &pScript);
+
+  // Whether the loop vectorizer runs on the expanded kernel loops of pScript,
+  // which the kernel expansion only prepares them for when it does.
+  bool vectorizesKernelLoops(const Script &pScript) const;
+
+  // Whether the target has vector length agnostic vectors (RVV, SVE), which
+  // let the loop vectorizer handle the tail of a loop with predication.
+  bool hasScalableVectors() const;
+
+  // Collect the names of the symbols that the runtime looks up in a compiled
+  // script. Return false on error.
+  bool collectExportedSymbols(Script &pScript,
+                              std::set<std::string> &pExportedSymbols);
+
+  // Internalize the symbols that the runtime doesn't look up, but
+  // pKeepSymbols.
+  bool addInternalizeSymbolsPass(
+      Script &pScript, llvm::legacy::PassManager &pPM,
+      const std::set<std::string> &pKeepSymbols = std::set<std::string>());
+
+  // Let the loop vectorizer replace the calls that the kernels make to the
+  // math functions of the runtime with calls to their float2 or float4
+  // overloads, by adding the overloads the module defines to pTLII.  Their
+  // names are added to pVectorFunctions.
+  void addVectorMathFunctions(Script &pScript,
+                              llvm::TargetLibraryInfoImpl &pTLII,
+                              std::set<std::string> &pVectorFunctions);
+
+  void addEvaluateInitPass(Script &pScript, llvm::legacy::PassManager &pPM);
+  void addExpandKernelPass(Script &pScript, llvm::legacy::PassManager &pPM);
+  void addKernelTuningPass(Script &pScript, llvm::legacy::PassManager &pPM);
+  void addBoundsCheckHoistingPass(Script &pScript,
+                                  llvm::legacy::PassManager &pPM);
   void addDebugInfoPass(Script &pScript, llvm::legacy::PassManager &pPM);
   void addGlobalInfoPass(Script &pScript, llvm::legacy::PassManager &pPM);
   void addInvariantPass(llvm::legacy::PassManager &pPM);
   void addInvokeHelperPass(llvm::legacy::PassManager &pPM);
+  void addCallConvPass(llvm::legacy::PassManager &pPM);
 
 public:
   Compiler();
@@ -101,6 +137,21 @@ public:
   enum ErrorCode compile(Script &pScript, llvm::raw_pwrite_stream &pResult,
                          llvm::raw_ostream *IRStream);
 
+  // Run the passes of compile() on a script, without generating code for it.
+  enum ErrorCode optimize(Script &pScript);
+
+  // Finish a module that the scripts optimized with a deferred runtime (see
+  // Script::setDeferRuntime()) were linked into, along with the runtime:
+  // internalize everything but pExportedSymbols, drop what is unused, and
+  // correct the calling convention of the calls into the runtime.
+  enum ErrorCode runCombinedPasses(llvm::Module &pModule,
+                                   const std::set<std::string> &pExportedSymbols);
+
+  // Generate code for an optimized module and output the object to a LLVM
+  // stream.
+  enum ErrorCode generateCode(llvm::Module &pModule,
+                              llvm::raw_pwrite_stream &pResult);
+
   const llvm::TargetMachine& getTargetMachine() const
   { return *mTarget; }
 
@@ -109,12 +160,14 @@ public:
 
   ~Compiler();
 
-  // Compare undefined external functions in pScript against a list of allowed
-  // RenderScript functions.  Returns error if any external function that is
-  // not in this list is callable from the script.
-  enum ErrorCode screenGlobalFunctions(Script &pScript);
-
-  void translateGEPs(Script &pScript);
+  // Run the passes that have to see pScript before the runtime is linked in,
+  // in a single pass manager run:
+  // - Compare undefined external functions in pScript against a list of
+  //   allowed RenderScript functions.  Returns error if any external function
+  //   that is not in this list is callable from the script.
+  // - If pTranslateGEPs is true, translate GEPs on structs to GEPs on int8*
+  //   with byte offsets (see RSX86TranslateGEPPass).
+  enum ErrorCode runPreLinkPasses(Script &pScript, bool pTranslateGEPs);
 };
 
 } // end namespace bcc
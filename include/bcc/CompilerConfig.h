@@ -54,6 +54,9 @@ private:
   // Are we set up to compile for full precision or something reduced?
   bool mFullPrecision;
 
+  // Whether to generate SVE code on AArch64 (see initializeArch()).
+  bool mEnableSVE;
+
   // The list of target specific features to enable or disable -- this should
   // be a list of strings starting with '+' (enable) or '-' (disable).
   std::string mFeatureString;
@@ -114,6 +117,14 @@ public:
     initializeArch();
   }
 
+  inline bool getEnableSVE() const
+  { return mEnableSVE; }
+  inline void setEnableSVE(bool pEnableSVE) {
+    mEnableSVE = pEnableSVE;
+    // As for setFullPrecision(), mFeatureString has to be recomputed.
+    initializeArch();
+  }
+
   inline const std::string &getFeatureString() const
   { return mFeatureString; }
   void setFeatureString(const std::vector<std::string> &pAttrs);
@@ -48,6 +48,11 @@
   #define PROVIDE_X86_CODEGEN 1
   #define DEFAULT_X86_64_CODEGEN 1
 
+#elif defined(FORCE_RISCV64_CODEGEN)
+  // Only set by riscv64 device builds, whose LLVM has a RISC-V backend.
+  #define PROVIDE_RISCV64_CODEGEN 1
+  #define DEFAULT_RISCV64_CODEGEN 1
+
 #else
   #define PROVIDE_ARM_CODEGEN 1
   #define PROVIDE_ARM64_CODEGEN 1
@@ -80,6 +85,7 @@
 #define DEFAULT_MIPS64_TRIPLE_STRING   "mips64el-none-linux-gnueabi"
 #define DEFAULT_X86_TRIPLE_STRING      "i686-unknown-linux"
 #define DEFAULT_X86_64_TRIPLE_STRING   "x86_64-unknown-linux"
+#define DEFAULT_RISCV64_TRIPLE_STRING  "riscv64-unknown-linux"
 
 // Custom DataLayout string for X86 with i64 and f64 set to match the ARM32
 // alignment requirement of 64-bits.
@@ -100,6 +106,8 @@
   #define DEFAULT_TARGET_TRIPLE_STRING DEFAULT_X86_TRIPLE_STRING
 #elif defined(DEFAULT_X86_64_CODEGEN)
   #define DEFAULT_TARGET_TRIPLE_STRING DEFAULT_X86_64_TRIPLE_STRING
+#elif defined(DEFAULT_RISCV64_CODEGEN)
+  #define DEFAULT_TARGET_TRIPLE_STRING DEFAULT_RISCV64_TRIPLE_STRING
 #endif
 
 #if (defined(__VFP_FP__) && !defined(__SOFTFP__))
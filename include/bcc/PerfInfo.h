@@ -0,0 +1,78 @@
+/*
+ * Copyright 2026, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BCC_PERF_INFO_H
+#define BCC_PERF_INFO_H
+
+#include <llvm/ADT/StringRef.h>
+
+#include <cstdint>
+#include <string>
+
+namespace bcc {
+
+// How to describe the code of a loaded script to Linux perf.
+enum PerfInfoFormat {
+  // Append "<start> <size> <name>" lines to /tmp/perf-<pid>.map.  perf reads
+  // them for the samples it can't attribute to a file mapping.
+  kPerfMap,
+
+  // Append code load records, with the code bytes and the line tables, to
+  // /tmp/jit-<pid>.dump, for "perf record -k mono" and "perf inject --jit".
+  // The file is mapped into the process, so that perf finds it.
+  kJitDump
+};
+
+/// @brief Tell Linux perf about the functions of a script that was loaded
+/// into the current process, such as a shared object the RSCompilerDriver
+/// built and the runtime mapped from its cache directory.
+///
+/// Every function symbol of the image is described, including the local ones
+/// like expanded and fused kernels, if the image still has its symbol table;
+/// only the exported functions are described otherwise.  Line tables are
+/// taken from the .debug_line section, if there is one (see
+/// RSCompilerDriver::setLineTablesOnly()).
+///
+/// Only Linux hosts are supported.  This function is thread-safe.
+///
+/// @param pFormat The format to write the information in.
+/// @param pImage The contents of the loaded ELF64 shared object or
+/// executable.
+/// @param pLoadBias The difference between the address at which the image
+/// was loaded and the virtual addresses it was linked at.
+/// @param pError The reason for the failure, on failure.
+/// @return True, if the information was written.
+bool writePerfInfo(PerfInfoFormat pFormat, llvm::StringRef pImage,
+                   uint64_t pLoadBias, std::string &pError);
+
+/// @brief Write a perf map of the functions of a shared object at the
+/// addresses it was linked at, for a loader that can't call writePerfInfo()
+/// to add its load address to them, or for symbolizing offline.
+///
+/// The functions are described as by writePerfInfo(pFormat = kPerfMap), and
+/// their names are followed by " (<file>:<line>)", the source location of
+/// their first instruction, if the image has line tables.
+///
+/// @param pImage The contents of the ELF64 shared object or executable.
+/// @param pPath The file to write the map to, which is overwritten.
+/// @param pError The reason for the failure, on failure.
+/// @return True, if the map was written.
+bool writePerfMapFile(llvm::StringRef pImage, const std::string &pPath,
+                      std::string &pError);
+
+}  // end namespace bcc
+
+#endif  // BCC_PERF_INFO_H
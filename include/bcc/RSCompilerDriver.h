@@ -26,12 +26,19 @@
 #include <string>
 #include <vector>
 
+namespace llvm {
+class raw_ostream;
+class raw_pwrite_stream;
+template <typename T> class SmallVectorImpl;
+}
+
 namespace bcc {
 
 class BCCContext;
 class CompilerConfig;
 class RSCompilerDriver;
 class Source;
+class TuningDatabase;
 
 // Type signature for dynamically loaded initialization of an RSCompilerDriver.
 typedef void (*RSCompilerDriverInit_t) (bcc::RSCompilerDriver *);
@@ -39,6 +46,10 @@ typedef void (*RSCompilerDriverInit_t) (bcc::RSCompilerDriver *);
 #define RS_COMPILER_DRIVER_INIT_FN rsCompilerDriverInit
 
 class RSCompilerDriver {
+public:
+  // The name (and DT_NEEDED entry) of the shared runtime object.
+  static const char kSharedRuntimeName[];
+
 private:
   CompilerConfig *mConfig;
   Compiler mCompiler;
@@ -64,10 +75,94 @@ private:
   // when potentially embedding information about globals.
   bool mEmbedGlobalInfoSkipConstant;
 
+  // Optional database of per-kernel codegen parameters (not owned).
+  TuningDatabase *mTuningDatabase;
+
+  // Whether to reduce the dynamic relocations and symbols of the compiled
+  // script: position-relative .rs.* tables, hidden visibility outside the
+  // export set and local-binding calls.
+  bool mMinimizeRelocations;
+
+  // Whether to embed a single table of all the script's entry points, so
+  // that the runtime can resolve them with one symbol lookup.
+  bool mEmbedEntryTable;
+
+  // Whether to instrument script entry points with runtime counters, exported
+  // as .rs.kernel_stats.
+  bool mEmbedKernelStats;
+
+  // Whether to vectorize kernel loops over small vector and struct elements
+  // (e.g. uchar4 pixels) as interleaved access groups.
+  bool mEnableInterleavedAccess;
+
+  // Whether to fuse consecutive forEach launches in the functions of the script.
+  bool mFuseForEach;
+
+  // Whether to turn the data-parallel loops of invokables into kernel
+  // launches.
+  bool mParallelizeInvokables;
+
+  // Whether to try to run init() at compile time and bake its results into the
+  // global initializers.
+  bool mEvaluateInit;
+
+  // Whether to resolve the runtime functions that aren't inlined against one
+  // shared, precompiled runtime object (see buildSharedRuntime()) at load
+  // time, instead of giving every script its own copy.
+  bool mShareRuntime;
+
+  // Alignment in bytes that the runtime guarantees for allocation base
+  // addresses, or 0 for none.
+  unsigned mAllocationAlignment;
+
+  // Directory where machine code is cached per function between builds, or
+  // empty to always generate code for the whole module.
+  std::string mIncrementalCacheDir;
+
+  // Whether to emit only line tables as debug info, without lowering the
+  // optimization level.
+  bool mLineTablesOnly;
+
+  // Whether to run the loop vectorizer on the expanded kernel loops.
+  bool mVectorizeKernels;
+
+  // Whether compileScript() links the object into a loadable shared object
+  // ({name}.so instead of {name}.o) with the built-in linker.
+  bool mEmitSharedObject;
+
+  // The DT_NEEDED entries of the shared objects produced by the built-in
+  // linker.
+  std::vector<std::string> mSharedObjectDependencies;
+
+  // Whether to write a perf map ({name}.so.map) next to the shared objects
+  // produced by the built-in linker.
+  bool mEmitPerfMap;
+
   // Setup the compiler config for the given script. Return true if mConfig has
   // been changed and false if it remains unchanged.
   bool setupConfig(const Script &pScript);
 
+  // Screens the provided bitcode and links it with the runtime at
+  // pRuntimePath, ready to be handed to emitScript().
+  Compiler::ErrorCode prepareScript(Script& pScript, const char* pScriptName,
+                                    const char* pRuntimePath,
+                                    const char* pBuildChecksum);
+
+  // Configures the compiler for pScript.
+  Compiler::ErrorCode configCompiler(const Script& pScript,
+                                     const char* pScriptName);
+
+  // Configures the compiler for pScript and writes the object to pResult.
+  Compiler::ErrorCode emitScript(Script& pScript, const char* pScriptName,
+                                 llvm::raw_pwrite_stream& pResult,
+                                 llvm::raw_ostream* pIRStream);
+
+  // Emits pScript and links it into a shared object next to pOutputPath
+  // (with the .so extension), or writes the object to pOutputPath if it can't
+  // be linked.  Whichever of the two files isn't written is removed.
+  Compiler::ErrorCode emitSharedObject(Script& pScript, const char* pOutputPath,
+                                       llvm::raw_ostream* pIRStream);
+
   // Compiles the provided bitcode, placing the binary at pOutputPath.
   // - If pDumpIR is true, a ".ll" file will also be created.
   Compiler::ErrorCode compileScript(Script& pScript, const char* pScriptName,
@@ -76,6 +171,34 @@ private:
                                     const char* pBuildChecksum,
                                     bool pDumpIR);
 
+  // Compiles the provided bitcode, writing the binary to pResult without
+  // touching the filesystem.
+  Compiler::ErrorCode compileScript(Script& pScript, const char* pScriptName,
+                                    llvm::raw_pwrite_stream& pResult,
+                                    const char* pRuntimePath,
+                                    const char* pBuildChecksum);
+
+  // Shared implementation of build() and buildInMemory(). The object is
+  // written to pResult if it is non-null, and to pOutputPath otherwise.
+  bool buildScript(BCCContext& pContext, const char* pResName,
+                   const char* pBitcode, size_t pBitcodeSize,
+                   const char* pBuildChecksum, const char* pRuntimePath,
+                   RSLinkRuntimeCallback pLinkRuntimeCallback,
+                   const char* pOutputPath, bool pDumpIR,
+                   llvm::raw_pwrite_stream* pResult);
+
+  // Shared implementation of buildScriptGroup() and
+  // buildScriptGroupInMemory(), with the same convention for pResult.
+  bool compileScriptGroup(
+      BCCContext& Context, const char* pOutputFilepath, const char* pRuntimePath,
+      const char* pRuntimeRelaxedPath, bool dumpIR, const char* buildChecksum,
+      const std::vector<Source*>& sources,
+      const std::list<std::list<std::pair<int, int>>>& toFuse,
+      const std::list<std::string>& fused,
+      const std::list<std::list<std::pair<int, int>>>& invokes,
+      const std::list<std::string>& invokeBatchNames,
+      llvm::raw_pwrite_stream* pResult);
+
 public:
   RSCompilerDriver();
   ~RSCompilerDriver();
@@ -137,6 +260,166 @@ public:
     return mEmbedGlobalInfoSkipConstant;
   }
 
+  // Set the database used to look up tuned codegen parameters for kernels.
+  // Kernels that are not in the database are recorded into it.
+  void setTuningDatabase(TuningDatabase *pDatabase) {
+    mTuningDatabase = pDatabase;
+  }
+
+  TuningDatabase *getTuningDatabase() const {
+    return mTuningDatabase;
+  }
+
+  void setMinimizeRelocations(bool v) {
+    mMinimizeRelocations = v;
+  }
+
+  bool getMinimizeRelocations() const {
+    return mMinimizeRelocations;
+  }
+
+  void setEmbedEntryTable(bool v) {
+    mEmbedEntryTable = v;
+  }
+
+  bool getEmbedEntryTable() const {
+    return mEmbedEntryTable;
+  }
+
+  void setEmbedKernelStats(bool v) {
+    mEmbedKernelStats = v;
+  }
+
+  bool getEmbedKernelStats() const {
+    return mEmbedKernelStats;
+  }
+
+  void setEnableInterleavedAccess(bool v) {
+    mEnableInterleavedAccess = v;
+  }
+
+  bool getEnableInterleavedAccess() const {
+    return mEnableInterleavedAccess;
+  }
+
+  void setFuseForEach(bool v) {
+    mFuseForEach = v;
+  }
+
+  bool getFuseForEach() const {
+    return mFuseForEach;
+  }
+
+  void setParallelizeInvokables(bool v) {
+    mParallelizeInvokables = v;
+  }
+
+  bool getParallelizeInvokables() const {
+    return mParallelizeInvokables;
+  }
+
+  void setEvaluateInit(bool v) {
+    mEvaluateInit = v;
+  }
+
+  bool getEvaluateInit() const {
+    return mEvaluateInit;
+  }
+
+  // Set to true to leave the runtime functions that aren't inlined out of the
+  // scripts.  The shared objects produced by the built-in linker then have
+  // kSharedRuntimeName among their DT_NEEDED entries; it is built by
+  // buildSharedRuntime().
+  void setShareRuntime(bool v) {
+    mShareRuntime = v;
+  }
+
+  bool getShareRuntime() const {
+    return mShareRuntime;
+  }
+
+  // Set the alignment (a power of 2, in bytes) that the runtime guarantees
+  // for the base address of allocations.  Expanded kernels then run a copy of
+  // their loop that assumes this alignment when the allocations they are
+  // handed are aligned.
+  void setAllocationAlignment(unsigned v) {
+    mAllocationAlignment = v;
+  }
+
+  unsigned getAllocationAlignment() const {
+    return mAllocationAlignment;
+  }
+
+  // Set a directory in which to cache the machine code of every function of
+  // the scripts, keyed by a hash of the function's optimized IR and the code
+  // generation options.  Rebuilds then only generate code for the functions
+  // that changed.  The directory is created if it doesn't exist; removing
+  // stale entries is left to the caller.
+  void setIncrementalCacheDir(const std::string &v) {
+    mIncrementalCacheDir = v;
+  }
+
+  const std::string &getIncrementalCacheDir() const {
+    return mIncrementalCacheDir;
+  }
+
+  // Set to true to compile scripts for sample profilers: the scripts are
+  // optimized at the highest level whatever level their bitcode asks for, and
+  // the only debug info emitted is line tables, which also cover the
+  // generated expanded kernels and fused kernels.  Variable locations and
+  // types of scripts compiled with full debug info are dropped.
+  void setLineTablesOnly(bool v) {
+    mLineTablesOnly = v;
+  }
+
+  bool getLineTablesOnly() const {
+    return mLineTablesOnly;
+  }
+
+  // Set to true to run the loop vectorizer on the expanded kernel loops of
+  // optimized scripts, on targets where it isn't run anyway.  The calls that
+  // kernels make to the math functions of the runtime are then widened into
+  // calls to their float2 or float4 overloads.
+  void setVectorizeKernels(bool v) {
+    mVectorizeKernels = v;
+  }
+
+  bool getVectorizeKernels() const {
+    return mVectorizeKernels;
+  }
+
+  // Set to true to have build() and buildScriptGroup() place a shared object
+  // at {name}.so that can be loaded without running an external linker.  If
+  // the object can't be linked by the built-in linker, {name}.o is written as
+  // before.  Either way, the other file is removed if it exists.
+  void setEmitSharedObject(bool v) {
+    mEmitSharedObject = v;
+  }
+
+  bool getEmitSharedObject() const {
+    return mEmitSharedObject;
+  }
+
+  void setSharedObjectDependencies(const std::vector<std::string> &v) {
+    mSharedObjectDependencies = v;
+  }
+
+  const std::vector<std::string> &getSharedObjectDependencies() const {
+    return mSharedObjectDependencies;
+  }
+
+  // Set to true to write a perf map of every shared object the built-in
+  // linker produces to {name}.so.map, at the addresses the object was linked
+  // at (see writePerfMapFile()).  The loader adds its load address to them,
+  // or calls writePerfInfo() instead.
+  void setEmitPerfMap(bool v) {
+    mEmitPerfMap = v;
+  }
+
+  bool getEmitPerfMap() const {
+    return mEmitPerfMap;
+  }
+
   // FIXME: This method accompany with loadScript and compileScript should
   //        all be const-methods. They're not now because the getAddress() in
   //        SymbolResolverInterface is not a const-method.
@@ -156,10 +439,53 @@ public:
       const std::list<std::list<std::pair<int, int>>>& invokes,
       const std::list<std::string>& invokeBatchNames);
 
+  // Same as build(), but the object is placed in pObject instead of
+  // {pCacheDir}/{pResName}.o.  Nothing is written to the filesystem, so the
+  // caller decides whether (and where) the object is persisted.
+  bool buildInMemory(BCCContext& pContext, const char* pResName,
+                     const char* pBitcode, size_t pBitcodeSize,
+                     const char* pBuildChecksum, const char* pRuntimePath,
+                     llvm::SmallVectorImpl<char>& pObject,
+                     RSLinkRuntimeCallback pLinkRuntimeCallback = nullptr);
+
+  // Same as buildScriptGroup(), but the object is placed in pObject.
+  // pScriptName only names the merged script in diagnostics.
+  bool buildScriptGroupInMemory(
+      BCCContext& Context, const char* pScriptName, const char* pRuntimePath,
+      const char* pRuntimeRelaxedPath, const char* buildChecksum,
+      const std::vector<Source*>& sources,
+      const std::list<std::list<std::pair<int, int>>>& toFuse,
+      const std::list<std::string>& fused,
+      const std::list<std::list<std::pair<int, int>>>& invokes,
+      const std::list<std::string>& invokeBatchNames,
+      llvm::SmallVectorImpl<char>& pObject);
+
+  // Compile the runtime at pRuntimePath into the shared object that the
+  // scripts compiled with setShareRuntime(true) resolve their runtime calls
+  // against, and place it at {pOutputDir}/{kSharedRuntimeName}.  It depends
+  // on getSharedObjectDependencies().
+  // Returns true if the shared object is successfully built.
+  bool buildSharedRuntime(BCCContext &pContext, const char *pOutputDir,
+                          const char *pRuntimePath);
+
   // Returns true if script is successfully compiled.
   bool buildForCompatLib(Script &pScript, const char *pOut,
                          const char *pBuildChecksum, const char *pRuntimePath,
                          bool pDumpIR);
+
+  // Same as buildForCompatLib(), but compiles all of pScripts (the scripts of
+  // an app) into a single object at pOut, so that the support library loads
+  // one shared object for all of them.  The symbols defined by pScripts[i],
+  // including its .rs.info, are prefixed with pNames[i] followed by '.', and
+  // the runtime functions that aren't inlined are only emitted once.  The
+  // names have to be distinct.  pScripts[0] holds the combined module
+  // afterwards.
+  // Returns true if the scripts are successfully compiled.
+  bool buildCombinedForCompatLib(BCCContext &pContext,
+                                 const std::vector<Script *> &pScripts,
+                                 const std::vector<std::string> &pNames,
+                                 const char *pOut, const char *pBuildChecksum,
+                                 const char *pRuntimePath);
 };
 
 } // end namespace bcc
@@ -22,6 +22,8 @@
 #include <llvm/Support/CodeGen.h>
 #include "bcc/Source.h"
 
+#include <string>
+
 namespace llvm {
 class Module;
 }
@@ -31,6 +33,7 @@ namespace bcc {
 class Script;
 class Source;
 class CompilerConfig;
+class TuningDatabase;
 
 typedef llvm::Module *(*RSLinkRuntimeCallback)(bcc::Script *, llvm::Module *,
                                                llvm::Module *);
@@ -56,11 +59,73 @@ private:
   // when potentially embedding information about globals.
   bool mEmbedGlobalInfoSkipConstant;
 
+  // Optional database of per-kernel codegen parameters (not owned).
+  TuningDatabase *mTuningDatabase;
+
+  // Whether to emit position-relative .rs.* tables and bind everything
+  // outside the export set locally.
+  bool mMinimizeRelocations;
+
+  // Whether to embed the .rs.entry_table of script entry points.
+  bool mEmbedEntryTable;
+
+  // Whether to instrument entry points with counters in .rs.kernel_stats.
+  bool mEmbedKernelStats;
+
+  // Whether to lower kernel accesses to small vector and struct elements so
+  // that they can be vectorized as interleaved access groups.
+  bool mEnableInterleavedAccess;
+
+  // Whether to fuse consecutive forEach launches in the functions of the script.
+  bool mFuseForEach;
+
+  // Whether to outline the data-parallel loops of invokables into kernels
+  // launched on all cores.
+  bool mParallelizeInvokables;
+
+  // Whether to try to run init() at compile time and bake its results into the
+  // global initializers.
+  bool mEvaluateInit;
+
+  // Whether to leave the runtime functions that aren't inlined as external
+  // references to a shared runtime object instead of copying them in.
+  bool mShareRuntime;
+
+  // Alignment in bytes that the runtime guarantees for allocation base
+  // addresses, or 0 if kernels can't rely on any.
+  unsigned mAllocationAlignment;
+
+  // Directory of the machine code cached per function by the incremental
+  // code generator, or empty to generate code for the whole module.
+  std::string mIncrementalCacheDir;
+
+  // Whether the script is linked against the debug runtime, whose element
+  // accessors check their arguments, and these checks should be done once
+  // per launch where possible.
+  bool mHoistBoundsChecks;
+
+  // Whether the runtime functions that aren't inlined are left out of the
+  // script, to be linked in once for all the scripts of a combined object.
+  bool mDeferRuntime;
+
+  // Whether to only emit line tables, for the generated code as well as for
+  // the source, so that an optimized script can be profiled.
+  bool mLineTablesOnly;
+
+  // Whether to run the loop vectorizer on the expanded kernel loops, letting
+  // it call the vector overloads of the runtime math functions.
+  bool mVectorizeKernels;
+
 public:
   explicit Script(Source *pSource);
 
   ~Script() {}
 
+  // Load the Renderscript runtime library rt_path, prepared for being merged
+  // into the source of this script (or into one it was combined into).
+  // Return nullptr on error.
+  Source *LoadRuntime(const char *rt_path);
+
   bool LinkRuntime(const char *rt_path);
 
   unsigned getCompilerVersion() const {
@@ -105,6 +170,100 @@ public:
     return mEmbedGlobalInfoSkipConstant;
   }
 
+  // Set the database used to look up per-kernel codegen parameters. A null
+  // database means that the default heuristics are used for every kernel.
+  void setTuningDatabase(TuningDatabase *pDatabase) {
+    mTuningDatabase = pDatabase;
+  }
+
+  TuningDatabase *getTuningDatabase() const { return mTuningDatabase; }
+
+  void setMinimizeRelocations(bool pEnable) {
+    mMinimizeRelocations = pEnable;
+  }
+
+  bool getMinimizeRelocations() const { return mMinimizeRelocations; }
+
+  void setEmbedEntryTable(bool pEnable) {
+    mEmbedEntryTable = pEnable;
+  }
+
+  bool getEmbedEntryTable() const { return mEmbedEntryTable; }
+
+  void setEmbedKernelStats(bool pEnable) {
+    mEmbedKernelStats = pEnable;
+  }
+
+  bool getEmbedKernelStats() const { return mEmbedKernelStats; }
+
+  void setEnableInterleavedAccess(bool pEnable) {
+    mEnableInterleavedAccess = pEnable;
+  }
+
+  bool getEnableInterleavedAccess() const { return mEnableInterleavedAccess; }
+
+  void setFuseForEach(bool pEnable) {
+    mFuseForEach = pEnable;
+  }
+
+  bool getFuseForEach() const { return mFuseForEach; }
+
+  void setParallelizeInvokables(bool pEnable) {
+    mParallelizeInvokables = pEnable;
+  }
+
+  bool getParallelizeInvokables() const { return mParallelizeInvokables; }
+
+  void setEvaluateInit(bool pEnable) {
+    mEvaluateInit = pEnable;
+  }
+
+  bool getEvaluateInit() const { return mEvaluateInit; }
+
+  void setShareRuntime(bool pEnable) {
+    mShareRuntime = pEnable;
+  }
+
+  bool getShareRuntime() const { return mShareRuntime; }
+
+  void setAllocationAlignment(unsigned pAlignment) {
+    mAllocationAlignment = pAlignment;
+  }
+
+  unsigned getAllocationAlignment() const { return mAllocationAlignment; }
+
+  void setIncrementalCacheDir(const std::string &pDir) {
+    mIncrementalCacheDir = pDir;
+  }
+
+  const std::string &getIncrementalCacheDir() const {
+    return mIncrementalCacheDir;
+  }
+
+  void setHoistBoundsChecks(bool pEnable) {
+    mHoistBoundsChecks = pEnable;
+  }
+
+  bool getHoistBoundsChecks() const { return mHoistBoundsChecks; }
+
+  void setDeferRuntime(bool pEnable) {
+    mDeferRuntime = pEnable;
+  }
+
+  bool getDeferRuntime() const { return mDeferRuntime; }
+
+  void setLineTablesOnly(bool pEnable) {
+    mLineTablesOnly = pEnable;
+  }
+
+  bool getLineTablesOnly() const { return mLineTablesOnly; }
+
+  void setVectorizeKernels(bool pEnable) {
+    mVectorizeKernels = pEnable;
+  }
+
+  bool getVectorizeKernels() const { return mVectorizeKernels; }
+
   // Merge (or link) another source into the current source associated with
   // this Script object. Return false on error.
   //
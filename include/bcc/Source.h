@@ -72,7 +72,10 @@ public:
 
   // Merge the current source with pSource. pSource
   // will be destroyed after successfully merged. Return false on error.
-  bool merge(Source &pSource);
+  //
+  // If pOnlyNeeded is true, only the definitions of pSource that the current
+  // source refers to are linked in.
+  bool merge(Source &pSource, bool pOnlyNeeded = false);
 
   unsigned getCompilerVersion() const;
 
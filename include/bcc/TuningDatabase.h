@@ -0,0 +1,107 @@
+/*
+ * Copyright 2026, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BCC_TUNING_DATABASE_H
+#define BCC_TUNING_DATABASE_H
+
+#include <map>
+#include <string>
+#include <utility>
+
+namespace llvm {
+class Function;
+}
+
+namespace bcc {
+
+// Codegen parameters for the loop of one expanded kernel (<NAME>.expand).
+// A value of 0 leaves the corresponding decision to LLVM's heuristics.
+struct KernelTuningParams {
+  unsigned mUnrollCount;
+  unsigned mVectorizeWidth;
+  unsigned mInterleaveCount;
+
+  KernelTuningParams()
+    : mUnrollCount(0), mVectorizeWidth(0), mInterleaveCount(0) { }
+
+  bool isDefault() const {
+    return (mUnrollCount == 0) && (mVectorizeWidth == 0) &&
+           (mInterleaveCount == 0);
+  }
+};
+
+//===----------------------------------------------------------------------===//
+// TuningDatabase
+//===----------------------------------------------------------------------===//
+// Persistent map from (CPU model, kernel IR hash) to the KernelTuningParams
+// that should be applied when compiling that kernel for that CPU.  Entries are
+// produced offline by measuring candidate variants on the device; the
+// compiler only consumes them.
+//
+// The on-disk format is line oriented text:
+//
+//   # <cpu> <ir-hash> <unroll> <vectorize-width> <interleave> [<kernel-name>]
+//   cortex-a57 5d41402abc4b2a76b9719d911017c592 4 4 2 root
+//
+// Kernels that were looked up but not found are remembered (with default
+// parameters) so that a tuning harness can pick them up from the saved file.
+class TuningDatabase {
+public:
+  typedef std::pair<std::string, std::string> Key;  // (cpu, ir-hash)
+
+private:
+  struct Entry {
+    KernelTuningParams mParams;
+    std::string mKernelName;
+  };
+
+  std::map<Key, Entry> mEntries;
+
+  // Set when lookup() recorded a kernel that wasn't in the database yet.
+  bool mDirty;
+
+public:
+  TuningDatabase() : mDirty(false) { }
+
+  // Load entries from pPath, merging them into this database. Return false
+  // if the file cannot be read or is malformed.
+  bool load(const char *pPath);
+
+  // Write all entries to pPath. Return false on error.
+  bool save(const char *pPath) const;
+
+  // Return the parameters recorded for the kernel with the given hash on
+  // the given CPU.  If there are none, the kernel is remembered with default
+  // parameters and a default-constructed KernelTuningParams is returned.
+  KernelTuningParams lookup(const std::string &pCPU, const std::string &pHash,
+                            const std::string &pKernelName);
+
+  void insert(const std::string &pCPU, const std::string &pHash,
+              const std::string &pKernelName,
+              const KernelTuningParams &pParams);
+
+  bool isDirty() const { return mDirty; }
+
+  // Compute the key used to identify pKernel in the database: a hex MD5 of
+  // the kernel function's textual IR before expansion and optimization,
+  // printed without debug info in a module that defines nothing else, so that
+  // the key doesn't change with the rest of the script.
+  static std::string hashKernel(const llvm::Function &pKernel);
+};
+
+} // end namespace bcc
+
+#endif // BCC_TUNING_DATABASE_H
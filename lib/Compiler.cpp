@@ -15,7 +15,9 @@
  */
 
 #include "Assert.h"
+#include "IncrementalCodeGen.h"
 #include "Log.h"
+#include "RSFunctionsList.h"
 #include "RSTransforms.h"
 #include "RSUtils.h"
 #include "rsDefines.h"
@@ -28,10 +30,15 @@
 #include "bcinfo/MetadataExtractor.h"
 
 #include <llvm/Analysis/Passes.h>
+#include <llvm/Analysis/TargetLibraryInfo.h>
 #include <llvm/Analysis/TargetTransformInfo.h>
 #include <llvm/CodeGen/RegAllocRegistry.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Instructions.h>
 #include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Metadata.h>
 #include <llvm/IR/Module.h>
+#include <llvm/MC/SubtargetFeature.h>
 #include <llvm/Support/TargetRegistry.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/IR/DataLayout.h>
@@ -42,8 +49,13 @@
 #include <llvm/Transforms/Scalar.h>
 #include <llvm/Transforms/Vectorize.h>
 
+#include <algorithm>
+#include <cctype>
+#include <map>
 #include <string>
 #include <set>
+#include <string_view>
+#include <vector>
 
 namespace {
 
@@ -111,6 +123,61 @@ bool validateLayoutOfExportedTypes(const llvm::Module &module,
   return allOk;
 }
 
+// The runtime functions that take floats and whose vector overloads don't
+// work element by element.
+const char *const NonElementwiseMathFunctions[] = {
+  "normalize", "fast_normalize", "native_normalize"
+};
+
+// Pair every runtime function that takes and returns floats with its
+// overloads for float2 and float4, e.g. _Z3sinf with _Z3sinDv2_f and
+// _Z3sinDv4_f, or _Z3powff with _Z3powDv4_fS_.  The names point into
+// stubList.
+const std::vector<llvm::VecDesc> &getVectorMathFunctions() {
+  static const std::vector<llvm::VecDesc> descs = [] {
+    const std::set<std::string_view> names(stubList.begin(), stubList.end());
+    std::vector<llvm::VecDesc> result;
+    for (std::string_view scalar : names) {
+      // _Z<length><name><parameters>
+      if (scalar.substr(0, 2) != "_Z") {
+        continue;
+      }
+      size_t pos = 2;
+      size_t length = 0;
+      while ((pos < scalar.size()) && isdigit(scalar[pos])) {
+        length = length * 10 + (scalar[pos++] - '0');
+      }
+      if ((length == 0) || (pos + length >= scalar.size())) {
+        continue;
+      }
+      const std::string_view name = scalar.substr(pos, length);
+      const std::string_view params = scalar.substr(pos + length);
+      if ((params != "f") && (params != "ff") && (params != "fff")) {
+        continue;
+      }
+      if (std::find(std::begin(NonElementwiseMathFunctions),
+                    std::end(NonElementwiseMathFunctions), name) !=
+          std::end(NonElementwiseMathFunctions)) {
+        continue;
+      }
+
+      for (unsigned width : {2, 4}) {
+        std::string vector(scalar.substr(0, pos + length));
+        vector += "Dv" + std::to_string(width) + "_f";
+        for (size_t i = 1; i < params.size(); ++i) {
+          vector += "S_";
+        }
+        auto found = names.find(vector);
+        if (found != names.end()) {
+          result.push_back({scalar.data(), found->data(), width});
+        }
+      }
+    }
+    return result;
+  }();
+  return descs;
+}
+
 }  // end unnamed namespace
 
 using namespace bcc;
@@ -218,24 +285,32 @@ Compiler::~Compiler() {
 
 // This function has complete responsibility for creating and executing the
 // exact list of compiler passes.
-enum Compiler::ErrorCode Compiler::runPasses(Script &script,
-                                             llvm::raw_pwrite_stream &pResult) {
+enum Compiler::ErrorCode Compiler::runTransformPasses(Script &script) {
   // Pass manager for link-time optimization
   llvm::legacy::PassManager transformPasses;
 
-  // Empty MCContext.
-  llvm::MCContext *mc_context = nullptr;
-
   transformPasses.add(
       createTargetTransformInfoWrapperPass(mTarget->getTargetIRAnalysis()));
 
+  // The vector overloads of the math functions have to survive until the
+  // loop vectorizer has run.
+  llvm::TargetLibraryInfoImpl TLII(mTarget->getTargetTriple());
+  std::set<std::string> vector_math_functions;
+  if (vectorizesKernelLoops(script))
+    addVectorMathFunctions(script, TLII, vector_math_functions);
+  transformPasses.add(new llvm::TargetLibraryInfoWrapperPass(TLII));
+
   // Add some initial custom passes.
+  addEvaluateInitPass(script, transformPasses);
   addInvokeHelperPass(transformPasses);
-  addExpandKernelPass(transformPasses);
+  addExpandKernelPass(script, transformPasses);
+  addKernelTuningPass(script, transformPasses);
+  addBoundsCheckHoistingPass(script, transformPasses);
   addDebugInfoPass(script, transformPasses);
   addInvariantPass(transformPasses);
   if (mTarget->getOptLevel() != llvm::CodeGenOpt::None) {
-    if (!addInternalizeSymbolsPass(script, transformPasses))
+    if (!addInternalizeSymbolsPass(script, transformPasses,
+                                   vector_math_functions))
       return kErrCustomPasses;
   }
   addGlobalInfoPass(script, transformPasses);
@@ -248,8 +323,34 @@ enum Compiler::ErrorCode Compiler::runPasses(Script &script,
     // FIXME: Figure out which passes should be executed.
     llvm::PassManagerBuilder Builder;
     Builder.Inliner = llvm::createFunctionInliningPass();
+    // Otherwise LTO only vectorizes the loops that ask for it, which the
+    // expanded kernel loops don't.
+    if (vectorizesKernelLoops(script))
+      Builder.LoopVectorize = true;
     Builder.populateLTOPassManager(transformPasses);
 
+    if (script.getEnableInterleavedAccess()) {
+      // RSKernelExpandPass split the accesses to small vector and struct
+      // elements into per-field accesses; vectorize them again in the
+      // expanded kernel loops alone.
+      transformPasses.add(createRSVectorizeExpandedLoopsPass(
+          mTarget->getTargetIRAnalysis(), &TLII));
+    }
+
+    if (script.getAllocationAlignment() > 1) {
+      // Turn the assumptions RSKernelExpandPass placed in the aligned copies
+      // of the kernel loops into alignment on the accesses themselves.
+      transformPasses.add(llvm::createAlignmentFromAssumptionsPass());
+    }
+
+    // Drop the vector overloads of the math functions that the loop
+    // vectorizer didn't call.
+    if (!vector_math_functions.empty()) {
+      if (!addInternalizeSymbolsPass(script, transformPasses))
+        return kErrCustomPasses;
+      transformPasses.add(llvm::createGlobalDCEPass());
+    }
+
     /* FIXME: Reenable autovectorization after rebase.
        bug 19324423
     // Add vectorization passes after LTO passes are in
@@ -267,21 +368,87 @@ enum Compiler::ErrorCode Compiler::runPasses(Script &script,
     */
   }
 
+  // Drop the runtime functions that didn't get inlined, so that they are
+  // emitted as references to the shared runtime (or linked in later, once for
+  // a combined object), along with whatever they alone kept alive.
+  if (script.getShareRuntime() || script.getDeferRuntime()) {
+    transformPasses.add(createRSShareRuntimePass());
+    transformPasses.add(llvm::createGlobalDCEPass());
+  }
+
   // These passes have to come after LTO, since we don't want to examine
-  // functions that are never actually called.
-  if (llvm::Triple(getTargetMachine().getTargetTriple()).getArch() == llvm::Triple::x86_64 ||
-      llvm::Triple(getTargetMachine().getTargetTriple()).getArch() == llvm::Triple::mips64el)
-    transformPasses.add(createRSX86_64CallConvPass());  // Add pass to correct calling convention for X86-64 and mips64.
+  // functions that are never actually called.  The calls into a runtime that
+  // is linked in later are corrected once it is.
+  if (!script.getDeferRuntime())
+    addCallConvPass(transformPasses);
   transformPasses.add(createRSIsThreadablePass());      // Add pass to mark script as threadable.
 
+  // The counters go in after LTO so that inlined callees aren't counted twice.
+  if (script.getEmbedKernelStats())
+    transformPasses.add(createRSKernelStatsPass());
+
   // RSEmbedInfoPass needs to come after we have scanned for non-threadable
   // functions.
   if (script.getEmbedInfo())
     transformPasses.add(createRSEmbedInfoPass());
 
+  if (script.getEmbedEntryTable())
+    transformPasses.add(createRSEntryTablePass());
+
+  // Symbol binding can only be decided once all the .rs.* symbols exist.
+  if (script.getMinimizeRelocations()) {
+    std::set<std::string> export_symbols;
+    if (!collectExportedSymbols(script, export_symbols))
+      return kErrCustomPasses;
+    transformPasses.add(createRSLocalBindingPass(export_symbols));
+  }
+
   // Execute the passes.
   transformPasses.run(script.getSource().getModule());
 
+  return kSuccess;
+}
+
+void Compiler::addCallConvPass(llvm::legacy::PassManager &pPM) {
+  // RISC-V needs no calling convention fixup: like AAPCS64, LP64D passes
+  // aggregates larger than 16 bytes (e.g. RS object types) by reference.
+  if (llvm::Triple(getTargetMachine().getTargetTriple()).getArch() == llvm::Triple::x86_64 ||
+      llvm::Triple(getTargetMachine().getTargetTriple()).getArch() == llvm::Triple::mips64el)
+    pPM.add(createRSX86_64CallConvPass());  // Add pass to correct calling convention for X86-64 and mips64.
+}
+
+enum Compiler::ErrorCode
+Compiler::runCombinedPasses(llvm::Module &pModule,
+                            const std::set<std::string> &pExportedSymbols) {
+  if (mTarget == nullptr) {
+    return kErrNoTargetMachine;
+  }
+
+  llvm::legacy::PassManager combinedPasses;
+
+  // Only the symbols of the scripts are looked up in the combined object; the
+  // runtime functions that were linked in for them are theirs alone.
+  auto IsExportedSymbol = [&pExportedSymbols](const llvm::GlobalValue &GV) {
+    return pExportedSymbols.count(GV.getName()) > 0;
+  };
+  combinedPasses.add(llvm::createInternalizePass(IsExportedSymbol));
+  combinedPasses.add(llvm::createGlobalDCEPass());
+  addCallConvPass(combinedPasses);
+
+  combinedPasses.run(pModule);
+
+  return kSuccess;
+}
+
+enum Compiler::ErrorCode Compiler::generateCode(llvm::Module &pModule,
+                                                llvm::raw_pwrite_stream &pResult) {
+  if (mTarget == nullptr) {
+    return kErrNoTargetMachine;
+  }
+
+  // Empty MCContext.
+  llvm::MCContext *mc_context = nullptr;
+
   // Run backend separately to avoid interference between debug metadata
   // generation and backend initialization.
   llvm::legacy::PassManager codeGenPasses;
@@ -293,16 +460,13 @@ enum Compiler::ErrorCode Compiler::runPasses(Script &script,
   }
 
   // Execute the passes.
-  codeGenPasses.run(script.getSource().getModule());
+  codeGenPasses.run(pModule);
 
   return kSuccess;
 }
 
-enum Compiler::ErrorCode Compiler::compile(Script &script,
-                                           llvm::raw_pwrite_stream &pResult,
-                                           llvm::raw_ostream *IRStream) {
+enum Compiler::ErrorCode Compiler::optimize(Script &script) {
   llvm::Module &module = script.getSource().getModule();
-  enum ErrorCode err;
 
   if (mTarget == nullptr) {
     return kErrNoTargetMachine;
@@ -354,7 +518,34 @@ enum Compiler::ErrorCode Compiler::compile(Script &script,
     }
   }
 
-  if ((err = runPasses(script, pResult)) != kSuccess) {
+  return runTransformPasses(script);
+}
+
+enum Compiler::ErrorCode Compiler::compile(Script &script,
+                                           llvm::raw_pwrite_stream &pResult,
+                                           llvm::raw_ostream *IRStream) {
+  llvm::Module &module = script.getSource().getModule();
+  enum ErrorCode err;
+
+  if ((err = optimize(script)) != kSuccess) {
+    return err;
+  }
+
+  // Only generate code for the functions that changed since the objects in
+  // the cache were generated, if there is one.
+  bool emitted = false;
+  if (!script.getIncrementalCacheDir().empty()) {
+    std::string error;
+    emitted = emitObjectIncrementally(*mTarget, module,
+                                      script.getIncrementalCacheDir(), pResult,
+                                      error);
+    if (!emitted) {
+      ALOGW("Falling back to whole-module code generation! (%s)",
+            error.c_str());
+    }
+  }
+
+  if (!emitted && (err = generateCode(module, pResult)) != kSuccess) {
     return err;
   }
 
@@ -365,9 +556,8 @@ enum Compiler::ErrorCode Compiler::compile(Script &script,
   return kSuccess;
 }
 
-bool Compiler::addInternalizeSymbolsPass(Script &script, llvm::legacy::PassManager &pPM) {
-  // Add a pass to internalize the symbols that don't need to have global
-  // visibility.
+bool Compiler::collectExportedSymbols(Script &script,
+                                      std::set<std::string> &export_symbols) {
   llvm::Module &module = script.getSource().getModule();
   bcinfo::MetadataExtractor me(&module);
   if (!me.extract()) {
@@ -375,9 +565,6 @@ bool Compiler::addInternalizeSymbolsPass(Script &script, llvm::legacy::PassManag
     return false;
   }
 
-  // Set of symbols that should not be internalized.
-  std::set<std::string> export_symbols;
-
   const char *sf[] = {
     kRoot,               // Graphics drawing function or compute kernel.
     kInit,               // Initialization routine called implicitly on startup.
@@ -446,6 +633,34 @@ bool Compiler::addInternalizeSymbolsPass(Script &script, llvm::legacy::PassManag
     export_symbols.insert(symbol_name);
   }
 
+  return true;
+}
+
+bool Compiler::addInternalizeSymbolsPass(
+    Script &script, llvm::legacy::PassManager &pPM,
+    const std::set<std::string> &pKeepSymbols) {
+  // Add a pass to internalize the symbols that don't need to have global
+  // visibility.
+  std::set<std::string> export_symbols(pKeepSymbols);
+  if (!collectExportedSymbols(script, export_symbols))
+    return false;
+
+  // The variables of a runtime that is resolved later are shared with it, so
+  // the script doesn't see every access to them.  The runtime functions are
+  // internalized like the script's own, so that they are inlined the same.
+  if (llvm::NamedMDNode *runtime_symbols =
+          script.getSource().getModule().getNamedMetadata(
+              kRsRuntimeSymbolsMetadataName)) {
+    for (const llvm::MDNode *symbol : runtime_symbols->operands()) {
+      const llvm::Constant *linked =
+          llvm::mdconst::extract<llvm::Constant>(symbol->getOperand(1));
+      if (!linked->getType()->getPointerElementType()->isFunctionTy()) {
+        export_symbols.insert(
+            llvm::cast<llvm::MDString>(symbol->getOperand(0))->getString());
+      }
+    }
+  }
+
   auto IsExportedSymbol = [=](const llvm::GlobalValue &GV) {
     return export_symbols.count(GV.getName()) > 0;
   };
@@ -463,20 +678,176 @@ void Compiler::addInvokeHelperPass(llvm::legacy::PassManager &pPM) {
 }
 
 void Compiler::addDebugInfoPass(Script &script, llvm::legacy::PassManager &pPM) {
-  if (script.getSource().getDebugInfoEnabled())
+  if (script.getLineTablesOnly())
+    pPM.add(createRSAddDebugInfoPass(/* pLineTablesOnly */ true));
+  else if (script.getSource().getDebugInfoEnabled())
     pPM.add(createRSAddDebugInfoPass());
 }
 
-void Compiler::addExpandKernelPass(llvm::legacy::PassManager &pPM) {
+void Compiler::addVectorMathFunctions(
+    Script &script, llvm::TargetLibraryInfoImpl &pTLII,
+    std::set<std::string> &pVectorFunctions) {
+  // The vectorizer widens the type of a call to get the type of the vector
+  // function, so only the overloads defined with exactly that type can be
+  // used.  This also rules out the functions that aren't element-wise, like
+  // length(), and the targets whose calling convention for the runtime
+  // passes vectors differently.  With a deferred runtime, there are none.
+  llvm::Module &module = script.getSource().getModule();
+  auto isWidened = [](llvm::Type *scalar, llvm::Type *vector, unsigned width) {
+    return scalar->isFloatTy() && vector->isVectorTy() &&
+           (vector->getVectorNumElements() == width) &&
+           vector->getVectorElementType()->isFloatTy();
+  };
+
+  // Only the calls that the kernels make end up in the expanded loops, once
+  // the kernels are inlined into them.
+  bcinfo::MetadataExtractor me(&module);
+  if (!me.extract()) {
+    return;
+  }
+  std::vector<const char *> kernel_names(
+      me.getExportForEachNameList(),
+      me.getExportForEachNameList() + me.getExportForEachSignatureCount());
+  for (size_t i = 0; i < me.getExportReduceCount(); ++i) {
+    kernel_names.push_back(me.getExportReduceList()[i].mAccumulatorName);
+  }
+  std::map<llvm::Function *, std::vector<llvm::CallInst *>> kernel_calls;
+  for (const char *name : kernel_names) {
+    llvm::Function *kernel = module.getFunction(name);
+    if ((kernel == nullptr) || kernel->isDeclaration()) {
+      continue;
+    }
+    for (llvm::BasicBlock &block : *kernel) {
+      for (llvm::Instruction &inst : block) {
+        llvm::CallInst *call = llvm::dyn_cast<llvm::CallInst>(&inst);
+        if ((call != nullptr) && (call->getCalledFunction() != nullptr)) {
+          kernel_calls[call->getCalledFunction()].push_back(call);
+        }
+      }
+    }
+  }
+
+  std::vector<llvm::VecDesc> descs;
+  for (const llvm::VecDesc &desc : getVectorMathFunctions()) {
+    llvm::Function *scalar = module.getFunction(desc.ScalarFnName);
+    llvm::Function *vector = module.getFunction(desc.VectorFnName);
+    if ((scalar == nullptr) || (vector == nullptr) ||
+        vector->isDeclaration() || (kernel_calls.count(scalar) == 0) ||
+        scalar->hasFnAttribute(llvm::Attribute::AlwaysInline) ||
+        (scalar->arg_size() != vector->arg_size()) ||
+        !isWidened(scalar->getReturnType(), vector->getReturnType(),
+                   desc.VectorizationFactor)) {
+      continue;
+    }
+    bool widened = true;
+    for (auto s = scalar->arg_begin(), v = vector->arg_begin();
+         s != scalar->arg_end(); ++s, ++v) {
+      widened &= isWidened(s->getType(), v->getType(),
+                           desc.VectorizationFactor);
+    }
+    if (widened) {
+      // The inliner runs before the loop vectorizer, and would leave it
+      // nothing to map.  The calls from anywhere else are still inlined.
+      for (llvm::CallInst *call : kernel_calls[scalar]) {
+        call->addAttribute(llvm::AttributeSet::FunctionIndex,
+                           llvm::Attribute::NoInline);
+      }
+      descs.push_back(desc);
+      pVectorFunctions.insert(desc.VectorFnName);
+    }
+  }
+  pTLII.addVectorizableFunctions(descs);
+}
+
+bool Compiler::vectorizesKernelLoops(const Script &script) const {
+  if (mTarget->getOptLevel() == llvm::CodeGenOpt::None)
+    return false;
+  // With RVV or SVE the loop vectorizer emits vector-length agnostic code,
+  // so the expanded kernel loops can be vectorized without knowing the
+  // vector length.
+  return hasScalableVectors() || script.getVectorizeKernels();
+}
+
+bool Compiler::hasScalableVectors() const {
+  llvm::SubtargetFeatures features(mTarget->getTargetFeatureString());
+  const std::vector<std::string> &enabled = features.getFeatures();
+  auto hasFeature = [&enabled](const char *feature) {
+    return std::find(enabled.begin(), enabled.end(), feature) != enabled.end();
+  };
+
+  switch (mTarget->getTargetTriple().getArch()) {
+#if defined(PROVIDE_RISCV64_CODEGEN)
+  case llvm::Triple::riscv64:
+    return hasFeature("+v");
+#endif
+  case llvm::Triple::aarch64:
+    return hasFeature("+sve") || hasFeature("+sve2");
+  default:
+    return false;
+  }
+}
+
+void Compiler::addExpandKernelPass(Script &script, llvm::legacy::PassManager &pPM) {
   // Expand ForEach and reduce on CPU path to reduce launch overhead.
   bool pEnableStepOpt = true;
-  pPM.add(createRSKernelExpandPass(pEnableStepOpt));
+  // Splitting element accesses only pays off if the loop vectorizer runs
+  // afterwards (see runTransformPasses()).
+  bool pEnableInterleave = script.getEnableInterleavedAccess() &&
+                           mTarget->getOptLevel() != llvm::CodeGenOpt::None;
+  // Versioning the loops on the alignment of the allocations only pays off
+  // if they are vectorized afterwards, too; otherwise both copies would be
+  // the same scalar code.  This also keeps the pass from picking up a
+  // contract recorded in the bitcode when they aren't.
+  bool pEnableAlignmentVersioning =
+      vectorizesKernelLoops(script) || pEnableInterleave;
+  unsigned pAllocationAlignment = script.getAllocationAlignment();
+  // With scalable vectors the loop vectorizer can fold the remainder of the
+  // kernel loops into a predicated last vector iteration.  This is only a
+  // hint: the current loop vectorizer ignores it and keeps a scalar
+  // remainder loop.
+  bool pEnableTailFolding = hasScalableVectors() &&
+                            mTarget->getOptLevel() != llvm::CodeGenOpt::None;
+  pPM.add(createRSKernelExpandPass(pEnableStepOpt, pEnableInterleave,
+                                   pEnableAlignmentVersioning,
+                                   pAllocationAlignment, pEnableTailFolding));
+}
+
+void Compiler::addKernelTuningPass(Script &script, llvm::legacy::PassManager &pPM) {
+  // Loop hints are only honored by the LTO pipeline, so there is nothing to
+  // tune when optimizations are disabled.
+  if (script.getTuningDatabase() != nullptr &&
+      mTarget->getOptLevel() != llvm::CodeGenOpt::None) {
+    pPM.add(createRSKernelTuningPass(script.getTuningDatabase(),
+                                     mTarget->getTargetCPU().str()));
+  }
+}
+
+void Compiler::addBoundsCheckHoistingPass(Script &script,
+                                          llvm::legacy::PassManager &pPM) {
+  // The unchecked copies of the kernels are only worth their size in
+  // optimized builds; unoptimized ones keep the checks in the loop, where
+  // they are easier to step through.
+  if (script.getHoistBoundsChecks() &&
+      mTarget->getOptLevel() != llvm::CodeGenOpt::None) {
+    pPM.add(createRSBoundsCheckHoistingPass());
+  }
 }
 
 void Compiler::addGlobalInfoPass(Script &script, llvm::legacy::PassManager &pPM) {
   // Add additional information about RS global variables inside the Module.
   if (script.getEmbedGlobalInfo()) {
-    pPM.add(createRSGlobalInfoPass(script.getEmbedGlobalInfoSkipConstant()));
+    pPM.add(createRSGlobalInfoPass(script.getEmbedGlobalInfoSkipConstant(),
+                                   script.getMinimizeRelocations()));
+  }
+}
+
+void Compiler::addEvaluateInitPass(Script &script,
+                                   llvm::legacy::PassManager &pPM) {
+  // Fold init() into the global initializers while it is still intact.
+  // Host and target agree on the results of IEEE arithmetic, but constant
+  // folded math library calls use the host library, hence the opt-in.
+  if (script.getEvaluateInit()) {
+    pPM.add(createRSEvaluateInitPass());
   }
 }
 
@@ -486,7 +857,8 @@ void Compiler::addInvariantPass(llvm::legacy::PassManager &pPM) {
   pPM.add(createRSInvariantPass());
 }
 
-enum Compiler::ErrorCode Compiler::screenGlobalFunctions(Script &script) {
+enum Compiler::ErrorCode Compiler::runPreLinkPasses(Script &script,
+                                                    bool pTranslateGEPs) {
   llvm::Module &module = script.getSource().getModule();
 
   // Materialize the bitcode module in case this is a lazy-load module.  Do not
@@ -501,19 +873,32 @@ enum Compiler::ErrorCode Compiler::screenGlobalFunctions(Script &script) {
     }
   }
 
-  // Add pass to check for illegal function calls.
   llvm::legacy::PassManager pPM;
+
+  // Add pass to check for illegal function calls.
   pPM.add(createRSScreenFunctionsPass());
-  pPM.run(module);
 
-  return kSuccess;
+  // The GEPs are only translated for 32-bit x86, which is the only target
+  // where this saves a pass manager run: the screening pass preserves all
+  // analyses, so the module is only walked once more.
+  if (pTranslateGEPs) {
+    pPM.add(createRSX86TranslateGEPPass());
+  }
 
-}
+  // Fuse the forEach launches of invokables while the kernels can still be
+  // told apart from the runtime functions they call, and before the exported
+  // symbols are collected for internalization.
+  if (script.getFuseForEach()) {
+    pPM.add(createRSForEachFusionPass());
+  }
 
-void Compiler::translateGEPs(Script &script) {
-  llvm::legacy::PassManager pPM;
-  pPM.add(createRSX86TranslateGEPPass());
+  // Turn the data-parallel loops of invokables into launches of synthesized
+  // kernels, for the same reasons.
+  if (script.getParallelizeInvokables()) {
+    pPM.add(createRSParallelizeInvokablesPass());
+  }
+
+  pPM.run(module);
 
-  // Materialization done in screenGlobalFunctions above.
-  pPM.run(script.getSource().getModule());
+  return kSuccess;
 }
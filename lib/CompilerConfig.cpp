@@ -50,7 +50,8 @@ void AddX86NativeCPUFeatures(std::vector<std::string>* attributes) {
 #endif // (PROVIDE_X86_CODEGEN) && !defined(__HOST__)
 
 CompilerConfig::CompilerConfig(const std::string &pTriple)
-  : mTriple(pTriple), mFullPrecision(true), mTarget(nullptr) {
+  : mTriple(pTriple), mFullPrecision(true), mEnableSVE(false),
+    mTarget(nullptr) {
   //===--------------------------------------------------------------------===//
   // Default setting of target options
   //===--------------------------------------------------------------------===//
@@ -165,6 +166,25 @@ bool CompilerConfig::initializeArch() {
 
 #if defined(PROVIDE_ARM64_CODEGEN)
   case llvm::Triple::aarch64:
+    // SVE is opt-in, and is meant to let the loop vectorizer emit
+    // predicated, vector length agnostic code for the expanded kernels
+    // instead of 128-bit NEON loops with a scalar remainder.  The current
+    // AArch64 backend has no SVE code generation and still emits NEON code.
+    // On the device, the object is only built with SVE if the CPU has it.
+    if (mEnableSVE || getProperty("debug.rs.arm64-sve")) {
+#if defined(DEFAULT_ARM64_CODEGEN) && defined(TARGET_BUILD)
+      llvm::StringMap<bool> features;
+      llvm::sys::getHostCPUFeatures(features);
+      if (features.count("sve") && features["sve"]) {
+        attributes.push_back("+sve");
+        if (features.count("sve2") && features["sve2"])
+          attributes.push_back("+sve2");
+      }
+#else
+      attributes.push_back("+sve");
+#endif  // DEFAULT_ARM64_CODEGEN && TARGET_BUILD
+    }
+
 #if defined(TARGET_BUILD)
     if (!getProperty("debug.rs.arm-no-tune-for-cpu")) {
 #ifdef DEFAULT_ARM64_CODEGEN
@@ -225,6 +245,41 @@ bool CompilerConfig::initializeArch() {
     break;
 #endif  // PROVIDE_X86_CODEGEN
 
+#if defined (PROVIDE_RISCV64_CODEGEN)
+  case llvm::Triple::riscv64:
+    // RV64GC is the baseline for Android RISC-V devices, with the
+    // hard-float LP64D ABI used by the runtime.
+    attributes.push_back("+m");
+    attributes.push_back("+a");
+    attributes.push_back("+f");
+    attributes.push_back("+d");
+    attributes.push_back("+c");
+    getTargetOptions().MCOptions.ABIName = "lp64d";
+
+    // The vector extension lets the loop vectorizer emit vector-length
+    // agnostic code for the expanded kernels.
+    if (!getProperty("debug.rs.riscv-no-rvv")) {
+#if defined(DEFAULT_RISCV64_CODEGEN) && defined(TARGET_BUILD)
+      llvm::StringMap<bool> features;
+      llvm::sys::getHostCPUFeatures(features);
+      if (features.count("v") && features["v"])
+        attributes.push_back("+v");
+#else
+      attributes.push_back("+v");
+#endif  // DEFAULT_RISCV64_CODEGEN && TARGET_BUILD
+    }
+
+#if defined(TARGET_BUILD)
+    if (!getProperty("debug.rs.riscv-no-tune-for-cpu")) {
+#ifdef DEFAULT_RISCV64_CODEGEN
+      setCPU(llvm::sys::getHostCPUName());
+#endif
+    }
+#endif  // TARGET_BUILD
+    getTargetOptions().UseInitArray = true;
+    break;
+#endif  // PROVIDE_RISCV64_CODEGEN
+
   default:
     ALOGE("Unsupported architecture type: %s", mTarget->getName());
     return false;
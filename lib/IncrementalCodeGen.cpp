@@ -0,0 +1,291 @@
+/*
+ * Copyright 2026, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "IncrementalCodeGen.h"
+
+#include "Log.h"
+#include "ObjectMerger.h"
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/Triple.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Part of every key, so that the objects cached by a compiler that splits or
+// keys the module differently are never reused.
+const char kCacheVersion[] = "bcc-incremental-1";
+
+// Turn the symbols that are local to the object into hidden global ones, so
+// that the parts of the module can refer to each other.
+void externalizeLocals(llvm::Module &pModule) {
+  auto externalize = [](llvm::GlobalValue &GV) {
+    if (llvm::GlobalObject *GO = llvm::dyn_cast<llvm::GlobalObject>(&GV)) {
+      // The merged object can't have section groups, and it only has a single
+      // copy of each definition anyway.
+      GO->setComdat(nullptr);
+    }
+    if (!GV.hasLocalLinkage()) {
+      return;
+    }
+    if (!GV.hasName()) {
+      GV.setName("__bcc_local");
+    }
+    GV.setLinkage(llvm::GlobalValue::ExternalLinkage);
+    GV.setVisibility(llvm::GlobalValue::HiddenVisibility);
+  };
+
+  for (llvm::Function &F : pModule) {
+    externalize(F);
+  }
+  for (llvm::GlobalVariable &GV : pModule.globals()) {
+    externalize(GV);
+  }
+  for (llvm::GlobalAlias &GA : pModule.aliases()) {
+    externalize(GA);
+  }
+}
+
+// Clone the part of pModule that defines the values pDefine accepts, along
+// with declarations of whatever they refer to.  The module-level inline
+// assembly and identification only go into the part that keeps them.
+std::unique_ptr<llvm::Module>
+clonePart(const llvm::Module &pModule,
+          std::function<bool(const llvm::GlobalValue *)> pDefine,
+          bool pKeepModuleLevel) {
+  llvm::ValueToValueMapTy VMap;
+  std::unique_ptr<llvm::Module> Part = llvm::CloneModule(&pModule, VMap,
+                                                         pDefine);
+  Part->setModuleIdentifier("");
+  Part->setSourceFileName("");
+  if (!pKeepModuleLevel) {
+    Part->setModuleInlineAsm("");
+  }
+
+  // Drop everything the code of the part doesn't depend on, so that it
+  // doesn't take part in the key.
+  std::vector<llvm::GlobalValue *> Unused;
+  auto collect = [&Unused](llvm::GlobalValue &GV) {
+    GV.removeDeadConstantUsers();
+    if (GV.isDeclaration() && GV.use_empty()) {
+      Unused.push_back(&GV);
+    }
+  };
+  for (llvm::Function &F : *Part) {
+    collect(F);
+  }
+  for (llvm::GlobalVariable &GV : Part->globals()) {
+    collect(GV);
+  }
+  for (llvm::GlobalValue *GV : Unused) {
+    GV->eraseFromParent();
+  }
+
+  std::vector<llvm::NamedMDNode *> Named;
+  for (llvm::NamedMDNode &NMD : Part->named_metadata()) {
+    if ((NMD.getName() != "llvm.module.flags") &&
+        (!pKeepModuleLevel || (NMD.getName() != "llvm.ident"))) {
+      Named.push_back(&NMD);
+    }
+  }
+  for (llvm::NamedMDNode *NMD : Named) {
+    Part->eraseNamedMetadata(NMD);
+  }
+
+  return Part;
+}
+
+// Compute the name of the cached object of pPart: a hex MD5 of its IR and of
+// the options that affect the code pTarget generates for it.
+std::string computeKey(const llvm::TargetMachine &pTarget,
+                       const llvm::Module &pPart) {
+  std::string text;
+  llvm::raw_string_ostream os(text);
+  const llvm::TargetOptions &options = pTarget.Options;
+  os << kCacheVersion << ' ' << LLVM_VERSION_STRING << '\n'
+     << pTarget.getTargetTriple().str() << ' ' << pTarget.getTargetCPU()
+     << ' ' << pTarget.getTargetFeatureString() << '\n'
+     << pTarget.getOptLevel() << ' ' << pTarget.getRelocationModel() << ' '
+     << pTarget.getCodeModel() << ' ' << options.UnsafeFPMath
+     << options.NoInfsFPMath << options.NoNaNsFPMath << ' '
+     << options.FloatABIType << ' ' << options.AllowFPOpFusion << '\n';
+  pPart.print(os, nullptr);
+  os.flush();
+
+  llvm::MD5 hasher;
+  hasher.update(text);
+  llvm::MD5::MD5Result result;
+  hasher.final(result);
+
+  llvm::SmallString<32> hash;
+  llvm::MD5::stringifyResult(result, hash);
+  return hash.str();
+}
+
+bool generateObject(llvm::TargetMachine &pTarget, llvm::Module &pPart,
+                    std::string &pObject) {
+  llvm::SmallString<0> object;
+  {
+    llvm::raw_svector_ostream os(object);
+    llvm::legacy::PassManager codeGenPasses;
+    llvm::MCContext *mc_context = nullptr;
+    if (pTarget.addPassesToEmitMC(codeGenPasses, mc_context, os,
+                                  /* DisableVerify */false)) {
+      return false;
+    }
+    codeGenPasses.run(pPart);
+  }
+  pObject = object.str();
+  return true;
+}
+
+bool readCachedObject(llvm::StringRef pPath, std::string &pObject) {
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> mb_or_error =
+      llvm::MemoryBuffer::getFile(pPath);
+  if (!mb_or_error) {
+    return false;
+  }
+  pObject = mb_or_error.get()->getBuffer().str();
+  return true;
+}
+
+// Failing to fill the cache only costs the next compilation some time, so
+// errors are ignored.  The object goes through a temporary file so that a
+// concurrent compilation never reads a partial one.
+void writeCachedObject(const std::string &pCacheDir, llvm::StringRef pPath,
+                       llvm::StringRef pObject) {
+  int fd;
+  llvm::SmallString<128> tmp_path;
+  if (llvm::sys::fs::createUniqueFile(pCacheDir + "/tmp-%%%%%%%%", fd,
+                                      tmp_path)) {
+    return;
+  }
+
+  bool written;
+  {
+    llvm::raw_fd_ostream os(fd, /* shouldClose */true);
+    os << pObject;
+    os.close();
+    written = !os.has_error();
+    os.clear_error();
+  }
+  if (!written || llvm::sys::fs::rename(tmp_path, pPath)) {
+    llvm::sys::fs::remove(tmp_path);
+  }
+}
+
+}  // end anonymous namespace
+
+namespace bcc {
+
+bool emitObjectIncrementally(llvm::TargetMachine &pTarget,
+                             const llvm::Module &pModule,
+                             const std::string &pCacheDir,
+                             llvm::raw_pwrite_stream &pResult,
+                             std::string &pError) {
+  // The debug info of every part would describe the whole compile unit.
+  if (pModule.getNamedMetadata("llvm.dbg.cu") != nullptr) {
+    pError = "modules with debug info are not supported";
+    return false;
+  }
+  // Don't generate code for the parts of a module that can't be merged.
+  if (!pTarget.getTargetTriple().isArch64Bit()) {
+    pError = "only ELF64 objects can be merged";
+    return false;
+  }
+  if (std::error_code ec = llvm::sys::fs::create_directories(pCacheDir)) {
+    pError = "unable to create " + pCacheDir + " (" + ec.message() + ")";
+    return false;
+  }
+
+  // An alias has to be defined in the same part as what it aliases (like the
+  // local aliases of -rs-minimize-relocs), which needs to be a single object.
+  for (const llvm::GlobalAlias &GA : pModule.aliases()) {
+    if (GA.getBaseObject() == nullptr) {
+      pError = "alias " + GA.getName().str() + " has no base object";
+      return false;
+    }
+  }
+
+  std::unique_ptr<llvm::Module> Base = llvm::CloneModule(&pModule);
+  externalizeLocals(*Base);
+
+  // The object a value is defined along with: an alias goes with its base
+  // object.
+  auto getDefiningObject = [](const llvm::GlobalValue *GV) {
+    if (const llvm::GlobalAlias *GA = llvm::dyn_cast<llvm::GlobalAlias>(GV)) {
+      return static_cast<const llvm::GlobalValue *>(GA->getBaseObject());
+    }
+    return GV;
+  };
+
+  // The code of a function only depends on the declarations of its callees,
+  // so that editing a function doesn't invalidate its callers.
+  std::vector<std::unique_ptr<llvm::Module>> Parts;
+  for (const llvm::Function &F : *Base) {
+    if (F.isDeclaration() || F.hasAvailableExternallyLinkage()) {
+      continue;
+    }
+    Parts.push_back(clonePart(*Base, [&](const llvm::GlobalValue *GV) {
+      return getDefiningObject(GV) == &F;
+    }, /* pKeepModuleLevel */false));
+  }
+  Parts.push_back(clonePart(*Base, [&](const llvm::GlobalValue *GV) {
+    return !llvm::isa<llvm::Function>(getDefiningObject(GV));
+  }, /* pKeepModuleLevel */true));
+
+  std::vector<std::string> Objects(Parts.size());
+  unsigned NumReused = 0;
+  for (size_t i = 0; i < Parts.size(); ++i) {
+    llvm::SmallString<128> path(pCacheDir);
+    llvm::sys::path::append(path, computeKey(pTarget, *Parts[i]) + ".o");
+    if (readCachedObject(path.str(), Objects[i])) {
+      ++NumReused;
+      continue;
+    }
+    if (!generateObject(pTarget, *Parts[i], Objects[i])) {
+      pError = "unable to set up code generation";
+      return false;
+    }
+    writeCachedObject(pCacheDir, path.str(), Objects[i]);
+  }
+  ALOGV("Reused the machine code of %u of %u parts", NumReused,
+        static_cast<unsigned>(Parts.size()));
+
+  std::vector<llvm::StringRef> Refs(Objects.begin(), Objects.end());
+  llvm::SmallString<0> Merged;
+  if (!mergeObjects(Refs, Merged, pError)) {
+    return false;
+  }
+  pResult << Merged.str();
+  return true;
+}
+
+}  // end namespace bcc
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2026, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BCC_INCREMENTAL_CODEGEN_H
+#define BCC_INCREMENTAL_CODEGEN_H
+
+#include <string>
+
+namespace llvm {
+class Module;
+class TargetMachine;
+class raw_pwrite_stream;
+}
+
+namespace bcc {
+
+/// @brief Generate the object for an optimized module, reusing the machine
+/// code of the functions that didn't change since a previous compilation.
+///
+/// The module is split into one module per function definition, holding the
+/// declarations of everything the function refers to, and one module with
+/// the global variables.  Each part is keyed by an MD5 of its IR and of the
+/// code generation options of pTarget, and its object is looked up in
+/// pCacheDir; only the parts that miss are code-generated, and their objects
+/// are added to the cache.  The objects are then merged into the result.
+///
+/// Since every part is a separate object, the symbols with local linkage are
+/// emitted as hidden symbols.
+///
+/// @param pTarget The target machine to generate code with.
+/// @param pModule The module, after all the IR passes have run.  It isn't
+/// modified.
+/// @param pCacheDir The directory of the cached objects.
+/// @param pResult The stream to write the object to, on success.
+/// @param pError The reason for the failure, on failure.
+/// @return True, if the object was written.  False, if the module or the
+/// target isn't supported, in which case nothing has been written and the
+/// caller should generate code for the whole module.
+bool emitObjectIncrementally(llvm::TargetMachine &pTarget,
+                             const llvm::Module &pModule,
+                             const std::string &pCacheDir,
+                             llvm::raw_pwrite_stream &pResult,
+                             std::string &pError);
+
+}  // end namespace bcc
+
+#endif  // BCC_INCREMENTAL_CODEGEN_H
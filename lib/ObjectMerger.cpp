@@ -0,0 +1,566 @@
+/*
+ * Copyright 2026, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ObjectMerger.h"
+
+#include <llvm/Support/ELF.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/MathExtras.h>
+
+#include <algorithm>
+#include <cstring>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace llvm::ELF;
+
+namespace {
+
+struct InputObject {
+  llvm::StringRef Data;
+  const Elf64_Ehdr *Header;
+  const Elf64_Shdr *Sections;
+  unsigned NumSections;
+  llvm::StringRef ShStrTab;
+  const Elf64_Sym *Symbols;
+  unsigned NumSymbols;
+  llvm::StringRef StrTab;
+
+  // Output section of each input section, 0 if it is dropped.
+  std::vector<unsigned> SectionMap;
+  // Output symbol of each input symbol.
+  std::vector<unsigned> SymbolMap;
+};
+
+struct OutputSection {
+  std::string Name;
+  Elf64_Shdr Header;
+  llvm::StringRef Contents;
+};
+
+// The merged entry of a global symbol.
+struct GlobalSymbol {
+  int DefInput;          // -1 while the symbol is undefined.
+  unsigned DefSymbol;
+  int RefInput;          // First occurrence, for undefined symbols.
+  unsigned RefSymbol;
+  bool StrongRef;        // Whether any occurrence isn't weak.
+  unsigned char Visibility;
+  unsigned Index;        // Index in the merged symbol table.
+};
+
+// Returns the more constraining of two symbol visibilities.
+unsigned char mergeVisibility(unsigned char A, unsigned char B) {
+  if (A == STV_DEFAULT) {
+    return B;
+  }
+  if (B == STV_DEFAULT) {
+    return A;
+  }
+  // STV_INTERNAL < STV_HIDDEN < STV_PROTECTED, from most to least
+  // constraining.
+  return std::min(A, B);
+}
+
+class Merger {
+private:
+  std::vector<InputObject> mInputs;
+  std::string &mError;
+
+  std::vector<OutputSection> mOutput;
+  std::vector<Elf64_Sym> mSymbols;
+  std::string mStrTab;
+  // Storage of the contents generated for the output sections.
+  std::list<std::string> mBuffers;
+
+  bool fail(const std::string &Msg) {
+    mError = Msg;
+    return false;
+  }
+
+  template <typename T>
+  static const T *getArray(llvm::StringRef Data, uint64_t Offset,
+                           uint64_t Count) {
+    if ((Offset > Data.size()) ||
+        (Count > (Data.size() - Offset) / sizeof(T))) {
+      return nullptr;
+    }
+    return reinterpret_cast<const T *>(Data.data() + Offset);
+  }
+
+  static bool getSectionContents(const InputObject &In, unsigned Index,
+                                 llvm::StringRef &Contents) {
+    const Elf64_Shdr &Section = In.Sections[Index];
+    if (Section.sh_type == SHT_NOBITS) {
+      Contents = llvm::StringRef();
+      return true;
+    }
+    const char *Data = getArray<char>(In.Data, Section.sh_offset,
+                                      Section.sh_size);
+    if (Data == nullptr) {
+      return false;
+    }
+    Contents = llvm::StringRef(Data, Section.sh_size);
+    return true;
+  }
+
+  static llvm::StringRef getString(llvm::StringRef Table, uint32_t Offset) {
+    return Table.substr(Offset).split('\0').first;
+  }
+
+  uint32_t addString(llvm::StringRef Str) {
+    if (Str.empty()) {
+      return 0;
+    }
+    uint32_t Offset = mStrTab.size();
+    mStrTab.append(Str.data(), Str.size());
+    mStrTab.push_back('\0');
+    return Offset;
+  }
+
+  llvm::StringRef addBuffer(std::string Contents) {
+    mBuffers.push_back(std::move(Contents));
+    return mBuffers.back();
+  }
+
+  unsigned addSection(llvm::StringRef Name, const Elf64_Shdr &Header,
+                      llvm::StringRef Contents) {
+    OutputSection Out = { Name.str(), Header, Contents };
+    mOutput.push_back(Out);
+    return mOutput.size() - 1;
+  }
+
+  // Map the section index of a symbol of In to the output.
+  bool mapSectionIndex(const InputObject &In, uint16_t Index,
+                       uint16_t &Result) {
+    if ((Index == SHN_UNDEF) || (Index == SHN_ABS) || (Index == SHN_COMMON)) {
+      Result = Index;
+      return true;
+    }
+    if ((Index >= SHN_LORESERVE) || (Index >= In.NumSections)) {
+      return fail("unsupported section index " + std::to_string(Index));
+    }
+    Result = In.SectionMap[Index];
+    return true;
+  }
+
+  bool parse(InputObject &In);
+  bool mergeSections();
+  bool mergeSymbols();
+  bool mergeRelocations();
+  void write(llvm::SmallVectorImpl<char> &pResult);
+
+public:
+  Merger(const std::vector<llvm::StringRef> &pObjects, std::string &pError)
+    : mError(pError) {
+    for (llvm::StringRef Object : pObjects) {
+      InputObject In;
+      In.Data = Object;
+      In.Header = nullptr;
+      In.Sections = nullptr;
+      In.NumSections = 0;
+      In.Symbols = nullptr;
+      In.NumSymbols = 0;
+      mInputs.push_back(In);
+    }
+  }
+
+  bool merge(llvm::SmallVectorImpl<char> &pResult);
+};
+
+bool Merger::parse(InputObject &In) {
+  In.Header = getArray<Elf64_Ehdr>(In.Data, 0, 1);
+  if ((In.Header == nullptr) || !In.Header->checkMagic() ||
+      (In.Header->getFileClass() != ELFCLASS64) ||
+      (In.Header->getDataEncoding() != ELFDATA2LSB) ||
+      (In.Header->e_type != ET_REL)) {
+    return fail("not a little-endian ELF64 relocatable object");
+  }
+
+  In.NumSections = In.Header->e_shnum;
+  In.Sections = getArray<Elf64_Shdr>(In.Data, In.Header->e_shoff,
+                                     In.NumSections);
+  if ((In.Sections == nullptr) || (In.NumSections == 0) ||
+      (In.Header->e_shstrndx >= In.NumSections) ||
+      !getSectionContents(In, In.Header->e_shstrndx, In.ShStrTab)) {
+    return fail("malformed section header table");
+  }
+
+  for (unsigned i = 0; i < In.NumSections; ++i) {
+    const Elf64_Shdr &Section = In.Sections[i];
+    llvm::StringRef Contents;
+    if (!getSectionContents(In, i, Contents)) {
+      return fail("malformed section " +
+                  getString(In.ShStrTab, Section.sh_name).str());
+    }
+
+    switch (Section.sh_type) {
+    case SHT_SYMTAB:
+      if (In.Symbols != nullptr) {
+        return fail("more than one symbol table");
+      }
+      In.NumSymbols = Section.sh_size / sizeof(Elf64_Sym);
+      In.Symbols = getArray<Elf64_Sym>(In.Data, Section.sh_offset,
+                                       In.NumSymbols);
+      if ((In.Symbols == nullptr) || (Section.sh_link >= In.NumSections) ||
+          !getSectionContents(In, Section.sh_link, In.StrTab)) {
+        return fail("malformed symbol table");
+      }
+      break;
+    case SHT_RELA:
+      if ((Section.sh_info >= In.NumSections) ||
+          (Section.sh_entsize != sizeof(Elf64_Rela))) {
+        return fail("malformed relocation section");
+      }
+      break;
+    case SHT_REL:
+      return fail("REL relocations are not supported");
+    case SHT_GROUP:
+      return fail("section groups are not supported");
+    case SHT_SYMTAB_SHNDX:
+      return fail("extended section indices are not supported");
+    default:
+      break;
+    }
+  }
+
+  if (In.Symbols == nullptr) {
+    return fail("missing symbol table");
+  }
+  return true;
+}
+
+bool Merger::mergeSections() {
+  Elf64_Shdr Null;
+  memset(&Null, 0, sizeof(Null));
+  addSection("", Null, llvm::StringRef());
+
+  for (InputObject &In : mInputs) {
+    In.SectionMap.assign(In.NumSections, 0);
+    for (unsigned i = 1; i < In.NumSections; ++i) {
+      const Elf64_Shdr &Section = In.Sections[i];
+      // The tables are rebuilt, and the relocations are rewritten once the
+      // symbols are merged.
+      if ((Section.sh_type == SHT_SYMTAB) || (Section.sh_type == SHT_STRTAB) ||
+          (Section.sh_type == SHT_RELA)) {
+        continue;
+      }
+      llvm::StringRef Contents;
+      getSectionContents(In, i, Contents);
+      Elf64_Shdr Header = Section;
+      Header.sh_name = 0;
+      Header.sh_offset = 0;
+      In.SectionMap[i] = addSection(getString(In.ShStrTab, Section.sh_name),
+                                    Header, Contents);
+    }
+
+    // Only the links of SHF_LINK_ORDER sections refer to other sections.
+    for (unsigned i = 1; i < In.NumSections; ++i) {
+      unsigned Out = In.SectionMap[i];
+      if (Out == 0) {
+        continue;
+      }
+      Elf64_Shdr &Header = mOutput[Out].Header;
+      if (Header.sh_flags & SHF_LINK_ORDER) {
+        if ((Header.sh_link >= In.NumSections) ||
+            (In.SectionMap[Header.sh_link] == 0)) {
+          return fail("malformed SHF_LINK_ORDER section " + mOutput[Out].Name);
+        }
+        Header.sh_link = In.SectionMap[Header.sh_link];
+      } else {
+        Header.sh_link = 0;
+      }
+    }
+  }
+  return true;
+}
+
+bool Merger::mergeSymbols() {
+  Elf64_Sym Null;
+  memset(&Null, 0, sizeof(Null));
+  mSymbols.push_back(Null);
+  mStrTab.assign(1, '\0');
+
+  // Local symbols come first and are kept as they are.
+  for (InputObject &In : mInputs) {
+    In.SymbolMap.assign(In.NumSymbols, 0);
+    for (unsigned i = 1; i < In.NumSymbols; ++i) {
+      const Elf64_Sym &Symbol = In.Symbols[i];
+      if (Symbol.getBinding() != STB_LOCAL) {
+        continue;
+      }
+      Elf64_Sym Out = Symbol;
+      if (!mapSectionIndex(In, Symbol.st_shndx, Out.st_shndx)) {
+        return false;
+      }
+      if ((Out.st_shndx == SHN_UNDEF) && (Symbol.st_shndx != SHN_UNDEF)) {
+        // The symbol of a section that was dropped can't be referred to by
+        // the relocations that are kept.
+        if (Symbol.getType() == STT_SECTION) {
+          continue;
+        }
+        return fail("local symbol in unsupported section");
+      }
+      Out.st_name = addString(getString(In.StrTab, Symbol.st_name));
+      In.SymbolMap[i] = mSymbols.size();
+      mSymbols.push_back(Out);
+    }
+  }
+  const unsigned FirstGlobal = mSymbols.size();
+
+  // Resolve the global symbols by name, in order of first appearance.
+  std::map<std::string, GlobalSymbol> Globals;
+  std::vector<std::string> Order;
+  for (unsigned InIndex = 0; InIndex < mInputs.size(); ++InIndex) {
+    const InputObject &In = mInputs[InIndex];
+    for (unsigned i = 1; i < In.NumSymbols; ++i) {
+      const Elf64_Sym &Symbol = In.Symbols[i];
+      if (Symbol.getBinding() == STB_LOCAL) {
+        continue;
+      }
+      std::string Name = getString(In.StrTab, Symbol.st_name).str();
+      auto It = Globals.find(Name);
+      if (It == Globals.end()) {
+        GlobalSymbol G = { -1, 0, static_cast<int>(InIndex), i, false,
+                           STV_DEFAULT, 0 };
+        It = Globals.insert(std::make_pair(Name, G)).first;
+        Order.push_back(Name);
+      }
+      GlobalSymbol &G = It->second;
+      G.StrongRef |= (Symbol.getBinding() != STB_WEAK);
+      G.Visibility = mergeVisibility(G.Visibility, Symbol.st_other & 0x3);
+      if (Symbol.st_shndx == SHN_UNDEF) {
+        continue;
+      }
+
+      if (G.DefInput >= 0) {
+        const Elf64_Sym &Def = mInputs[G.DefInput].Symbols[G.DefSymbol];
+        if (Symbol.getBinding() == STB_WEAK) {
+          continue;
+        }
+        if (Def.getBinding() != STB_WEAK) {
+          return fail("duplicate symbol " + Name);
+        }
+      }
+      G.DefInput = InIndex;
+      G.DefSymbol = i;
+    }
+  }
+
+  for (const std::string &Name : Order) {
+    GlobalSymbol &G = Globals[Name];
+    Elf64_Sym Out;
+    if (G.DefInput >= 0) {
+      const InputObject &In = mInputs[G.DefInput];
+      Out = In.Symbols[G.DefSymbol];
+      if (!mapSectionIndex(In, Out.st_shndx, Out.st_shndx)) {
+        return false;
+      }
+      if (Out.st_shndx == SHN_UNDEF) {
+        return fail("symbol " + Name + " defined in unsupported section");
+      }
+    } else {
+      Out = mInputs[G.RefInput].Symbols[G.RefSymbol];
+      Out.setBinding(G.StrongRef ? STB_GLOBAL : STB_WEAK);
+    }
+    Out.st_other = (Out.st_other & ~0x3) | G.Visibility;
+    Out.st_name = addString(Name);
+    G.Index = mSymbols.size();
+    mSymbols.push_back(Out);
+  }
+
+  for (InputObject &In : mInputs) {
+    for (unsigned i = 1; i < In.NumSymbols; ++i) {
+      if (In.Symbols[i].getBinding() != STB_LOCAL) {
+        In.SymbolMap[i] =
+            Globals[getString(In.StrTab, In.Symbols[i].st_name).str()].Index;
+      }
+    }
+  }
+
+  // The symbol table goes after the relocation sections, which refer to it.
+  Elf64_Shdr Header;
+  memset(&Header, 0, sizeof(Header));
+  Header.sh_type = SHT_SYMTAB;
+  Header.sh_info = FirstGlobal;
+  Header.sh_addralign = 8;
+  Header.sh_entsize = sizeof(Elf64_Sym);
+  Header.sh_size = mSymbols.size() * sizeof(Elf64_Sym);
+  addSection(".symtab", Header, llvm::StringRef(
+      reinterpret_cast<const char *>(mSymbols.data()), Header.sh_size));
+  return true;
+}
+
+bool Merger::mergeRelocations() {
+  const unsigned SymTabIndex = mOutput.size() - 1;
+  std::vector<unsigned> RelaSections;
+
+  for (InputObject &In : mInputs) {
+    for (unsigned i = 1; i < In.NumSections; ++i) {
+      const Elf64_Shdr &Section = In.Sections[i];
+      if ((Section.sh_type != SHT_RELA) ||
+          (In.SectionMap[Section.sh_info] == 0)) {
+        continue;
+      }
+
+      llvm::StringRef Contents;
+      getSectionContents(In, i, Contents);
+      const size_t NumRelocs = Section.sh_size / sizeof(Elf64_Rela);
+      std::string Relocs(Contents.data(), NumRelocs * sizeof(Elf64_Rela));
+      Elf64_Rela *Rela = reinterpret_cast<Elf64_Rela *>(&Relocs[0]);
+      for (size_t j = 0; j < NumRelocs; ++j) {
+        uint32_t Sym = Rela[j].getSymbol();
+        if (Sym >= In.NumSymbols) {
+          return fail("malformed relocation section");
+        }
+        if ((Sym != 0) && (In.SymbolMap[Sym] == 0)) {
+          return fail("relocation against a dropped symbol");
+        }
+        Rela[j].setSymbolAndType(In.SymbolMap[Sym], Rela[j].getType());
+      }
+
+      Elf64_Shdr Header = Section;
+      Header.sh_name = 0;
+      Header.sh_offset = 0;
+      Header.sh_link = SymTabIndex;
+      Header.sh_info = In.SectionMap[Section.sh_info];
+      RelaSections.push_back(addSection(
+          getString(In.ShStrTab, Section.sh_name), Header,
+          addBuffer(std::move(Relocs))));
+    }
+  }
+
+  // Keep the symbol table last but for the string tables.
+  std::rotate(mOutput.begin() + SymTabIndex, mOutput.begin() + SymTabIndex + 1,
+              mOutput.end());
+  for (unsigned Index : RelaSections) {
+    mOutput[Index - 1].Header.sh_link = mOutput.size() - 1;
+  }
+  return true;
+}
+
+void Merger::write(llvm::SmallVectorImpl<char> &pResult) {
+  const unsigned SymTabIndex = mOutput.size() - 1;
+
+  Elf64_Shdr Header;
+  memset(&Header, 0, sizeof(Header));
+  Header.sh_type = SHT_STRTAB;
+  Header.sh_addralign = 1;
+  Header.sh_size = mStrTab.size();
+  mOutput[SymTabIndex].Header.sh_link = addSection(".strtab", Header, mStrTab);
+
+  // The section names are added last, including their own.
+  const unsigned ShStrTabIndex = addSection(".shstrtab", Header,
+                                            llvm::StringRef());
+  std::string ShStrTab(1, '\0');
+  std::map<std::string, uint32_t> NameOffsets;
+  for (OutputSection &Out : mOutput) {
+    if (Out.Name.empty()) {
+      continue;
+    }
+    auto It = NameOffsets.find(Out.Name);
+    if (It == NameOffsets.end()) {
+      It = NameOffsets.insert(std::make_pair(Out.Name, ShStrTab.size())).first;
+      ShStrTab += Out.Name;
+      ShStrTab.push_back('\0');
+    }
+    Out.Header.sh_name = It->second;
+  }
+  mOutput[ShStrTabIndex].Contents = addBuffer(std::move(ShStrTab));
+  mOutput[ShStrTabIndex].Header.sh_size =
+      mOutput[ShStrTabIndex].Contents.size();
+
+  uint64_t Offset = sizeof(Elf64_Ehdr);
+  for (unsigned i = 1; i < mOutput.size(); ++i) {
+    Elf64_Shdr &Section = mOutput[i].Header;
+    Offset = llvm::alignTo(Offset, std::max<uint64_t>(Section.sh_addralign, 1));
+    Section.sh_offset = Offset;
+    if (Section.sh_type != SHT_NOBITS) {
+      Offset += Section.sh_size;
+    }
+  }
+  const uint64_t ShOff = llvm::alignTo(Offset, 8);
+
+  pResult.assign(ShOff + mOutput.size() * sizeof(Elf64_Shdr), 0);
+  char *Buf = pResult.data();
+  for (unsigned i = 0; i < mOutput.size(); ++i) {
+    const OutputSection &Out = mOutput[i];
+    if ((Out.Header.sh_type != SHT_NOBITS) && !Out.Contents.empty()) {
+      memcpy(Buf + Out.Header.sh_offset, Out.Contents.data(),
+             Out.Contents.size());
+    }
+    memcpy(Buf + ShOff + i * sizeof(Elf64_Shdr), &Out.Header,
+           sizeof(Elf64_Shdr));
+  }
+
+  Elf64_Ehdr Ehdr = *mInputs.front().Header;
+  Ehdr.e_entry = 0;
+  Ehdr.e_phoff = 0;
+  Ehdr.e_phentsize = 0;
+  Ehdr.e_phnum = 0;
+  Ehdr.e_shoff = ShOff;
+  Ehdr.e_ehsize = sizeof(Elf64_Ehdr);
+  Ehdr.e_shentsize = sizeof(Elf64_Shdr);
+  Ehdr.e_shnum = mOutput.size();
+  Ehdr.e_shstrndx = ShStrTabIndex;
+  memcpy(Buf, &Ehdr, sizeof(Ehdr));
+}
+
+bool Merger::merge(llvm::SmallVectorImpl<char> &pResult) {
+  if (!llvm::sys::IsLittleEndianHost) {
+    return fail("big-endian hosts are not supported");
+  }
+  if (mInputs.empty()) {
+    return fail("no objects to merge");
+  }
+
+  for (InputObject &In : mInputs) {
+    if (!parse(In)) {
+      return false;
+    }
+    if ((In.Header->e_machine != mInputs.front().Header->e_machine) ||
+        (In.Header->e_flags != mInputs.front().Header->e_flags)) {
+      return fail("objects for different machines");
+    }
+  }
+
+  if (!mergeSections() || !mergeSymbols() || !mergeRelocations()) {
+    return false;
+  }
+  if (mOutput.size() + 2 >= SHN_LORESERVE) {
+    return fail("too many sections");
+  }
+  write(pResult);
+  return true;
+}
+
+}  // end anonymous namespace
+
+namespace bcc {
+
+bool mergeObjects(const std::vector<llvm::StringRef> &pObjects,
+                  llvm::SmallVectorImpl<char> &pResult, std::string &pError) {
+  Merger merger(pObjects, pError);
+  if (!merger.merge(pResult)) {
+    pResult.clear();
+    return false;
+  }
+  return true;
+}
+
+}  // end namespace bcc
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2026, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BCC_OBJECT_MERGER_H
+#define BCC_OBJECT_MERGER_H
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringRef.h>
+
+#include <string>
+#include <vector>
+
+namespace bcc {
+
+/// @brief Merge relocatable objects into a single relocatable object.
+///
+/// This is the equivalent of "ld -r" for the objects that the Compiler emits
+/// for the parts of one script: the sections of every object are kept as
+/// they are, the local symbols are concatenated, and the global symbols are
+/// resolved by name, so that a reference in one object binds to the
+/// definition in another.  The relocations are rewritten against the merged
+/// symbol table.
+///
+/// Only little-endian ELF64 objects with RELA relocations, and without
+/// section groups, are supported.
+///
+/// @param pObjects The relocatable objects, for the same machine.
+/// @param pResult The merged object, on success.
+/// @param pError The reason for the failure, on failure.
+/// @return True, if the objects were merged.  False, if they are malformed,
+/// use a feature that isn't supported or define a symbol more than once.
+bool mergeObjects(const std::vector<llvm::StringRef> &pObjects,
+                  llvm::SmallVectorImpl<char> &pResult, std::string &pError);
+
+}  // end namespace bcc
+
+#endif  // BCC_OBJECT_MERGER_H
@@ -0,0 +1,691 @@
+/*
+ * Copyright 2026, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "bcc/PerfInfo.h"
+
+#include <llvm/Support/DataExtractor.h>
+#include <llvm/Support/Dwarf.h>
+#include <llvm/Support/ELF.h>
+#include <llvm/Support/Host.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+using namespace llvm::ELF;
+
+namespace {
+
+struct FunctionInfo {
+  llvm::StringRef Name;
+  uint64_t Addr;  // Link-time address.
+  uint64_t Size;
+  llvm::StringRef Code;
+};
+
+// A row of the line tables, for the instructions starting at Addr.
+struct LineRow {
+  uint64_t Addr;
+  uint32_t Line;
+  uint32_t Discriminator;
+  unsigned File;  // Index into ImageReader::getFiles().
+};
+
+// Reads the functions and the line tables of an ELF64 image.
+class ImageReader {
+private:
+  llvm::StringRef mImage;
+  std::string &mError;
+
+  const Elf64_Ehdr *mHeader;
+  const Elf64_Shdr *mSections;
+  unsigned mNumSections;
+  llvm::StringRef mShStrTab;
+
+  std::vector<std::string> mFiles;
+
+  bool fail(const std::string &Msg) {
+    mError = Msg;
+    return false;
+  }
+
+  template <typename T>
+  const T *getArray(uint64_t Offset, uint64_t Count) const {
+    if ((Offset > mImage.size()) ||
+        (Count > (mImage.size() - Offset) / sizeof(T))) {
+      return nullptr;
+    }
+    return reinterpret_cast<const T *>(mImage.data() + Offset);
+  }
+
+  bool getSectionContents(unsigned Index, llvm::StringRef &Contents) const {
+    const Elf64_Shdr &Section = mSections[Index];
+    if (Section.sh_type == SHT_NOBITS) {
+      Contents = llvm::StringRef();
+      return true;
+    }
+    const char *Data = getArray<char>(Section.sh_offset, Section.sh_size);
+    if (Data == nullptr) {
+      return false;
+    }
+    Contents = llvm::StringRef(Data, Section.sh_size);
+    return true;
+  }
+
+  static llvm::StringRef getString(llvm::StringRef Table, uint32_t Offset) {
+    return Table.substr(Offset).split('\0').first;
+  }
+
+  bool readLineTable(llvm::DataExtractor &Data, uint32_t &Offset,
+                     std::vector<LineRow> &pRows);
+
+public:
+  ImageReader(llvm::StringRef pImage, std::string &pError)
+    : mImage(pImage), mError(pError), mHeader(nullptr), mSections(nullptr),
+      mNumSections(0) {
+  }
+
+  bool parse();
+
+  uint16_t getMachine() const {
+    return mHeader->e_machine;
+  }
+
+  const std::vector<std::string> &getFiles() const {
+    return mFiles;
+  }
+
+  bool getFunctions(std::vector<FunctionInfo> &pFunctions);
+  bool getLineRows(std::vector<LineRow> &pRows);
+};
+
+bool ImageReader::parse() {
+  if (!llvm::sys::IsLittleEndianHost) {
+    return fail("big-endian hosts are not supported");
+  }
+
+  mHeader = getArray<Elf64_Ehdr>(0, 1);
+  if ((mHeader == nullptr) || !mHeader->checkMagic() ||
+      (mHeader->getFileClass() != ELFCLASS64) ||
+      (mHeader->getDataEncoding() != ELFDATA2LSB)) {
+    return fail("not a little-endian ELF64 image");
+  }
+  if ((mHeader->e_type != ET_DYN) && (mHeader->e_type != ET_EXEC)) {
+    return fail("not a shared object or an executable");
+  }
+
+  mNumSections = mHeader->e_shnum;
+  mSections = getArray<Elf64_Shdr>(mHeader->e_shoff, mNumSections);
+  if ((mSections == nullptr) || (mNumSections == 0) ||
+      (mHeader->e_shstrndx >= mNumSections) ||
+      !getSectionContents(mHeader->e_shstrndx, mShStrTab)) {
+    return fail("malformed section header table");
+  }
+  return true;
+}
+
+bool ImageReader::getFunctions(std::vector<FunctionInfo> &pFunctions) {
+  // Prefer the full symbol table to the dynamic one, which only has the
+  // exported symbols.
+  int SymTabIndex = -1;
+  for (unsigned i = 0; i < mNumSections; ++i) {
+    if (mSections[i].sh_type == SHT_SYMTAB) {
+      SymTabIndex = i;
+      break;
+    }
+    if ((mSections[i].sh_type == SHT_DYNSYM) && (SymTabIndex < 0)) {
+      SymTabIndex = i;
+    }
+  }
+  if (SymTabIndex < 0) {
+    return fail("no symbol table");
+  }
+
+  const Elf64_Shdr &SymTab = mSections[SymTabIndex];
+  const unsigned NumSymbols = SymTab.sh_size / sizeof(Elf64_Sym);
+  const Elf64_Sym *Symbols = getArray<Elf64_Sym>(SymTab.sh_offset, NumSymbols);
+  llvm::StringRef StrTab;
+  if ((Symbols == nullptr) || (SymTab.sh_link >= mNumSections) ||
+      !getSectionContents(SymTab.sh_link, StrTab)) {
+    return fail("malformed symbol table");
+  }
+
+  for (unsigned i = 1; i < NumSymbols; ++i) {
+    const Elf64_Sym &Symbol = Symbols[i];
+    if ((Symbol.getType() != STT_FUNC) || (Symbol.st_size == 0) ||
+        (Symbol.st_shndx == SHN_UNDEF) || (Symbol.st_shndx >= mNumSections)) {
+      continue;
+    }
+    const Elf64_Shdr &Section = mSections[Symbol.st_shndx];
+    if (!(Section.sh_flags & SHF_EXECINSTR) ||
+        (Symbol.st_value < Section.sh_addr) ||
+        (Symbol.st_size > Section.sh_size) ||
+        (Symbol.st_value - Section.sh_addr >
+         Section.sh_size - Symbol.st_size)) {
+      continue;
+    }
+
+    FunctionInfo Function;
+    Function.Name = getString(StrTab, Symbol.st_name);
+    Function.Addr = Symbol.st_value;
+    Function.Size = Symbol.st_size;
+    llvm::StringRef Contents;
+    if (getSectionContents(Symbol.st_shndx, Contents)) {
+      Function.Code = Contents.substr(Symbol.st_value - Section.sh_addr,
+                                      Symbol.st_size);
+    }
+    if (!Function.Name.empty()) {
+      pFunctions.push_back(Function);
+    }
+  }
+
+  // Describe the code at an address once, under its first name.
+  std::stable_sort(pFunctions.begin(), pFunctions.end(),
+                   [](const FunctionInfo &L, const FunctionInfo &R) {
+                     return L.Addr < R.Addr;
+                   });
+  pFunctions.erase(std::unique(pFunctions.begin(), pFunctions.end(),
+                               [](const FunctionInfo &L,
+                                  const FunctionInfo &R) {
+                                 return L.Addr == R.Addr;
+                               }),
+                   pFunctions.end());
+  return true;
+}
+
+bool ImageReader::getLineRows(std::vector<LineRow> &pRows) {
+  llvm::StringRef Contents;
+  for (unsigned i = 0; i < mNumSections; ++i) {
+    if (getString(mShStrTab, mSections[i].sh_name) == ".debug_line") {
+      if (!getSectionContents(i, Contents)) {
+        return fail("malformed .debug_line section");
+      }
+      break;
+    }
+  }
+
+  llvm::DataExtractor Data(Contents, /* IsLittleEndian */true,
+                           /* AddressSize */8);
+  uint32_t Offset = 0;
+  while (Data.isValidOffset(Offset)) {
+    if (!readLineTable(Data, Offset, pRows)) {
+      return false;
+    }
+  }
+
+  std::stable_sort(pRows.begin(), pRows.end(),
+                   [](const LineRow &L, const LineRow &R) {
+                     return L.Addr < R.Addr;
+                   });
+  return true;
+}
+
+// Run the line number program of the unit at Offset (DWARF 2 to 4, in the
+// 32-bit format), and move Offset past the unit.
+bool ImageReader::readLineTable(llvm::DataExtractor &Data, uint32_t &Offset,
+                                std::vector<LineRow> &pRows) {
+  const uint32_t UnitLength = Data.getU32(&Offset);
+  if ((UnitLength == 0xffffffff) ||
+      (UnitLength > Data.getData().size() - Offset)) {
+    return fail("unsupported .debug_line section");
+  }
+  const uint32_t UnitEnd = Offset + UnitLength;
+
+  const uint16_t Version = Data.getU16(&Offset);
+  if ((Version < 2) || (Version > 4)) {
+    Offset = UnitEnd;
+    return true;
+  }
+  const uint32_t HeaderLength = Data.getU32(&Offset);
+  const uint32_t ProgramOffset = Offset + HeaderLength;
+  const uint8_t MinInstLength = Data.getU8(&Offset);
+  if (Version >= 4) {
+    Data.getU8(&Offset);  // maximum_operations_per_instruction
+  }
+  Data.getU8(&Offset);  // default_is_stmt
+  const int8_t LineBase = static_cast<int8_t>(Data.getU8(&Offset));
+  const uint8_t LineRange = Data.getU8(&Offset);
+  const uint8_t OpcodeBase = Data.getU8(&Offset);
+  if ((LineRange == 0) || (OpcodeBase == 0) || (ProgramOffset > UnitEnd)) {
+    return fail("malformed .debug_line section");
+  }
+  std::vector<uint8_t> OpcodeLengths(OpcodeBase - 1);
+  for (uint8_t &Length : OpcodeLengths) {
+    Length = Data.getU8(&Offset);
+  }
+
+  std::vector<std::string> Dirs(1);
+  while (const char *Dir = Data.getCStr(&Offset)) {
+    if (*Dir == '\0') {
+      break;
+    }
+    Dirs.push_back(Dir);
+  }
+
+  // File numbers start at 1.
+  std::vector<unsigned> Files(1, 0);
+  while (const char *Name = Data.getCStr(&Offset)) {
+    if (*Name == '\0') {
+      break;
+    }
+    const uint64_t Dir = Data.getULEB128(&Offset);
+    Data.getULEB128(&Offset);  // modification time
+    Data.getULEB128(&Offset);  // length
+    if ((*Name != '/') && (Dir != 0) && (Dir < Dirs.size())) {
+      mFiles.push_back(Dirs[Dir] + "/" + Name);
+    } else {
+      mFiles.push_back(Name);
+    }
+    Files.push_back(mFiles.size() - 1);
+  }
+
+  uint64_t Addr = 0;
+  uint32_t File = 1;
+  uint32_t Line = 1;
+  uint32_t Discriminator = 0;
+  auto addRow = [&]() {
+    if ((File != 0) && (File < Files.size())) {
+      LineRow Row;
+      Row.Addr = Addr;
+      Row.Line = Line;
+      Row.Discriminator = Discriminator;
+      Row.File = Files[File];
+      pRows.push_back(Row);
+    }
+    Discriminator = 0;
+  };
+
+  Offset = ProgramOffset;
+  while (Offset < UnitEnd) {
+    const uint8_t Opcode = Data.getU8(&Offset);
+    if (Opcode >= OpcodeBase) {
+      const uint8_t Adjusted = Opcode - OpcodeBase;
+      Addr += (Adjusted / LineRange) * MinInstLength;
+      Line += LineBase + (Adjusted % LineRange);
+      addRow();
+      continue;
+    }
+
+    switch (Opcode) {
+    case 0: {
+      const uint64_t Length = Data.getULEB128(&Offset);
+      if ((Length == 0) || (Length > UnitEnd - Offset)) {
+        return fail("malformed .debug_line section");
+      }
+      const uint32_t End = Offset + Length;
+      switch (Data.getU8(&Offset)) {
+      case llvm::dwarf::DW_LNE_end_sequence:
+        Addr = 0;
+        File = 1;
+        Line = 1;
+        Discriminator = 0;
+        break;
+      case llvm::dwarf::DW_LNE_set_address:
+        Addr = Data.getU64(&Offset);
+        break;
+      case llvm::dwarf::DW_LNE_set_discriminator:
+        Discriminator = Data.getULEB128(&Offset);
+        break;
+      default:
+        break;
+      }
+      Offset = End;
+      break;
+    }
+    case llvm::dwarf::DW_LNS_copy:
+      addRow();
+      break;
+    case llvm::dwarf::DW_LNS_advance_pc:
+      Addr += Data.getULEB128(&Offset) * MinInstLength;
+      break;
+    case llvm::dwarf::DW_LNS_advance_line:
+      Line += Data.getSLEB128(&Offset);
+      break;
+    case llvm::dwarf::DW_LNS_set_file:
+      File = Data.getULEB128(&Offset);
+      break;
+    case llvm::dwarf::DW_LNS_const_add_pc:
+      Addr += ((255 - OpcodeBase) / LineRange) * MinInstLength;
+      break;
+    case llvm::dwarf::DW_LNS_fixed_advance_pc:
+      Addr += Data.getU16(&Offset);
+      break;
+    default:
+      // The other standard opcodes don't matter here, skip their operands.
+      for (uint8_t i = 0; i < OpcodeLengths[Opcode - 1]; ++i) {
+        Data.getULEB128(&Offset);
+      }
+      break;
+    }
+  }
+
+  Offset = UnitEnd;
+  return true;
+}
+
+// Write the perf map entries of pFunctions, at pLoadBias, to pMap.  Functions
+// with line rows get the source location of their first one.
+void printPerfMap(FILE *pMap, const ImageReader &pReader,
+                  const std::vector<FunctionInfo> &pFunctions,
+                  const std::vector<LineRow> &pRows, uint64_t pLoadBias) {
+  for (const FunctionInfo &Function : pFunctions) {
+    fprintf(pMap, "%llx %llx %.*s",
+            static_cast<unsigned long long>(Function.Addr + pLoadBias),
+            static_cast<unsigned long long>(Function.Size),
+            static_cast<int>(Function.Name.size()), Function.Name.data());
+    auto First = std::lower_bound(pRows.begin(), pRows.end(), Function.Addr,
+                                  [](const LineRow &Row, uint64_t Addr) {
+                                    return Row.Addr < Addr;
+                                  });
+    if ((First != pRows.end()) &&
+        (First->Addr < Function.Addr + Function.Size)) {
+      fprintf(pMap, " (%s:%u)", pReader.getFiles()[First->File].c_str(),
+              First->Line);
+    }
+    fputc('\n', pMap);
+  }
+}
+
+#if defined(__linux__)
+
+// Serializes the writes to the files of the process.
+std::mutex gPerfInfoLock;
+
+// The jitdump file of the process, or -1 if it hasn't been created yet.
+int gJitDumpFd = -1;
+uint64_t gJitDumpCodeIndex = 0;
+
+// The jitdump format, see tools/perf/Documentation/jitdump-specification.txt
+// in the Linux sources.
+const uint32_t kJitDumpMagic = 0x4A695444;
+const uint32_t kJitDumpVersion = 1;
+const uint32_t kJitCodeLoad = 0;
+const uint32_t kJitCodeDebugInfo = 2;
+
+struct JitDumpHeader {
+  uint32_t Magic;
+  uint32_t Version;
+  uint32_t TotalSize;
+  uint32_t ElfMach;
+  uint32_t Pad1;
+  uint32_t Pid;
+  uint64_t Timestamp;
+  uint64_t Flags;
+};
+
+struct JitRecordHeader {
+  uint32_t Id;
+  uint32_t TotalSize;
+  uint64_t Timestamp;
+};
+
+struct JitCodeLoad {
+  uint32_t Pid;
+  uint32_t Tid;
+  uint64_t Vma;
+  uint64_t CodeAddr;
+  uint64_t CodeSize;
+  uint64_t CodeIndex;
+};
+
+struct JitDebugInfo {
+  uint64_t CodeAddr;
+  uint64_t NumEntries;
+};
+
+struct JitDebugEntry {
+  uint64_t Addr;
+  int32_t Line;
+  int32_t Discriminator;
+};
+
+// The clock of "perf record -k mono".
+uint64_t getTimestamp() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+template <typename T>
+void append(std::string &pBuffer, const T &pValue) {
+  pBuffer.append(reinterpret_cast<const char *>(&pValue), sizeof(pValue));
+}
+
+void appendString(std::string &pBuffer, llvm::StringRef pString) {
+  pBuffer.append(pString.data(), pString.size());
+  pBuffer.push_back('\0');
+}
+
+bool writeAll(int pFd, const std::string &pBuffer) {
+  const char *Data = pBuffer.data();
+  size_t Left = pBuffer.size();
+  while (Left != 0) {
+    ssize_t Written = ::write(pFd, Data, Left);
+    if (Written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    Data += Written;
+    Left -= Written;
+  }
+  return true;
+}
+
+bool openJitDump(uint16_t pMachine, std::string &pError) {
+  if (gJitDumpFd >= 0) {
+    return true;
+  }
+
+  const std::string Path = "/tmp/jit-" + std::to_string(getpid()) + ".dump";
+  int Fd = ::open(Path.c_str(), O_CREAT | O_TRUNC | O_RDWR | O_CLOEXEC, 0666);
+  if (Fd < 0) {
+    pError = "unable to create " + Path + " (" + strerror(errno) + ")";
+    return false;
+  }
+
+  // perf record finds the file through an executable mapping of it, which
+  // is kept for the lifetime of the process.
+  void *Marker = mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ | PROT_EXEC,
+                      MAP_PRIVATE, Fd, 0);
+  if (Marker == MAP_FAILED) {
+    pError = "unable to map " + Path + " (" + strerror(errno) + ")";
+    ::close(Fd);
+    return false;
+  }
+
+  JitDumpHeader Header = JitDumpHeader();
+  Header.Magic = kJitDumpMagic;
+  Header.Version = kJitDumpVersion;
+  Header.TotalSize = sizeof(Header);
+  Header.ElfMach = pMachine;
+  Header.Pid = getpid();
+  Header.Timestamp = getTimestamp();
+  std::string Buffer;
+  append(Buffer, Header);
+  if (!writeAll(Fd, Buffer)) {
+    pError = "unable to write " + Path + " (" + strerror(errno) + ")";
+    ::close(Fd);
+    return false;
+  }
+
+  gJitDumpFd = Fd;
+  return true;
+}
+
+bool writePerfMap(const ImageReader &pReader,
+                  const std::vector<FunctionInfo> &pFunctions,
+                  const std::vector<LineRow> &pRows, uint64_t pLoadBias,
+                  std::string &pError) {
+  const std::string Path = "/tmp/perf-" + std::to_string(getpid()) + ".map";
+  FILE *Map = fopen(Path.c_str(), "a");
+  if (Map == nullptr) {
+    pError = "unable to open " + Path + " (" + strerror(errno) + ")";
+    return false;
+  }
+  printPerfMap(Map, pReader, pFunctions, pRows, pLoadBias);
+  if (fclose(Map) != 0) {
+    pError = "unable to write " + Path;
+    return false;
+  }
+  return true;
+}
+
+bool writeJitDump(const ImageReader &pReader,
+                  const std::vector<FunctionInfo> &pFunctions,
+                  const std::vector<LineRow> &pRows, uint64_t pLoadBias,
+                  std::string &pError) {
+  if (!openJitDump(pReader.getMachine(), pError)) {
+    return false;
+  }
+
+  const uint32_t Pid = getpid();
+  const uint32_t Tid = syscall(SYS_gettid);
+  std::string Buffer;
+  for (const FunctionInfo &Function : pFunctions) {
+    if (Function.Code.size() != Function.Size) {
+      continue;
+    }
+    const uint64_t CodeAddr = Function.Addr + pLoadBias;
+
+    // The line tables of a function go before its code.
+    auto Begin = std::lower_bound(pRows.begin(), pRows.end(), Function.Addr,
+                                  [](const LineRow &Row, uint64_t Addr) {
+                                    return Row.Addr < Addr;
+                                  });
+    auto End = std::lower_bound(Begin, pRows.end(),
+                                Function.Addr + Function.Size,
+                                [](const LineRow &Row, uint64_t Addr) {
+                                  return Row.Addr < Addr;
+                                });
+    if (Begin != End) {
+      std::string Record;
+      JitDebugInfo Info;
+      Info.CodeAddr = CodeAddr;
+      Info.NumEntries = End - Begin;
+      append(Record, Info);
+      for (auto Row = Begin; Row != End; ++Row) {
+        JitDebugEntry Entry;
+        Entry.Addr = Row->Addr + pLoadBias;
+        Entry.Line = Row->Line;
+        Entry.Discriminator = Row->Discriminator;
+        append(Record, Entry);
+        appendString(Record, pReader.getFiles()[Row->File]);
+      }
+
+      JitRecordHeader Header;
+      Header.Id = kJitCodeDebugInfo;
+      Header.TotalSize = sizeof(Header) + Record.size();
+      Header.Timestamp = getTimestamp();
+      append(Buffer, Header);
+      Buffer += Record;
+    }
+
+    JitRecordHeader Header;
+    Header.Id = kJitCodeLoad;
+    Header.TotalSize = sizeof(Header) + sizeof(JitCodeLoad) +
+                       Function.Name.size() + 1 + Function.Size;
+    Header.Timestamp = getTimestamp();
+    append(Buffer, Header);
+
+    JitCodeLoad Load;
+    Load.Pid = Pid;
+    Load.Tid = Tid;
+    Load.Vma = CodeAddr;
+    Load.CodeAddr = CodeAddr;
+    Load.CodeSize = Function.Size;
+    Load.CodeIndex = gJitDumpCodeIndex++;
+    append(Buffer, Load);
+    appendString(Buffer, Function.Name);
+    Buffer += Function.Code;
+  }
+
+  if (!writeAll(gJitDumpFd, Buffer)) {
+    pError = std::string("unable to write the jitdump file (") +
+             strerror(errno) + ")";
+    return false;
+  }
+  return true;
+}
+
+#endif  // __linux__
+
+}  // end anonymous namespace
+
+namespace bcc {
+
+bool writePerfInfo(PerfInfoFormat pFormat, llvm::StringRef pImage,
+                   uint64_t pLoadBias, std::string &pError) {
+#if defined(__linux__)
+  ImageReader Reader(pImage, pError);
+  std::vector<FunctionInfo> Functions;
+  if (!Reader.parse() || !Reader.getFunctions(Functions)) {
+    return false;
+  }
+
+  std::vector<LineRow> Rows;
+  if (!Reader.getLineRows(Rows)) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> Lock(gPerfInfoLock);
+  if (pFormat == kPerfMap) {
+    return writePerfMap(Reader, Functions, Rows, pLoadBias, pError);
+  }
+  return writeJitDump(Reader, Functions, Rows, pLoadBias, pError);
+#else
+  pError = "perf is only supported on Linux";
+  return false;
+#endif
+}
+
+bool writePerfMapFile(llvm::StringRef pImage, const std::string &pPath,
+                      std::string &pError) {
+  ImageReader Reader(pImage, pError);
+  std::vector<FunctionInfo> Functions;
+  std::vector<LineRow> Rows;
+  if (!Reader.parse() || !Reader.getFunctions(Functions) ||
+      !Reader.getLineRows(Rows)) {
+    return false;
+  }
+
+  FILE *Map = fopen(pPath.c_str(), "w");
+  if (Map == nullptr) {
+    pError = "unable to open " + pPath + " (" + strerror(errno) + ")";
+    return false;
+  }
+  printPerfMap(Map, Reader, Functions, Rows, /* pLoadBias */0);
+  if (fclose(Map) != 0) {
+    pError = "unable to write " + pPath;
+    return false;
+  }
+  return true;
+}
+
+}  // end namespace bcc
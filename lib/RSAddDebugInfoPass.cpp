@@ -27,9 +27,12 @@
 #include <llvm/IR/Function.h>
 #include <llvm/IR/InstIterator.h>
 #include <llvm/IR/Instructions.h>
+#include <llvm/IR/IntrinsicInst.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Module.h>
+#include <llvm/ADT/DenseMap.h>
 #include <llvm/ADT/SetVector.h>
+#include <llvm/Support/CommandLine.h>
 
 namespace {
 
@@ -38,9 +41,30 @@ const char DEBUG_GENERATED_FILE[] = "generated.rs";
 const char DEBUG_PROTOTYPE_VAR_NAME[] = "rsDebugOuterForeachT";
 const char DEBUG_COMPILE_UNIT_MDNAME[] = "llvm.dbg.cu";
 
+// The mode the compiler driver asks for with Script::setLineTablesOnly(), for
+// running the pass on its own (e.g. from opt).  Named after the pass, since
+// bcc has an -rs-line-tables-only option of its own.
+llvm::cl::opt<bool> ClLineTablesOnly(
+    "addrsdi-line-tables-only", llvm::cl::init(false),
+    llvm::cl::desc("Only add line tables to the generated code, and reduce "
+                   "the debug info of the script to line tables"));
+
 /*
  * LLVM pass to attach debug information to the bits of code
  * generated by the compiler.
+ *
+ * In line-tables-only mode, the generated code only gets line information,
+ * so that sample profilers can attribute time to it in optimized builds:
+ * * The compile unit for the generated code only asks for line tables.
+ * * The expanded functions get no variables, and each of their basic blocks
+ *   gets a line of its own, so the loop can be told apart from its setup.
+ * * Kernels without debug info of their own, like the fused kernels, get
+ *   a subprogram as well, so that the code inlined into them is attributed
+ *   to them.
+ * * The variable locations are dropped, and the compile units of the script
+ *   are replaced by ones that only ask for line tables.  The script may also
+ *   have been compiled without any debug info, in which case only the
+ *   generated code has lines.
  */
 class RSAddDebugInfoPass : public llvm::ModulePass {
 
@@ -48,7 +72,8 @@ public:
   // Pass ID
   static char ID;
 
-  RSAddDebugInfoPass() : ModulePass(ID), kernelTypeMD(nullptr),
+  explicit RSAddDebugInfoPass(bool pLineTablesOnly = ClLineTablesOnly)
+      : ModulePass(ID), lineTablesOnly(pLineTablesOnly), kernelTypeMD(nullptr),
       sourceFileName(nullptr), emptyExpr(nullptr), abiMetaCU(nullptr),
       indexVarType(nullptr) {
   }
@@ -76,9 +101,18 @@ public:
         expandFuncs.insert(func);
     };
 
-    for (size_t i = 0; i < nForEachKernels; ++i)
+    // Kernels the compiler generated, which have no source location.
+    llvm::SmallSetVector<llvm::Function *, 4> generatedKernels{};
+
+    for (size_t i = 0; i < nForEachKernels; ++i) {
       pushExpanded(forEachKernels[i]);
 
+      llvm::Function *const kernel = Module.getFunction(forEachKernels[i]);
+      if (lineTablesOnly && kernel && !kernel->isDeclaration() &&
+          !kernel->getSubprogram())
+        generatedKernels.insert(kernel);
+    }
+
     for (size_t i = 0; i < nReductions; ++i) {
       const bcinfo::MetadataExtractor::Reduce &reduction = reductions[i];
       pushExpanded(reduction.mAccumulatorName);
@@ -88,13 +122,22 @@ public:
     llvm::DIBuilder DebugInfo(Module);
     initializeDebugInfo(DebugInfo, Module);
 
+    if (lineTablesOnly)
+      stripToLineTables(Module);
+
     for (const auto &expandFunc : expandFuncs) {
       // Attach DI metadata to each generated function.
       // No inlining has occurred at this point so it's safe to name match
       // without worrying about inlined function bodies.
-      attachDebugInfo(DebugInfo, *expandFunc);
+      if (lineTablesOnly)
+        attachLineTables(DebugInfo, *expandFunc);
+      else
+        attachDebugInfo(DebugInfo, *expandFunc);
     }
 
+    for (const auto &kernel : generatedKernels)
+      attachLineTables(DebugInfo, *kernel);
+
     DebugInfo.finalize();
 
     cleanupDebugInfo(Module);
@@ -111,13 +154,22 @@ private:
   // * Store a couple of useful pieces of debug metadata in member
   //   variables so they do not have to be created multiple times.
   void initializeDebugInfo(llvm::DIBuilder &DebugInfo,
-                           const llvm::Module &Module) {
+                           llvm::Module &Module) {
     llvm::LLVMContext &ctx = Module.getContext();
 
     // Start generating debug information for bcc-generated code.
     DebugInfo.createCompileUnit(llvm::dwarf::DW_LANG_GOOGLE_RenderScript,
                                 DEBUG_GENERATED_FILE, DEBUG_SOURCE_PATH,
-                                "RS", false, "", 0);
+                                "RS", lineTablesOnly, "", 0, "",
+                                lineTablesOnly ?
+                                    llvm::DICompileUnit::LineTablesOnly :
+                                    llvm::DICompileUnit::FullDebug);
+
+    // Without it, the code generator would ignore the debug info of a module
+    // that had none to begin with.
+    if (!Module.getModuleFlag("Debug Info Version"))
+      Module.addModuleFlag(llvm::Module::Warning, "Debug Info Version",
+                           llvm::DEBUG_METADATA_VERSION);
 
     // Pre-generate and save useful pieces of debug metadata.
     sourceFileName = DebugInfo.createFile(DEBUG_GENERATED_FILE, DEBUG_SOURCE_PATH);
@@ -145,8 +197,10 @@ private:
     }
 
     // Lookup the expanded function interface type metadata.
+    // Line tables don't describe the arguments, so the generated functions
+    // are given the type void() then.
     llvm::MDTuple *kernelPrototypeMD = nullptr;
-    if (kernelPrototypeVarMD != nullptr) {
+    if (kernelPrototypeVarMD != nullptr && !lineTablesOnly) {
       // Dig into the metadata to look for function prototype.
       llvm::DIDerivedType *DT = nullptr;
       DT = llvm::cast<llvm::DIDerivedType>(kernelPrototypeVarMD->getType());
@@ -252,6 +306,81 @@ private:
     }
   }
 
+  /// @brief Add line information to a generated function.
+  ///
+  /// This procedure adds an entry for the function specified by Func to the
+  /// current compile unit, and sets the location of each instruction to
+  /// generated.rs:N, N being the position of its basic block in Func.
+  void attachLineTables(llvm::DIBuilder &DebugInfo, llvm::Function &Func) {
+    llvm::DISubprogram *GeneratedFunc = DebugInfo.createFunction(
+        sourceFileName, // scope
+        Func.getName(), Func.getName(),
+        sourceFileName, 1, kernelTypeMD,
+        false, true, 1, 0, true
+    );
+    Func.setSubprogram(GeneratedFunc);
+
+    unsigned line = 1;
+    for (llvm::BasicBlock &block : Func) {
+      for (llvm::Instruction &inst : block)
+        inst.setDebugLoc(llvm::DebugLoc::get(line, 1, GeneratedFunc));
+      line++;
+    }
+  }
+
+  // @brief Reduce the debug info of the script to line tables.
+  //
+  // Removes the variable location intrinsics, which would otherwise keep
+  // values alive for the debugger, and replaces the compile units of the
+  // script by copies that only ask for line tables, without globals, types
+  // or imported entities.  The emission kind of a compile unit can't be
+  // changed in place, so the subprograms are moved to the copies.
+  void stripToLineTables(llvm::Module &Module) {
+    llvm::SmallVector<llvm::Instruction *, 16> variableInsts;
+    for (llvm::Function &func : Module)
+      for (llvm::Instruction &inst : llvm::instructions(func))
+        if (llvm::isa<llvm::DbgDeclareInst>(inst) ||
+            llvm::isa<llvm::DbgValueInst>(inst))
+          variableInsts.push_back(&inst);
+    for (llvm::Instruction *inst : variableInsts)
+      inst->eraseFromParent();
+
+    for (llvm::GlobalVariable &global : Module.globals())
+      global.eraseMetadata(llvm::LLVMContext::MD_dbg);
+
+    llvm::NamedMDNode *debugMD =
+        Module.getNamedMetadata(DEBUG_COMPILE_UNIT_MDNAME);
+    llvm::SmallVector<llvm::MDNode *, 4> units(debugMD->op_begin(),
+                                               debugMD->op_end());
+    llvm::DenseMap<llvm::DICompileUnit *, llvm::DICompileUnit *> lineTableUnits;
+    debugMD->clearOperands();
+    for (llvm::MDNode *node : units) {
+      auto *CU = llvm::dyn_cast<llvm::DICompileUnit>(node);
+      // The compile unit of the generated code already only has line tables,
+      // and the one with the kernel ABI is removed by cleanupDebugInfo().
+      if (CU == nullptr || CU == abiMetaCU ||
+          CU->getEmissionKind() == llvm::DICompileUnit::LineTablesOnly) {
+        debugMD->addOperand(node);
+        continue;
+      }
+
+      // Adds the copy to the compile unit list.
+      llvm::DIBuilder unitBuilder(Module);
+      lineTableUnits[CU] = unitBuilder.createCompileUnit(
+          CU->getSourceLanguage(), CU->getFilename(), CU->getDirectory(),
+          CU->getProducer(), CU->isOptimized(), CU->getFlags(),
+          CU->getRuntimeVersion(), CU->getSplitDebugFilename(),
+          llvm::DICompileUnit::LineTablesOnly, CU->getDWOId());
+      unitBuilder.finalize();
+    }
+
+    for (llvm::Function &func : Module)
+      if (llvm::DISubprogram *subprogram = func.getSubprogram())
+        if (llvm::DICompileUnit *unit =
+                lineTableUnits.lookup(subprogram->getUnit()))
+          subprogram->replaceUnit(unit);
+  }
+
   // @brief Clean up the debug info.
   //
   // At the moment, it only finds the compile unit for the expanded function
@@ -275,6 +404,7 @@ private:
 
 private:
   // private attributes
+  bool lineTablesOnly;
   llvm::DISubroutineType* kernelTypeMD;
   llvm::DIFile *sourceFileName;
   llvm::DIExpression *emptyExpr;
@@ -290,8 +420,8 @@ static llvm::RegisterPass<RSAddDebugInfoPass> X("addrsdi", "Add RS DebugInfo Pas
 
 namespace bcc {
 
-llvm::ModulePass * createRSAddDebugInfoPass() {
-  return new RSAddDebugInfoPass();
+llvm::ModulePass * createRSAddDebugInfoPass(bool pLineTablesOnly) {
+  return new RSAddDebugInfoPass(pLineTablesOnly);
 }
 
 } // end namespace bcc
@@ -0,0 +1,1006 @@
+/*
+ * Copyright 2026, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Log.h"
+#include "RSTransforms.h"
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/CallSite.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DataLayout.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/InlineAsm.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Pass.h>
+#include <llvm/Support/MathExtras.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/ValueMapper.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Runtime functions the launch-time check is built from.
+const char kGetDimXName[] = "_Z19rsAllocationGetDimX13rs_allocation";
+const char kGetDimYName[] = "_Z19rsAllocationGetDimY13rs_allocation";
+const char kGetDimZName[] = "_Z19rsAllocationGetDimZ13rs_allocation";
+const char kGetElementName[] = "_Z22rsAllocationGetElement13rs_allocation";
+const char kGetDataTypeName[] = "_Z20rsElementGetDataType10rs_element";
+const char kGetVectorSizeName[] = "_Z22rsElementGetVectorSize10rs_element";
+
+// The untyped accessor, which doesn't check its indices in any runtime.
+const char kGetElementAtName[] = "_Z14rsGetElementAt13rs_allocationjjj";
+
+// The typed accessors of the debug runtime call into the driver for the
+// checked access, e.g. rsGetElementAtImpl_float().
+const char kCheckedImplMarker[] = "ElementAtImpl_";
+
+const char kExpandSuffix[] = ".expand";
+
+// RsDataType of the element types of the typed accessors.
+struct DataTypeName {
+  const char *Name;
+  unsigned DataType;
+};
+
+const DataTypeName kDataTypes[] = {
+  { "half",   1 },  // RS_TYPE_FLOAT_16
+  { "float",  2 },  // RS_TYPE_FLOAT_32
+  { "double", 3 },  // RS_TYPE_FLOAT_64
+  { "char",   4 },  // RS_TYPE_SIGNED_8
+  { "short",  5 },  // RS_TYPE_SIGNED_16
+  { "int",    6 },  // RS_TYPE_SIGNED_32
+  { "long",   7 },  // RS_TYPE_SIGNED_64
+  { "uchar",  8 },  // RS_TYPE_UNSIGNED_8
+  { "ushort", 9 },  // RS_TYPE_UNSIGNED_16
+  { "uint",   10 }, // RS_TYPE_UNSIGNED_32
+  { "ulong",  11 }, // RS_TYPE_UNSIGNED_64
+};
+
+/* RSBoundsCheckHoistingPass: Replaces the per-access checks of the debug
+ * runtime in expanded kernel loops with one check per launch.
+ *
+ * Under a debug context, scripts are linked against a runtime whose typed
+ * accessors (rsGetElementAt_float() etc.) call into the driver, which checks
+ * the indices against the dimensions of the allocation and the accessor type
+ * against its element, and reports an error instead of accessing it.
+ *
+ * A call to such an accessor in a kernel is unchecked when:
+ * - its allocation is read from a global that nothing the kernel runs
+ *   writes, so that it is the same allocation throughout the launch;
+ * - each of its indices is Scale * v + Offset for constants Scale and
+ *   Offset, where v is either the x of the kernel or a loop-invariant
+ *   argument of the kernel (such as y), or is a constant.
+ *
+ * The loop of the .expand function is then versioned: a copy of the kernel
+ * does these accesses through rsGetElementAt() without checks, and is only
+ * run if, before the loop, every allocation is non-null, has the element
+ * type of its accessors, and the range of each index over [x1, x2) is
+ * within its dimension.  Otherwise, the original loop runs, so the same
+ * errors are reported in the same order as without the pass.
+ *
+ * Must run after RSKernelExpandPass and before the unused runtime functions
+ * are removed, since the check calls the runtime getters.
+ */
+class RSBoundsCheckHoistingPass : public llvm::ModulePass {
+private:
+  static char ID;
+
+  // What the name of a typed accessor says about it.
+  struct Accessor {
+    bool IsChecked;
+    bool IsSet;
+    unsigned DataType;
+    unsigned VectorSize;
+    unsigned NumIndices;
+    llvm::Type *ElementTy;
+  };
+
+  // Scale * Base + Offset, where Base is an argument of the kernel, or null
+  // for a constant.
+  struct AffineIndex {
+    llvm::Argument *Base;
+    int64_t Scale;
+    int64_t Offset;
+  };
+
+  struct Access {
+    llvm::CallInst *Call;
+    const Accessor *Info;
+    llvm::GlobalVariable *Allocation;
+    AffineIndex Indices[3];
+  };
+
+  // A loop created by RSKernelExpandPass::createLoop():
+  //
+  // Loop:
+  //   %X = load i32, i32* %rsIndex
+  //   ...
+  //   %X.next = add nuw i32 %X, 1
+  //   store i32 %X.next, i32* %rsIndex
+  //   br i1 (%X.next < Upper), label %Loop, label %Exit
+  struct LoopShape {
+    llvm::LoadInst *IV;
+    llvm::AllocaInst *IVVar;
+    llvm::Value *Upper;
+  };
+
+  llvm::Module *Module;
+  const llvm::DataLayout *DL;
+
+  llvm::Function *GetDim[3];
+  llvm::Function *GetElement;
+  llvm::Function *GetDataType;
+  llvm::Function *GetVectorSize;
+  llvm::Function *GetElementAt;
+
+  std::map<llvm::Function *, Accessor> Accessors;
+
+  // Returns the typed accessor F, or null if F isn't one.
+  const Accessor *getAccessor(llvm::Function *F) {
+    auto It = Accessors.find(F);
+    if (It != Accessors.end()) {
+      return &It->second;
+    }
+
+    Accessor Info;
+    if (!parseAccessor(F, Info)) {
+      return nullptr;
+    }
+    return &(Accessors[F] = Info);
+  }
+
+  static bool parseAccessor(llvm::Function *F, Accessor &Info) {
+    // _Z<length><identifier><parameters>
+    llvm::StringRef Name = F->getName();
+    if (!Name.startswith("_Z")) {
+      return false;
+    }
+    Name = Name.drop_front(2);
+    size_t Digits = Name.find_first_not_of("0123456789");
+    unsigned Length = 0;
+    if (Digits == 0 || Digits == llvm::StringRef::npos ||
+        Name.substr(0, Digits).getAsInteger(10, Length) ||
+        Length > Name.size() - Digits) {
+      return false;
+    }
+    llvm::StringRef Identifier = Name.substr(Digits, Length);
+
+    llvm::StringRef TypeName;
+    if (Identifier.startswith("rsGetElementAt_")) {
+      Info.IsSet = false;
+      TypeName = Identifier.drop_front(strlen("rsGetElementAt_"));
+    } else if (Identifier.startswith("rsSetElementAt_")) {
+      Info.IsSet = true;
+      TypeName = Identifier.drop_front(strlen("rsSetElementAt_"));
+    } else {
+      return false;
+    }
+
+    Info.VectorSize = 1;
+    if (!TypeName.empty() && TypeName.back() >= '2' && TypeName.back() <= '4') {
+      Info.VectorSize = TypeName.back() - '0';
+      TypeName = TypeName.drop_back();
+    }
+    Info.DataType = 0;
+    for (const DataTypeName &DT : kDataTypes) {
+      if (TypeName == DT.Name) {
+        Info.DataType = DT.DataType;
+      }
+    }
+    if (Info.DataType == 0) {
+      return false;
+    }
+
+    // The element must be passed and returned by value; the indices follow
+    // the allocation and, for rsSetElementAt_*(), the value.
+    llvm::FunctionType *FTy = F->getFunctionType();
+    const unsigned FirstIndex = Info.IsSet ? 2 : 1;
+    if (FTy->getNumParams() <= FirstIndex ||
+        FTy->getNumParams() > FirstIndex + 3) {
+      return false;
+    }
+    Info.NumIndices = FTy->getNumParams() - FirstIndex;
+    Info.ElementTy = Info.IsSet ? FTy->getParamType(1) : FTy->getReturnType();
+    if (Info.IsSet != FTy->getReturnType()->isVoidTy() ||
+        !Info.ElementTy->isSingleValueType() ||
+        Info.ElementTy->isPointerTy()) {
+      return false;
+    }
+    for (unsigned i = FirstIndex; i < FTy->getNumParams(); ++i) {
+      if (!FTy->getParamType(i)->isIntegerTy(32)) {
+        return false;
+      }
+    }
+
+    Info.IsChecked = false;
+    for (llvm::BasicBlock &BB : *F) {
+      for (llvm::Instruction &I : BB) {
+        llvm::CallInst *Call = llvm::dyn_cast<llvm::CallInst>(&I);
+        llvm::Function *Callee =
+            Call != nullptr ? Call->getCalledFunction() : nullptr;
+        if (Callee != nullptr &&
+            Callee->getName().find(kCheckedImplMarker) !=
+                llvm::StringRef::npos) {
+          Info.IsChecked = true;
+        }
+      }
+    }
+    return true;
+  }
+
+  // Match V to Scale * Base + Offset.  The ranges keep the launch-time
+  // computation of the index range from overflowing 64 bits.
+  static bool matchAffine(llvm::Value *V, AffineIndex &Index,
+                          unsigned Depth = 0) {
+    if (!V->getType()->isIntegerTy(32)) {
+      return false;
+    }
+    if (llvm::ConstantInt *C = llvm::dyn_cast<llvm::ConstantInt>(V)) {
+      Index = { nullptr, 0, static_cast<int64_t>(C->getZExtValue()) };
+      return true;
+    }
+    if (llvm::Argument *Arg = llvm::dyn_cast<llvm::Argument>(V)) {
+      Index = { Arg, 1, 0 };
+      return true;
+    }
+
+    llvm::BinaryOperator *BO = llvm::dyn_cast<llvm::BinaryOperator>(V);
+    if (BO == nullptr || Depth > 8) {
+      return false;
+    }
+    llvm::Value *Other = BO->getOperand(0);
+    llvm::ConstantInt *C = llvm::dyn_cast<llvm::ConstantInt>(BO->getOperand(1));
+    if (C == nullptr && BO->isCommutative()) {
+      Other = BO->getOperand(1);
+      C = llvm::dyn_cast<llvm::ConstantInt>(BO->getOperand(0));
+    }
+    if (C == nullptr || !matchAffine(Other, Index, Depth + 1)) {
+      return false;
+    }
+
+    const int64_t K = C->getSExtValue();
+    switch (BO->getOpcode()) {
+    case llvm::Instruction::Add:
+      Index.Offset += K;
+      break;
+    case llvm::Instruction::Sub:
+      if (C != BO->getOperand(1)) {
+        return false;
+      }
+      Index.Offset -= K;
+      break;
+    case llvm::Instruction::Mul:
+      Index.Scale *= K;
+      Index.Offset *= K;
+      break;
+    case llvm::Instruction::Shl:
+      if (C != BO->getOperand(1) || K < 0 || K > 30) {
+        return false;
+      }
+      Index.Scale *= INT64_C(1) << K;
+      Index.Offset *= INT64_C(1) << K;
+      break;
+    default:
+      return false;
+    }
+    return std::abs(Index.Scale) < (INT64_C(1) << 30) &&
+           std::abs(Index.Offset) < (INT64_C(1) << 32);
+  }
+
+  // Returns the global the allocation handle Handle is read from, or null if
+  // it isn't read from one.
+  llvm::GlobalVariable *getHandleSource(llvm::Value *Handle) {
+    // Handles passed by value are loaded from the global.
+    if (!Handle->getType()->isPointerTy()) {
+      llvm::LoadInst *Load = llvm::dyn_cast<llvm::LoadInst>(Handle);
+      if (Load == nullptr || Load->isVolatile()) {
+        return nullptr;
+      }
+      return llvm::dyn_cast<llvm::GlobalVariable>(
+          Load->getPointerOperand()->stripPointerCasts());
+    }
+
+    llvm::Value *Ptr = Handle->stripPointerCasts();
+    if (llvm::GlobalVariable *GV = llvm::dyn_cast<llvm::GlobalVariable>(Ptr)) {
+      return GV;
+    }
+
+    // Handles passed by reference point to a copy of the global, which must
+    // not be written by anything else.
+    llvm::AllocaInst *Copy = llvm::dyn_cast<llvm::AllocaInst>(Ptr);
+    if (Copy == nullptr) {
+      return nullptr;
+    }
+    llvm::GlobalVariable *Source = nullptr;
+    std::vector<llvm::Value *> Worklist(1, Copy);
+    while (!Worklist.empty()) {
+      llvm::Value *V = Worklist.back();
+      Worklist.pop_back();
+      for (llvm::User *U : V->users()) {
+        if (llvm::isa<llvm::BitCastInst>(U)) {
+          Worklist.push_back(U);
+          continue;
+        }
+        if (llvm::MemCpyInst *MC = llvm::dyn_cast<llvm::MemCpyInst>(U)) {
+          if (MC->getRawDest() != V) {
+            continue;
+          }
+          llvm::GlobalVariable *GV = llvm::dyn_cast<llvm::GlobalVariable>(
+              MC->getRawSource()->stripPointerCasts());
+          llvm::ConstantInt *Length =
+              llvm::dyn_cast<llvm::ConstantInt>(MC->getLength());
+          if (GV == nullptr || (Source != nullptr && Source != GV) ||
+              Length == nullptr ||
+              Length->getZExtValue() !=
+                  DL->getTypeAllocSize(GV->getValueType())) {
+            return nullptr;
+          }
+          Source = GV;
+          continue;
+        }
+        if (const llvm::IntrinsicInst *II =
+                llvm::dyn_cast<llvm::IntrinsicInst>(U)) {
+          if (II->getIntrinsicID() == llvm::Intrinsic::lifetime_start ||
+              II->getIntrinsicID() == llvm::Intrinsic::lifetime_end) {
+            continue;
+          }
+        }
+        llvm::CallInst *Call = llvm::dyn_cast<llvm::CallInst>(U);
+        if (Call != nullptr && Call->getCalledFunction() != nullptr &&
+            (Call->onlyReadsMemory() ||
+             getAccessor(Call->getCalledFunction()) != nullptr)) {
+          // Only as the handle, which the accessors don't write.
+          bool OnlyHandle = true;
+          for (unsigned i = 1; i < Call->getNumArgOperands(); ++i) {
+            OnlyHandle &= (Call->getArgOperand(i) != V);
+          }
+          if (OnlyHandle) {
+            continue;
+          }
+        }
+        return nullptr;
+      }
+    }
+    return Source;
+  }
+
+  // Returns whether GV may be written (or its address escape) in any of
+  // Functions.
+  bool mayBeWritten(llvm::GlobalVariable *GV,
+                    const std::set<llvm::Function *> &Functions) {
+    std::vector<llvm::Value *> Worklist(1, GV);
+    std::set<llvm::Value *> Visited;
+    while (!Worklist.empty()) {
+      llvm::Value *V = Worklist.back();
+      Worklist.pop_back();
+      if (!Visited.insert(V).second) {
+        continue;
+      }
+      for (llvm::User *U : V->users()) {
+        if (llvm::ConstantExpr *CE = llvm::dyn_cast<llvm::ConstantExpr>(U)) {
+          if (!CE->isCast() &&
+              CE->getOpcode() != llvm::Instruction::GetElementPtr) {
+            return true;
+          }
+          Worklist.push_back(CE);
+          continue;
+        }
+        llvm::Instruction *I = llvm::dyn_cast<llvm::Instruction>(U);
+        if (I == nullptr) {
+          return true;
+        }
+        if (Functions.count(I->getParent()->getParent()) == 0) {
+          continue;
+        }
+
+        if (llvm::isa<llvm::LoadInst>(I)) {
+          continue;
+        }
+        if (llvm::isa<llvm::BitCastInst>(I) ||
+            llvm::isa<llvm::GetElementPtrInst>(I)) {
+          Worklist.push_back(I);
+          continue;
+        }
+        if (llvm::MemTransferInst *MT =
+                llvm::dyn_cast<llvm::MemTransferInst>(I)) {
+          if (MT->getRawDest() == V) {
+            return true;
+          }
+          continue;
+        }
+        llvm::CallInst *Call = llvm::dyn_cast<llvm::CallInst>(I);
+        if (Call != nullptr && !llvm::isa<llvm::MemIntrinsic>(Call) &&
+            Call->onlyReadsMemory()) {
+          continue;
+        }
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Collect F and the functions it calls, directly or not.  Returns false if
+  // it makes an indirect call.
+  static bool collectCallees(llvm::Function *F,
+                             std::set<llvm::Function *> &Functions) {
+    std::vector<llvm::Function *> Worklist(1, F);
+    Functions.insert(F);
+    while (!Worklist.empty()) {
+      llvm::Function *Caller = Worklist.back();
+      Worklist.pop_back();
+      for (llvm::BasicBlock &BB : *Caller) {
+        for (llvm::Instruction &I : BB) {
+          llvm::CallSite CS(&I);
+          if (!CS) {
+            continue;
+          }
+          llvm::Function *Callee = CS.getCalledFunction();
+          if (Callee == nullptr) {
+            if (llvm::isa<llvm::InlineAsm>(CS.getCalledValue())) {
+              continue;
+            }
+            return false;
+          }
+          if (!Callee->isDeclaration() && Functions.insert(Callee).second) {
+            Worklist.push_back(Callee);
+          }
+        }
+      }
+    }
+    return true;
+  }
+
+  // Match Loop to the shape of the loops created by RSKernelExpandPass.
+  static bool matchLoop(llvm::BasicBlock *Loop, LoopShape &Shape) {
+    llvm::BranchInst *Latch =
+        llvm::dyn_cast<llvm::BranchInst>(Loop->getTerminator());
+    if (Latch == nullptr || !Latch->isConditional() ||
+        Latch->getSuccessor(0) != Loop) {
+      return false;
+    }
+    llvm::ICmpInst *Cmp = llvm::dyn_cast<llvm::ICmpInst>(Latch->getCondition());
+    if (Cmp == nullptr || Cmp->getPredicate() != llvm::ICmpInst::ICMP_ULT) {
+      return false;
+    }
+    llvm::BinaryOperator *Next =
+        llvm::dyn_cast<llvm::BinaryOperator>(Cmp->getOperand(0));
+    llvm::ConstantInt *Step = Next != nullptr ?
+        llvm::dyn_cast<llvm::ConstantInt>(Next->getOperand(1)) : nullptr;
+    if (Next == nullptr || Next->getOpcode() != llvm::Instruction::Add ||
+        Step == nullptr || !Step->isOne()) {
+      return false;
+    }
+    Shape.IV = llvm::dyn_cast<llvm::LoadInst>(Next->getOperand(0));
+    if (Shape.IV == nullptr || Shape.IV->getParent() != Loop) {
+      return false;
+    }
+    Shape.IVVar = llvm::dyn_cast<llvm::AllocaInst>(
+        Shape.IV->getPointerOperand());
+    Shape.Upper = Cmp->getOperand(1);
+    return Shape.IVVar != nullptr;
+  }
+
+  // Returns the value the loops start from: the one store to IVVar outside
+  // of them.  The stores in the loops must be increments.
+  static llvm::StoreInst *
+  getLowerStore(llvm::AllocaInst *IVVar,
+                const std::set<llvm::BasicBlock *> &Loops) {
+    llvm::StoreInst *Lower = nullptr;
+    for (llvm::User *U : IVVar->users()) {
+      if (llvm::isa<llvm::LoadInst>(U)) {
+        continue;
+      }
+      llvm::StoreInst *Store = llvm::dyn_cast<llvm::StoreInst>(U);
+      if (Store == nullptr || Store->getPointerOperand() != IVVar) {
+        return nullptr;
+      }
+      if (Loops.count(Store->getParent()) == 0) {
+        if (Lower != nullptr) {
+          return nullptr;
+        }
+        Lower = Store;
+        continue;
+      }
+      llvm::BinaryOperator *Next =
+          llvm::dyn_cast<llvm::BinaryOperator>(Store->getValueOperand());
+      llvm::LoadInst *IV = Next != nullptr ?
+          llvm::dyn_cast<llvm::LoadInst>(Next->getOperand(0)) : nullptr;
+      if (Next == nullptr || Next->getOpcode() != llvm::Instruction::Add ||
+          IV == nullptr || IV->getPointerOperand() != IVVar) {
+        return nullptr;
+      }
+    }
+    return Lower;
+  }
+
+  // Pass the allocation or element handle stored at Ptr as a parameter of
+  // type ParamTy, following the calling convention of the runtime.
+  static llvm::Value *passHandle(llvm::IRBuilder<> &Builder, llvm::Value *Ptr,
+                                 llvm::Type *ParamTy) {
+    if (ParamTy->isPointerTy()) {
+      return Builder.CreatePointerCast(Ptr, ParamTy);
+    }
+    return Builder.CreateLoad(
+        Builder.CreatePointerCast(Ptr, ParamTy->getPointerTo()));
+  }
+
+  // Returns the element of the allocation stored at Allocation, as a pointer
+  // to the element handle.
+  llvm::Value *getElement(llvm::IRBuilder<> &Builder,
+                          llvm::IRBuilder<> &AllocaBuilder,
+                          llvm::Value *Allocation) {
+    llvm::FunctionType *FTy = GetElement->getFunctionType();
+    if (FTy->getReturnType()->isVoidTy()) {
+      // Returned through an sret pointer.
+      llvm::Value *Element = AllocaBuilder.CreateAlloca(
+          FTy->getParamType(0)->getPointerElementType(), nullptr,
+          "bounds.element");
+      Builder.CreateCall(GetElement, {
+          Element, passHandle(Builder, Allocation, FTy->getParamType(1))});
+      return Element;
+    }
+    llvm::Value *Element = AllocaBuilder.CreateAlloca(FTy->getReturnType(),
+                                                      nullptr,
+                                                      "bounds.element");
+    Builder.CreateStore(Builder.CreateCall(GetElement, {
+        passHandle(Builder, Allocation, FTy->getParamType(0))}), Element);
+    return Element;
+  }
+
+  // Returns Scale * Base + Offset, as a 64-bit value.
+  static llvm::Value *emitAffine(llvm::IRBuilder<> &Builder, llvm::Value *Base,
+                                 const AffineIndex &Index) {
+    llvm::Type *Int64Ty = Builder.getInt64Ty();
+    if (Index.Scale != 1) {
+      Base = Builder.CreateMul(
+          Base, llvm::ConstantInt::getSigned(Int64Ty, Index.Scale));
+    }
+    if (Index.Offset != 0) {
+      Base = Builder.CreateAdd(
+          Base, llvm::ConstantInt::getSigned(Int64Ty, Index.Offset));
+    }
+    return Base;
+  }
+
+  // Returns the range of Index over the loop, as 64-bit [Lo, Hi].
+  static void emitRange(llvm::IRBuilder<> &Builder, const AffineIndex &Index,
+                        int XArgNo, llvm::ArrayRef<llvm::Value *> InvariantArgs,
+                        llvm::Value *First, llvm::Value *Last,
+                        llvm::Value *&Lo, llvm::Value *&Hi) {
+    if (Index.Base == nullptr) {
+      Lo = Hi = Builder.getInt64(Index.Offset);
+      return;
+    }
+    if (static_cast<int>(Index.Base->getArgNo()) != XArgNo) {
+      llvm::Value *Base = Builder.CreateZExt(
+          InvariantArgs[Index.Base->getArgNo()], Builder.getInt64Ty());
+      Lo = Hi = emitAffine(Builder, Base, Index);
+      return;
+    }
+    Lo = emitAffine(Builder, First, Index);
+    Hi = emitAffine(Builder, Last, Index);
+    if (Index.Scale < 0) {
+      std::swap(Lo, Hi);
+    }
+  }
+
+  // Returns an unchecked copy of Kernel, in which Accesses are done through
+  // rsGetElementAt().
+  llvm::Function *createUncheckedKernel(llvm::Function *Kernel,
+                                        const std::vector<Access> &Accesses) {
+    llvm::ValueToValueMapTy VMap;
+    llvm::Function *Unchecked = llvm::CloneFunction(Kernel, VMap);
+    Unchecked->setName(Kernel->getName() + ".unchecked");
+    Unchecked->setLinkage(llvm::GlobalValue::InternalLinkage);
+
+    for (const Access &A : Accesses) {
+      llvm::CallInst *Call = llvm::cast<llvm::CallInst>(VMap[A.Call]);
+      llvm::IRBuilder<> Builder(Call);
+      const unsigned FirstIndex = A.Info->IsSet ? 2 : 1;
+      llvm::Value *Args[4] = {
+        Call->getArgOperand(0), Builder.getInt32(0), Builder.getInt32(0),
+        Builder.getInt32(0)
+      };
+      for (unsigned i = 0; i < A.Info->NumIndices; ++i) {
+        Args[i + 1] = Call->getArgOperand(FirstIndex + i);
+      }
+      llvm::Value *Ptr = Builder.CreatePointerCast(
+          Builder.CreateCall(GetElementAt, Args),
+          A.Info->ElementTy->getPointerTo(), "element.ptr");
+      const unsigned Align = DL->getABITypeAlignment(A.Info->ElementTy);
+      if (A.Info->IsSet) {
+        Builder.CreateAlignedStore(Call->getArgOperand(1), Ptr, Align);
+      } else {
+        llvm::Value *Element = Builder.CreateAlignedLoad(Ptr, Align);
+        Element->takeName(Call);
+        Call->replaceAllUsesWith(Element);
+      }
+      Call->eraseFromParent();
+    }
+    return Unchecked;
+  }
+
+  llvm::MDNode *duplicateLoopID(llvm::MDNode *LoopID) {
+    llvm::SmallVector<llvm::Metadata *, 4> Ops(1, nullptr);
+    for (unsigned i = 1; i < LoopID->getNumOperands(); ++i) {
+      Ops.push_back(LoopID->getOperand(i));
+    }
+    llvm::MDNode *Copy = llvm::MDNode::getDistinct(Module->getContext(), Ops);
+    Copy->replaceOperandWith(0, Copy);
+    return Copy;
+  }
+
+  bool hoistChecks(llvm::Function &Expanded) {
+    // Find the loops calling the kernel.  With versioning on alignment,
+    // there are two copies of the loop.
+    llvm::Function *Kernel = nullptr;
+    std::vector<llvm::CallInst *> KernelCalls;
+    std::set<llvm::BasicBlock *> Loops;
+    for (llvm::BasicBlock &BB : Expanded) {
+      for (llvm::Instruction &I : BB) {
+        llvm::CallInst *Call = llvm::dyn_cast<llvm::CallInst>(&I);
+        llvm::Function *Callee =
+            Call != nullptr ? Call->getCalledFunction() : nullptr;
+        if (Callee == nullptr || Callee->isDeclaration() ||
+            Callee->isIntrinsic()) {
+          continue;
+        }
+        if (Kernel != nullptr && Callee != Kernel) {
+          return false;
+        }
+        Kernel = Callee;
+        KernelCalls.push_back(Call);
+        Loops.insert(&BB);
+      }
+    }
+    if (Kernel == nullptr || Loops.size() != KernelCalls.size()) {
+      return false;
+    }
+
+    LoopShape Shape;
+    llvm::AllocaInst *IVVar = nullptr;
+    llvm::Value *Upper = nullptr;
+    int XArgNo = -1;
+    for (llvm::CallInst *Call : KernelCalls) {
+      if (!matchLoop(Call->getParent(), Shape) ||
+          (IVVar != nullptr && (Shape.IVVar != IVVar ||
+                                Shape.Upper != Upper))) {
+        return false;
+      }
+      IVVar = Shape.IVVar;
+      Upper = Shape.Upper;
+      int ArgNo = -1;
+      for (unsigned i = 0; i < Call->getNumArgOperands(); ++i) {
+        if (Call->getArgOperand(i) == Shape.IV) {
+          ArgNo = i;
+        }
+      }
+      if (Call != KernelCalls.front() && ArgNo != XArgNo) {
+        return false;
+      }
+      XArgNo = ArgNo;
+    }
+    llvm::StoreInst *LowerStore = getLowerStore(IVVar, Loops);
+    if (LowerStore == nullptr) {
+      return false;
+    }
+    llvm::Value *Lower = LowerStore->getValueOperand();
+
+    // The check goes on the edge into the loops.
+    llvm::DominatorTree DT(Expanded);
+    llvm::BasicBlock *Header = *Loops.begin();
+    for (llvm::BasicBlock *Loop : Loops) {
+      Header = DT.findNearestCommonDominator(Header, Loop);
+    }
+    llvm::BasicBlock *Preheader = nullptr;
+    for (llvm::BasicBlock *Pred : llvm::predecessors(Header)) {
+      if (Loops.count(Pred) != 0) {
+        continue;
+      }
+      if (Preheader != nullptr) {
+        return false;
+      }
+      Preheader = Pred;
+    }
+    if (Preheader == nullptr || llvm::isa<llvm::PHINode>(Header->front()) ||
+        !llvm::isa<llvm::BranchInst>(Preheader->getTerminator())) {
+      return false;
+    }
+
+    // The values the check is computed from must be available before the
+    // loops.
+    llvm::Instruction *CheckPt = Preheader->getTerminator();
+    auto isAvailable = [&](llvm::Value *V) {
+      llvm::Instruction *I = llvm::dyn_cast<llvm::Instruction>(V);
+      return I == nullptr || DT.dominates(I, CheckPt);
+    };
+    if (!isAvailable(Lower) || !isAvailable(Upper) ||
+        !DT.dominates(LowerStore, CheckPt)) {
+      return false;
+    }
+    std::vector<llvm::Value *> InvariantArgs;
+    for (unsigned i = 0; i < KernelCalls.front()->getNumArgOperands(); ++i) {
+      llvm::Value *Arg = KernelCalls.front()->getArgOperand(i);
+      bool Invariant = static_cast<int>(i) != XArgNo && isAvailable(Arg);
+      for (llvm::CallInst *Call : KernelCalls) {
+        Invariant &= (Call->getArgOperand(i) == Arg);
+      }
+      InvariantArgs.push_back(Invariant ? Arg : nullptr);
+    }
+
+    std::set<llvm::Function *> Callees;
+    if (!collectCallees(Kernel, Callees)) {
+      return false;
+    }
+    Callees.insert(&Expanded);
+
+    // Find the accesses whose checks can be done up front.
+    std::vector<Access> Accesses;
+    std::map<llvm::GlobalVariable *, bool> Written;
+    for (llvm::BasicBlock &BB : *Kernel) {
+      for (llvm::Instruction &I : BB) {
+        llvm::CallInst *Call = llvm::dyn_cast<llvm::CallInst>(&I);
+        llvm::Function *Callee =
+            Call != nullptr ? Call->getCalledFunction() : nullptr;
+        const Accessor *Info =
+            Callee != nullptr ? getAccessor(Callee) : nullptr;
+        if (Info == nullptr || !Info->IsChecked ||
+            Call->getArgOperand(0)->getType() !=
+                GetElementAt->getFunctionType()->getParamType(0)) {
+          continue;
+        }
+
+        Access A;
+        A.Call = Call;
+        A.Info = Info;
+        A.Allocation = getHandleSource(Call->getArgOperand(0));
+        if (A.Allocation == nullptr) {
+          continue;
+        }
+        auto It = Written.find(A.Allocation);
+        if (It == Written.end()) {
+          It = Written.insert(std::make_pair(
+              A.Allocation, mayBeWritten(A.Allocation, Callees))).first;
+        }
+        bool Affine = !It->second;
+        const unsigned FirstIndex = Info->IsSet ? 2 : 1;
+        for (unsigned i = 0; Affine && i < Info->NumIndices; ++i) {
+          AffineIndex &Index = A.Indices[i];
+          Affine = matchAffine(Call->getArgOperand(FirstIndex + i), Index) &&
+                   (Index.Base == nullptr ||
+                    (Index.Base->getParent() == Kernel &&
+                     (static_cast<int>(Index.Base->getArgNo()) == XArgNo ||
+                      InvariantArgs[Index.Base->getArgNo()] != nullptr)));
+        }
+        if (Affine) {
+          Accesses.push_back(A);
+        }
+      }
+    }
+    if (Accesses.empty()) {
+      return false;
+    }
+
+    llvm::LLVMContext &Ctx = Module->getContext();
+    llvm::Function *Unchecked = createUncheckedKernel(Kernel, Accesses);
+
+    // The checked loop: a copy of one of the loops, calling the original
+    // kernel.  It only has the induction variable alloca and values from
+    // before the loops as live-ins.
+    llvm::BasicBlock *Loop = KernelCalls.front()->getParent();
+    llvm::ValueToValueMapTy VMap;
+    llvm::BasicBlock *Checked =
+        llvm::CloneBasicBlock(Loop, VMap, ".checked", &Expanded);
+    VMap[Loop] = Checked;
+    for (llvm::Instruction &I : *Checked) {
+      llvm::RemapInstruction(&I, VMap, llvm::RF_NoModuleLevelChanges |
+                                       llvm::RF_IgnoreMissingLocals);
+    }
+    if (llvm::MDNode *LoopID =
+            Checked->getTerminator()->getMetadata(llvm::LLVMContext::MD_loop)) {
+      Checked->getTerminator()->setMetadata(llvm::LLVMContext::MD_loop,
+                                            duplicateLoopID(LoopID));
+    }
+    llvm::BasicBlock *Exit = Loop->getTerminator()->getSuccessor(1);
+    for (llvm::Instruction &I : *Exit) {
+      llvm::PHINode *Phi = llvm::dyn_cast<llvm::PHINode>(&I);
+      if (Phi == nullptr) {
+        break;
+      }
+      llvm::Value *Incoming = Phi->getIncomingValueForBlock(Loop);
+      llvm::Value *Mapped = VMap.lookup(Incoming);
+      Phi->addIncoming(Mapped != nullptr ? Mapped : Incoming, Checked);
+    }
+    for (llvm::CallInst *Call : KernelCalls) {
+      Call->setCalledFunction(Unchecked);
+    }
+
+    // Preheader -> Loop.bounds -> Loop.bounds.check -> Header, where either
+    // of the checks fails over to Loop.checked.
+    llvm::BasicBlock *Bounds =
+        llvm::BasicBlock::Create(Ctx, "Loop.bounds", &Expanded, Header);
+    llvm::BasicBlock *Check =
+        llvm::BasicBlock::Create(Ctx, "Loop.bounds.check", &Expanded, Header);
+    Preheader->getTerminator()->replaceUsesOfWith(Header, Bounds);
+
+    // Nothing can be checked on an empty launch or a null allocation.
+    llvm::IRBuilder<> Builder(Bounds);
+    llvm::IRBuilder<> AllocaBuilder(
+        &*Expanded.getEntryBlock().getFirstInsertionPt());
+    llvm::Type *Int8PtrTy = Builder.getInt8PtrTy();
+    llvm::Value *Valid = Builder.CreateICmpULT(Lower, Upper);
+    std::set<llvm::GlobalVariable *> Allocations;
+    for (const Access &A : Accesses) {
+      if (!Allocations.insert(A.Allocation).second) {
+        continue;
+      }
+      llvm::Value *Handle = Builder.CreateLoad(
+          Builder.CreatePointerCast(A.Allocation, Int8PtrTy->getPointerTo()));
+      Valid = Builder.CreateAnd(Valid, Builder.CreateICmpNE(
+          Handle, llvm::ConstantPointerNull::get(
+                      llvm::cast<llvm::PointerType>(Int8PtrTy))));
+    }
+    Builder.CreateCondBr(Valid, Check, Checked);
+
+    Builder.SetInsertPoint(Check);
+    llvm::Type *Int64Ty = Builder.getInt64Ty();
+    llvm::Value *First = Builder.CreateZExt(Lower, Int64Ty);
+    llvm::Value *Last = Builder.CreateSub(Builder.CreateZExt(Upper, Int64Ty),
+                                          Builder.getInt64(1));
+    std::map<llvm::GlobalVariable *, llvm::Value *> Dims[3];
+    std::map<llvm::GlobalVariable *,
+             std::pair<llvm::Value *, llvm::Value *>> ElementTypes;
+    llvm::Value *InBounds = nullptr;
+    auto require = [&](llvm::Value *Cond) {
+      InBounds = InBounds != nullptr ? Builder.CreateAnd(InBounds, Cond) : Cond;
+    };
+    std::set<std::pair<llvm::GlobalVariable *, const Accessor *>> Typed;
+    for (const Access &A : Accesses) {
+      // The element type, once per allocation and type of accessor.
+      if (Typed.insert(std::make_pair(A.Allocation, A.Info)).second) {
+        std::pair<llvm::Value *, llvm::Value *> &Type =
+            ElementTypes[A.Allocation];
+        if (Type.first == nullptr) {
+          llvm::Value *Element = getElement(Builder, AllocaBuilder,
+                                            A.Allocation);
+          Type.first = Builder.CreateCall(GetDataType, {
+              passHandle(Builder, Element,
+                         GetDataType->getFunctionType()->getParamType(0))});
+          Type.second = Builder.CreateCall(GetVectorSize, {
+              passHandle(Builder, Element,
+                         GetVectorSize->getFunctionType()->getParamType(0))});
+        }
+        require(Builder.CreateICmpEQ(Type.first, llvm::ConstantInt::get(
+            Type.first->getType(), A.Info->DataType)));
+        require(Builder.CreateICmpEQ(Type.second, llvm::ConstantInt::get(
+            Type.second->getType(), A.Info->VectorSize)));
+      }
+
+      for (unsigned i = 0; i < A.Info->NumIndices; ++i) {
+        llvm::Value *&Dim = Dims[i][A.Allocation];
+        if (Dim == nullptr) {
+          Dim = Builder.CreateZExt(Builder.CreateCall(GetDim[i], {
+              passHandle(Builder, A.Allocation,
+                         GetDim[i]->getFunctionType()->getParamType(0))}),
+              Int64Ty);
+        }
+        const AffineIndex &Index = A.Indices[i];
+        llvm::Value *Lo, *Hi;
+        emitRange(Builder, Index, XArgNo, InvariantArgs, First, Last, Lo, Hi);
+        // Arguments are zero-extended, so only negative constants can make
+        // the index negative.
+        if (Index.Offset < 0 || (Index.Base != nullptr && Index.Scale < 0)) {
+          require(Builder.CreateICmpSGE(Lo, Builder.getInt64(0)));
+        }
+        require(Builder.CreateICmpULT(Hi, Dim));
+      }
+    }
+    InBounds->setName("in_bounds");
+    Builder.CreateCondBr(InBounds, Header, Checked);
+
+    ALOGV("Hoisted %u checked accesses out of the loop of %s",
+          static_cast<unsigned>(Accesses.size()),
+          Expanded.getName().str().c_str());
+    return true;
+  }
+
+  llvm::Function *getRuntimeFunction(const char *Name) {
+    llvm::Function *F = Module->getFunction(Name);
+    return (F != nullptr && !F->isDeclaration()) ? F : nullptr;
+  }
+
+public:
+  RSBoundsCheckHoistingPass()
+    : ModulePass(ID), Module(nullptr), DL(nullptr), GetElement(nullptr),
+      GetDataType(nullptr), GetVectorSize(nullptr), GetElementAt(nullptr) {
+    GetDim[0] = GetDim[1] = GetDim[2] = nullptr;
+  }
+
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
+    // This pass does not use any other analysis passes, but it does
+    // add functions and blocks to the module.
+  }
+
+  bool runOnModule(llvm::Module &M) override {
+    Module = &M;
+    DL = &M.getDataLayout();
+    Accessors.clear();
+
+    // The checks can only be hoisted if the runtime that was linked in
+    // provides everything they are built from.
+    GetDim[0] = getRuntimeFunction(kGetDimXName);
+    GetDim[1] = getRuntimeFunction(kGetDimYName);
+    GetDim[2] = getRuntimeFunction(kGetDimZName);
+    GetElement = getRuntimeFunction(kGetElementName);
+    GetDataType = getRuntimeFunction(kGetDataTypeName);
+    GetVectorSize = getRuntimeFunction(kGetVectorSizeName);
+    GetElementAt = getRuntimeFunction(kGetElementAtName);
+    if (GetDim[0] == nullptr || GetDim[1] == nullptr || GetDim[2] == nullptr ||
+        GetElement == nullptr || GetDataType == nullptr ||
+        GetVectorSize == nullptr || GetElementAt == nullptr ||
+        GetElement->getFunctionType()->getNumParams() !=
+            (GetElement->getReturnType()->isVoidTy() ? 2u : 1u)) {
+      return false;
+    }
+
+    std::vector<llvm::Function *> Expanded;
+    for (llvm::Function &F : M) {
+      if (!F.isDeclaration() && F.getName().endswith(kExpandSuffix)) {
+        Expanded.push_back(&F);
+      }
+    }
+
+    bool Changed = false;
+    for (llvm::Function *F : Expanded) {
+      Changed |= hoistChecks(*F);
+    }
+    return Changed;
+  }
+
+  virtual const char *getPassName() const override {
+    return "Hoist debug runtime bounds checks out of kernel loops";
+  }
+};
+
+}  // end anonymous namespace
+
+char RSBoundsCheckHoistingPass::ID = 0;
+
+static llvm::RegisterPass<RSBoundsCheckHoistingPass>
+X("rs-hoist-bounds-checks",
+  "Hoist the element accessor checks of the RenderScript debug runtime out "
+  "of expanded kernel loops");
+
+namespace bcc {
+
+llvm::ModulePass *createRSBoundsCheckHoistingPass() {
+  return new RSBoundsCheckHoistingPass();
+}
+
+}  // end namespace bcc
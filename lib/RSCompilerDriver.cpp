@@ -20,6 +20,8 @@
 #include "FileMutex.h"
 #include "Log.h"
 #include "RSScriptGroupFusion.h"
+#include "RSUtils.h"
+#include "SharedObjectLinker.h"
 #include "slang_version.h"
 
 #include "bcc/BCCContext.h"
@@ -27,6 +29,7 @@
 #include "bcc/CompilerConfig.h"
 #include "bcc/Config.h"
 #include "bcc/Initialization.h"
+#include "bcc/PerfInfo.h"
 #include "bcc/Script.h"
 #include "bcc/Source.h"
 #include "bcinfo/BitcodeWrapper.h"
@@ -42,15 +45,28 @@
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Target/TargetMachine.h>
 
+#include <algorithm>
+#include <set>
 #include <sstream>
 #include <string>
 
 using namespace bcc;
 
+const char RSCompilerDriver::kSharedRuntimeName[] = "libRSSharedRuntime.so";
+
 RSCompilerDriver::RSCompilerDriver() :
     mConfig(nullptr), mCompiler(), mDebugContext(false),
     mLinkRuntimeCallback(nullptr), mEnableGlobalMerge(true),
-    mEmbedGlobalInfo(false), mEmbedGlobalInfoSkipConstant(false) {
+    mEmbedGlobalInfo(false), mEmbedGlobalInfoSkipConstant(false),
+    mTuningDatabase(nullptr), mMinimizeRelocations(false),
+    mEmbedEntryTable(false), mEmbedKernelStats(false),
+    mEnableInterleavedAccess(false), mFuseForEach(false),
+    mParallelizeInvokables(false), mEvaluateInit(false),
+    mShareRuntime(false), mAllocationAlignment(0),
+    mLineTablesOnly(false), mVectorizeKernels(false),
+    mEmitSharedObject(false),
+    mSharedObjectDependencies({"libRSDriver.so", "libm.so", "libc.so"}),
+    mEmitPerfMap(false) {
   init::Initialize();
 }
 
@@ -106,22 +122,15 @@ bool RSCompilerDriver::setupConfig(const Script &pScript) {
   return changed;
 }
 
-Compiler::ErrorCode RSCompilerDriver::compileScript(Script& pScript, const char* pScriptName,
-                                                    const char* pOutputPath,
+Compiler::ErrorCode RSCompilerDriver::prepareScript(Script& pScript,
+                                                    const char* pScriptName,
                                                     const char* pRuntimePath,
-                                                    const char* pBuildChecksum,
-                                                    bool pDumpIR) {
+                                                    const char* pBuildChecksum) {
   // embed build checksum metadata into the source
   if (pBuildChecksum != nullptr && strlen(pBuildChecksum) > 0) {
     pScript.getSource().addBuildChecksumMetadata(pBuildChecksum);
   }
 
-  // Verify that the only external functions in pScript are Renderscript
-  // functions.  Fail if verification returns an error.
-  if (mCompiler.screenGlobalFunctions(pScript) != Compiler::kSuccess) {
-    return Compiler::kErrInvalidSource;
-  }
-
   // For (32-bit) x86, translate GEPs on structs or arrays of structs to GEPs on
   // int8* with byte offsets.  This is to ensure that layout of structs with
   // 64-bit scalar fields matches frontend-generated code that adheres to ARM
@@ -131,9 +140,13 @@ Compiler::ErrorCode RSCompilerDriver::compileScript(Script& pScript, const char*
   // (during LinkRuntime below) to ensure that RenderScript-driver-provided
   // structs (like Allocation_t) don't get forced into using the ARM layout
   // rules.
-  if (!pScript.isStructExplicitlyPaddedBySlang() &&
-      (mCompiler.getTargetMachine().getTargetTriple().getArch() == llvm::Triple::x86)) {
-    mCompiler.translateGEPs(pScript);
+  bool translate_geps = !pScript.isStructExplicitlyPaddedBySlang() &&
+      (mCompiler.getTargetMachine().getTargetTriple().getArch() == llvm::Triple::x86);
+
+  // Verify that the only external functions in pScript are Renderscript
+  // functions.  Fail if verification returns an error.
+  if (mCompiler.runPreLinkPasses(pScript, translate_geps) != Compiler::kSuccess) {
+    return Compiler::kErrInvalidSource;
   }
 
   //===--------------------------------------------------------------------===//
@@ -145,6 +158,133 @@ Compiler::ErrorCode RSCompilerDriver::compileScript(Script& pScript, const char*
     return Compiler::kErrInvalidSource;
   }
 
+  return Compiler::kSuccess;
+}
+
+Compiler::ErrorCode RSCompilerDriver::configCompiler(const Script& pScript,
+                                                     const char* pScriptName) {
+  // Setup the config to the compiler.
+  bool compiler_need_reconfigure = setupConfig(pScript);
+
+  if (mConfig == nullptr) {
+    ALOGE("Failed to setup config for RS compiler to compile %s!",
+          pScriptName);
+    return Compiler::kErrInvalidSource;
+  }
+
+  if (compiler_need_reconfigure) {
+    Compiler::ErrorCode err = mCompiler.config(*mConfig);
+    if (err != Compiler::kSuccess) {
+      ALOGE("Failed to config the RS compiler for %s! (%s)", pScriptName,
+            Compiler::GetErrorString(err));
+      return Compiler::kErrInvalidSource;
+    }
+  }
+
+  return Compiler::kSuccess;
+}
+
+Compiler::ErrorCode RSCompilerDriver::emitScript(Script& pScript,
+                                                 const char* pScriptName,
+                                                 llvm::raw_pwrite_stream& pResult,
+                                                 llvm::raw_ostream* pIRStream) {
+  Compiler::ErrorCode status = configCompiler(pScript, pScriptName);
+  if (status != Compiler::kSuccess) {
+    return status;
+  }
+
+  // Run the compiler.
+  Compiler::ErrorCode compile_result =
+      mCompiler.compile(pScript, pResult, pIRStream);
+
+  if (compile_result != Compiler::kSuccess) {
+    ALOGE("Unable to compile the source of %s! (%s)", pScriptName,
+          Compiler::GetErrorString(compile_result));
+    return Compiler::kErrInvalidSource;
+  }
+
+  return Compiler::kSuccess;
+}
+
+Compiler::ErrorCode RSCompilerDriver::emitSharedObject(Script& pScript,
+                                                       const char* pOutputPath,
+                                                       llvm::raw_ostream* pIRStream) {
+  llvm::SmallString<0> object;
+  {
+    llvm::raw_svector_ostream object_stream(object);
+    Compiler::ErrorCode status = emitScript(pScript, pOutputPath,
+                                            object_stream, pIRStream);
+    if (status != Compiler::kSuccess) {
+      return status;
+    }
+  }
+
+  llvm::SmallString<80> so_path(pOutputPath);
+  llvm::sys::path::replace_extension(so_path, ".so");
+
+  // Fall back to the relocatable object if the built-in linker can't handle
+  // it, so that it can still be linked externally.  Only one of them is left
+  // in place, so that the loader doesn't pick up one from a previous build.
+  const char *path = pOutputPath;
+  const char *stale_path = so_path.c_str();
+  llvm::StringRef contents = object;
+  llvm::SmallString<0> shared_object;
+  std::string link_error;
+  std::vector<std::string> needed(mSharedObjectDependencies);
+  if (mShareRuntime) {
+    needed.insert(needed.begin(), kSharedRuntimeName);
+  }
+  bool linked = linkSharedObject(object,
+                                 llvm::sys::path::filename(so_path).str(),
+                                 needed, shared_object, link_error);
+  if (linked) {
+    path = so_path.c_str();
+    stale_path = pOutputPath;
+    contents = shared_object;
+  } else {
+    ALOGW("Unable to link %s, writing %s instead! (%s)", so_path.c_str(),
+          pOutputPath, link_error.c_str());
+  }
+
+  std::error_code error;
+  llvm::raw_fd_ostream out_stream(path, error, llvm::sys::fs::F_RW);
+  if (error) {
+    ALOGE("Unable to open %s for write! (%s)", path, error.message().c_str());
+    return Compiler::kErrPrepareOutput;
+  }
+  out_stream << contents;
+
+  error = llvm::sys::fs::remove(stale_path);
+  if (error) {
+    ALOGE("Unable to remove %s! (%s)", stale_path, error.message().c_str());
+    return Compiler::kErrPrepareOutput;
+  }
+
+  // The map is only a profiling aid, so failing to write it isn't an error.
+  if (mEmitPerfMap) {
+    std::string map_path = so_path.str().str() + ".map";
+    std::string map_error;
+    if (!linked) {
+      llvm::sys::fs::remove(map_path);
+    } else if (!writePerfMapFile(shared_object, map_path, map_error)) {
+      ALOGW("Unable to write %s! (%s)", map_path.c_str(), map_error.c_str());
+    }
+  }
+
+  return Compiler::kSuccess;
+}
+
+Compiler::ErrorCode RSCompilerDriver::compileScript(Script& pScript, const char* pScriptName,
+                                                    const char* pOutputPath,
+                                                    const char* pRuntimePath,
+                                                    const char* pBuildChecksum,
+                                                    bool pDumpIR) {
+  Compiler::ErrorCode status = prepareScript(pScript, pScriptName,
+                                             pRuntimePath, pBuildChecksum);
+  if (status != Compiler::kSuccess) {
+    return status;
+  }
+
   {
     // FIXME(srhines): Windows compilation can't use locking like this, but
     // we also don't need to worry about concurrent writers of the same file.
@@ -161,33 +301,7 @@ Compiler::ErrorCode RSCompilerDriver::compileScript(Script& pScript, const char*
     }
 #endif
 
-    // Open the output file for write.
     std::error_code error;
-    llvm::raw_fd_ostream out_stream(pOutputPath, error, llvm::sys::fs::F_RW);
-    if (error) {
-      ALOGE("Unable to open %s for write! (%s)", pOutputPath,
-            error.message().c_str());
-      return Compiler::kErrPrepareOutput;
-    }
-
-    // Setup the config to the compiler.
-    bool compiler_need_reconfigure = setupConfig(pScript);
-
-    if (mConfig == nullptr) {
-      ALOGE("Failed to setup config for RS compiler to compile %s!",
-            pOutputPath);
-      return Compiler::kErrInvalidSource;
-    }
-
-    if (compiler_need_reconfigure) {
-      Compiler::ErrorCode err = mCompiler.config(*mConfig);
-      if (err != Compiler::kSuccess) {
-        ALOGE("Failed to config the RS compiler for %s! (%s)",pOutputPath,
-              Compiler::GetErrorString(err));
-        return Compiler::kErrInvalidSource;
-      }
-    }
-
     std::unique_ptr<llvm::raw_fd_ostream> IRStream;
     if (pDumpIR) {
       std::string path(pOutputPath);
@@ -201,18 +315,35 @@ Compiler::ErrorCode RSCompilerDriver::compileScript(Script& pScript, const char*
       }
     }
 
-    // Run the compiler.
-    Compiler::ErrorCode compile_result =
-        mCompiler.compile(pScript, out_stream, IRStream.get());
+    if (mEmitSharedObject) {
+      return emitSharedObject(pScript, pOutputPath, IRStream.get());
+    }
 
-    if (compile_result != Compiler::kSuccess) {
-      ALOGE("Unable to compile the source to file %s! (%s)", pOutputPath,
-            Compiler::GetErrorString(compile_result));
-      return Compiler::kErrInvalidSource;
+    // Open the output file for write.
+    llvm::raw_fd_ostream out_stream(pOutputPath, error, llvm::sys::fs::F_RW);
+    if (error) {
+      ALOGE("Unable to open %s for write! (%s)", pOutputPath,
+            error.message().c_str());
+      return Compiler::kErrPrepareOutput;
     }
+
+    status = emitScript(pScript, pOutputPath, out_stream, IRStream.get());
   }
 
-  return Compiler::kSuccess;
+  return status;
+}
+
+Compiler::ErrorCode RSCompilerDriver::compileScript(Script& pScript, const char* pScriptName,
+                                                    llvm::raw_pwrite_stream& pResult,
+                                                    const char* pRuntimePath,
+                                                    const char* pBuildChecksum) {
+  Compiler::ErrorCode status = prepareScript(pScript, pScriptName,
+                                             pRuntimePath, pBuildChecksum);
+  if (status != Compiler::kSuccess) {
+    return status;
+  }
+
+  return emitScript(pScript, pScriptName, pResult, nullptr);
 }
 
 bool RSCompilerDriver::build(BCCContext &pContext,
@@ -235,12 +366,6 @@ bool RSCompilerDriver::build(BCCContext &pContext,
     return false;
   }
 
-  if ((pBitcode == nullptr) || (pBitcodeSize <= 0)) {
-    ALOGE("No bitcode supplied! (bitcode: %p, size of bitcode: %u)",
-          pBitcode, static_cast<unsigned>(pBitcodeSize));
-    return false;
-  }
-
   //===--------------------------------------------------------------------===//
   // Construct output path.
   // {pCacheDir}/{pResName}.o
@@ -249,6 +374,48 @@ bool RSCompilerDriver::build(BCCContext &pContext,
   llvm::sys::path::append(output_path, pResName);
   llvm::sys::path::replace_extension(output_path, ".o");
 
+  return buildScript(pContext, pResName, pBitcode, pBitcodeSize,
+                     pBuildChecksum, pRuntimePath, pLinkRuntimeCallback,
+                     output_path.c_str(), pDumpIR, nullptr);
+}
+
+bool RSCompilerDriver::buildInMemory(BCCContext &pContext,
+                                     const char *pResName,
+                                     const char *pBitcode,
+                                     size_t pBitcodeSize,
+                                     const char *pBuildChecksum,
+                                     const char *pRuntimePath,
+                                     llvm::SmallVectorImpl<char> &pObject,
+                                     RSLinkRuntimeCallback pLinkRuntimeCallback) {
+  if (pResName == nullptr) {
+    ALOGE("Invalid parameter passed to RSCompilerDriver::buildInMemory()! "
+          "(resource name: (null))");
+    return false;
+  }
+
+  pObject.clear();
+  llvm::raw_svector_ostream out_stream(pObject);
+  return buildScript(pContext, pResName, pBitcode, pBitcodeSize,
+                     pBuildChecksum, pRuntimePath, pLinkRuntimeCallback,
+                     nullptr, false, &out_stream);
+}
+
+bool RSCompilerDriver::buildScript(BCCContext &pContext,
+                                   const char *pResName,
+                                   const char *pBitcode,
+                                   size_t pBitcodeSize,
+                                   const char *pBuildChecksum,
+                                   const char *pRuntimePath,
+                                   RSLinkRuntimeCallback pLinkRuntimeCallback,
+                                   const char *pOutputPath,
+                                   bool pDumpIR,
+                                   llvm::raw_pwrite_stream *pResult) {
+  if ((pBitcode == nullptr) || (pBitcodeSize <= 0)) {
+    ALOGE("No bitcode supplied! (bitcode: %p, size of bitcode: %u)",
+          pBitcode, static_cast<unsigned>(pBitcodeSize));
+    return false;
+  }
+
   //===--------------------------------------------------------------------===//
   // Load the bitcode and create script.
   //===--------------------------------------------------------------------===//
@@ -268,11 +435,30 @@ bool RSCompilerDriver::build(BCCContext &pContext,
 
   script.setEmbedGlobalInfo(mEmbedGlobalInfo);
   script.setEmbedGlobalInfoSkipConstant(mEmbedGlobalInfoSkipConstant);
+  script.setTuningDatabase(mTuningDatabase);
+  script.setMinimizeRelocations(mMinimizeRelocations);
+  script.setEmbedEntryTable(mEmbedEntryTable);
+  script.setEmbedKernelStats(mEmbedKernelStats);
+  script.setEnableInterleavedAccess(mEnableInterleavedAccess);
+  script.setFuseForEach(mFuseForEach);
+  script.setParallelizeInvokables(mParallelizeInvokables);
+  script.setEvaluateInit(mEvaluateInit);
+  script.setShareRuntime(mShareRuntime);
+  script.setAllocationAlignment(mAllocationAlignment);
+  script.setIncrementalCacheDir(mIncrementalCacheDir);
+  script.setHoistBoundsChecks(mDebugContext);
+  script.setLineTablesOnly(mLineTablesOnly);
+  script.setVectorizeKernels(mVectorizeKernels);
 
   // Read optimization level from bitcode wrapper.
   bcinfo::BitcodeWrapper wrapper(pBitcode, pBitcodeSize);
   script.setOptimizationLevel(static_cast<llvm::CodeGenOpt::Level>(
                               wrapper.getOptimizationLevel()));
+  // Scripts built with debug info usually ask for no optimization, but line
+  // tables are only wanted to profile the code that ships.
+  if (mLineTablesOnly) {
+    script.setOptimizationLevel(llvm::CodeGenOpt::Aggressive);
+  }
 
 // Assertion-enabled builds can't compile legacy bitcode (due to the use of
 // getName() with anonymous structure definitions).
@@ -291,11 +477,14 @@ bool RSCompilerDriver::build(BCCContext &pContext,
   //===--------------------------------------------------------------------===//
   // Compile the script
   //===--------------------------------------------------------------------===//
-  Compiler::ErrorCode status = compileScript(script, pResName,
-                                             output_path.c_str(),
-                                             pRuntimePath,
-                                             pBuildChecksum,
-                                             pDumpIR);
+  Compiler::ErrorCode status;
+  if (pResult != nullptr) {
+    status = compileScript(script, pResName, *pResult, pRuntimePath,
+                           pBuildChecksum);
+  } else {
+    status = compileScript(script, pResName, pOutputPath, pRuntimePath,
+                           pBuildChecksum, pDumpIR);
+  }
 
   return status == Compiler::kSuccess;
 }
@@ -308,6 +497,37 @@ bool RSCompilerDriver::buildScriptGroup(
     const std::list<std::string>& fused,
     const std::list<std::list<std::pair<int, int>>>& invokes,
     const std::list<std::string>& invokeBatchNames) {
+  return compileScriptGroup(Context, pOutputFilepath, pRuntimePath,
+                            pRuntimeRelaxedPath, dumpIR, buildChecksum, sources,
+                            toFuse, fused, invokes, invokeBatchNames, nullptr);
+}
+
+bool RSCompilerDriver::buildScriptGroupInMemory(
+    BCCContext& Context, const char* pScriptName, const char* pRuntimePath,
+    const char* pRuntimeRelaxedPath, const char* buildChecksum,
+    const std::vector<Source*>& sources,
+    const std::list<std::list<std::pair<int, int>>>& toFuse,
+    const std::list<std::string>& fused,
+    const std::list<std::list<std::pair<int, int>>>& invokes,
+    const std::list<std::string>& invokeBatchNames,
+    llvm::SmallVectorImpl<char>& pObject) {
+  pObject.clear();
+  llvm::raw_svector_ostream out_stream(pObject);
+  return compileScriptGroup(Context, pScriptName, pRuntimePath,
+                            pRuntimeRelaxedPath, false, buildChecksum, sources,
+                            toFuse, fused, invokes, invokeBatchNames,
+                            &out_stream);
+}
+
+bool RSCompilerDriver::compileScriptGroup(
+    BCCContext& Context, const char* pOutputFilepath, const char* pRuntimePath,
+    const char* pRuntimeRelaxedPath, bool dumpIR, const char* buildChecksum,
+    const std::vector<Source*>& sources,
+    const std::list<std::list<std::pair<int, int>>>& toFuse,
+    const std::list<std::string>& fused,
+    const std::list<std::list<std::pair<int, int>>>& invokes,
+    const std::list<std::string>& invokeBatchNames,
+    llvm::raw_pwrite_stream* pResult) {
 
   // Read and store metadata before linking the modules together
   std::vector<bcinfo::MetadataExtractor*> metadata;
@@ -410,9 +630,20 @@ bool RSCompilerDriver::buildScriptGroup(
   script.setOptimizationLevel(llvm::CodeGenOpt::Level::Aggressive);
   script.setEmbedGlobalInfo(mEmbedGlobalInfo);
   script.setEmbedGlobalInfoSkipConstant(mEmbedGlobalInfoSkipConstant);
-
-  llvm::SmallString<80> output_path(pOutputFilepath);
-  llvm::sys::path::replace_extension(output_path, ".o");
+  script.setTuningDatabase(mTuningDatabase);
+  script.setMinimizeRelocations(mMinimizeRelocations);
+  script.setEmbedEntryTable(mEmbedEntryTable);
+  script.setEmbedKernelStats(mEmbedKernelStats);
+  script.setEnableInterleavedAccess(mEnableInterleavedAccess);
+  script.setFuseForEach(mFuseForEach);
+  script.setParallelizeInvokables(mParallelizeInvokables);
+  script.setEvaluateInit(mEvaluateInit);
+  script.setShareRuntime(mShareRuntime);
+  script.setAllocationAlignment(mAllocationAlignment);
+  script.setIncrementalCacheDir(mIncrementalCacheDir);
+  script.setHoistBoundsChecks(mDebugContext);
+  script.setLineTablesOnly(mLineTablesOnly);
+  script.setVectorizeKernels(mVectorizeKernels);
 
   // Pick the right runtime lib
   const char* coreLibPath = pRuntimePath;
@@ -424,12 +655,69 @@ bool RSCompilerDriver::buildScriptGroup(
       }
   }
 
+  if (pResult != nullptr) {
+    return compileScript(script, pOutputFilepath, *pResult, coreLibPath,
+                         buildChecksum) == Compiler::kSuccess;
+  }
+
+  llvm::SmallString<80> output_path(pOutputFilepath);
+  llvm::sys::path::replace_extension(output_path, ".o");
+
   compileScript(script, pOutputFilepath, output_path.c_str(), coreLibPath,
                 buildChecksum, dumpIR);
 
   return true;
 }
 
+bool RSCompilerDriver::buildSharedRuntime(BCCContext &pContext,
+                                          const char *pOutputDir,
+                                          const char *pRuntimePath) {
+  const std::unique_ptr<Source> source(
+      Source::CreateFromFile(pContext, pRuntimePath));
+  if (source == nullptr) {
+    ALOGE("Failed to load Renderscript runtime '%s'!", pRuntimePath);
+    return false;
+  }
+
+  // The runtime is already optimized; only generate code for it, keeping
+  // all of its symbols visible to the scripts.
+  Script script(source.get());
+  script.setOptimizationLevel(getConfig()->getOptimizationLevel());
+  Compiler::ErrorCode status = configCompiler(script, pRuntimePath);
+  llvm::SmallString<0> object;
+  if (status == Compiler::kSuccess) {
+    llvm::raw_svector_ostream object_stream(object);
+    status = mCompiler.generateCode(source->getModule(), object_stream);
+  }
+  if (status != Compiler::kSuccess) {
+    ALOGE("Unable to compile Renderscript runtime %s! (%s)", pRuntimePath,
+          Compiler::GetErrorString(status));
+    return false;
+  }
+
+  llvm::SmallString<0> shared_object;
+  std::string link_error;
+  if (!linkSharedObject(object, kSharedRuntimeName, mSharedObjectDependencies,
+                        shared_object, link_error)) {
+    ALOGE("Unable to link Renderscript runtime %s! (%s)", pRuntimePath,
+          link_error.c_str());
+    return false;
+  }
+
+  llvm::SmallString<80> path(pOutputDir);
+  llvm::sys::path::append(path, kSharedRuntimeName);
+  std::error_code error;
+  llvm::raw_fd_ostream out_stream(path, error, llvm::sys::fs::F_RW);
+  if (error) {
+    ALOGE("Unable to open %s for write! (%s)", path.c_str(),
+          error.message().c_str());
+    return false;
+  }
+  out_stream << shared_object;
+
+  return true;
+}
+
 bool RSCompilerDriver::buildForCompatLib(Script &pScript, const char *pOut,
                                          const char *pBuildChecksum,
                                          const char *pRuntimePath,
@@ -440,6 +728,20 @@ bool RSCompilerDriver::buildForCompatLib(Script &pScript, const char *pOut,
 
   pScript.setEmbedGlobalInfo(mEmbedGlobalInfo);
   pScript.setEmbedGlobalInfoSkipConstant(mEmbedGlobalInfoSkipConstant);
+  pScript.setTuningDatabase(mTuningDatabase);
+  pScript.setMinimizeRelocations(mMinimizeRelocations);
+  pScript.setEmbedEntryTable(mEmbedEntryTable);
+  pScript.setEmbedKernelStats(mEmbedKernelStats);
+  pScript.setEnableInterleavedAccess(mEnableInterleavedAccess);
+  pScript.setFuseForEach(mFuseForEach);
+  pScript.setParallelizeInvokables(mParallelizeInvokables);
+  pScript.setEvaluateInit(mEvaluateInit);
+  pScript.setShareRuntime(mShareRuntime);
+  pScript.setAllocationAlignment(mAllocationAlignment);
+  pScript.setIncrementalCacheDir(mIncrementalCacheDir);
+  pScript.setHoistBoundsChecks(mDebugContext);
+  pScript.setLineTablesOnly(mLineTablesOnly);
+  pScript.setVectorizeKernels(mVectorizeKernels);
   pScript.setLinkRuntimeCallback(getLinkRuntimeCallback());
 
   Compiler::ErrorCode status = compileScript(pScript, pOut, pOut, pRuntimePath,
@@ -450,3 +752,186 @@ bool RSCompilerDriver::buildForCompatLib(Script &pScript, const char *pOut,
 
   return true;
 }
+
+namespace {
+
+// Prefix the names of the symbols pModule defines, so that they don't clash
+// with the symbols of the other scripts of a combined object, and collect the
+// new names in pPrefixed.  The runtime symbols in pRuntime keep their names,
+// so that they resolve against the single copy of the runtime.
+void prefixSymbols(llvm::Module &pModule, const std::string &pPrefix,
+                   const std::set<std::string> &pRuntime,
+                   std::set<std::string> &pPrefixed) {
+  auto prefix = [&](llvm::GlobalValue &GV) {
+    // The llvm.* globals are appended to their counterparts by name.
+    if (GV.isDeclaration() || GV.hasLocalLinkage() ||
+        GV.getName().startswith("llvm.") || pRuntime.count(GV.getName())) {
+      return;
+    }
+    GV.setName(pPrefix + GV.getName().str());
+    pPrefixed.insert(GV.getName().str());
+  };
+
+  for (llvm::Function &F : pModule) {
+    prefix(F);
+  }
+  for (llvm::GlobalVariable &GV : pModule.globals()) {
+    prefix(GV);
+  }
+  for (llvm::GlobalAlias &GA : pModule.aliases()) {
+    prefix(GA);
+  }
+}
+
+}  // end anonymous namespace
+
+bool RSCompilerDriver::buildCombinedForCompatLib(
+    BCCContext &pContext, const std::vector<Script *> &pScripts,
+    const std::vector<std::string> &pNames, const char *pOut,
+    const char *pBuildChecksum, const char *pRuntimePath) {
+  if (pScripts.empty() || (pScripts.size() != pNames.size()) ||
+      (std::set<std::string>(pNames.begin(), pNames.end()).size() !=
+       pNames.size())) {
+    ALOGE("Invalid parameter passed to "
+          "RSCompilerDriver::buildCombinedForCompatLib()! (%u scripts with "
+          "%u distinct names)", static_cast<unsigned>(pScripts.size()),
+          static_cast<unsigned>(
+              std::set<std::string>(pNames.begin(), pNames.end()).size()));
+    return false;
+  }
+
+  // Optimize every script on its own, as buildForCompatLib() would, but with
+  // the runtime functions that aren't inlined left as references, and link
+  // them into the first one.
+  std::set<std::string> exported_symbols;
+  llvm::CodeGenOpt::Level opt_level = llvm::CodeGenOpt::None;
+  bool full_precision = false;
+  for (size_t i = 0; i < pScripts.size(); ++i) {
+    Script &script = *pScripts[i];
+    const char *name = pNames[i].c_str();
+
+    script.setEmbedInfo(true);
+
+    script.setEmbedGlobalInfo(mEmbedGlobalInfo);
+    script.setEmbedGlobalInfoSkipConstant(mEmbedGlobalInfoSkipConstant);
+    script.setTuningDatabase(mTuningDatabase);
+    script.setMinimizeRelocations(mMinimizeRelocations);
+    script.setEmbedEntryTable(mEmbedEntryTable);
+    script.setEmbedKernelStats(mEmbedKernelStats);
+    script.setEnableInterleavedAccess(mEnableInterleavedAccess);
+    script.setFuseForEach(mFuseForEach);
+    script.setParallelizeInvokables(mParallelizeInvokables);
+    script.setEvaluateInit(mEvaluateInit);
+    script.setShareRuntime(mShareRuntime);
+    script.setAllocationAlignment(mAllocationAlignment);
+    script.setHoistBoundsChecks(mDebugContext);
+    script.setLineTablesOnly(mLineTablesOnly);
+    script.setVectorizeKernels(mVectorizeKernels);
+    script.setDeferRuntime(true);
+    script.setLinkRuntimeCallback(getLinkRuntimeCallback());
+
+    Compiler::ErrorCode status = prepareScript(script, name, pRuntimePath,
+                                               pBuildChecksum);
+
+    // Remember the runtime symbols before optimize() resolves them, since
+    // those that weren't inlined or dropped (e.g. at -O0) must not be
+    // prefixed.
+    std::set<std::string> runtime_symbols;
+    if (const llvm::NamedMDNode *symbols =
+            script.getSource().getModule().getNamedMetadata(
+                kRsRuntimeSymbolsMetadataName)) {
+      for (const llvm::MDNode *symbol : symbols->operands()) {
+        runtime_symbols.insert(
+            llvm::cast<llvm::MDString>(symbol->getOperand(0))->getString());
+      }
+    }
+
+    if (status == Compiler::kSuccess) {
+      status = configCompiler(script, name);
+    }
+    if (status == Compiler::kSuccess) {
+      status = mCompiler.optimize(script);
+    }
+    if (status != Compiler::kSuccess) {
+      ALOGE("Unable to compile the source of %s! (%s)", name,
+            Compiler::GetErrorString(status));
+      return false;
+    }
+    opt_level = std::max(opt_level, mConfig->getOptimizationLevel());
+    full_precision |= mConfig->getFullPrecision();
+
+    // The support library looks up the symbols of the script, including its
+    // .rs.info, under "{name}.".
+    prefixSymbols(script.getSource().getModule(), pNames[i] + ".",
+                  runtime_symbols, exported_symbols);
+    if ((i > 0) && !pScripts[0]->mergeSource(script.getSource())) {
+      ALOGE("Failed to combine %s with %s!", name, pNames[0].c_str());
+      return false;
+    }
+  }
+
+  // Link in a single copy of the runtime functions that are still called,
+  // unless they are resolved against the shared runtime.
+  Source &combined = pScripts[0]->getSource();
+  if (!mShareRuntime) {
+    // Prepared the same way as when linking the runtime into a single script.
+    Source *runtime = pScripts[0]->LoadRuntime(pRuntimePath);
+    if (runtime == nullptr) {
+      return false;
+    }
+    llvm::Module &runtime_module = runtime->getModule();
+    runtime_module.setTargetTriple(combined.getModule().getTargetTriple());
+    runtime_module.setDataLayout(combined.getModule().getDataLayout());
+    if (!combined.merge(*runtime, /* pOnlyNeeded */true)) {
+      ALOGE("Failed to link the combined scripts with Renderscript runtime "
+            "%s!", pRuntimePath);
+      delete runtime;
+      return false;
+    }
+  }
+
+  // Generate code as for the most demanding of the scripts.
+  if (mConfig->getOptimizationLevel() != opt_level) {
+    mConfig->setOptimizationLevel(opt_level);
+  }
+#if defined(PROVIDE_ARM_CODEGEN)
+  if (mConfig->getFullPrecision() != full_precision) {
+    mConfig->setFullPrecision(full_precision);
+  }
+#endif
+  Compiler::ErrorCode status = mCompiler.config(*mConfig);
+  if (status == Compiler::kSuccess) {
+    status = mCompiler.runCombinedPasses(combined.getModule(),
+                                         exported_symbols);
+  }
+  if (status != Compiler::kSuccess) {
+    ALOGE("Unable to compile the combined scripts! (%s)",
+          Compiler::GetErrorString(status));
+    return false;
+  }
+
+#ifndef _WIN32
+  FileMutex write_output_mutex(pOut);
+  if (write_output_mutex.hasError() || !write_output_mutex.lockMutex()) {
+    ALOGE("Unable to acquire the lock for writing %s! (%s)",
+          pOut, write_output_mutex.getErrorMessage().c_str());
+    return false;
+  }
+#endif
+
+  std::error_code error;
+  llvm::raw_fd_ostream out_stream(pOut, error, llvm::sys::fs::F_RW);
+  if (error) {
+    ALOGE("Unable to open %s for write! (%s)", pOut, error.message().c_str());
+    return false;
+  }
+
+  status = mCompiler.generateCode(combined.getModule(), out_stream);
+  if (status != Compiler::kSuccess) {
+    ALOGE("Unable to generate code for the combined scripts! (%s)",
+          Compiler::GetErrorString(status));
+    return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright 2026, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Assert.h"
+#include "Log.h"
+#include "RSTransforms.h"
+#include "RSUtils.h"
+
+#include "bcinfo/MetadataExtractor.h"
+#include "rsDefines.h"
+
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Pass.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+const char kRsEntryTable[] = ".rs.entry_table";
+
+/* RSEntryTablePass: Embeds a table with the addresses of all the symbols the
+ * runtime looks up in a compiled script, so that it can resolve a single
+ * symbol at load time and index into it instead of resolving each one by name.
+ *
+ * .rs.entry_table
+ *   [N * i8*] - void *[N]
+ *   Entries are laid out in the order of the MetadataExtractor export lists:
+ *     - one data pointer per exported variable
+ *     - one function pointer per exported invokable
+ *     - one function pointer per forEach kernel (<NAME>.expand)
+ *     - four function pointers per general reduce kernel: initializer,
+ *       expanded accumulator, combiner and outconverter
+ *     - init
+ *     - .rs.dtor
+ *   A symbol that is absent from the Module has a null entry.
+ *
+ * Must run after LTO, so that it doesn't keep otherwise dead symbols alive.
+ */
+class RSEntryTablePass : public llvm::ModulePass {
+private:
+  static char ID;
+
+public:
+  RSEntryTablePass()
+    : ModulePass(ID) {
+  }
+
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
+    // This pass does not use any other analysis passes, but it does
+    // add a new global variable.
+  }
+
+  bool runOnModule(llvm::Module &M) override {
+    bcinfo::MetadataExtractor me(&M);
+    if (!me.extract()) {
+      ALOGE("Could not extract metadata from module!");
+      return false;
+    }
+
+    llvm::Type *VoidPtrTy = llvm::Type::getInt8PtrTy(M.getContext());
+    std::vector<llvm::Constant *> Entries;
+
+    auto AddEntry = [&](llvm::GlobalValue *GV) {
+      Entries.push_back(GV ? llvm::ConstantExpr::getBitCast(GV, VoidPtrTy)
+                           : llvm::Constant::getNullValue(VoidPtrTy));
+    };
+    auto AddFunction = [&](const char *Name) {
+      AddEntry(Name ? M.getFunction(Name) : nullptr);
+    };
+
+    const char **VarNameList = me.getExportVarNameList();
+    for (size_t i = 0; i < me.getExportVarCount(); ++i) {
+      AddEntry(M.getNamedGlobal(VarNameList[i]));
+    }
+
+    const char **FuncNameList = me.getExportFuncNameList();
+    for (size_t i = 0; i < me.getExportFuncCount(); ++i) {
+      AddFunction(FuncNameList[i]);
+    }
+
+    const char **ForEachNameList = me.getExportForEachNameList();
+    for (size_t i = 0; i < me.getExportForEachSignatureCount(); ++i) {
+      AddFunction((std::string(ForEachNameList[i]) + ".expand").c_str());
+    }
+
+    const bcinfo::MetadataExtractor::Reduce *ReduceList =
+        me.getExportReduceList();
+    for (size_t i = 0; i < me.getExportReduceCount(); ++i) {
+      const bcinfo::MetadataExtractor::Reduce &Reduce = ReduceList[i];
+      AddFunction(Reduce.mInitializerName);
+      AddFunction((std::string(Reduce.mAccumulatorName) + ".expand").c_str());
+      AddFunction(Reduce.mCombinerName != nullptr
+                      ? Reduce.mCombinerName
+                      : nameReduceCombinerFromAccumulator(
+                            Reduce.mAccumulatorName).c_str());
+      AddFunction(Reduce.mOutConverterName);
+    }
+
+    AddFunction(kInit);
+    AddFunction(kRsDtor);
+
+    llvm::ArrayType *EntryTableTy = llvm::ArrayType::get(VoidPtrTy,
+                                                         Entries.size());
+
+    // @.rs.entry_table = constant [N * i8*] [...]
+    llvm::GlobalVariable *EntryTable = llvm::dyn_cast<llvm::GlobalVariable>(
+        M.getOrInsertGlobal(kRsEntryTable, EntryTableTy));
+    EntryTable->setInitializer(llvm::ConstantArray::get(EntryTableTy, Entries));
+    EntryTable->setConstant(true);
+
+    // Upon completion, this pass has always modified the Module.
+    return true;
+  }
+
+  virtual const char *getPassName() const override {
+    return "Embed a table of script entry points";
+  }
+};
+
+}  // end anonymous namespace
+
+char RSEntryTablePass::ID = 0;
+
+static llvm::RegisterPass<RSEntryTablePass> X("embed-rs-entry-table",
+  "Embed a table of RenderScript entry points");
+
+namespace bcc {
+
+llvm::ModulePass *createRSEntryTablePass() {
+  return new RSEntryTablePass();
+}
+
+}  // end namespace bcc
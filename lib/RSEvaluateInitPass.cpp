@@ -0,0 +1,311 @@
+/*
+ * Copyright 2026, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Log.h"
+#include "RSTransforms.h"
+
+#include "rsDefines.h"
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Analysis/TargetLibraryInfo.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/CallSite.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Pass.h>
+#include <llvm/Transforms/Scalar.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/Evaluator.h>
+#include <llvm/Transforms/Utils/ValueMapper.h>
+
+#include <map>
+#include <vector>
+
+namespace {
+
+// Upper bound on the size of the fully unrolled body of init(), in
+// instructions, so that a huge table doesn't blow up compile time.
+const int kUnrollThreshold = 1 << 16;
+
+// Upper bound on the number of calls inlined into init().  Recursion stops
+// the evaluation anyway; this only bounds the work spent before it does.
+const unsigned kMaxInlinedCalls = 1024;
+
+/* RSEvaluateInitPass: Runs the init() function of a script at compile time and
+ * bakes its results into the initializers of the script globals, so that the
+ * runtime doesn't have to compute constant tables on every script creation.
+ *
+ * The evaluation is done by the static constructor evaluator that GlobalOpt
+ * uses for llvm.global_ctors (which the LTO pipeline already folds).  That
+ * evaluator gives up on loops and on calls to functions without a body, so
+ * init() is first copied into a scratch function in which the calls to
+ * functions of the Module are inlined and the loops are fully unrolled.
+ *
+ * On success, init() is removed, or emptied if anything still refers to it.
+ * If init() calls into the runtime (allocations, rsDebug(), ...), writes
+ * anything but globals with a definitive initializer, or has loops without a
+ * constant trip count, the Module is left unchanged and init() runs at script
+ * creation as before.
+ *
+ * Must run before RSKernelExpandPass and internalization, so that init() is
+ * still intact and the LTO pipeline sees the new initializers.
+ */
+class RSEvaluateInitPass : public llvm::ModulePass {
+private:
+  static char ID;
+
+  // A global initializer under construction: either a leaf constant or,
+  // once a store to one of its elements has been seen, the per-element
+  // values of the aggregate.
+  struct MutableValue {
+    llvm::Constant *Value;
+    std::vector<MutableValue> Elements;
+    bool Stored;
+
+    explicit MutableValue(llvm::Constant *V) : Value(V), Stored(false) {}
+
+    // Store Val at the element of this value that the indices of Addr from
+    // OpNo on select.  Returns false if the store overlaps another one, since
+    // the evaluator doesn't record which of the two came last.
+    bool store(llvm::ConstantExpr *Addr, unsigned OpNo, llvm::Constant *Val) {
+      if (Stored) {
+        return false;
+      }
+      if (OpNo == Addr->getNumOperands()) {
+        if (!Elements.empty()) {
+          return false;
+        }
+        Value = Val;
+        Stored = true;
+        return true;
+      }
+      if (Elements.empty()) {
+        llvm::Type *Ty = Value->getType();
+        unsigned NumElements = Ty->isStructTy() ? Ty->getStructNumElements() :
+                               Ty->isArrayTy() ? Ty->getArrayNumElements() :
+                                                 Ty->getVectorNumElements();
+        for (unsigned i = 0; i < NumElements; ++i) {
+          Elements.emplace_back(Value->getAggregateElement(i));
+        }
+      }
+      uint64_t Idx =
+          llvm::cast<llvm::ConstantInt>(Addr->getOperand(OpNo))->getZExtValue();
+      return Elements[Idx].store(Addr, OpNo + 1, Val);
+    }
+
+    llvm::Constant *get() const {
+      if (Elements.empty()) {
+        return Value;
+      }
+      std::vector<llvm::Constant *> Elts;
+      for (const MutableValue &Element : Elements) {
+        Elts.push_back(Element.get());
+      }
+      llvm::Type *Ty = Value->getType();
+      if (llvm::StructType *STy = llvm::dyn_cast<llvm::StructType>(Ty)) {
+        return llvm::ConstantStruct::get(STy, Elts);
+      }
+      if (llvm::ArrayType *ATy = llvm::dyn_cast<llvm::ArrayType>(Ty)) {
+        return llvm::ConstantArray::get(ATy, Elts);
+      }
+      return llvm::ConstantVector::get(Elts);
+    }
+  };
+
+  // Inline the calls to functions of the Module into Function, so that the
+  // loops in the callees are unrolled along with those of Function.
+  void inlineCalls(llvm::Function &Function) {
+    unsigned NumInlined = 0;
+    bool Changed = true;
+    while (Changed && NumInlined < kMaxInlinedCalls) {
+      Changed = false;
+      llvm::SmallVector<llvm::CallInst *, 16> Calls;
+      for (llvm::BasicBlock &BB : Function) {
+        for (llvm::Instruction &I : BB) {
+          llvm::CallInst *Call = llvm::dyn_cast<llvm::CallInst>(&I);
+          if (Call == nullptr) {
+            continue;
+          }
+          llvm::Function *Callee = Call->getCalledFunction();
+          if (Callee != nullptr && !Callee->isDeclaration() &&
+              Callee != &Function) {
+            Calls.push_back(Call);
+          }
+        }
+      }
+      for (llvm::CallInst *Call : Calls) {
+        llvm::InlineFunctionInfo IFI;
+        if (llvm::InlineFunction(llvm::CallSite(Call), IFI)) {
+          Changed = true;
+          if (++NumInlined == kMaxInlinedCalls) {
+            break;
+          }
+        }
+      }
+    }
+  }
+
+  // Simplify Function into straight-line code for the evaluator.
+  void unrollLoops(llvm::Module &Module, llvm::Function &Function) {
+    llvm::legacy::FunctionPassManager FPM(&Module);
+    FPM.add(llvm::createSROAPass());
+    FPM.add(llvm::createEarlyCSEPass());
+    FPM.add(llvm::createInstructionCombiningPass());
+    FPM.add(llvm::createCFGSimplificationPass());
+    FPM.add(llvm::createLoopRotatePass());
+    FPM.add(llvm::createIndVarSimplifyPass());
+    FPM.add(llvm::createLoopUnrollPass(kUnrollThreshold, -1, 0, 0));
+    FPM.add(llvm::createInstructionCombiningPass());
+    FPM.add(llvm::createCFGSimplificationPass());
+    FPM.doInitialization();
+    FPM.run(Function);
+    FPM.doFinalization();
+  }
+
+  // Write the memory mutated by the evaluator into the global initializers.
+  // Returns false, leaving the Module unchanged, if the stores can't be
+  // ordered.
+  bool commit(const llvm::DenseMap<llvm::Constant *, llvm::Constant *> &Memory) {
+    std::map<llvm::GlobalVariable *, llvm::Constant *> Whole;
+    std::map<llvm::GlobalVariable *,
+             std::vector<std::pair<llvm::ConstantExpr *, llvm::Constant *>>>
+        Partial;
+
+    for (const auto &Store : Memory) {
+      if (llvm::GlobalVariable *GV =
+              llvm::dyn_cast<llvm::GlobalVariable>(Store.first)) {
+        Whole[GV] = Store.second;
+        continue;
+      }
+      llvm::ConstantExpr *CE = llvm::dyn_cast<llvm::ConstantExpr>(Store.first);
+      if (CE == nullptr || CE->getOpcode() != llvm::Instruction::GetElementPtr) {
+        return false;
+      }
+      llvm::GlobalVariable *GV =
+          llvm::dyn_cast<llvm::GlobalVariable>(CE->getOperand(0));
+      if (GV == nullptr) {
+        return false;
+      }
+      Partial[GV].push_back(std::make_pair(CE, Store.second));
+    }
+
+    // The evaluator only records the final value stored at each address, not
+    // the order of the stores, so the new initializers are all built before
+    // any is set: a global that was stored both as a whole and element-wise
+    // can't be reconstructed.
+    std::vector<std::pair<llvm::GlobalVariable *, llvm::Constant *>> Inits(
+        Whole.begin(), Whole.end());
+    for (const auto &Stores : Partial) {
+      llvm::GlobalVariable *GV = Stores.first;
+      if (Whole.count(GV)) {
+        return false;
+      }
+      MutableValue Init(GV->getInitializer());
+      for (const auto &Store : Stores.second) {
+        // Operand 1 is the index through the pointer to the global, which
+        // the evaluator requires to be 0.
+        if (!Init.store(Store.first, 2, Store.second)) {
+          return false;
+        }
+      }
+      Inits.push_back(std::make_pair(GV, Init.get()));
+    }
+
+    for (const auto &Init : Inits) {
+      Init.first->setInitializer(Init.second);
+    }
+    return true;
+  }
+
+public:
+  RSEvaluateInitPass()
+    : ModulePass(ID) {
+  }
+
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
+    AU.addRequired<llvm::TargetLibraryInfoWrapperPass>();
+  }
+
+  bool runOnModule(llvm::Module &Module) override {
+    llvm::Function *Init = Module.getFunction(kInit);
+    if (Init == nullptr || Init->isDeclaration() || Init->isVarArg() ||
+        Init->arg_size() != 0 || !Init->getReturnType()->isVoidTy()) {
+      return false;
+    }
+
+    // Work on a copy, so that a failed evaluation leaves init() untouched.
+    llvm::Function *Scratch = llvm::Function::Create(
+        Init->getFunctionType(), llvm::GlobalValue::InternalLinkage,
+        std::string(kInit) + ".eval", &Module);
+    llvm::ValueToValueMapTy VMap;
+    llvm::SmallVector<llvm::ReturnInst *, 4> Returns;
+    llvm::CloneFunctionInto(Scratch, Init, VMap,
+                            /* ModuleLevelChanges */false, Returns);
+
+    inlineCalls(*Scratch);
+    unrollLoops(Module, *Scratch);
+
+    const llvm::TargetLibraryInfo &TLI =
+        getAnalysis<llvm::TargetLibraryInfoWrapperPass>().getTLI();
+    llvm::Evaluator Eval(Module.getDataLayout(), &TLI);
+    llvm::Constant *RetVal = nullptr;
+    llvm::SmallVector<llvm::Constant *, 0> Args;
+    bool Evaluated = Eval.EvaluateFunction(Scratch, RetVal, Args) &&
+                     commit(Eval.getMutatedMemory());
+    Scratch->eraseFromParent();
+
+    if (!Evaluated) {
+      ALOGV("Could not evaluate %s() at compile time", kInit);
+      return false;
+    }
+
+    ALOGV("Evaluated %s() at compile time (%u stores)", kInit,
+          Eval.getMutatedMemory().size());
+    if (Init->use_empty()) {
+      Init->eraseFromParent();
+    } else {
+      Init->deleteBody();
+      llvm::BasicBlock *BB = llvm::BasicBlock::Create(Module.getContext(),
+                                                      "entry", Init);
+      llvm::ReturnInst::Create(Module.getContext(), BB);
+    }
+    return true;
+  }
+
+  virtual const char *getPassName() const override {
+    return "Evaluate script init() at compile time";
+  }
+};
+
+}  // end anonymous namespace
+
+char RSEvaluateInitPass::ID = 0;
+
+static llvm::RegisterPass<RSEvaluateInitPass> X("rs-eval-init",
+  "Evaluate RenderScript init() at compile time");
+
+namespace bcc {
+
+llvm::ModulePass *createRSEvaluateInitPass() {
+  return new RSEvaluateInitPass();
+}
+
+}  // end namespace bcc
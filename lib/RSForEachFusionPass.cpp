@@ -0,0 +1,781 @@
+/*
+ * Copyright 2026, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Log.h"
+#include "RSScriptGroupFusion.h"
+#include "RSTransforms.h"
+#include "RSUtils.h"
+
+#include "bcinfo/MetadataExtractor.h"
+
+#include <llvm/Analysis/ValueTracking.h>
+#include <llvm/IR/CallSite.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DataLayout.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Pass.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Bounds the search through temporaries for the origin of an allocation.
+const unsigned kMaxFreshDepth = 4;
+
+bool isCallTo(const llvm::Value *V, const char *Name) {
+  const llvm::CallInst *Call = llvm::dyn_cast<llvm::CallInst>(V);
+  if (Call == nullptr || Call->getCalledFunction() == nullptr) {
+    return false;
+  }
+  return Call->getCalledFunction()->getName().find(Name) !=
+         llvm::StringRef::npos;
+}
+
+bool isLifetimeOrDebug(const llvm::Instruction *I) {
+  if (llvm::isa<llvm::DbgInfoIntrinsic>(I)) {
+    return true;
+  }
+  const llvm::IntrinsicInst *II = llvm::dyn_cast<llvm::IntrinsicInst>(I);
+  return II != nullptr &&
+         (II->getIntrinsicID() == llvm::Intrinsic::lifetime_start ||
+          II->getIntrinsicID() == llvm::Intrinsic::lifetime_end);
+}
+
+/* RSForEachFusionPass: Fuses back-to-back forEach launches in a function of
+ * the script into a single launch of a fused kernel, so that scripts get the
+ * benefit of kernel fusion without going through the ScriptGroup API.
+ *
+ * The front end lowers rsForEach() to
+ *   rsForEachInternal(slot, options, hasOutput, numInputs, allocs)
+ * where allocs points to a temporary array of the inputs followed by the
+ * output.  A sequence of such calls in a basic block is fused when:
+ * - no launch has options, each has an output and at most one input, and
+ *   the kernels are pointwise: they don't write memory other than their own
+ *   stack, which RSScriptGroupFusion then chains element by element;
+ * - only stack temporaries are written between the calls;
+ * - the output of each launch is the input of the next, through a global
+ *   rs_allocation that isn't exported, only ever holds allocations created by
+ *   the script itself and isn't read anywhere else.  The contents of such an
+ *   intermediate allocation can't be observed, so it is no longer written.
+ *   Since the runtime rejects launches over allocations of different
+ *   dimensions, the fused launch covers the same cells as each of the
+ *   original ones.
+ *
+ * The fused kernel is appended to the forEach exports of the Module and the
+ * last call of the sequence is replaced with a launch of it; the others are
+ * removed.
+ *
+ * Must run before RSKernelExpandPass and before the runtime is linked, so
+ * that the fused kernel is expanded and exported like the others.
+ */
+class RSForEachFusionPass : public llvm::ModulePass {
+private:
+  static char ID;
+
+  // Memory copied into the allocation array of a launch.
+  struct Copy {
+    int64_t DstOffset;
+    uint64_t Size;
+    llvm::Value *SrcBase;
+    int64_t SrcOffset;
+    llvm::Instruction *Reader;  // The instruction reading from SrcBase.
+  };
+
+  struct Launch {
+    llvm::CallInst *Call;
+    int Slot;
+    unsigned NumInputs;
+    llvm::Value *AllocsBase;
+    int64_t AllocsOffset;
+    uint64_t AllocSize;
+    // The copies into the allocation array since the previous launch.
+    std::vector<Copy> Copies;
+    // Whether only stack temporaries were written since the previous launch.
+    bool Adjacent;
+  };
+
+  // Consecutive launches to fuse; Intermediates[i] connects the output of
+  // Launches[i] to the input of Launches[i + 1], and Readers[i] are the
+  // instructions that read it to pass it to Launches[i + 1].
+  struct Chain {
+    std::vector<Launch> Launches;
+    std::vector<llvm::GlobalVariable *> Intermediates;
+    std::vector<std::vector<llvm::Instruction *>> Readers;
+  };
+
+  // A link of a candidate chain: the index of the chain and of its
+  // intermediate.
+  typedef std::pair<size_t, size_t> Link;
+
+  const llvm::DataLayout *DL;
+  bcinfo::MetadataExtractor *Metadata;
+  std::map<llvm::Function *, bool> PointwiseKernels;
+
+  bool isStackAddress(llvm::Value *Ptr) {
+    return llvm::isa<llvm::AllocaInst>(llvm::GetUnderlyingObject(Ptr, *DL));
+  }
+
+  // Returns whether I only writes to stack temporaries, if anything.
+  bool onlyWritesStack(llvm::Instruction &I) {
+    if (llvm::StoreInst *Store = llvm::dyn_cast<llvm::StoreInst>(&I)) {
+      return !Store->isVolatile() && isStackAddress(Store->getPointerOperand());
+    }
+    if (llvm::MemIntrinsic *MI = llvm::dyn_cast<llvm::MemIntrinsic>(&I)) {
+      return isStackAddress(MI->getRawDest());
+    }
+    if (isLifetimeOrDebug(&I)) {
+      return true;
+    }
+    // Reference counting of the temporary allocation arrays.
+    if (isCallTo(&I, "rsSetObject") || isCallTo(&I, "rsClearObject")) {
+      return isStackAddress(llvm::cast<llvm::CallInst>(I).getArgOperand(0));
+    }
+    return !I.mayHaveSideEffects();
+  }
+
+  // Returns whether Function only writes to its own stack, so that it can be
+  // run for one cell right after another kernel.
+  bool isPointwise(llvm::Function *Function) {
+    auto It = PointwiseKernels.find(Function);
+    if (It != PointwiseKernels.end()) {
+      return It->second;
+    }
+    // Assume recursion is not pointwise while Function is being examined.
+    PointwiseKernels[Function] = false;
+    if (Function->isDeclaration()) {
+      return false;
+    }
+
+    for (llvm::BasicBlock &BB : *Function) {
+      for (llvm::Instruction &I : BB) {
+        llvm::CallSite CS(&I);
+        if (CS && !isLifetimeOrDebug(&I) &&
+            !llvm::isa<llvm::MemIntrinsic>(&I)) {
+          if (CS.onlyReadsMemory()) {
+            continue;
+          }
+          llvm::Function *Callee = CS.getCalledFunction();
+          if (Callee == nullptr || !isPointwise(Callee)) {
+            return false;
+          }
+          continue;
+        }
+        if (!onlyWritesStack(I)) {
+          return false;
+        }
+      }
+    }
+
+    PointwiseKernels[Function] = true;
+    return true;
+  }
+
+  // Returns whether V, through casts, is only used by Consumer.
+  bool onlyFeeds(llvm::Value *V, llvm::Instruction *Consumer) {
+    for (llvm::User *U : V->users()) {
+      if (U != Consumer &&
+          !(llvm::isa<llvm::CastInst>(U) && onlyFeeds(U, Consumer))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Returns whether V is a handle to an allocation created by the script,
+  // which doesn't go anywhere but Consumer.
+  bool isFreshValue(llvm::Value *V, llvm::Instruction *Consumer,
+                    unsigned Depth) {
+    V = V->stripPointerCasts();
+    if (isCallTo(V, "rsCreateAllocation")) {
+      return onlyFeeds(V, Consumer);
+    }
+    if (llvm::LoadInst *Load = llvm::dyn_cast<llvm::LoadInst>(V)) {
+      return isFreshMemory(Load->getPointerOperand(), Consumer, Depth);
+    }
+    return false;
+  }
+
+  // Returns whether the temporary at Ptr only ever holds allocations created
+  // by the script, and is only read by Consumer.
+  bool isFreshMemory(llvm::Value *Ptr, llvm::Instruction *Consumer,
+                     unsigned Depth) {
+    if (Depth++ == kMaxFreshDepth) {
+      return false;
+    }
+    llvm::AllocaInst *Alloca = llvm::dyn_cast<llvm::AllocaInst>(
+        llvm::GetUnderlyingObject(Ptr, *DL));
+    if (Alloca == nullptr) {
+      return false;
+    }
+
+    llvm::SmallVector<llvm::Value *, 8> Worklist;
+    Worklist.push_back(Alloca);
+    while (!Worklist.empty()) {
+      llvm::Value *Addr = Worklist.pop_back_val();
+      for (llvm::User *U : Addr->users()) {
+        if (llvm::isa<llvm::BitCastInst>(U) ||
+            llvm::isa<llvm::GetElementPtrInst>(U)) {
+          Worklist.push_back(U);
+          continue;
+        }
+        llvm::Instruction *I = llvm::cast<llvm::Instruction>(U);
+        if (I == Consumer || isLifetimeOrDebug(I) ||
+            isCallTo(I, "rsCreateAllocation") ||
+            isCallTo(I, "rsClearObject")) {
+          continue;
+        }
+        if (llvm::isa<llvm::LoadInst>(I)) {
+          if (onlyFeeds(I, Consumer)) {
+            continue;
+          }
+          return false;
+        }
+        if (!isFreshWrite(I, Addr, Depth)) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  // Returns whether I writes a fresh allocation to Addr.
+  bool isFreshWrite(llvm::Instruction *I, llvm::Value *Addr, unsigned Depth) {
+    if (llvm::StoreInst *Store = llvm::dyn_cast<llvm::StoreInst>(I)) {
+      return Store->getPointerOperand() == Addr &&
+             isFreshValue(Store->getValueOperand(), I, Depth);
+    }
+    if (llvm::MemTransferInst *MT = llvm::dyn_cast<llvm::MemTransferInst>(I)) {
+      return MT->getRawDest() == Addr &&
+             isFreshMemory(MT->getRawSource(), I, Depth);
+    }
+    if (isCallTo(I, "rsSetObject")) {
+      // The source is passed by reference or by value, depending on the
+      // target.
+      llvm::CallInst *Call = llvm::cast<llvm::CallInst>(I);
+      llvm::Value *Src = Call->getArgOperand(1);
+      return Call->getArgOperand(0) == Addr &&
+             (Src->getType()->isPointerTy() ? isFreshMemory(Src, I, Depth)
+                                            : isFreshValue(Src, I, Depth));
+    }
+    return false;
+  }
+
+  // Returns whether the contents of GV can only be observed through Readers.
+  bool isUnobservable(llvm::GlobalVariable *GV,
+                      const std::set<llvm::Instruction *> &GVReaders) {
+    if (!GV->hasInitializer() ||
+        getRsDataTypeForType(GV->getValueType()) != RS_TYPE_ALLOCATION) {
+      return false;
+    }
+    const char **VarNameList = Metadata->getExportVarNameList();
+    for (size_t i = 0; i < Metadata->getExportVarCount(); ++i) {
+      if (GV->getName() == VarNameList[i]) {
+        return false;
+      }
+    }
+
+    llvm::SmallVector<llvm::Value *, 8> Worklist;
+    Worklist.push_back(GV);
+    while (!Worklist.empty()) {
+      llvm::Value *Addr = Worklist.pop_back_val();
+      for (llvm::User *U : Addr->users()) {
+        if (llvm::isa<llvm::ConstantExpr>(U) ||
+            llvm::isa<llvm::BitCastInst>(U) ||
+            llvm::isa<llvm::GetElementPtrInst>(U)) {
+          Worklist.push_back(U);
+          continue;
+        }
+        llvm::Instruction *I = llvm::dyn_cast<llvm::Instruction>(U);
+        if (I == nullptr) {
+          return false;
+        }
+        if (GVReaders.count(I) || isCallTo(I, "rsClearObject")) {
+          continue;
+        }
+        if (!isFreshWrite(I, Addr, 0)) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  // Record I in Copies if it copies into the memory at AllocsBase.  Returns
+  // false if I writes there in any other way.
+  bool recordCopy(llvm::Instruction &I, llvm::Value *AllocsBase,
+                  uint64_t AllocSize, std::vector<Copy> &Copies) {
+    llvm::Value *Dst = nullptr;
+    llvm::Value *Src = nullptr;
+    llvm::Instruction *Reader = &I;
+    uint64_t Size = 0;
+
+    if (llvm::StoreInst *Store = llvm::dyn_cast<llvm::StoreInst>(&I)) {
+      Dst = Store->getPointerOperand();
+      Size = DL->getTypeStoreSize(Store->getValueOperand()->getType());
+      if (llvm::LoadInst *Load =
+              llvm::dyn_cast<llvm::LoadInst>(Store->getValueOperand())) {
+        Src = Load->getPointerOperand();
+        Reader = Load;
+      }
+    } else if (llvm::MemTransferInst *MT =
+                   llvm::dyn_cast<llvm::MemTransferInst>(&I)) {
+      Dst = MT->getRawDest();
+      Src = MT->getRawSource();
+      llvm::ConstantInt *Length =
+          llvm::dyn_cast<llvm::ConstantInt>(MT->getLength());
+      Size = Length != nullptr ? Length->getZExtValue() : 0;
+    } else if (isCallTo(&I, "rsSetObject")) {
+      llvm::CallInst *Call = llvm::cast<llvm::CallInst>(&I);
+      Dst = Call->getArgOperand(0);
+      Size = AllocSize;
+      Src = Call->getArgOperand(1);
+      if (!Src->getType()->isPointerTy()) {
+        llvm::LoadInst *Load =
+            llvm::dyn_cast<llvm::LoadInst>(Src->stripPointerCasts());
+        Src = Load != nullptr ? Load->getPointerOperand() : nullptr;
+        Reader = Load;
+      }
+    } else {
+      llvm::CallSite CS(&I);
+      if (!CS || isLifetimeOrDebug(&I)) {
+        return true;
+      }
+      // Any other call that gets the allocation array may write to it.
+      for (llvm::Value *Arg : CS.args()) {
+        if (Arg->getType()->isPointerTy() &&
+            llvm::GetUnderlyingObject(Arg, *DL) == AllocsBase) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    int64_t DstOffset = 0;
+    if (llvm::GetPointerBaseWithConstantOffset(Dst, DstOffset, *DL) !=
+        AllocsBase) {
+      return llvm::GetUnderlyingObject(Dst, *DL) != AllocsBase;
+    }
+
+    Copy C = { DstOffset, Size, nullptr, 0, Reader };
+    if (Src != nullptr && Size != 0) {
+      C.SrcBase = llvm::GetPointerBaseWithConstantOffset(Src, C.SrcOffset, *DL);
+    }
+    Copies.push_back(C);
+    return true;
+  }
+
+  // Returns the global the cell Index of the allocation array of L was
+  // copied from, or nullptr if it isn't a plain copy of a global.  The
+  // instructions reading the global are added to CellReaders.
+  llvm::GlobalVariable *
+  getCellSource(const Launch &L, unsigned Index,
+                std::vector<llvm::Instruction *> &CellReaders) {
+    const int64_t Begin = L.AllocsOffset + Index * L.AllocSize;
+    const int64_t End = Begin + L.AllocSize;
+    llvm::GlobalVariable *Source = nullptr;
+    uint64_t Covered = 0;
+
+    for (const Copy &C : L.Copies) {
+      const int64_t CopyEnd = C.DstOffset + C.Size;
+      if (CopyEnd <= Begin || C.DstOffset >= End) {
+        continue;
+      }
+      llvm::GlobalVariable *GV =
+          llvm::dyn_cast_or_null<llvm::GlobalVariable>(C.SrcBase);
+      if (GV == nullptr || C.Size == 0 || C.DstOffset < Begin ||
+          CopyEnd > End || C.SrcOffset != C.DstOffset - Begin ||
+          (Source != nullptr && Source != GV)) {
+        return nullptr;
+      }
+      Source = GV;
+      Covered += C.Size;
+      CellReaders.push_back(C.Reader);
+    }
+
+    return Covered == L.AllocSize ? Source : nullptr;
+  }
+
+  // Parse a call to rsForEachInternal() that can take part in a fusion.
+  bool parseLaunch(llvm::CallInst *Call, Launch &L) {
+    if (Call->getNumArgOperands() != 5) {
+      return false;
+    }
+    llvm::ConstantInt *Slot =
+        llvm::dyn_cast<llvm::ConstantInt>(Call->getArgOperand(0));
+    llvm::ConstantInt *HasOutput =
+        llvm::dyn_cast<llvm::ConstantInt>(Call->getArgOperand(2));
+    llvm::ConstantInt *NumInputs =
+        llvm::dyn_cast<llvm::ConstantInt>(Call->getArgOperand(3));
+    if (Slot == nullptr || HasOutput == nullptr || NumInputs == nullptr ||
+        !llvm::isa<llvm::ConstantPointerNull>(Call->getArgOperand(1)) ||
+        HasOutput->isZero() || NumInputs->getZExtValue() > 1) {
+      return false;
+    }
+
+    L.Call = Call;
+    L.Slot = Slot->getSExtValue();
+    L.NumInputs = NumInputs->getZExtValue();
+    const size_t NumSlots = Metadata->getExportForEachSignatureCount();
+    if (L.Slot < 0 || static_cast<size_t>(L.Slot) >= NumSlots ||
+        Metadata->getExportForEachInputCountList()[L.Slot] != L.NumInputs) {
+      return false;
+    }
+
+    const char *KernelName = Metadata->getExportForEachNameList()[L.Slot];
+    llvm::Function *Kernel = KernelName != nullptr ?
+        Call->getModule()->getFunction(KernelName) : nullptr;
+    if (Kernel == nullptr || !isPointwise(Kernel)) {
+      return false;
+    }
+
+    llvm::Value *Allocs = Call->getArgOperand(4);
+    L.AllocsOffset = 0;
+    L.AllocsBase =
+        llvm::GetPointerBaseWithConstantOffset(Allocs, L.AllocsOffset, *DL);
+    L.AllocSize =
+        DL->getTypeAllocSize(Allocs->getType()->getPointerElementType());
+    return llvm::isa<llvm::AllocaInst>(L.AllocsBase);
+  }
+
+  // Collect the fusable sequences of launches in BB.
+  void collectChains(llvm::BasicBlock &BB, std::vector<Chain> &Chains) {
+    Chain Current;
+    std::vector<llvm::Instruction *> Window;
+
+    auto Flush = [&]() {
+      if (Current.Launches.size() > 1) {
+        Chains.push_back(Current);
+      }
+      Current = Chain();
+    };
+
+    for (llvm::Instruction &I : BB) {
+      if (!isCallTo(&I, "rsForEachInternal")) {
+        Window.push_back(&I);
+        continue;
+      }
+
+      Launch L;
+      if (!parseLaunch(llvm::cast<llvm::CallInst>(&I), L)) {
+        Flush();
+        Window.clear();
+        continue;
+      }
+
+      L.Adjacent = true;
+      bool KnownCopies = true;
+      for (llvm::Instruction *W : Window) {
+        L.Adjacent &= onlyWritesStack(*W);
+        KnownCopies &= recordCopy(*W, L.AllocsBase, L.AllocSize, L.Copies);
+      }
+      Window.clear();
+
+      llvm::GlobalVariable *Intermediate = nullptr;
+      std::vector<llvm::Instruction *> CellReaders;
+      if (!Current.Launches.empty() && L.Adjacent && KnownCopies &&
+          L.NumInputs == 1) {
+        const Launch &Prev = Current.Launches.back();
+        llvm::GlobalVariable *Output =
+            getCellSource(Prev, Prev.NumInputs, CellReaders);
+        llvm::GlobalVariable *Input = getCellSource(L, 0, CellReaders);
+        if (Output != nullptr && Output == Input) {
+          Intermediate = Output;
+        }
+      }
+
+      if (Intermediate == nullptr) {
+        Flush();
+      } else {
+        Current.Intermediates.push_back(Intermediate);
+        Current.Readers.push_back(CellReaders);
+      }
+      // The copies of a launch are only needed to find where its output
+      // goes, which requires them to have been complete.
+      if (!KnownCopies) {
+        L.Copies.clear();
+      }
+      Current.Launches.push_back(L);
+    }
+    Flush();
+  }
+
+  // Remove the fused kernel Name that no launch is going to use from the
+  // Module and from its forEach exports.
+  static void eraseFusedKernel(llvm::Module &M, const std::string &Name) {
+    llvm::NamedMDNode *NameMD = M.getNamedMetadata("#rs_export_foreach_name");
+    llvm::NamedMDNode *SigMD = M.getNamedMetadata("#rs_export_foreach");
+    std::vector<llvm::MDNode *> Names;
+    std::vector<llvm::MDNode *> Sigs;
+    for (unsigned i = 0; i < NameMD->getNumOperands(); ++i) {
+      llvm::MDString *S =
+          llvm::cast<llvm::MDString>(NameMD->getOperand(i)->getOperand(0));
+      if (S->getString() != Name) {
+        Names.push_back(NameMD->getOperand(i));
+        Sigs.push_back(SigMD->getOperand(i));
+      }
+    }
+    NameMD->clearOperands();
+    SigMD->clearOperands();
+    for (size_t i = 0; i < Names.size(); ++i) {
+      NameMD->addOperand(Names[i]);
+      SigMD->addOperand(Sigs[i]);
+    }
+    M.getFunction(Name)->eraseFromParent();
+  }
+
+  // Returns the slot of the forEach export Name.
+  static int getForEachSlot(llvm::Module &M, const std::string &Name) {
+    llvm::NamedMDNode *NameMD = M.getNamedMetadata("#rs_export_foreach_name");
+    for (unsigned i = 0; i < NameMD->getNumOperands(); ++i) {
+      llvm::MDString *S =
+          llvm::cast<llvm::MDString>(NameMD->getOperand(i)->getOperand(0));
+      if (S->getString() == Name) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  // Replace the launches of C with one of the fused kernel at FusedSlot.
+  void rewriteChain(const Chain &C, int FusedSlot) {
+    const Launch &First = C.Launches.front();
+    const Launch &Last = C.Launches.back();
+    llvm::BasicBlock &Entry = Last.Call->getFunction()->getEntryBlock();
+    llvm::Type *AllocTy =
+        Last.Call->getArgOperand(4)->getType()->getPointerElementType();
+    const unsigned Align = DL->getABITypeAlignment(AllocTy);
+
+    llvm::IRBuilder<> Builder(&*Entry.getFirstInsertionPt());
+    llvm::AllocaInst *Allocs = Builder.CreateAlloca(
+        llvm::ArrayType::get(AllocTy, First.NumInputs + 1), nullptr,
+        "fused.allocs");
+
+    // The allocation arrays of the original launches are only valid at the
+    // launch itself, so the input is taken at the first launch and the output
+    // at the last one.
+    if (First.NumInputs == 1) {
+      Builder.SetInsertPoint(First.Call);
+      Builder.CreateMemCpy(Builder.CreateConstInBoundsGEP2_32(
+                               Allocs->getAllocatedType(), Allocs, 0, 0),
+                           First.Call->getArgOperand(4), Last.AllocSize,
+                           Align);
+    }
+
+    Builder.SetInsertPoint(Last.Call);
+    Builder.CreateMemCpy(
+        Builder.CreateConstInBoundsGEP2_32(Allocs->getAllocatedType(), Allocs,
+                                           0, First.NumInputs),
+        Builder.CreateConstInBoundsGEP1_32(AllocTy,
+                                           Last.Call->getArgOperand(4),
+                                           Last.NumInputs),
+        Last.AllocSize, Align);
+
+    llvm::CallInst *Fused = llvm::cast<llvm::CallInst>(Last.Call->clone());
+    llvm::Type *SlotTy = Fused->getArgOperand(0)->getType();
+    llvm::Type *NumInputsTy = Fused->getArgOperand(3)->getType();
+    Fused->setArgOperand(0, llvm::ConstantInt::get(SlotTy, FusedSlot));
+    Fused->setArgOperand(3, llvm::ConstantInt::get(NumInputsTy,
+                                                   First.NumInputs));
+    Fused->setArgOperand(4, Builder.CreateConstInBoundsGEP2_32(
+        Allocs->getAllocatedType(), Allocs, 0, 0));
+    Builder.Insert(Fused);
+
+    for (const Launch &L : C.Launches) {
+      L.Call->eraseFromParent();
+    }
+  }
+
+public:
+  RSForEachFusionPass()
+    : ModulePass(ID), DL(nullptr), Metadata(nullptr) {
+  }
+
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
+    // This pass does not use any other analysis passes, but it does
+    // add new functions and modify the existing ones.
+  }
+
+  bool runOnModule(llvm::Module &M) override {
+    bcinfo::MetadataExtractor me(&M);
+    if (!me.extract()) {
+      ALOGE("Could not extract metadata from module!");
+      return false;
+    }
+
+    // The fused kernels are appended to the named forEach exports, which
+    // older bitcode doesn't have.
+    llvm::NamedMDNode *ExportForEachNameMD =
+        M.getNamedMetadata("#rs_export_foreach_name");
+    if (ExportForEachNameMD == nullptr ||
+        ExportForEachNameMD->getNumOperands() !=
+            me.getExportForEachSignatureCount()) {
+      return false;
+    }
+
+    DL = &M.getDataLayout();
+    Metadata = &me;
+    PointwiseKernels.clear();
+
+    std::vector<Chain> Candidates;
+    for (llvm::Function &F : M) {
+      for (llvm::BasicBlock &BB : F) {
+        collectChains(BB, Candidates);
+      }
+    }
+
+    // An intermediate is only unobservable if all the launches reading it
+    // are fused, so the chains are split at the intermediates that can be
+    // observed until every chain left has been fused.  Splitting or failing
+    // to fuse a chain leaves its reads of intermediates in place, which can
+    // make other intermediates observable in turn.
+    const char **ForEachNameList = me.getExportForEachNameList();
+    std::set<Link> Unfused;
+    std::map<std::vector<llvm::CallInst *>, std::string> FusedNames;
+    std::vector<Chain> Chains;
+    for (bool Retry = true; Retry;) {
+      Retry = false;
+
+      std::map<llvm::GlobalVariable *, std::set<llvm::Instruction *>> Readers;
+      for (size_t c = 0; c < Candidates.size(); ++c) {
+        const Chain &Candidate = Candidates[c];
+        for (size_t i = 0; i < Candidate.Intermediates.size(); ++i) {
+          std::set<llvm::Instruction *> &GVReaders =
+              Readers[Candidate.Intermediates[i]];
+          if (!Unfused.count(Link(c, i))) {
+            GVReaders.insert(Candidate.Readers[i].begin(),
+                             Candidate.Readers[i].end());
+          }
+        }
+      }
+      std::map<llvm::GlobalVariable *, bool> Unobservable;
+      for (auto &GVReaders : Readers) {
+        Unobservable[GVReaders.first] =
+            isUnobservable(GVReaders.first, GVReaders.second);
+      }
+
+      Chains.clear();
+      for (size_t c = 0; c < Candidates.size(); ++c) {
+        const Chain &Candidate = Candidates[c];
+        Chain Current;
+        std::vector<Link> Links;
+        for (size_t i = 0; i < Candidate.Launches.size(); ++i) {
+          Current.Launches.push_back(Candidate.Launches[i]);
+          if (i + 1 < Candidate.Launches.size() &&
+              !Unfused.count(Link(c, i)) &&
+              Unobservable[Candidate.Intermediates[i]]) {
+            Links.push_back(Link(c, i));
+            continue;
+          }
+          if (i + 1 < Candidate.Launches.size() &&
+              Unfused.insert(Link(c, i)).second) {
+            Retry = true;
+          }
+          if (Current.Launches.size() > 1) {
+            std::vector<llvm::CallInst *> Key;
+            for (const Launch &L : Current.Launches) {
+              Key.push_back(L.Call);
+            }
+            auto Fused = FusedNames.find(Key);
+            if (Fused == FusedNames.end()) {
+              std::vector<int> Slots;
+              std::string FusedName;
+              for (const Launch &L : Current.Launches) {
+                Slots.push_back(L.Slot);
+                FusedName += std::string(ForEachNameList[L.Slot]) + ".";
+              }
+              FusedName += "fused";
+              const std::string BaseName = FusedName;
+              for (int n = 1; M.getFunction(FusedName) != nullptr; ++n) {
+                FusedName = BaseName + "." + std::to_string(n);
+              }
+              if (!bcc::fuseKernels(me, Slots, FusedName, &M)) {
+                FusedName.clear();
+              }
+              Fused = FusedNames.insert(std::make_pair(Key, FusedName)).first;
+            }
+            if (!Fused->second.empty()) {
+              Chains.push_back(Current);
+            } else {
+              Unfused.insert(Links.begin(), Links.end());
+              Retry = true;
+            }
+          }
+          Current = Chain();
+          Links.clear();
+        }
+      }
+    }
+
+    // Drop the kernels fused for chains that were split afterwards.
+    std::set<std::string> UsedNames;
+    for (const Chain &C : Chains) {
+      std::vector<llvm::CallInst *> Key;
+      for (const Launch &L : C.Launches) {
+        Key.push_back(L.Call);
+      }
+      UsedNames.insert(FusedNames[Key]);
+    }
+    for (const auto &Fused : FusedNames) {
+      if (!Fused.second.empty() && !UsedNames.count(Fused.second)) {
+        eraseFusedKernel(M, Fused.second);
+      }
+    }
+
+    bool Changed = false;
+    for (const Chain &C : Chains) {
+      std::vector<llvm::CallInst *> Key;
+      for (const Launch &L : C.Launches) {
+        Key.push_back(L.Call);
+      }
+      const std::string &FusedName = FusedNames[Key];
+      llvm::Function *Caller = C.Launches.front().Call->getFunction();
+      ALOGV("Fused %zu forEach launches in %s into %s", C.Launches.size(),
+            Caller->getName().str().c_str(), FusedName.c_str());
+      rewriteChain(C, getForEachSlot(M, FusedName));
+      Changed = true;
+    }
+
+    Metadata = nullptr;
+    return Changed;
+  }
+
+  virtual const char *getPassName() const override {
+    return "Fuse consecutive forEach launches";
+  }
+};
+
+}  // end anonymous namespace
+
+char RSForEachFusionPass::ID = 0;
+
+static llvm::RegisterPass<RSForEachFusionPass> X("rs-foreach-fusion",
+  "Fuse consecutive RenderScript forEach launches");
+
+namespace bcc {
+
+llvm::ModulePass *createRSForEachFusionPass() {
+  return new RSForEachFusionPass();
+}
+
+}  // end namespace bcc
@@ -34,6 +34,9 @@ namespace {
 
 const bool kDebugGlobalInfo = false;
 
+const char kRsGlobalNameOffsets[]    = ".rs.global_name_offsets";
+const char kRsGlobalAddressOffsets[] = ".rs.global_address_offsets";
+
 /* RSGlobalInfoPass: Embeds additional information about RenderScript global
  * variables into the Module. The 5 variables added are specified as follows:
  * 1) .rs.global_entries
@@ -62,6 +65,17 @@ const bool kDebugGlobalInfo = false;
  *        17    Static (1 is static, 0 is extern)
  *        16    Constant (1 is const, 0 is non-const)
  *    15 - 0    RsDataType (see frameworks/rs/rsDefines.h for more info)
+ *
+ * When relative offsets are requested, 2) and 3) are replaced by tables that
+ * need no dynamic relocations:
+ * 2') .rs.global_name_offsets
+ *    [N * i32] - int32_t[N]
+ *    Offset of each name string from the start of this table.
+ * 3') .rs.global_address_offsets
+ *    [N * i32] - int32_t[N]
+ *    Offset of each global variable from the start of this table.  The
+ *    offsets can only be resolved at link time once RSLocalBindingPass has
+ *    bound them to variables that can't be preempted.
  */
 class RSGlobalInfoPass: public llvm::ModulePass {
 private:
@@ -69,6 +83,36 @@ private:
   // in our various exported data structures.
   bool mSkipConstants;
 
+  // If true, we emit names and addresses as offsets relative to their table
+  // instead of as pointers.
+  bool mRelativeOffsets;
+
+  // Create the constant table Name holding the offsets of Targets from the
+  // start of the table.
+  static llvm::GlobalVariable *
+  createRelativeTable(llvm::Module &M, const char *Name,
+                      const std::vector<llvm::Constant *> &Targets) {
+    llvm::Type *Int32Ty = llvm::Type::getInt32Ty(M.getContext());
+    llvm::Type *IntPtrTy = M.getDataLayout().getIntPtrType(M.getContext());
+    llvm::ArrayType *Int32ArrayTy = llvm::ArrayType::get(Int32Ty,
+                                                         Targets.size());
+
+    llvm::GlobalVariable *Table = llvm::dyn_cast<llvm::GlobalVariable>(
+        M.getOrInsertGlobal(Name, Int32ArrayTy));
+    llvm::Constant *Base = llvm::ConstantExpr::getPtrToInt(Table, IntPtrTy);
+
+    std::vector<llvm::Constant *> Offsets;
+    for (llvm::Constant *Target : Targets) {
+      llvm::Constant *Offset = llvm::ConstantExpr::getSub(
+          llvm::ConstantExpr::getPtrToInt(Target, IntPtrTy), Base);
+      Offsets.push_back(llvm::ConstantExpr::getTruncOrBitCast(Offset, Int32Ty));
+    }
+
+    Table->setInitializer(llvm::ConstantArray::get(Int32ArrayTy, Offsets));
+    Table->setConstant(true);
+    return Table;
+  }
+
   // Encodes properties of the GlobalVariable into a uint32_t.
   // These values are used to populate the .rs.global_properties array.
   static uint32_t getEncodedProperties(const llvm::GlobalVariable &GV) {
@@ -98,8 +142,10 @@ private:
 public:
   static char ID;
 
-  explicit RSGlobalInfoPass(bool pSkipConstants = false)
-    : ModulePass (ID), mSkipConstants(pSkipConstants) {
+  explicit RSGlobalInfoPass(bool pSkipConstants = false,
+                            bool pRelativeOffsets = false)
+    : ModulePass (ID), mSkipConstants(pSkipConstants),
+      mRelativeOffsets(pRelativeOffsets) {
   }
 
   void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
@@ -144,7 +190,9 @@ public:
       }
 
       // In LLVM, an instance of GlobalVariable is actually a Value
-      // corresponding to the address of it.
+      // corresponding to the address of it.  RSLocalBindingPass makes the
+      // relative offsets of exported variables refer to a local alias later
+      // on; GlobalOpt would fold an alias created here back into GV.
       GVAddresses.push_back(llvm::ConstantExpr::getBitCast(&GV, VoidPtrTy));
       GVNameStrings.push_back(GV.getName());
 
@@ -211,23 +259,32 @@ public:
     GlobalEntries->setInitializer(GlobalEntriesInit);
     GlobalEntries->setConstant(true);
 
-    // 2) @.rs.global_names = constant [N * i8*] [...]
-    V = M.getOrInsertGlobal(kRsGlobalNames, VoidPtrArrayTy);
-    llvm::GlobalVariable *GlobalNames =
-        llvm::dyn_cast<llvm::GlobalVariable>(V);
-    llvm::Constant *GlobalNamesInit =
-        llvm::ConstantArray::get(VoidPtrArrayTy, GVNames);
-    GlobalNames->setInitializer(GlobalNamesInit);
-    GlobalNames->setConstant(true);
-
-    // 3) @.rs.global_addresses = constant [N * i8*] [...]
-    V = M.getOrInsertGlobal(kRsGlobalAddresses, VoidPtrArrayTy);
-    llvm::GlobalVariable *GlobalAddresses =
-        llvm::dyn_cast<llvm::GlobalVariable>(V);
-    llvm::Constant *GlobalAddressesInit =
-        llvm::ConstantArray::get(VoidPtrArrayTy, GVAddresses);
-    GlobalAddresses->setInitializer(GlobalAddressesInit);
-    GlobalAddresses->setConstant(true);
+    llvm::GlobalVariable *GlobalNames;
+    llvm::GlobalVariable *GlobalAddresses;
+    if (mRelativeOffsets) {
+      // 2') @.rs.global_name_offsets = constant [N * i32] [...]
+      GlobalNames = createRelativeTable(M, kRsGlobalNameOffsets, GVNames);
+
+      // 3') @.rs.global_address_offsets = constant [N * i32] [...]
+      GlobalAddresses = createRelativeTable(M, kRsGlobalAddressOffsets,
+                                            GVAddresses);
+    } else {
+      // 2) @.rs.global_names = constant [N * i8*] [...]
+      V = M.getOrInsertGlobal(kRsGlobalNames, VoidPtrArrayTy);
+      GlobalNames = llvm::dyn_cast<llvm::GlobalVariable>(V);
+      llvm::Constant *GlobalNamesInit =
+          llvm::ConstantArray::get(VoidPtrArrayTy, GVNames);
+      GlobalNames->setInitializer(GlobalNamesInit);
+      GlobalNames->setConstant(true);
+
+      // 3) @.rs.global_addresses = constant [N * i8*] [...]
+      V = M.getOrInsertGlobal(kRsGlobalAddresses, VoidPtrArrayTy);
+      GlobalAddresses = llvm::dyn_cast<llvm::GlobalVariable>(V);
+      llvm::Constant *GlobalAddressesInit =
+          llvm::ConstantArray::get(VoidPtrArrayTy, GVAddresses);
+      GlobalAddresses->setInitializer(GlobalAddressesInit);
+      GlobalAddresses->setConstant(true);
+    }
 
 
     // 4) @.rs.global_sizes = constant [N * i32 or i64] [...]
@@ -274,8 +331,9 @@ static llvm::RegisterPass<RSGlobalInfoPass> X("embed-rs-global-info",
 
 namespace bcc {
 
-llvm::ModulePass * createRSGlobalInfoPass(bool pSkipConstants) {
-  return new RSGlobalInfoPass(pSkipConstants);
+llvm::ModulePass * createRSGlobalInfoPass(bool pSkipConstants,
+                                          bool pRelativeOffsets) {
+  return new RSGlobalInfoPass(pSkipConstants, pRelativeOffsets);
 }
 
 }
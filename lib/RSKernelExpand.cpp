@@ -26,8 +26,11 @@
 
 #include <cstdlib>
 #include <functional>
+#include <iterator>
 #include <unordered_set>
 
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/StringExtras.h>
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/Instructions.h>
@@ -35,11 +38,14 @@
 #include <llvm/IR/MDBuilder.h>
 #include <llvm/IR/Module.h>
 #include <llvm/Pass.h>
+#include <llvm/Support/CommandLine.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/IR/DataLayout.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/Type.h>
 #include <llvm/Transforms/Utils/BasicBlockUtils.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/ValueMapper.h>
 
 #ifndef __DISABLE_ASSERTS
 // Only used in bccAssert()
@@ -50,12 +56,31 @@ const int kNumExpandedReduceAccumulatorParams = 4;
 const char kRenderScriptTBAARootName[] = "RenderScript Distinct TBAA";
 const char kRenderScriptTBAANodeName[] = "RenderScript TBAA";
 
+// Named metadata recording the alignment, in bytes, that the runtime
+// guarantees for the base address of every allocation.
+const char kAllocationAlignmentMDName[] = "#rs_allocation_alignment";
+
 using namespace bcc;
 
 namespace {
 
 static const bool gEnableRsTbaa = true;
 
+// The loop transformations the compiler driver only asks for when it
+// optimizes, for running the pass on its own (e.g. from opt).
+llvm::cl::opt<bool> ClAlignmentVersioning(
+    "rs-alignment-versioning", llvm::cl::init(true),
+    llvm::cl::desc("Version expanded kernel loops on the "
+                   "#rs_allocation_alignment contract"));
+llvm::cl::opt<bool> ClSplitFieldAccesses(
+    "rs-split-field-accesses", llvm::cl::init(false),
+    llvm::cl::desc("Split the accesses to small vector and struct elements "
+                   "in expanded kernel loops into per-field accesses"));
+llvm::cl::opt<bool> ClTailFolding(
+    "rs-tail-folding", llvm::cl::init(false),
+    llvm::cl::desc("Ask the loop vectorizer to fold the remainder of "
+                   "expanded kernel loops into a predicated iteration"));
+
 /* RSKernelExpandPass
  *
  * This pass generates functions used to implement calls via
@@ -141,6 +166,29 @@ private:
   // Turns on optimization of allocation stride values.
   bool mEnableStepOpt;
 
+  // Turns on splitting of small vector and struct element accesses into
+  // per-field scalar accesses (see isInterleavableType()).
+  bool mEnableInterleave;
+
+  // Turns on versioning of the expanded loops on the alignment contract for
+  // allocation base addresses (see versionLoopForAlignment()).
+  bool mEnableAlignmentVersioning;
+
+  // Alignment contract for allocation base addresses requested by the
+  // compiler driver, or 0 to use the one recorded in the Module, if any.
+  unsigned mAllocationAlignment;
+
+  // Alignment contract in effect for the Module being processed (0 or 1 if
+  // there is none).
+  unsigned mAllocAlignment;
+
+  // Turns on a hint asking the loop vectorizer to handle the remainder of
+  // the expanded loops with a predicated vector iteration rather than a
+  // scalar epilogue (for targets with scalable vectors).  The loop vectorizer
+  // of the LLVM this is built against doesn't know the hint yet and ignores
+  // it; it only takes effect with one that supports tail folding.
+  bool mEnableTailFolding;
+
   uint32_t getRootSignature(llvm::Function *Function) {
     const llvm::NamedMDNode *ExportForEachMetadata =
         Module->getNamedMetadata("#rs_export_foreach");
@@ -465,7 +513,10 @@ private:
     IVNext = Builder.CreateNUWAdd(IV, Builder.getInt32(1));
     Builder.CreateStore(IVNext, IVVar);
     Cond = Builder.CreateICmpULT(IVNext, UpperBound);
-    Builder.CreateCondBr(Cond, HeaderBB, AfterBB);
+    llvm::BranchInst *Latch = Builder.CreateCondBr(Cond, HeaderBB, AfterBB);
+    if (mEnableTailFolding) {
+      Latch->setMetadata(llvm::LLVMContext::MD_loop, createTailFoldingLoopID());
+    }
     AfterBB->setName("Exit");
     Builder.SetInsertPoint(llvm::cast<llvm::Instruction>(IVNext));
 
@@ -474,6 +525,105 @@ private:
     return AfterBB;
   }
 
+  /// @brief Create a loop ID asking for the loop to be vectorized with a
+  /// predicated tail (see mEnableTailFolding).
+  llvm::MDNode *createTailFoldingLoopID() {
+    llvm::Metadata *Hints[] = {
+      nullptr,
+      llvm::MDNode::get(*Context, {
+        llvm::MDString::get(*Context, "llvm.loop.vectorize.predicate.enable"),
+        llvm::ConstantAsMetadata::get(llvm::ConstantInt::getTrue(*Context))
+      })
+    };
+    llvm::MDNode *LoopID = llvm::MDNode::getDistinct(*Context, Hints);
+    LoopID->replaceOperandWith(0, LoopID);
+    return LoopID;
+  }
+
+  /// @brief Version a loop created by createLoop() on the alignment of the
+  /// allocations it accesses.
+  ///
+  /// The runtime promises that allocations are allocated at addresses
+  /// aligned to mAllocAlignment bytes, but the row of a 2D launch or the
+  /// chunk of a 1D launch handed to an expanded function need not start at
+  /// such an address, so the contract can't be assumed blindly. The loop is
+  /// therefore guarded by a check that all of BasePtrs are aligned:
+  ///
+  /// Preheader:
+  ///   br i1 %x1 < %x2, label %Loop.guard, label %Exit
+  /// Loop.guard:
+  ///   br i1 %is_aligned, label %Loop.aligned, label %Loop.unaligned
+  /// Loop.aligned:
+  ///   <alignment assumptions on BasePtrs>
+  ///   br label %Loop
+  /// Loop:             ; the original loop
+  /// Loop.unaligned:   ; a copy of the original loop
+  ///
+  /// The assumptions let the loop vectorizer emit aligned vector accesses
+  /// without a peeled prologue in the common case.
+  ///
+  /// @param Preheader The block in which createLoop() was called.
+  /// @param Loop The loop body, as set up by createLoop().
+  /// @param BasePtrs The (loop-invariant) base pointers of the allocations.
+  void versionLoopForAlignment(llvm::BasicBlock *Preheader,
+                               llvm::BasicBlock *Loop,
+                               llvm::ArrayRef<llvm::Value *> BasePtrs) {
+    if (mAllocAlignment <= 1 || BasePtrs.empty()) {
+      return;
+    }
+
+    llvm::BranchInst *Entry =
+        llvm::cast<llvm::BranchInst>(Preheader->getTerminator());
+    bccAssert(Entry->isConditional() && Entry->getSuccessor(0) == Loop);
+    bccAssert(llvm::cast<llvm::BranchInst>(Loop->getTerminator())
+                  ->getSuccessor(0) == Loop);
+
+    llvm::Function *Function = Loop->getParent();
+    llvm::DataLayout DL(Module);
+    llvm::Type *IntPtrTy = DL.getIntPtrType(*Context);
+
+    // The loop only has the induction variable alloca and loop-invariant
+    // values from the preheader as live-ins, so a plain copy of the block
+    // makes a complete second loop.
+    llvm::ValueToValueMapTy VMap;
+    llvm::BasicBlock *Unaligned =
+        llvm::CloneBasicBlock(Loop, VMap, ".unaligned", Function);
+    VMap[Loop] = Unaligned;
+    for (llvm::Instruction &I : *Unaligned) {
+      llvm::RemapInstruction(&I, VMap, llvm::RF_NoModuleLevelChanges |
+                                       llvm::RF_IgnoreMissingLocals);
+    }
+    // Each loop needs a distinct loop ID.
+    if (Unaligned->getTerminator()->getMetadata(llvm::LLVMContext::MD_loop)) {
+      Unaligned->getTerminator()->setMetadata(llvm::LLVMContext::MD_loop,
+                                              createTailFoldingLoopID());
+    }
+
+    llvm::BasicBlock *Guard =
+        llvm::BasicBlock::Create(*Context, "Loop.guard", Function, Loop);
+    llvm::BasicBlock *Aligned =
+        llvm::BasicBlock::Create(*Context, "Loop.aligned", Function, Loop);
+    Entry->setSuccessor(0, Guard);
+
+    llvm::IRBuilder<> Builder(Guard);
+    llvm::Value *AddrBits = nullptr;
+    for (llvm::Value *BasePtr : BasePtrs) {
+      llvm::Value *Addr = Builder.CreatePtrToInt(BasePtr, IntPtrTy);
+      AddrBits = AddrBits ? Builder.CreateOr(AddrBits, Addr) : Addr;
+    }
+    llvm::Value *Misalignment =
+        Builder.CreateAnd(AddrBits, mAllocAlignment - 1, "misalignment");
+    llvm::Value *IsAligned = Builder.CreateICmpEQ(
+        Misalignment, llvm::ConstantInt::get(IntPtrTy, 0), "is_aligned");
+    Builder.CreateCondBr(IsAligned, Aligned, Unaligned);
+
+    Builder.SetInsertPoint(Aligned);
+    for (llvm::Value *BasePtr : BasePtrs) {
+      Builder.CreateAlignmentAssumption(DL, BasePtr, mAllocAlignment);
+    }
+    Builder.CreateBr(Loop);
+  }
+
   // Finish building the outgoing argument list for calling a ForEach-able function.
   //
   // ArgVector - on input, the non-special arguments
@@ -537,10 +687,129 @@ private:
     return Out;
   }
 
+  // Returns true if allocation elements of type Ty should be loaded and
+  // stored one field at a time.  A uchar4 pixel, for example, becomes four
+  // i8 accesses with a stride of 4 bytes, which the loop vectorizer can turn
+  // into an interleaved access group (ld4/st4 on ARM, loads and shuffles on
+  // x86) once the kernel body has been scalarized.  Only types with 2 to 4
+  // fields of the same scalar type of at most 32 bits and no padding between
+  // them qualify.
+  bool isInterleavableType(llvm::Type *Ty) {
+    unsigned NumFields;
+    llvm::Type *FieldTy;
+    if (llvm::VectorType *VT = llvm::dyn_cast<llvm::VectorType>(Ty)) {
+      NumFields = VT->getNumElements();
+      FieldTy = VT->getElementType();
+    } else if (llvm::StructType *ST = llvm::dyn_cast<llvm::StructType>(Ty)) {
+      if (ST->isOpaque() || ST->getNumElements() == 0) {
+        return false;
+      }
+      NumFields = ST->getNumElements();
+      FieldTy = ST->getElementType(0);
+      for (unsigned i = 1; i < NumFields; ++i) {
+        if (ST->getElementType(i) != FieldTy) {
+          return false;
+        }
+      }
+      const llvm::DataLayout &DL = Module->getDataLayout();
+      if (DL.getTypeAllocSize(ST) != NumFields * DL.getTypeAllocSize(FieldTy)) {
+        return false;
+      }
+    } else {
+      return false;
+    }
+
+    if (NumFields < 2 || NumFields > 4) {
+      return false;
+    }
+    return FieldTy->isIntegerTy(8) || FieldTy->isIntegerTy(16) ||
+           FieldTy->isIntegerTy(32) || FieldTy->isHalfTy() ||
+           FieldTy->isFloatTy();
+  }
+
+  // Returns a pointer to field Idx of the vector or struct pointed to by Ptr.
+  llvm::Value *createFieldGEP(llvm::IRBuilder<> &Builder, llvm::Value *Ptr,
+                              unsigned Idx) {
+    llvm::Type *Ty = Ptr->getType()->getPointerElementType();
+    if (llvm::VectorType *VT = llvm::dyn_cast<llvm::VectorType>(Ty)) {
+      llvm::Type *FieldTy = VT->getElementType();
+      llvm::Value *FieldBase =
+          Builder.CreatePointerCast(Ptr, FieldTy->getPointerTo());
+      return Builder.CreateConstInBoundsGEP1_32(FieldTy, FieldBase, Idx);
+    }
+    return Builder.CreateStructGEP(Ty, Ptr, Idx);
+  }
+
+  // Load the element pointed to by Ptr, one field at a time if its type is
+  // interleavable.
+  llvm::Value *createElementLoad(llvm::IRBuilder<> &Builder, llvm::Value *Ptr,
+                                 llvm::MDNode *TBAA, const llvm::Twine &Name) {
+    llvm::Type *Ty = Ptr->getType()->getPointerElementType();
+    if (!mEnableInterleave || !isInterleavableType(Ty)) {
+      llvm::LoadInst *Load = Builder.CreateLoad(Ptr, Name);
+      if (gEnableRsTbaa) {
+        Load->setMetadata("tbaa", TBAA);
+      }
+      return Load;
+    }
+
+    const unsigned NumFields = Ty->isVectorTy() ? Ty->getVectorNumElements()
+                                                : Ty->getStructNumElements();
+    llvm::Value *Element = llvm::UndefValue::get(Ty);
+    for (unsigned Idx = 0; Idx < NumFields; ++Idx) {
+      llvm::LoadInst *Load =
+          Builder.CreateLoad(createFieldGEP(Builder, Ptr, Idx), Name + ".field");
+      if (gEnableRsTbaa) {
+        Load->setMetadata("tbaa", TBAA);
+      }
+      if (Ty->isVectorTy()) {
+        Element = Builder.CreateInsertElement(Element, Load, Idx);
+      } else {
+        Element = Builder.CreateInsertValue(Element, Load, Idx);
+      }
+    }
+    Element->setName(Name);
+    return Element;
+  }
+
+  // Store Val to Ptr, one field at a time if its type is interleavable.
+  void createElementStore(llvm::IRBuilder<> &Builder, llvm::Value *Val,
+                          llvm::Value *Ptr, llvm::MDNode *TBAA) {
+    llvm::Type *Ty = Val->getType();
+    if (!mEnableInterleave || !isInterleavableType(Ty)) {
+      llvm::StoreInst *Store = Builder.CreateStore(Val, Ptr);
+      if (gEnableRsTbaa) {
+        Store->setMetadata("tbaa", TBAA);
+      }
+      return;
+    }
+
+    const unsigned NumFields = Ty->isVectorTy() ? Ty->getVectorNumElements()
+                                                : Ty->getStructNumElements();
+    for (unsigned Idx = 0; Idx < NumFields; ++Idx) {
+      llvm::Value *Field = Ty->isVectorTy()
+                               ? Builder.CreateExtractElement(Val, Idx)
+                               : Builder.CreateExtractValue(Val, Idx);
+      llvm::StoreInst *Store =
+          Builder.CreateStore(Field, createFieldGEP(Builder, Ptr, Idx));
+      if (gEnableRsTbaa) {
+        Store->setMetadata("tbaa", TBAA);
+      }
+    }
+  }
+
 public:
-  explicit RSKernelExpandPass(bool pEnableStepOpt = true)
+  explicit RSKernelExpandPass(bool pEnableStepOpt = true,
+                              bool pEnableInterleave = ClSplitFieldAccesses,
+                              bool pEnableAlignmentVersioning =
+                                  ClAlignmentVersioning,
+                              unsigned pAllocationAlignment = 0,
+                              bool pEnableTailFolding = ClTailFolding)
       : ModulePass(ID), Module(nullptr), Context(nullptr),
-        mEnableStepOpt(pEnableStepOpt) {
+        mEnableStepOpt(pEnableStepOpt), mEnableInterleave(pEnableInterleave),
+        mEnableAlignmentVersioning(pEnableAlignmentVersioning),
+        mAllocationAlignment(pAllocationAlignment), mAllocAlignment(0),
+        mEnableTailFolding(pEnableTailFolding) {
 
   }
 
@@ -747,11 +1016,8 @@ public:
       }
 
       llvm::Value *Input;
-      llvm::LoadInst *InputLoad = Builder.CreateLoad(InPtr, "input");
-
-      if (gEnableRsTbaa) {
-        InputLoad->setMetadata("tbaa", TBAAAllocation);
-      }
+      llvm::Value *InputLoad =
+          createElementLoad(Builder, InPtr, TBAAAllocation, "input");
 
       if (llvm::Value *TemporarySlot = InStructTempSlots[Index]) {
         // Pass a pointer to a temporary on the stack, rather than
@@ -770,6 +1036,96 @@ public:
     }
   }
 
+  // Generate loop-invariant setup code for the additional outputs of an
+  // expanded multi-output ForEach-able function.  Output N (counting from 1)
+  // is written through an out-pointer parameter of the UNexpanded function and
+  // lives in the allocation at OutPtr[N] of the DriverInfo structure.
+  //
+  // LoopHeader - block at the end of which the setup code will be inserted
+  // Arg_p - RSKernelDriverInfo pointer passed to the expanded function
+  // TBAAPointer - metadata for marking loads of pointer values out of RSKernelDriverInfo
+  // ArgIter - iterator pointing to the first additional output parameter of the
+  //           UNexpanded function
+  // NumOutputs - number of additional outputs
+  //
+  // OutTypes[] - this function saves the output parameter types, they will be
+  //              used in ExpandExtraOutputsBody().
+  // OutBufPtrs[] - this function sets each array element to point to the first cell / byte
+  //                (byte for x86, cell for other platforms) of the corresponding output allocation
+  void ExpandExtraOutputsLoopInvariant(llvm::IRBuilder<> &Builder, llvm::BasicBlock *LoopHeader,
+                                       llvm::Value *Arg_p,
+                                       llvm::MDNode *TBAAPointer,
+                                       llvm::Function::arg_iterator ArgIter,
+                                       const size_t NumOutputs,
+                                       llvm::SmallVectorImpl<llvm::Type *> &OutTypes,
+                                       llvm::SmallVectorImpl<llvm::Value *> &OutBufPtrs) {
+    bccAssert(NumOutputs < RS_KERNEL_INPUT_LIMIT);
+
+    auto OldInsertionPoint = Builder.saveIP();
+    Builder.SetInsertPoint(LoopHeader->getTerminator());
+
+    for (size_t OutputIndex = 1; OutputIndex <= NumOutputs; ++OutputIndex, ArgIter++) {
+      llvm::Type *OutType = ArgIter->getType();
+      bccAssert(OutType->isPointerTy());
+
+      SmallGEPIndices OutBufPtrGEP(GEPHelper({0, RsExpandKernelDriverInfoPfxFieldOutPtr,
+                                              static_cast<int32_t>(OutputIndex)}));
+      llvm::Value    *OutBufPtrAddr = Builder.CreateInBoundsGEP(Arg_p, OutBufPtrGEP, "out_buf.gep");
+      llvm::LoadInst *OutBufPtr = Builder.CreateLoad(OutBufPtrAddr, "out_buf");
+
+      if (gEnableRsTbaa) {
+        OutBufPtr->setMetadata("tbaa", TBAAPointer);
+      }
+
+      llvm::Value *CastOutBufPtr = nullptr;
+      if (mStructExplicitlyPaddedBySlang || (Module->getTargetTriple() != DEFAULT_X86_TRIPLE_STRING)) {
+        CastOutBufPtr = Builder.CreatePointerCast(OutBufPtr, OutType, "casted_out");
+      } else {
+        // As for the first output, leave the x86 buffer as an int8_t* and
+        // index it with an explicit byte offset in ExpandExtraOutputsBody().
+        CastOutBufPtr = OutBufPtr;
+      }
+
+      OutTypes.push_back(OutType);
+      OutBufPtrs.push_back(CastOutBufPtr);
+    }
+
+    Builder.restoreIP(OldInsertionPoint);
+  }
+
+  // Generate loop-varying code for the additional outputs of an expanded
+  // multi-output ForEach-able function, and append the out-pointer arguments
+  // for the call to the UNexpanded function to RootArgs.
+  //
+  // Arg_x1 - first X coordinate to be processed by the expanded function
+  // OutTypes[], OutBufPtrs[] - produced by ExpandExtraOutputsLoopInvariant()
+  // IndVar - value of loop induction variable (X coordinate) for a given loop iteration
+  void ExpandExtraOutputsBody(llvm::IRBuilder<> &Builder,
+                              llvm::Value *Arg_x1,
+                              const llvm::SmallVectorImpl<llvm::Type *> &OutTypes,
+                              const llvm::SmallVectorImpl<llvm::Value *> &OutBufPtrs,
+                              llvm::Value *IndVar,
+                              llvm::SmallVectorImpl<llvm::Value *> &RootArgs) {
+    llvm::Value *Offset = Builder.CreateSub(IndVar, Arg_x1);
+    llvm::Type *Int32Ty = llvm::Type::getInt32Ty(*Context);
+
+    for (size_t Index = 0; Index < OutTypes.size(); ++Index) {
+      llvm::Value *OutPtr = nullptr;
+      if (mStructExplicitlyPaddedBySlang || (Module->getTargetTriple() != DEFAULT_X86_TRIPLE_STRING)) {
+        OutPtr = Builder.CreateInBoundsGEP(OutBufPtrs[Index], Offset);
+      } else {
+        llvm::DataLayout DL(X86_CUSTOM_DL_STRING);
+        llvm::Type *OutTy = OutTypes[Index];
+        uint64_t OutStep = DL.getTypeAllocSize(OutTy->getPointerElementType());
+        llvm::Value *OffsetInBytes = Builder.CreateMul(Offset, llvm::ConstantInt::get(Int32Ty, OutStep));
+        OutPtr = Builder.CreateInBoundsGEP(OutBufPtrs[Index], OffsetInBytes);
+        OutPtr = Builder.CreatePointerCast(OutPtr, OutTy);
+      }
+
+      RootArgs.push_back(OutPtr);
+    }
+  }
+
   /* Performs the actual optimization on a selected function. On success, the
    * Module will contain a new function of the name "<NAME>.expand" that
    * invokes <NAME>() in a loop with the appropriate parameters.
@@ -1028,6 +1384,7 @@ public:
     llvm::BasicBlock *LoopHeader = Builder.GetInsertBlock();
     llvm::Value *IV;
     createLoop(Builder, Arg_x1, Arg_x2, &IV);
+    llvm::BasicBlock *LoopBody = Builder.GetInsertBlock();
 
     llvm::SmallVector<llvm::Value*, 8> CalleeArgs;
     const int CalleeArgsContextIdx =
@@ -1037,15 +1394,30 @@ public:
 
     // After ExpandSpecialArguments() gets called, NumRemainingInputs
     // counts the number of arguments to the kernel that correspond to
-    // an array entry from the InPtr field of the DriverInfo
-    // structure.
-    const size_t NumInPtrArguments = NumRemainingInputs;
+    // an array entry from the InPtr field of the DriverInfo structure,
+    // followed by the out-pointer parameters of any additional outputs
+    // (entries 1 and up of the OutPtr field).
+    const size_t NumExtraOutputs =
+        bcinfo::MetadataExtractor::getForEachSignatureExtraOutCount(Signature);
+    bccAssert(NumExtraOutputs == 0 || CastedOutBasePtr != nullptr);
+    bccAssert(NumRemainingInputs >= NumExtraOutputs);
+    const size_t NumInPtrArguments = NumRemainingInputs - NumExtraOutputs;
 
     if (NumInPtrArguments > 0) {
       ExpandInputsLoopInvariant(Builder, LoopHeader, Arg_p, TBAAPointer, ArgIter, NumInPtrArguments,
                                 InTypes, InBufPtrs, InStructTempSlots);
     }
 
+    llvm::SmallVector<llvm::Type*,  8> ExtraOutTypes;
+    llvm::SmallVector<llvm::Value*, 8> ExtraOutBufPtrs;
+
+    if (NumExtraOutputs > 0) {
+      llvm::Function::arg_iterator ExtraOutArgIter = ArgIter;
+      std::advance(ExtraOutArgIter, NumInPtrArguments);
+      ExpandExtraOutputsLoopInvariant(Builder, LoopHeader, Arg_p, TBAAPointer, ExtraOutArgIter,
+                                      NumExtraOutputs, ExtraOutTypes, ExtraOutBufPtrs);
+    }
+
     // Populate the actual call to kernel().
     llvm::SmallVector<llvm::Value*, 8> RootArgs;
 
@@ -1081,17 +1453,28 @@ public:
                        InTypes, InBufPtrs, InStructTempSlots, IV, RootArgs);
     }
 
+    // Additional outputs
+
+    if (NumExtraOutputs > 0) {
+      ExpandExtraOutputsBody(Builder, Arg_x1, ExtraOutTypes, ExtraOutBufPtrs, IV, RootArgs);
+    }
+
     finishArgList(RootArgs, CalleeArgs, CalleeArgsContextIdx, *Function, Builder);
 
     llvm::Value *RetVal = Builder.CreateCall(Function, RootArgs);
 
     if (OutPtr && !PassOutByPointer) {
       RetVal->setName("call.result");
-      llvm::StoreInst *Store = Builder.CreateStore(RetVal, OutPtr);
-      if (gEnableRsTbaa) {
-        Store->setMetadata("tbaa", TBAAAllocation);
-      }
+      createElementStore(Builder, RetVal, OutPtr, TBAAAllocation);
+    }
+
+    llvm::SmallVector<llvm::Value*, 8> BasePtrs(InBufPtrs.begin(),
+                                                InBufPtrs.end());
+    if (OutBasePtr) {
+      BasePtrs.push_back(OutBasePtr);
     }
+    BasePtrs.append(ExtraOutBufPtrs.begin(), ExtraOutBufPtrs.end());
+    versionLoopForAlignment(LoopHeader, LoopBody, BasePtrs);
 
     return true;
   }
@@ -1186,6 +1569,7 @@ public:
     llvm::BasicBlock *LoopHeader = Builder.GetInsertBlock();
     llvm::Value *IndVar;
     createLoop(Builder, Arg_x1, Arg_x2, &IndVar);
+    llvm::BasicBlock *LoopBody = Builder.GetInsertBlock();
 
     llvm::SmallVector<llvm::Value*, 8> CalleeArgs;
     const int CalleeArgsContextIdx =
@@ -1206,6 +1590,8 @@ public:
     finishArgList(RootArgs, CalleeArgs, CalleeArgsContextIdx, *FnAccumulator, Builder);
     Builder.CreateCall(FnAccumulator, RootArgs);
 
+    versionLoopForAlignment(LoopHeader, LoopBody, InBufPtrs);
+
     return true;
   }
 
@@ -1365,6 +1751,44 @@ public:
     TBAARenderScript->replaceOperandWith(1, TBAARoot);
   }
 
+  /// @brief Get the allocation alignment contract of the Module
+  ///
+  /// The contract requested by the compiler driver, if any, is first recorded
+  /// in the Module, so that it stays with the bitcode the kernels were
+  /// expanded from.
+  ///
+  /// @return The alignment in bytes, or 0 if there is no contract.
+  unsigned getAllocationAlignment(llvm::Module &Module) {
+    if (mAllocationAlignment != 0) {
+      llvm::NamedMDNode *AlignmentMD =
+          Module.getOrInsertNamedMetadata(kAllocationAlignmentMDName);
+      AlignmentMD->clearOperands();
+      llvm::Metadata *Value[] = {
+        llvm::MDString::get(*Context, llvm::utostr(mAllocationAlignment))
+      };
+      AlignmentMD->addOperand(llvm::MDNode::get(*Context, Value));
+    }
+
+    const llvm::NamedMDNode *AlignmentMD =
+        Module.getNamedMetadata(kAllocationAlignmentMDName);
+    if (AlignmentMD == nullptr || AlignmentMD->getNumOperands() != 1) {
+      return 0;
+    }
+
+    const llvm::MDNode *Node = AlignmentMD->getOperand(0);
+    const llvm::MDString *Value =
+        Node->getNumOperands() == 1 ?
+            llvm::dyn_cast<llvm::MDString>(Node->getOperand(0)) : nullptr;
+    unsigned Alignment = 0;
+    if (Value == nullptr ||
+        Value->getString().getAsInteger(10, Alignment) ||
+        (Alignment & (Alignment - 1)) != 0) {
+      ALOGE("Ignoring malformed %s metadata", kAllocationAlignmentMDName);
+      return 0;
+    }
+    return Alignment;
+  }
+
   virtual bool runOnModule(llvm::Module &Module) {
     bool Changed  = false;
     this->Module  = &Module;
@@ -1379,6 +1803,8 @@ public:
     }
 
     mStructExplicitlyPaddedBySlang = (me.getCompilerVersion() >= SlangVersion::N_STRUCT_EXPLICIT_PADDING);
+    mAllocAlignment =
+        mEnableAlignmentVersioning ? getAllocationAlignment(Module) : 0;
 
     // Expand forEach_* style kernels.
     mExportForEachCount = me.getExportForEachSignatureCount();
@@ -1451,8 +1877,13 @@ namespace bcc {
 const char BCC_INDEX_VAR_NAME[] = "rsIndex";
 
 llvm::ModulePass *
-createRSKernelExpandPass(bool pEnableStepOpt) {
-  return new RSKernelExpandPass(pEnableStepOpt);
+createRSKernelExpandPass(bool pEnableStepOpt, bool pEnableInterleave,
+                         bool pEnableAlignmentVersioning,
+                         unsigned pAllocationAlignment,
+                         bool pEnableTailFolding) {
+  return new RSKernelExpandPass(pEnableStepOpt, pEnableInterleave,
+                                pEnableAlignmentVersioning,
+                                pAllocationAlignment, pEnableTailFolding);
 }
 
 } // end namespace bcc
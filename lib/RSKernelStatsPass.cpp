@@ -0,0 +1,275 @@
+/*
+ * Copyright 2026, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Assert.h"
+#include "Log.h"
+#include "RSTransforms.h"
+
+#include "bcc/Config.h"
+#include "bcinfo/MetadataExtractor.h"
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/Triple.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/InlineAsm.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Pass.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+const char kRsKernelStatsEntries[] = ".rs.kernel_stats_entries";
+const char kRsKernelStatsNames[]   = ".rs.kernel_stats_names";
+const char kRsKernelStats[]        = ".rs.kernel_stats";
+
+/* RSKernelStatsPass: Instruments the entry points of a script with runtime
+ * counters for profiling.  Every expanded forEach kernel (<NAME>.expand),
+ * expanded reduce accumulator and invokable atomically adds to its own entry
+ * of a per-script table on each call:
+ *
+ *   struct RsKernelStats {
+ *     uint64_t invocations;  // number of calls
+ *     uint64_t elements;     // cells processed (x2 - x1 for .expand functions)
+ *     uint64_t ticks;        // timestamp counter ticks spent in the call
+ *   };
+ *
+ * The timestamp counter is read once on entry and once on each return, never
+ * per element.  The following symbols are added to the Module:
+ * 1) .rs.kernel_stats_entries
+ *    i32 - int
+ *    Number of instrumented functions.
+ * 2) .rs.kernel_stats_names
+ *    [N * i8*] - const char *[N]
+ *    Name of each instrumented function.
+ * 3) .rs.kernel_stats
+ *    [N * {i64, i64, i64}] - RsKernelStats[N]
+ *    Zero-initialized counters, in the order of .rs.kernel_stats_names.
+ *
+ * Must run after LTO, so that only the functions reachable from the runtime
+ * are instrumented and the counters aren't duplicated by inlining.
+ */
+class RSKernelStatsPass : public llvm::ModulePass {
+private:
+  static char ID;
+
+  llvm::Module *Module;
+  llvm::Type *Int64Ty;
+  llvm::StructType *StatsTy;
+
+  // Emit a read of a user-accessible timestamp counter.  Targets without one
+  // get a constant 0, leaving only the invocation and element counts.
+  llvm::Value *createReadCounter(llvm::IRBuilder<> &Builder) {
+    llvm::Triple Triple(Module->getTargetTriple());
+    const char *Asm = nullptr;
+    const char *Constraints = "=r";
+
+    switch (Triple.getArch()) {
+    case llvm::Triple::x86:
+    case llvm::Triple::x86_64: {
+      // rdtsc is available to user space.
+      llvm::Function *ReadCycleCounter = llvm::Intrinsic::getDeclaration(
+          Module, llvm::Intrinsic::readcyclecounter);
+      return Builder.CreateCall(ReadCycleCounter, {}, "ticks");
+    }
+    case llvm::Triple::aarch64:
+      // Unlike the PMU cycle counter, the virtual counter can always be read
+      // from EL0 on Linux.
+      Asm = "mrs $0, cntvct_el0";
+      break;
+    case llvm::Triple::arm:
+      Asm = "mrrc p15, 1, ${0:Q}, ${0:R}, c14";
+      break;
+#if defined(PROVIDE_RISCV64_CODEGEN)
+    case llvm::Triple::riscv64:
+      Asm = "rdtime $0";
+      break;
+#endif
+    default:
+      return llvm::ConstantInt::get(Int64Ty, 0);
+    }
+
+    llvm::FunctionType *AsmTy = llvm::FunctionType::get(Int64Ty, false);
+    llvm::InlineAsm *ReadCounter =
+        llvm::InlineAsm::get(AsmTy, Asm, Constraints, /* hasSideEffects */true);
+    return Builder.CreateCall(ReadCounter, {}, "ticks");
+  }
+
+  // Instrument Function to accumulate into the counters at StatsEntry.
+  void instrument(llvm::Function &Function, llvm::Value *StatsEntry,
+                  bool IsExpanded) {
+    llvm::IRBuilder<> Builder(&*Function.getEntryBlock().getFirstInsertionPt());
+    llvm::Value *Start = createReadCounter(Builder);
+
+    llvm::Value *Elements = llvm::ConstantInt::get(Int64Ty, 0);
+    if (IsExpanded) {
+      // Expanded functions process cells [x1, x2).
+      llvm::Function::arg_iterator Args = Function.arg_begin();
+      ++Args;
+      llvm::Value *X1 = &*(Args++);
+      llvm::Value *X2 = &*(Args++);
+      Elements = Builder.CreateZExt(Builder.CreateSub(X2, X1), Int64Ty,
+                                    "elements");
+    }
+
+    llvm::SmallVector<llvm::ReturnInst *, 4> Returns;
+    for (llvm::BasicBlock &BB : Function) {
+      if (llvm::ReturnInst *Ret =
+              llvm::dyn_cast<llvm::ReturnInst>(BB.getTerminator())) {
+        Returns.push_back(Ret);
+      }
+    }
+
+    llvm::Value *One = llvm::ConstantInt::get(Int64Ty, 1);
+    for (llvm::ReturnInst *Ret : Returns) {
+      Builder.SetInsertPoint(Ret);
+      llvm::Value *Ticks = Builder.CreateSub(createReadCounter(Builder), Start);
+      llvm::Value *Fields[] = { One, Elements, Ticks };
+      for (unsigned i = 0; i < 3; ++i) {
+        llvm::Value *Field = Builder.CreateConstInBoundsGEP2_32(
+            StatsTy, StatsEntry, 0, i);
+        Builder.CreateAtomicRMW(llvm::AtomicRMWInst::Add, Field, Fields[i],
+                                llvm::AtomicOrdering::Monotonic);
+      }
+    }
+  }
+
+public:
+  RSKernelStatsPass()
+    : ModulePass(ID), Module(nullptr), Int64Ty(nullptr), StatsTy(nullptr) {
+  }
+
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
+    // This pass does not use any other analysis passes, but it does
+    // add new global variables and instructions.
+  }
+
+  bool runOnModule(llvm::Module &M) override {
+    Module = &M;
+    llvm::LLVMContext &Context = M.getContext();
+    Int64Ty = llvm::Type::getInt64Ty(Context);
+
+    bcinfo::MetadataExtractor me(&M);
+    if (!me.extract()) {
+      ALOGE("Could not extract metadata from module!");
+      return false;
+    }
+
+    // Collect the entry points, remembering which ones are expanded.  An
+    // accumulator can be shared between several reduce kernels.
+    std::vector<std::pair<llvm::Function *, bool>> Functions;
+    std::set<llvm::Function *> Seen;
+    auto AddFunction = [&](const std::string &Name, bool IsExpanded) {
+      llvm::Function *F = M.getFunction(Name);
+      if (F != nullptr && !F->isDeclaration() && Seen.insert(F).second) {
+        Functions.push_back(std::make_pair(F, IsExpanded));
+      }
+    };
+
+    const char **ForEachNameList = me.getExportForEachNameList();
+    for (size_t i = 0; i < me.getExportForEachSignatureCount(); ++i) {
+      AddFunction(std::string(ForEachNameList[i]) + ".expand", true);
+    }
+
+    const bcinfo::MetadataExtractor::Reduce *ReduceList =
+        me.getExportReduceList();
+    for (size_t i = 0; i < me.getExportReduceCount(); ++i) {
+      AddFunction(std::string(ReduceList[i].mAccumulatorName) + ".expand",
+                  true);
+    }
+
+    const char **FuncNameList = me.getExportFuncNameList();
+    for (size_t i = 0; i < me.getExportFuncCount(); ++i) {
+      AddFunction(FuncNameList[i], false);
+    }
+
+    const size_t NumEntries = Functions.size();
+    llvm::Type *Int32Ty = llvm::Type::getInt32Ty(Context);
+    llvm::Type *VoidPtrTy = llvm::Type::getInt8PtrTy(Context);
+    StatsTy = llvm::StructType::create(Context, {Int64Ty, Int64Ty, Int64Ty},
+                                       "RsKernelStats");
+    llvm::ArrayType *StatsArrayTy = llvm::ArrayType::get(StatsTy, NumEntries);
+    llvm::ArrayType *VoidPtrArrayTy = llvm::ArrayType::get(VoidPtrTy,
+                                                           NumEntries);
+
+    // 1) @.rs.kernel_stats_entries = constant i32 NumEntries
+    llvm::GlobalVariable *Entries = llvm::dyn_cast<llvm::GlobalVariable>(
+        M.getOrInsertGlobal(kRsKernelStatsEntries, Int32Ty));
+    Entries->setInitializer(llvm::ConstantInt::get(Int32Ty, NumEntries));
+    Entries->setConstant(true);
+
+    // 2) @.rs.kernel_stats_names = constant [N * i8*] [...]
+    std::vector<llvm::Constant *> Names;
+    for (size_t i = 0; i < NumEntries; ++i) {
+      llvm::Constant *C = llvm::ConstantDataArray::getString(
+          Context, Functions[i].first->getName());
+      llvm::GlobalVariable *NameStr = new llvm::GlobalVariable(
+          M, C->getType(), /* isConstant */true,
+          llvm::GlobalValue::PrivateLinkage, C,
+          ".rs.kernel_stats_name_str_" + std::to_string(i));
+      NameStr->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+      Names.push_back(llvm::ConstantExpr::getBitCast(NameStr, VoidPtrTy));
+    }
+    llvm::GlobalVariable *NamesGV = llvm::dyn_cast<llvm::GlobalVariable>(
+        M.getOrInsertGlobal(kRsKernelStatsNames, VoidPtrArrayTy));
+    NamesGV->setInitializer(llvm::ConstantArray::get(VoidPtrArrayTy, Names));
+    NamesGV->setConstant(true);
+
+    // 3) @.rs.kernel_stats = global [N * RsKernelStats] zeroinitializer
+    llvm::GlobalVariable *Stats = llvm::dyn_cast<llvm::GlobalVariable>(
+        M.getOrInsertGlobal(kRsKernelStats, StatsArrayTy));
+    Stats->setInitializer(llvm::ConstantAggregateZero::get(StatsArrayTy));
+
+    for (size_t i = 0; i < NumEntries; ++i) {
+      llvm::Constant *Indices[] = {
+        llvm::ConstantInt::get(Int32Ty, 0),
+        llvm::ConstantInt::get(Int32Ty, i)
+      };
+      llvm::Constant *StatsEntry = llvm::ConstantExpr::getInBoundsGetElementPtr(
+          StatsArrayTy, Stats, Indices);
+      instrument(*Functions[i].first, StatsEntry, Functions[i].second);
+    }
+
+    // Upon completion, this pass has always modified the Module.
+    return true;
+  }
+
+  virtual const char *getPassName() const override {
+    return "Instrument script entry points with runtime counters";
+  }
+};
+
+}  // end anonymous namespace
+
+char RSKernelStatsPass::ID = 0;
+
+static llvm::RegisterPass<RSKernelStatsPass> X("embed-rs-kernel-stats",
+  "Instrument RenderScript entry points with runtime counters");
+
+namespace bcc {
+
+llvm::ModulePass *createRSKernelStatsPass() {
+  return new RSKernelStatsPass();
+}
+
+}  // end namespace bcc
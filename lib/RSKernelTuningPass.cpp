@@ -0,0 +1,187 @@
+/*
+ * Copyright 2026, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Assert.h"
+#include "Log.h"
+#include "RSTransforms.h"
+
+#include "bcc/TuningDatabase.h"
+#include "bcinfo/MetadataExtractor.h"
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Analysis/CFG.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Metadata.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Pass.h>
+
+#include <string>
+
+namespace {
+
+/* RSKernelTuningPass: Applies per-kernel codegen parameters from a
+ * TuningDatabase to the loops of expanded kernels.
+ *
+ * The kernel is identified by the hash of its IR before expansion together
+ * with the target CPU. Parameters are attached as llvm.loop metadata on the
+ * back-edge of each loop in <NAME>.expand, where the unroller and the loop
+ * vectorizer pick them up during LTO.  Kernels missing from the database are
+ * recorded in it and compiled with the default heuristics.
+ *
+ * Must run after RSKernelExpandPass and before inlining.
+ */
+class RSKernelTuningPass : public llvm::ModulePass {
+private:
+  static char ID;
+
+  bcc::TuningDatabase *mDatabase;
+  std::string mCPU;
+
+  llvm::Metadata *getLoopHint(llvm::LLVMContext &Context, const char *Name,
+                              unsigned Value, unsigned Bits = 32) {
+    llvm::Metadata *Ops[] = {
+      llvm::MDString::get(Context, Name),
+      llvm::ConstantAsMetadata::get(
+          llvm::ConstantInt::get(llvm::Type::getIntNTy(Context, Bits), Value))
+    };
+    return llvm::MDNode::get(Context, Ops);
+  }
+
+  // Attach the loop hints for Params to every loop in Function.
+  bool applyParams(llvm::Function &Function,
+                   const bcc::KernelTuningParams &Params) {
+    llvm::LLVMContext &Context = Function.getContext();
+
+    // Operand 0 is reserved for the self-reference of the loop ID.
+    llvm::SmallVector<llvm::Metadata *, 4> Hints;
+    Hints.push_back(nullptr);
+    if (Params.mUnrollCount != 0) {
+      Hints.push_back(getLoopHint(Context, "llvm.loop.unroll.count",
+                                  Params.mUnrollCount));
+    }
+    if (Params.mVectorizeWidth != 0) {
+      // A width of 1 disables vectorization; anything wider has to be
+      // forced since the LTO pipeline doesn't vectorize loops by default.
+      Hints.push_back(getLoopHint(Context, "llvm.loop.vectorize.enable",
+                                  Params.mVectorizeWidth > 1, 1));
+      Hints.push_back(getLoopHint(Context, "llvm.loop.vectorize.width",
+                                  Params.mVectorizeWidth));
+    }
+    if (Params.mInterleaveCount != 0) {
+      Hints.push_back(getLoopHint(Context, "llvm.loop.interleave.count",
+                                  Params.mInterleaveCount));
+    }
+
+    llvm::SmallVector<std::pair<const llvm::BasicBlock *,
+                                const llvm::BasicBlock *>, 4> BackEdges;
+    llvm::FindFunctionBackedges(Function, BackEdges);
+
+    bool Changed = false;
+    for (auto &Edge : BackEdges) {
+      llvm::TerminatorInst *Latch =
+          const_cast<llvm::BasicBlock *>(Edge.first)->getTerminator();
+      // Keep the hints that RSKernelExpandPass put on the loop.
+      llvm::SmallVector<llvm::Metadata *, 4> LoopHints(Hints);
+      if (llvm::MDNode *OldID =
+              Latch->getMetadata(llvm::LLVMContext::MD_loop)) {
+        LoopHints.append(OldID->op_begin() + 1, OldID->op_end());
+      }
+      llvm::MDNode *LoopID = llvm::MDNode::getDistinct(Context, LoopHints);
+      LoopID->replaceOperandWith(0, LoopID);
+      Latch->setMetadata(llvm::LLVMContext::MD_loop, LoopID);
+      Changed = true;
+    }
+    return Changed;
+  }
+
+  bool tuneKernel(llvm::Module &Module, const char *Name) {
+    if (Name == nullptr) {
+      return false;
+    }
+
+    llvm::Function *Kernel = Module.getFunction(Name);
+    llvm::Function *Expanded = Module.getFunction(std::string(Name) + ".expand");
+    if (Kernel == nullptr || Expanded == nullptr || Kernel->isDeclaration()) {
+      return false;
+    }
+
+    const std::string Hash = bcc::TuningDatabase::hashKernel(*Kernel);
+    bcc::KernelTuningParams Params = mDatabase->lookup(mCPU, Hash, Name);
+    ALOGV("Kernel %s (%s on %s): unroll %u, vectorize width %u, interleave %u",
+          Name, Hash.c_str(), mCPU.c_str(), Params.mUnrollCount,
+          Params.mVectorizeWidth, Params.mInterleaveCount);
+    if (Params.isDefault()) {
+      return false;
+    }
+
+    return applyParams(*Expanded, Params);
+  }
+
+public:
+  RSKernelTuningPass(bcc::TuningDatabase *pDatabase, const std::string &pCPU)
+    : ModulePass(ID), mDatabase(pDatabase), mCPU(pCPU) {
+    bccAssert(mDatabase != nullptr);
+    if (mCPU.empty()) {
+      mCPU = "generic";
+    }
+  }
+
+  virtual void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
+  bool runOnModule(llvm::Module &Module) override {
+    bcinfo::MetadataExtractor me(&Module);
+    if (!me.extract()) {
+      ALOGE("Could not extract metadata from module!");
+      return false;
+    }
+
+    bool Changed = false;
+
+    const char **ForEachNameList = me.getExportForEachNameList();
+    for (size_t i = 0; i < me.getExportForEachSignatureCount(); ++i) {
+      Changed |= tuneKernel(Module, ForEachNameList[i]);
+    }
+
+    const bcinfo::MetadataExtractor::Reduce *ReduceList =
+        me.getExportReduceList();
+    for (size_t i = 0; i < me.getExportReduceCount(); ++i) {
+      Changed |= tuneKernel(Module, ReduceList[i].mAccumulatorName);
+    }
+
+    return Changed;
+  }
+
+  virtual const char *getPassName() const override {
+    return "Apply tuned codegen parameters to expanded kernels";
+  }
+};
+
+}  // end anonymous namespace
+
+char RSKernelTuningPass::ID = 0;
+
+namespace bcc {
+
+llvm::ModulePass *
+createRSKernelTuningPass(TuningDatabase *pDatabase, const std::string &pCPU) {
+  return new RSKernelTuningPass(pDatabase, pCPU);
+}
+
+}  // end namespace bcc
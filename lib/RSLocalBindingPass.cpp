@@ -0,0 +1,190 @@
+/*
+ * Copyright 2026, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Log.h"
+#include "RSTransforms.h"
+#include "RSUtils.h"
+
+#include <llvm/IR/CallSite.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Pass.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+const char kRsGlobalAddressOffsets[] = ".rs.global_address_offsets";
+
+/* RSLocalBindingPass: Reduces the dynamic symbols and relocations of the
+ * shared object that a script is linked into.
+ *
+ * - Definitions that the runtime doesn't look up (i.e. that are neither in
+ *   the export set nor one of the .rs.* symbols) get hidden visibility, so
+ *   they are left out of the dynamic symbol table.
+ * - Direct calls to exported functions from within the script are redirected
+ *   to a private alias, so they don't go through the PLT.
+ * - The offsets of exported variables in .rs.global_address_offsets are
+ *   redirected to a private alias as well, so that the linker can resolve
+ *   them.
+ *
+ * Runs last, after all the .rs.* symbols have been added and after all the
+ * optimizations, since GlobalOpt replaces the uses of private aliases with
+ * their aliasees.
+ */
+class RSLocalBindingPass : public llvm::ModulePass {
+private:
+  static char ID;
+
+  std::set<std::string> mExportedSymbols;
+
+  bool isExported(const llvm::GlobalValue &GV) const {
+    return GV.getName().startswith(".rs.") ||
+           mExportedSymbols.count(GV.getName()) > 0;
+  }
+
+  // Bind the direct calls to the exported function F within the module.
+  bool bindCallsLocally(llvm::Function &F) {
+    std::vector<llvm::CallSite> Calls;
+    for (llvm::User *U : F.users()) {
+      llvm::CallSite CS(U);
+      if (CS && CS.getCalledValue() == &F) {
+        Calls.push_back(CS);
+      }
+    }
+    if (Calls.empty()) {
+      return false;
+    }
+
+    llvm::GlobalValue *Local = getLocalBindingSymbol(F);
+    for (llvm::CallSite &CS : Calls) {
+      CS.setCalledFunction(Local);
+    }
+    return true;
+  }
+
+  // Rebuild C with the exported variables it refers to replaced by their
+  // local aliases.  Table itself is left alone.
+  llvm::Constant *bindConstantLocally(llvm::Constant *C,
+                                      llvm::GlobalVariable *Table) {
+    if (llvm::GlobalVariable *GV = llvm::dyn_cast<llvm::GlobalVariable>(C)) {
+      return GV == Table ? GV : getLocalBindingSymbol(*GV);
+    }
+    llvm::ConstantExpr *CE = llvm::dyn_cast<llvm::ConstantExpr>(C);
+    if (CE == nullptr) {
+      return C;
+    }
+    std::vector<llvm::Constant *> Operands;
+    for (llvm::Value *Operand : CE->operand_values()) {
+      Operands.push_back(
+          bindConstantLocally(llvm::cast<llvm::Constant>(Operand), Table));
+    }
+    return CE->getWithOperands(Operands);
+  }
+
+  // Bind the entries of .rs.global_address_offsets (see RSGlobalInfoPass).
+  bool bindGlobalAddressOffsetsLocally(llvm::Module &M) {
+    llvm::GlobalVariable *Table = M.getNamedGlobal(kRsGlobalAddressOffsets);
+    if (Table == nullptr || !Table->hasInitializer()) {
+      return false;
+    }
+    llvm::ConstantArray *Offsets =
+        llvm::dyn_cast<llvm::ConstantArray>(Table->getInitializer());
+    if (Offsets == nullptr) {
+      // An empty table is a ConstantAggregateZero.
+      return false;
+    }
+
+    std::vector<llvm::Constant *> Entries;
+    for (llvm::Value *Offset : Offsets->operand_values()) {
+      Entries.push_back(
+          bindConstantLocally(llvm::cast<llvm::Constant>(Offset), Table));
+    }
+    llvm::Constant *Init = llvm::ConstantArray::get(Offsets->getType(),
+                                                    Entries);
+    if (Init == Offsets) {
+      return false;
+    }
+    Table->setInitializer(Init);
+    return true;
+  }
+
+public:
+  explicit RSLocalBindingPass(const std::set<std::string> &pExportedSymbols)
+    : ModulePass(ID), mExportedSymbols(pExportedSymbols) {
+  }
+
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
+  bool runOnModule(llvm::Module &M) override {
+    bool Changed = false;
+
+    std::vector<llvm::Function *> ExportedFunctions;
+    for (llvm::Function &F : M) {
+      if (F.isDeclaration() || F.hasLocalLinkage() ||
+          !F.hasDefaultVisibility()) {
+        continue;
+      }
+      if (isExported(F)) {
+        ExportedFunctions.push_back(&F);
+      } else {
+        F.setVisibility(llvm::GlobalValue::HiddenVisibility);
+        Changed = true;
+      }
+    }
+
+    for (llvm::GlobalVariable &GV : M.globals()) {
+      if (GV.isDeclaration() || GV.hasLocalLinkage() ||
+          !GV.hasDefaultVisibility() || GV.getName().startswith("llvm.") ||
+          isExported(GV)) {
+        continue;
+      }
+      GV.setVisibility(llvm::GlobalValue::HiddenVisibility);
+      Changed = true;
+    }
+
+    for (llvm::Function *F : ExportedFunctions) {
+      Changed |= bindCallsLocally(*F);
+    }
+
+    Changed |= bindGlobalAddressOffsetsLocally(M);
+
+    return Changed;
+  }
+
+  virtual const char *getPassName() const override {
+    return "Bind non-exported symbols and internal calls locally";
+  }
+};
+
+}  // end anonymous namespace
+
+char RSLocalBindingPass::ID = 0;
+
+namespace bcc {
+
+llvm::ModulePass *
+createRSLocalBindingPass(const std::set<std::string> &pExportedSymbols) {
+  return new RSLocalBindingPass(pExportedSymbols);
+}
+
+}  // end namespace bcc
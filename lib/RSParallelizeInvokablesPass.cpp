@@ -0,0 +1,756 @@
+/*
+ * Copyright 2026, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Log.h"
+#include "RSTransforms.h"
+
+#include "bcinfo/MetadataExtractor.h"
+
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Analysis/AssumptionCache.h>
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/Analysis/ScalarEvolution.h>
+#include <llvm/Analysis/ScalarEvolutionExpander.h>
+#include <llvm/Analysis/ScalarEvolutionExpressions.h>
+#include <llvm/Analysis/TargetLibraryInfo.h>
+#include <llvm/Analysis/ValueTracking.h>
+#include <llvm/IR/CallSite.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DataLayout.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Pass.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/Local.h>
+#include <llvm/Transforms/Utils/ValueMapper.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Loops running fewer iterations than this stay on the calling thread, where
+// they are cheaper than the launch.
+const unsigned kMinParallelTripCount = 1024;
+
+// Layout of rs_script_call_t: the strategy, then the start and end of each of
+// the x, y, z and four array dimensions.
+const unsigned kScriptCallFields = 15;
+const unsigned kScriptCallXStart = 1;
+const unsigned kScriptCallXEnd = 2;
+
+// RS_FOR_EACH_STRATEGY_DONT_CARE
+const unsigned kForEachStrategyDontCare = 1;
+
+const char kForEachInternalName[] =
+    "_Z17rsForEachInternaliP14rs_script_calliiP13rs_allocation";
+
+bool isLifetimeOrDebug(const llvm::Instruction *I) {
+  if (llvm::isa<llvm::DbgInfoIntrinsic>(I)) {
+    return true;
+  }
+  const llvm::IntrinsicInst *II = llvm::dyn_cast<llvm::IntrinsicInst>(I);
+  return II != nullptr &&
+         (II->getIntrinsicID() == llvm::Intrinsic::lifetime_start ||
+          II->getIntrinsicID() == llvm::Intrinsic::lifetime_end);
+}
+
+/* RSParallelizeInvokablesPass: Turns the data-parallel loops of invokables
+ * into launches of synthesized kernels, so that scripts that process their
+ * allocations in a plain loop instead of a kernel still run on all cores.
+ *
+ * A loop of an exported invokable is parallelized when:
+ * - it has a preheader, a single latch that is also its only exiting block,
+ *   and a computable trip count;
+ * - its only header phi is an i32 induction variable stepping by one;
+ * - it only accesses allocations through 1D rsGetElementAt_*() and
+ *   rsSetElementAt_*() calls at the induction variable, so that iterations
+ *   only share the cells they own;
+ * - it doesn't write memory other than stack temporaries that are written
+ *   whole in every iteration before they are read, and only calls functions
+ *   that don't write memory;
+ * - nothing it computes is used after it.
+ *
+ * The body of such a loop becomes a kernel of x alone, which is appended to
+ * the forEach exports of the Module and expanded like the others.  The
+ * values the body takes from the invokable are passed through internal
+ * globals; invokables don't run concurrently, and the launch is synchronous.
+ * The preheader then launches the kernel over the range of the induction
+ * variable through rsForEachInternal() when the trip count is large enough,
+ * and falls back to the original loop otherwise.
+ *
+ * Must run before RSKernelExpandPass and before the runtime is linked, so
+ * that the synthesized kernels are expanded and exported like the others.
+ */
+class RSParallelizeInvokablesPass : public llvm::ModulePass {
+private:
+  static char ID;
+
+  struct Candidate {
+    llvm::Loop *Loop;
+    llvm::PHINode *IV;
+    const llvm::SCEV *Start;
+    const llvm::SCEV *TripCount;
+    // Temporaries that are private to an iteration of Loop.
+    std::set<llvm::AllocaInst *> LocalAllocas;
+    // The range of the induction variable, computed in the preheader.
+    llvm::Value *StartValue;
+    llvm::Value *EndValue;
+    llvm::Value *TripCountValue;
+  };
+
+  const llvm::DataLayout *DL;
+  llvm::TargetLibraryInfo *TLI;
+
+  // Returns whether the write of Size bytes to Addr covers the whole of
+  // Alloca.
+  bool isWholeWrite(llvm::Value *Addr, uint64_t Size,
+                    llvm::AllocaInst *Alloca) {
+    int64_t Offset = 0;
+    return llvm::GetPointerBaseWithConstantOffset(Addr, Offset, *DL) ==
+               Alloca && Offset == 0 &&
+           Size >= DL->getTypeAllocSize(Alloca->getAllocatedType());
+  }
+
+  // Returns whether Ptr points into a temporary that is only used in C.Loop,
+  // and that every iteration writes whole (or starts the lifetime of) before
+  // reading it, so that no value flows through it from one iteration to the
+  // next.
+  bool isIterationLocal(llvm::Value *Ptr, Candidate &C,
+                        llvm::DominatorTree &DT) {
+    llvm::AllocaInst *Alloca = llvm::dyn_cast<llvm::AllocaInst>(
+        llvm::GetUnderlyingObject(Ptr, *DL));
+    if (Alloca == nullptr || !Alloca->isStaticAlloca() ||
+        Alloca->isArrayAllocation()) {
+      return false;
+    }
+    if (C.LocalAllocas.count(Alloca)) {
+      return true;
+    }
+
+    std::vector<llvm::Instruction *> Kills;
+    std::vector<llvm::Instruction *> Reads;
+    llvm::SmallVector<llvm::Value *, 8> Worklist;
+    Worklist.push_back(Alloca);
+    while (!Worklist.empty()) {
+      llvm::Value *Addr = Worklist.pop_back_val();
+      for (llvm::User *U : Addr->users()) {
+        if (llvm::isa<llvm::BitCastInst>(U) ||
+            llvm::isa<llvm::GetElementPtrInst>(U)) {
+          Worklist.push_back(U);
+          continue;
+        }
+        llvm::Instruction *I = llvm::cast<llvm::Instruction>(U);
+        if (isLifetimeOrDebug(I)) {
+          llvm::IntrinsicInst *II = llvm::dyn_cast<llvm::IntrinsicInst>(I);
+          if (II != nullptr && C.Loop->contains(I) &&
+              II->getIntrinsicID() == llvm::Intrinsic::lifetime_start) {
+            Kills.push_back(I);
+          }
+          continue;
+        }
+        if (!C.Loop->contains(I)) {
+          return false;
+        }
+
+        if (llvm::StoreInst *Store = llvm::dyn_cast<llvm::StoreInst>(I)) {
+          if (Store->getValueOperand() == Addr) {
+            return false;
+          }
+          if (isWholeWrite(Addr, DL->getTypeStoreSize(
+                  Store->getValueOperand()->getType()), Alloca)) {
+            Kills.push_back(I);
+          }
+        } else if (llvm::isa<llvm::LoadInst>(I)) {
+          Reads.push_back(I);
+        } else if (llvm::MemIntrinsic *MI =
+                       llvm::dyn_cast<llvm::MemIntrinsic>(I)) {
+          llvm::ConstantInt *Length =
+              llvm::dyn_cast<llvm::ConstantInt>(MI->getLength());
+          if (MI->getRawDest() == Addr && Length != nullptr &&
+              isWholeWrite(Addr, Length->getZExtValue(), Alloca)) {
+            Kills.push_back(I);
+          }
+          llvm::MemTransferInst *MT = llvm::dyn_cast<llvm::MemTransferInst>(I);
+          if (MT != nullptr && MT->getRawSource() == Addr) {
+            Reads.push_back(I);
+          }
+        } else if (llvm::CallSite CS = llvm::CallSite(I)) {
+          // Calls only get to write their sret temporary; the others are
+          // checked not to write memory.
+          for (unsigned i = 0; i < CS.arg_size(); ++i) {
+            if (CS.getArgument(i) != Addr) {
+              continue;
+            }
+            if (CS.paramHasAttr(i + 1, llvm::Attribute::StructRet)) {
+              Kills.push_back(I);
+            } else {
+              Reads.push_back(I);
+            }
+          }
+        } else {
+          return false;
+        }
+      }
+    }
+
+    for (llvm::Instruction *Read : Reads) {
+      bool Killed = false;
+      for (llvm::Instruction *Kill : Kills) {
+        if (Kill != Read && DT.dominates(Kill, Read)) {
+          Killed = true;
+          break;
+        }
+      }
+      if (!Killed) {
+        return false;
+      }
+    }
+
+    C.LocalAllocas.insert(Alloca);
+    return true;
+  }
+
+  // Returns whether CS is a 1D rsGetElementAt_*() or rsSetElementAt_*() at
+  // the induction variable of C.
+  bool isElementAccess(llvm::CallSite CS, Candidate &C,
+                       llvm::DominatorTree &DT) {
+    llvm::Function *Callee = CS.getCalledFunction();
+    if (Callee == nullptr) {
+      return false;
+    }
+    llvm::StringRef Name = Callee->getName();
+    const bool IsGet = Name.find("rsGetElementAt_") != llvm::StringRef::npos;
+    const bool IsSet = Name.find("rsSetElementAt_") != llvm::StringRef::npos;
+    if (!IsGet && !IsSet) {
+      return false;
+    }
+
+    // Large elements are returned through a temporary.
+    unsigned First = 0;
+    if (CS.hasStructRetAttr()) {
+      if (!IsGet || !isIterationLocal(CS.getArgument(0), C, DT)) {
+        return false;
+      }
+      First = 1;
+    }
+
+    // The allocation, the value for a store, and the one coordinate.
+    const unsigned NumArgs = CS.arg_size();
+    if (NumArgs - First != (IsGet ? 2u : 3u)) {
+      return false;
+    }
+    return CS.getArgument(NumArgs - 1) == C.IV;
+  }
+
+  // Returns whether I can run in any order with respect to the other
+  // iterations of C.
+  bool isParallelSafe(llvm::Instruction &I, Candidate &C,
+                      llvm::DominatorTree &DT) {
+    if (isLifetimeOrDebug(&I)) {
+      return true;
+    }
+    if (llvm::LoadInst *Load = llvm::dyn_cast<llvm::LoadInst>(&I)) {
+      return Load->isSimple();
+    }
+    if (llvm::StoreInst *Store = llvm::dyn_cast<llvm::StoreInst>(&I)) {
+      return Store->isSimple() &&
+             isIterationLocal(Store->getPointerOperand(), C, DT);
+    }
+    if (llvm::MemIntrinsic *MI = llvm::dyn_cast<llvm::MemIntrinsic>(&I)) {
+      return !MI->isVolatile() && isIterationLocal(MI->getRawDest(), C, DT);
+    }
+    llvm::CallSite CS(&I);
+    if (CS) {
+      return isElementAccess(CS, C, DT) || CS.onlyReadsMemory();
+    }
+    return !I.mayWriteToMemory();
+  }
+
+  bool analyzeLoop(llvm::Loop *L, llvm::ScalarEvolution &SE,
+                   llvm::DominatorTree &DT, Candidate &C) {
+    llvm::BasicBlock *Header = L->getHeader();
+    llvm::BasicBlock *Latch = L->getLoopLatch();
+    if (L->getLoopPreheader() == nullptr || Latch == nullptr ||
+        L->getExitingBlock() != Latch || L->getExitBlock() == nullptr) {
+      return false;
+    }
+
+    // Any other header phi carries a value from one iteration to the next.
+    llvm::PHINode *IV = nullptr;
+    for (llvm::Instruction &I : *Header) {
+      llvm::PHINode *Phi = llvm::dyn_cast<llvm::PHINode>(&I);
+      if (Phi == nullptr) {
+        break;
+      }
+      if (IV != nullptr) {
+        return false;
+      }
+      IV = Phi;
+    }
+    if (IV == nullptr || !IV->getType()->isIntegerTy(32)) {
+      return false;
+    }
+
+    const llvm::SCEVAddRecExpr *AddRec =
+        llvm::dyn_cast<llvm::SCEVAddRecExpr>(SE.getSCEV(IV));
+    if (AddRec == nullptr || AddRec->getLoop() != L || !AddRec->isAffine() ||
+        !AddRec->getStepRecurrence(SE)->isOne()) {
+      return false;
+    }
+    const llvm::SCEV *BackedgeTakenCount = SE.getBackedgeTakenCount(L);
+    if (llvm::isa<llvm::SCEVCouldNotCompute>(BackedgeTakenCount) ||
+        BackedgeTakenCount->getType() != IV->getType() ||
+        !llvm::isSafeToExpand(BackedgeTakenCount, SE) ||
+        !llvm::isSafeToExpand(AddRec->getStart(), SE)) {
+      return false;
+    }
+    const llvm::SCEV *TripCount = SE.getAddExpr(
+        BackedgeTakenCount, SE.getConstant(IV->getType(), 1));
+    if (const llvm::SCEVConstant *Constant =
+            llvm::dyn_cast<llvm::SCEVConstant>(TripCount)) {
+      // A trip count of 0 means 2^32 iterations, which a launch can't cover.
+      if (Constant->getValue()->getZExtValue() < kMinParallelTripCount) {
+        return false;
+      }
+    }
+
+    C.Loop = L;
+    C.IV = IV;
+    C.Start = AddRec->getStart();
+    C.TripCount = TripCount;
+    C.LocalAllocas.clear();
+
+    for (llvm::BasicBlock *BB : L->blocks()) {
+      for (llvm::Instruction &I : *BB) {
+        for (llvm::User *U : I.users()) {
+          if (!L->contains(llvm::cast<llvm::Instruction>(U))) {
+            return false;
+          }
+        }
+        if (!llvm::isa<llvm::PHINode>(I) && !isParallelSafe(I, C, DT)) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  // Returns the value the kernel uses in place of V from the invokable, or
+  // nullptr if V can't be passed to it.  Temporaries of an iteration get a
+  // copy of their own; anything else is passed through a global that
+  // Spills records.
+  llvm::Value *
+  materialize(llvm::Value *V, const Candidate &C, llvm::IRBuilder<> &Builder,
+              std::map<llvm::Value *, llvm::Value *> &LiveIns,
+              std::vector<std::pair<llvm::Value *, llvm::GlobalVariable *>>
+                  &Spills) {
+    llvm::Value *&Local = LiveIns[V];
+    if (Local != nullptr) {
+      return Local;
+    }
+
+    llvm::Instruction *I = llvm::dyn_cast<llvm::Instruction>(V);
+    llvm::AllocaInst *Alloca = llvm::dyn_cast<llvm::AllocaInst>(
+        V->getType()->isPointerTy() ? llvm::GetUnderlyingObject(V, *DL)
+                                    : nullptr);
+    if (I != nullptr && Alloca != nullptr && C.LocalAllocas.count(Alloca) &&
+        (I == Alloca || llvm::isa<llvm::CastInst>(I) ||
+         llvm::isa<llvm::GetElementPtrInst>(I))) {
+      llvm::Instruction *Copy = I->clone();
+      for (llvm::Use &Op : Copy->operands()) {
+        if (llvm::isa<llvm::Instruction>(Op.get()) ||
+            llvm::isa<llvm::Argument>(Op.get())) {
+          llvm::Value *OpLocal =
+              materialize(Op.get(), C, Builder, LiveIns, Spills);
+          if (OpLocal == nullptr) {
+            delete Copy;
+            return nullptr;
+          }
+          Op.set(OpLocal);
+        }
+      }
+      Local = Builder.Insert(Copy, V->getName());
+      return Local;
+    }
+
+    if (!V->getType()->isSized()) {
+      return nullptr;
+    }
+    llvm::Function *Kernel = Builder.GetInsertBlock()->getParent();
+    llvm::GlobalVariable *GV = new llvm::GlobalVariable(
+        *Kernel->getParent(), V->getType(), false,
+        llvm::GlobalValue::InternalLinkage,
+        llvm::Constant::getNullValue(V->getType()),
+        Kernel->getName() + "." + (V->hasName() ? V->getName() : "in"));
+    Spills.push_back(std::make_pair(V, GV));
+    Local = Builder.CreateLoad(GV, V->getName());
+    return Local;
+  }
+
+  // Clone the body of C.Loop into a kernel of x called Name.  Returns nullptr
+  // if the body takes a value from the invokable that can't be passed to it.
+  llvm::Function *
+  outlineLoop(const Candidate &C, const std::string &Name,
+              std::vector<std::pair<llvm::Value *, llvm::GlobalVariable *>>
+                  &Spills) {
+    llvm::Function *F = C.Loop->getHeader()->getParent();
+    llvm::Module *M = F->getParent();
+    llvm::LLVMContext &Ctx = M->getContext();
+
+    llvm::FunctionType *KernelTy = llvm::FunctionType::get(
+        llvm::Type::getVoidTy(Ctx), {C.IV->getType()}, false);
+    llvm::Function *Kernel = llvm::Function::Create(
+        KernelTy, llvm::GlobalValue::ExternalLinkage, Name, M);
+    Kernel->setAttributes(llvm::AttributeSet().addAttributes(
+        Ctx, llvm::AttributeSet::FunctionIndex,
+        F->getAttributes().getFnAttributes()));
+    llvm::Argument *X = &*Kernel->arg_begin();
+    X->setName("x");
+
+    llvm::BasicBlock *Entry = llvm::BasicBlock::Create(Ctx, "entry", Kernel);
+    llvm::ValueToValueMapTy VMap;
+    std::vector<llvm::BasicBlock *> Blocks;
+    for (llvm::BasicBlock *BB : C.Loop->blocks()) {
+      llvm::BasicBlock *Clone = llvm::CloneBasicBlock(BB, VMap, "", Kernel);
+      VMap[BB] = Clone;
+      Blocks.push_back(Clone);
+    }
+    llvm::BasicBlock *Return = llvm::BasicBlock::Create(Ctx, "return", Kernel);
+    llvm::ReturnInst::Create(Ctx, Return);
+    VMap[C.Loop->getExitBlock()] = Return;
+
+    llvm::PHINode *IVClone = llvm::cast<llvm::PHINode>(VMap[C.IV]);
+    IVClone->eraseFromParent();
+    VMap[C.IV] = X;
+    for (llvm::BasicBlock *BB : Blocks) {
+      for (llvm::Instruction &I : *BB) {
+        llvm::RemapInstruction(&I, VMap,
+                               llvm::RF_NoModuleLevelChanges |
+                               llvm::RF_IgnoreMissingLocals);
+      }
+    }
+
+    // The back edge ends the iteration, which leaves the exit test dead.
+    llvm::BasicBlock *Header =
+        llvm::cast<llvm::BasicBlock>(VMap[C.Loop->getHeader()]);
+    llvm::BasicBlock *Latch =
+        llvm::cast<llvm::BasicBlock>(VMap[C.Loop->getLoopLatch()]);
+    llvm::BranchInst::Create(Header, Entry);
+    llvm::TerminatorInst *LatchTerm = Latch->getTerminator();
+    for (unsigned i = 0; i < LatchTerm->getNumSuccessors(); ++i) {
+      if (LatchTerm->getSuccessor(i) == Header) {
+        LatchTerm->setSuccessor(i, Return);
+      }
+    }
+    llvm::BranchInst *LatchBr = llvm::dyn_cast<llvm::BranchInst>(LatchTerm);
+    if (LatchBr != nullptr && LatchBr->isConditional() &&
+        LatchBr->getSuccessor(0) == LatchBr->getSuccessor(1)) {
+      llvm::Value *Cond = LatchBr->getCondition();
+      llvm::BranchInst::Create(Return, Latch);
+      LatchBr->eraseFromParent();
+      llvm::RecursivelyDeleteTriviallyDeadInstructions(Cond);
+    }
+
+    // The debug info of the invokable doesn't describe the kernel.
+    for (llvm::BasicBlock *BB : Blocks) {
+      for (auto It = BB->begin(); It != BB->end();) {
+        llvm::Instruction &I = *It++;
+        if (llvm::isa<llvm::DbgInfoIntrinsic>(I)) {
+          I.eraseFromParent();
+        } else {
+          I.setDebugLoc(llvm::DebugLoc());
+        }
+      }
+    }
+
+    // Collect the values the body still takes from the invokable.
+    std::vector<llvm::Use *> Uses;
+    for (llvm::BasicBlock *BB : Blocks) {
+      for (llvm::Instruction &I : *BB) {
+        for (llvm::Use &U : I.operands()) {
+          llvm::Instruction *Def = llvm::dyn_cast<llvm::Instruction>(U.get());
+          llvm::Argument *Arg = llvm::dyn_cast<llvm::Argument>(U.get());
+          if ((Def != nullptr && Def->getFunction() == F) ||
+              (Arg != nullptr && Arg->getParent() == F)) {
+            Uses.push_back(&U);
+          }
+        }
+      }
+    }
+
+    llvm::IRBuilder<> Builder(Entry->getTerminator());
+    std::map<llvm::Value *, llvm::Value *> LiveIns;
+    for (llvm::Use *U : Uses) {
+      llvm::Value *Local = materialize(U->get(), C, Builder, LiveIns, Spills);
+      if (Local == nullptr) {
+        Kernel->eraseFromParent();
+        for (auto &Spill : Spills) {
+          Spill.second->eraseFromParent();
+        }
+        Spills.clear();
+        return nullptr;
+      }
+      U->set(Local);
+    }
+
+    return Kernel;
+  }
+
+  llvm::Function *getForEachInternal(llvm::Module &M) {
+    llvm::Function *ForEach = M.getFunction(kForEachInternalName);
+    if (ForEach != nullptr) {
+      return ForEach;
+    }
+
+    llvm::LLVMContext &Ctx = M.getContext();
+    llvm::StructType *ScriptCallTy = M.getTypeByName("struct.rs_script_call");
+    if (ScriptCallTy == nullptr) {
+      ScriptCallTy = llvm::StructType::create(Ctx, "struct.rs_script_call");
+    }
+    llvm::StructType *AllocationTy = M.getTypeByName("struct.rs_allocation");
+    if (AllocationTy == nullptr) {
+      AllocationTy = llvm::StructType::create(Ctx, "struct.rs_allocation");
+    }
+    llvm::Type *Int32Ty = llvm::Type::getInt32Ty(Ctx);
+    llvm::FunctionType *ForEachTy = llvm::FunctionType::get(
+        llvm::Type::getVoidTy(Ctx),
+        {Int32Ty, ScriptCallTy->getPointerTo(), Int32Ty, Int32Ty,
+         AllocationTy->getPointerTo()},
+        false);
+    return llvm::Function::Create(ForEachTy, llvm::GlobalValue::ExternalLinkage,
+                                  kForEachInternalName, &M);
+  }
+
+  // Launch the kernel at Slot over the range of the induction variable of C
+  // from its preheader, unless the loop is too short to be worth it.
+  void rewriteLoop(const Candidate &C, int Slot,
+                   const std::vector<std::pair<llvm::Value *,
+                                               llvm::GlobalVariable *>>
+                       &Spills) {
+    llvm::BasicBlock *Header = C.Loop->getHeader();
+    llvm::BasicBlock *Preheader = C.Loop->getLoopPreheader();
+    llvm::BasicBlock *Latch = C.Loop->getLoopLatch();
+    llvm::BasicBlock *Exit = C.Loop->getExitBlock();
+    llvm::Function *F = Header->getParent();
+    llvm::LLVMContext &Ctx = F->getContext();
+    llvm::Type *Int32Ty = llvm::Type::getInt32Ty(Ctx);
+
+    llvm::IRBuilder<> Builder(&*F->getEntryBlock().getFirstInsertionPt());
+    llvm::ArrayType *OptionsTy =
+        llvm::ArrayType::get(Int32Ty, kScriptCallFields);
+    llvm::AllocaInst *Options =
+        Builder.CreateAlloca(OptionsTy, nullptr, "par.options");
+
+    llvm::BasicBlock *Launch =
+        llvm::BasicBlock::Create(Ctx, "par.launch", F, Header);
+    llvm::TerminatorInst *PreheaderTerm = Preheader->getTerminator();
+    Builder.SetInsertPoint(PreheaderTerm);
+    // The end is checked as well, since the range of a launch can't wrap.
+    llvm::Value *MinTripCount = llvm::ConstantInt::get(
+        C.TripCountValue->getType(), kMinParallelTripCount);
+    llvm::Value *Profitable = Builder.CreateAnd(
+        Builder.CreateICmpUGE(C.TripCountValue, MinTripCount),
+        Builder.CreateICmpUGT(C.EndValue, C.StartValue), "par.profitable");
+    Builder.CreateCondBr(Profitable, Launch, Header);
+    PreheaderTerm->eraseFromParent();
+
+    Builder.SetInsertPoint(Launch);
+    for (auto &Spill : Spills) {
+      Builder.CreateStore(Spill.first, Spill.second);
+    }
+    for (unsigned i = 0; i < kScriptCallFields; ++i) {
+      llvm::Value *Field = llvm::ConstantInt::get(Int32Ty, 0);
+      if (i == 0) {
+        Field = llvm::ConstantInt::get(Int32Ty, kForEachStrategyDontCare);
+      } else if (i == kScriptCallXStart) {
+        Field = C.StartValue;
+      } else if (i == kScriptCallXEnd) {
+        Field = C.EndValue;
+      }
+      Builder.CreateStore(Field, Builder.CreateConstInBoundsGEP2_32(
+                                     OptionsTy, Options, 0, i));
+    }
+
+    // A kernel without allocations takes its range from the options.
+    llvm::Function *ForEach = getForEachInternal(*F->getParent());
+    llvm::FunctionType *ForEachTy = ForEach->getFunctionType();
+    Builder.CreateCall(ForEach, {
+        llvm::ConstantInt::get(ForEachTy->getParamType(0), Slot),
+        Builder.CreateBitCast(Options, ForEachTy->getParamType(1)),
+        llvm::ConstantInt::get(ForEachTy->getParamType(2), 0),
+        llvm::ConstantInt::get(ForEachTy->getParamType(3), 0),
+        llvm::ConstantPointerNull::get(
+            llvm::cast<llvm::PointerType>(ForEachTy->getParamType(4)))});
+    Builder.CreateBr(Exit);
+
+    for (llvm::Instruction &I : *Exit) {
+      llvm::PHINode *Phi = llvm::dyn_cast<llvm::PHINode>(&I);
+      if (Phi == nullptr) {
+        break;
+      }
+      Phi->addIncoming(Phi->getIncomingValueForBlock(Latch), Launch);
+    }
+  }
+
+  void addForEachExport(llvm::Module &M, const std::string &Name,
+                        uint32_t Signature) {
+    llvm::LLVMContext &Ctx = M.getContext();
+    M.getOrInsertNamedMetadata("#rs_export_foreach_name")->addOperand(
+        llvm::MDNode::get(Ctx, llvm::MDString::get(Ctx, Name)));
+    M.getOrInsertNamedMetadata("#rs_export_foreach")->addOperand(
+        llvm::MDNode::get(Ctx, llvm::MDString::get(Ctx,
+                                                   llvm::utostr(Signature))));
+  }
+
+  bool parallelizeFunction(llvm::Function &F, int &NextSlot) {
+    llvm::DominatorTree DT(F);
+    llvm::LoopInfo LI(DT);
+    llvm::AssumptionCache AC(F);
+    llvm::ScalarEvolution SE(F, *TLI, AC, DT, LI);
+
+    // Outer loops are tried first; the loops in a candidate go with it.
+    std::vector<Candidate> Candidates;
+    std::vector<llvm::Loop *> Worklist(LI.begin(), LI.end());
+    while (!Worklist.empty()) {
+      llvm::Loop *L = Worklist.back();
+      Worklist.pop_back();
+      Candidate C;
+      if (analyzeLoop(L, SE, DT, C)) {
+        Candidates.push_back(C);
+      } else {
+        Worklist.insert(Worklist.end(), L->begin(), L->end());
+      }
+    }
+    if (Candidates.empty()) {
+      return false;
+    }
+
+    // Compute the ranges before any loop is rewritten, while the analyses
+    // still hold.
+    llvm::SCEVExpander Expander(SE, *DL, "par");
+    for (Candidate &C : Candidates) {
+      llvm::Instruction *InsertPt =
+          C.Loop->getLoopPreheader()->getTerminator();
+      llvm::Type *Ty = C.IV->getType();
+      C.StartValue = Expander.expandCodeFor(C.Start, Ty, InsertPt);
+      C.TripCountValue = Expander.expandCodeFor(C.TripCount, Ty, InsertPt);
+      C.EndValue = Expander.expandCodeFor(
+          SE.getAddExpr(C.Start, C.TripCount), Ty, InsertPt);
+    }
+
+    bool Changed = false;
+    unsigned Index = 0;
+    for (const Candidate &C : Candidates) {
+      std::string Name = F.getName().str() + ".loop";
+      if (Index++ != 0) {
+        Name += "." + std::to_string(Index - 1);
+      }
+      const std::string BaseName = Name;
+      for (int i = 1; F.getParent()->getFunction(Name) != nullptr; ++i) {
+        Name = BaseName + "." + std::to_string(i);
+      }
+
+      std::vector<std::pair<llvm::Value *, llvm::GlobalVariable *>> Spills;
+      if (outlineLoop(C, Name, Spills) == nullptr) {
+        continue;
+      }
+      ALOGV("Parallelized a loop of %s into kernel %s",
+            F.getName().str().c_str(), Name.c_str());
+      addForEachExport(*F.getParent(), Name,
+                       bcinfo::MD_SIG_Kernel | bcinfo::MD_SIG_X);
+      rewriteLoop(C, NextSlot++, Spills);
+      Changed = true;
+    }
+    return Changed;
+  }
+
+public:
+  RSParallelizeInvokablesPass()
+    : ModulePass(ID), DL(nullptr), TLI(nullptr) {
+  }
+
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
+    AU.addRequired<llvm::TargetLibraryInfoWrapperPass>();
+  }
+
+  bool runOnModule(llvm::Module &M) override {
+    bcinfo::MetadataExtractor me(&M);
+    if (!me.extract()) {
+      ALOGE("Could not extract metadata from module!");
+      return false;
+    }
+
+    // The kernels are appended to the named forEach exports, which older
+    // bitcode doesn't have.
+    llvm::NamedMDNode *ExportForEachNameMD =
+        M.getNamedMetadata("#rs_export_foreach_name");
+    if (ExportForEachNameMD == nullptr ||
+        ExportForEachNameMD->getNumOperands() !=
+            me.getExportForEachSignatureCount()) {
+      return false;
+    }
+
+    llvm::Function *ForEach = M.getFunction(kForEachInternalName);
+    if (ForEach != nullptr &&
+        ForEach->getFunctionType()->getNumParams() != 5) {
+      return false;
+    }
+
+    DL = &M.getDataLayout();
+    TLI = &getAnalysis<llvm::TargetLibraryInfoWrapperPass>().getTLI();
+
+    // Invokables called from other functions might be running in a kernel
+    // already, where they can't launch one.
+    bool Changed = false;
+    int NextSlot = me.getExportForEachSignatureCount();
+    const char **FuncNameList = me.getExportFuncNameList();
+    for (size_t i = 0; i < me.getExportFuncCount(); ++i) {
+      llvm::Function *F = M.getFunction(FuncNameList[i]);
+      if (F != nullptr && !F->isDeclaration() && F->use_empty()) {
+        Changed |= parallelizeFunction(*F, NextSlot);
+      }
+    }
+    return Changed;
+  }
+
+  virtual const char *getPassName() const override {
+    return "Parallelize the loops of invokables";
+  }
+};
+
+}  // end anonymous namespace
+
+char RSParallelizeInvokablesPass::ID = 0;
+
+static llvm::RegisterPass<RSParallelizeInvokablesPass>
+X("rs-parallelize-invokables",
+  "Turn data-parallel loops of RenderScript invokables into kernel launches");
+
+namespace bcc {
+
+llvm::ModulePass *createRSParallelizeInvokablesPass() {
+  return new RSParallelizeInvokablesPass();
+}
+
+}  // end namespace bcc
@@ -36,6 +36,14 @@ namespace bcc {
 
 namespace {
 
+// A kernel to fuse: the forEach slot in the metadata of the module that
+// defines it.  The name of the module is only used in diagnostics.
+struct KernelSlot {
+  const bcinfo::MetadataExtractor* metadata;
+  const char* moduleName;
+  int slot;
+};
+
 const Function* getInvokeFunction(const Source& source, const int slot,
                                   Module* newModule) {
 
@@ -49,20 +57,21 @@ const Function* getInvokeFunction(const Source& source, const int slot,
 }
 
 const Function*
-getFunction(Module* mergedModule, const Source* source, const int slot,
+getFunction(Module* mergedModule, const KernelSlot& kernel,
             uint32_t* signature) {
 
-  bcinfo::MetadataExtractor &metadata = *source->getMetadata();
+  const bcinfo::MetadataExtractor &metadata = *kernel.metadata;
+  const int slot = kernel.slot;
   const char* functionName = metadata.getExportForEachNameList()[slot];
   if (functionName == nullptr || !functionName[0]) {
     ALOGE("Kernel fusion (module %s slot %d): failed to find kernel function",
-          source->getName().c_str(), slot);
+          kernel.moduleName, slot);
     return nullptr;
   }
 
   if (metadata.getExportForEachInputCountList()[slot] > 1) {
     ALOGE("Kernel fusion (module %s function %s): cannot handle multiple inputs",
-          source->getName().c_str(), functionName);
+          kernel.moduleName, functionName);
     return nullptr;
   }
 
@@ -88,27 +97,25 @@ constexpr uint32_t ExpectedSignatureBits =
         bcinfo::MD_SIG_Z |
         bcinfo::MD_SIG_Kernel;
 
-int getFusedFuncSig(const std::vector<Source*>& sources,
-                    const std::vector<int>& slots,
+int getFusedFuncSig(const std::vector<KernelSlot>& kernels,
                     uint32_t* retSig) {
   *retSig = 0;
   uint32_t firstSignature = 0;
   uint32_t signature = 0;
-  auto slotIter = slots.begin();
-  for (const Source* source : sources) {
-    const int slot = *slotIter++;
-    bcinfo::MetadataExtractor &metadata = *source->getMetadata();
+  for (const KernelSlot& kernel : kernels) {
+    const int slot = kernel.slot;
+    const bcinfo::MetadataExtractor &metadata = *kernel.metadata;
 
     if (metadata.getExportForEachInputCountList()[slot] > 1) {
       ALOGE("Kernel fusion (module %s slot %d): cannot handle multiple inputs",
-            source->getName().c_str(), slot);
+            kernel.moduleName, slot);
       return -1;
     }
 
     signature = metadata.getExportForEachSignatureList()[slot];
     if (signature & ~ExpectedSignatureBits) {
       ALOGE("Kernel fusion (module %s slot %d): Unexpected signature %x",
-            source->getName().c_str(), slot, signature);
+            kernel.moduleName, slot, signature);
       return -1;
     }
 
@@ -130,18 +137,17 @@ int getFusedFuncSig(const std::vector<Source*>& sources,
   return 0;
 }
 
-llvm::FunctionType* getFusedFuncType(bcc::BCCContext& Context,
-                                     const std::vector<Source*>& sources,
-                                     const std::vector<int>& slots,
+llvm::FunctionType* getFusedFuncType(llvm::LLVMContext& Context,
+                                     const std::vector<KernelSlot>& kernels,
                                      Module* M,
                                      uint32_t* signature) {
-  int error = getFusedFuncSig(sources, slots, signature);
+  int error = getFusedFuncSig(kernels, signature);
 
   if (error < 0) {
     return nullptr;
   }
 
-  const Function* firstF = getFunction(M, sources.front(), slots.front(), nullptr);
+  const Function* firstF = getFunction(M, kernels.front(), nullptr);
 
   bccAssert (firstF != nullptr);
 
@@ -151,7 +157,7 @@ llvm::FunctionType* getFusedFuncType(bcc::BCCContext& Context,
     ArgTys.push_back(firstF->arg_begin()->getType());
   }
 
-  llvm::Type* I32Ty = llvm::IntegerType::get(Context.getLLVMContext(), 32);
+  llvm::Type* I32Ty = llvm::IntegerType::get(Context, 32);
   if (bcinfo::MetadataExtractor::hasForEachSignatureX(*signature)) {
     ArgTys.push_back(I32Ty);
   }
@@ -162,7 +168,7 @@ llvm::FunctionType* getFusedFuncType(bcc::BCCContext& Context,
     ArgTys.push_back(I32Ty);
   }
 
-  const Function* lastF = getFunction(M, sources.back(), slots.back(), nullptr);
+  const Function* lastF = getFunction(M, kernels.back(), nullptr);
 
   bccAssert (lastF != nullptr);
 
@@ -171,19 +177,14 @@ llvm::FunctionType* getFusedFuncType(bcc::BCCContext& Context,
   return llvm::FunctionType::get(retTy, ArgTys, false);
 }
 
-}  // anonymous namespace
-
-bool fuseKernels(bcc::BCCContext& Context,
-                 const std::vector<Source *>& sources,
-                 const std::vector<int>& slots,
-                 const std::string& fusedName,
-                 Module* mergedModule) {
-  bccAssert(sources.size() == slots.size() && "sources and slots differ in size");
-
+bool fuseKernelSlots(llvm::LLVMContext& ctxt,
+                     const std::vector<KernelSlot>& kernels,
+                     const std::string& fusedName,
+                     Module* mergedModule) {
   uint32_t fusedFunctionSignature;
 
   llvm::FunctionType* fusedType =
-          getFusedFuncType(Context, sources, slots, mergedModule, &fusedFunctionSignature);
+          getFusedFuncType(ctxt, kernels, mergedModule, &fusedFunctionSignature);
 
   if (fusedType == nullptr) {
     return false;
@@ -192,8 +193,6 @@ bool fuseKernels(bcc::BCCContext& Context,
   Function* fusedKernel =
           (Function*)(mergedModule->getOrInsertFunction(fusedName, fusedType));
 
-  llvm::LLVMContext& ctxt = Context.getLLVMContext();
-
   llvm::BasicBlock* block = llvm::BasicBlock::Create(ctxt, "entry", fusedKernel);
   llvm::IRBuilder<> builder(block);
 
@@ -223,22 +222,23 @@ bool fuseKernels(bcc::BCCContext& Context,
     Z->setName("z");
   }
 
-  auto slotIter = slots.begin();
-  for (const Source* source : sources) {
-    int slot = *slotIter;
+  for (auto kernelIter = kernels.begin(); kernelIter != kernels.end(); ++kernelIter) {
+    const KernelSlot& kernel = *kernelIter;
 
     uint32_t inputFunctionSignature;
     const Function* inputFunction =
-            getFunction(mergedModule, source, slot, &inputFunctionSignature);
+            getFunction(mergedModule, kernel, &inputFunctionSignature);
     if (inputFunction == nullptr) {
       // Either failed to find the kernel function, or the function has multiple inputs.
+      fusedKernel->eraseFromParent();
       return false;
     }
 
     // Don't try to fuse a non-kernel
     if (!bcinfo::MetadataExtractor::hasForEachSignatureKernel(inputFunctionSignature)) {
       ALOGE("Kernel fusion (module %s function %s): not a kernel",
-            source->getName().c_str(), inputFunction->getName().str().c_str());
+            kernel.moduleName, inputFunction->getName().str().c_str());
+      fusedKernel->eraseFromParent();
       return false;
     }
 
@@ -247,7 +247,8 @@ bool fuseKernels(bcc::BCCContext& Context,
     if (bcinfo::MetadataExtractor::hasForEachSignatureIn(inputFunctionSignature)) {
       if (dataElement == nullptr) {
         ALOGE("Kernel fusion (module %s function %s): expected input, but got null",
-              source->getName().c_str(), inputFunction->getName().str().c_str());
+              kernel.moduleName, inputFunction->getName().str().c_str());
+        fusedKernel->eraseFromParent();
         return false;
       }
 
@@ -261,17 +262,19 @@ bool fuseKernels(bcc::BCCContext& Context,
         firstArgType->print(rso);
         rso << ", received ";
         dataElement->getType()->print(rso);
-        ALOGE("Kernel fusion (module %s function %s): %s", source->getName().c_str(),
+        ALOGE("Kernel fusion (module %s function %s): %s", kernel.moduleName,
               inputFunction->getName().str().c_str(), rso.str().c_str());
+        fusedKernel->eraseFromParent();
         return false;
       }
 
       args.push_back(dataElement);
     } else {
       // Only the first kernel in a batch is allowed to have no input
-      if (slotIter != slots.begin()) {
+      if (kernelIter != kernels.begin()) {
         ALOGE("Kernel fusion (module %s function %s): function not first in batch takes no input",
-              source->getName().c_str(), inputFunction->getName().str().c_str());
+              kernel.moduleName, inputFunction->getName().str().c_str());
+        fusedKernel->eraseFromParent();
         return false;
       }
     }
@@ -289,8 +292,6 @@ bool fuseKernels(bcc::BCCContext& Context,
     }
 
     dataElement = builder.CreateCall((llvm::Value*)inputFunction, args);
-
-    slotIter++;
   }
 
   if (fusedKernel->getReturnType()->isVoidTy()) {
@@ -316,6 +317,38 @@ bool fuseKernels(bcc::BCCContext& Context,
   return true;
 }
 
+}  // anonymous namespace
+
+bool fuseKernels(bcc::BCCContext& Context,
+                 const std::vector<Source *>& sources,
+                 const std::vector<int>& slots,
+                 const std::string& fusedName,
+                 Module* mergedModule) {
+  bccAssert(sources.size() == slots.size() && "sources and slots differ in size");
+
+  std::vector<KernelSlot> kernels;
+  auto slotIter = slots.begin();
+  for (const Source* source : sources) {
+    kernels.push_back({source->getMetadata(), source->getName().c_str(),
+                       *slotIter++});
+  }
+
+  return fuseKernelSlots(Context.getLLVMContext(), kernels, fusedName,
+                         mergedModule);
+}
+
+bool fuseKernels(const bcinfo::MetadataExtractor& metadata,
+                 const std::vector<int>& slots,
+                 const std::string& fusedName,
+                 Module* module) {
+  std::vector<KernelSlot> kernels;
+  for (int slot : slots) {
+    kernels.push_back({&metadata, module->getModuleIdentifier().c_str(), slot});
+  }
+
+  return fuseKernelSlots(module->getContext(), kernels, fusedName, module);
+}
+
 bool renameInvoke(BCCContext& Context, const Source* source, const int slot,
                   const std::string& newName, Module* module) {
   const llvm::Function* F = getInvokeFunction(*source, slot, module);
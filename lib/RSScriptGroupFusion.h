@@ -20,6 +20,10 @@
 #include <vector>
 #include <string>
 
+namespace bcinfo {
+class MetadataExtractor;
+}
+
 namespace llvm {
 class Module;
 }
@@ -44,6 +48,20 @@ bool fuseKernels(BCCContext& Context,
                  const std::string& fusedName,
                  llvm::Module* mergedModule);
 
+/// @brief Fuse kernels of a single module
+///
+/// Like the above, for kernels that are all defined in module, such as the
+/// forEach launches of an invokable.
+///
+/// @param metadata The metadata of module.
+/// @param slots The slots where the kernels are located.
+/// @param fusedName
+/// @return True, if kernels are successfully fused. False, otherwise.
+bool fuseKernels(const bcinfo::MetadataExtractor& metadata,
+                 const std::vector<int>& slots,
+                 const std::string& fusedName,
+                 llvm::Module* module);
+
 bool renameInvoke(BCCContext& Context, const Source* source, const int slot,
                   const std::string& newName, llvm::Module* mergedModule);
 }
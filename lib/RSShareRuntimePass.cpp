@@ -0,0 +1,155 @@
+/*
+ * Copyright 2026, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Assert.h"
+#include "Log.h"
+#include "RSTransforms.h"
+#include "RSUtils.h"
+
+#include <llvm/IR/CallSite.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/IR/Metadata.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Pass.h>
+
+#include <vector>
+
+namespace {
+
+/* RSShareRuntimePass: Turns the runtime functions and variables that were
+ * linked into a script to be inlined (see Script::setShareRuntime() and
+ * Script::setDeferRuntime()) back into references to the runtime.
+ *
+ * The runtime symbols are listed in the #rs_runtime_symbols named metadata,
+ * with the type and the calling convention they were linked with:
+ *
+ *   !{!"<name>", <type>* undef, i32 <calling convention>}
+ *
+ * - A runtime function that is still called becomes an external declaration.
+ *   Its calling convention is restored, in case GlobalOpt changed it.  One
+ *   whose type was changed by the interprocedural optimizations keeps its
+ *   private copy, since it can't be called as the runtime defines it.
+ * - A runtime variable that is still referenced becomes an external
+ *   declaration.  These aren't internalized, so that the optimizations don't
+ *   rely on the script seeing every access to them.
+ * - The runtime symbols nothing refers to anymore are dropped.
+ *
+ * Runs after LTO, so that the inliner made the same decisions as if the
+ * runtime were copied into the script.  Run GlobalDCE afterwards to drop what
+ * only the bodies of the runtime functions referred to.
+ */
+class RSShareRuntimePass : public llvm::ModulePass {
+private:
+  static char ID;
+
+  // Restore the calling convention CC of the runtime function F and of the
+  // calls to it.
+  static void restoreCallingConv(llvm::Function &F, llvm::CallingConv::ID CC) {
+    F.setCallingConv(CC);
+    for (llvm::User *U : F.users()) {
+      llvm::CallSite CS(U);
+      if (CS && CS.getCalledValue() == &F) {
+        CS.setCallingConv(CC);
+      }
+    }
+  }
+
+public:
+  RSShareRuntimePass()
+    : ModulePass(ID) {
+  }
+
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
+    // This pass does not use any other analysis passes, but it does
+    // remove function bodies and global variables.
+  }
+
+  bool runOnModule(llvm::Module &M) override {
+    llvm::NamedMDNode *Symbols =
+        M.getNamedMetadata(kRsRuntimeSymbolsMetadataName);
+    if (Symbols == nullptr) {
+      return false;
+    }
+
+    std::vector<llvm::GlobalValue *> Unused;
+    for (const llvm::MDNode *Symbol : Symbols->operands()) {
+      bccAssert(Symbol->getNumOperands() == 3);
+      const llvm::MDString *Name =
+          llvm::cast<llvm::MDString>(Symbol->getOperand(0));
+      const llvm::Constant *Linked =
+          llvm::mdconst::extract<llvm::Constant>(Symbol->getOperand(1));
+      const llvm::ConstantInt *CC =
+          llvm::mdconst::extract<llvm::ConstantInt>(Symbol->getOperand(2));
+
+      llvm::GlobalValue *GV = M.getNamedValue(Name->getString());
+      if (GV == nullptr || GV->isDeclaration()) {
+        continue;
+      }
+
+      GV->removeDeadConstantUsers();
+      if (GV->use_empty()) {
+        Unused.push_back(GV);
+        continue;
+      }
+      if (GV->getType() != Linked->getType()) {
+        ALOGV("Keeping a copy of runtime symbol %s, whose type changed",
+              GV->getName().str().c_str());
+        continue;
+      }
+
+      if (llvm::Function *F = llvm::dyn_cast<llvm::Function>(GV)) {
+        F->deleteBody();
+        restoreCallingConv(*F, CC->getZExtValue());
+      } else if (llvm::GlobalVariable *Var =
+                     llvm::dyn_cast<llvm::GlobalVariable>(GV)) {
+        Var->setInitializer(nullptr);
+      } else {
+        continue;
+      }
+      GV->setLinkage(llvm::GlobalValue::ExternalLinkage);
+      GV->setVisibility(llvm::GlobalValue::DefaultVisibility);
+    }
+
+    for (llvm::GlobalValue *GV : Unused) {
+      GV->eraseFromParent();
+    }
+    M.eraseNamedMetadata(Symbols);
+
+    // Upon completion, this pass has always modified the Module.
+    return true;
+  }
+
+  virtual const char *getPassName() const override {
+    return "Resolve the runtime functions that weren't inlined externally";
+  }
+};
+
+}  // end anonymous namespace
+
+char RSShareRuntimePass::ID = 0;
+
+static llvm::RegisterPass<RSShareRuntimePass> X("rs-share-runtime",
+  "Turn the RenderScript runtime linked into a script back into references");
+
+namespace bcc {
+
+llvm::ModulePass *createRSShareRuntimePass() {
+  return new RSShareRuntimePass();
+}
+
+}  // end namespace bcc
@@ -17,17 +17,27 @@
 #ifndef BCC_RS_TRANSFORMS_H
 #define BCC_RS_TRANSFORMS_H
 
+#include <set>
+#include <string>
+
 namespace llvm {
   class ModulePass;
   class FunctionPass;
+  class TargetIRAnalysis;
+  class TargetLibraryInfoImpl;
 }
 
 namespace bcc {
 
+class TuningDatabase;
+
 extern const char BCC_INDEX_VAR_NAME[];
 
 llvm::ModulePass *
-createRSKernelExpandPass(bool pEnableStepOpt);
+createRSKernelExpandPass(bool pEnableStepOpt, bool pEnableInterleave = false,
+                         bool pEnableAlignmentVersioning = true,
+                         unsigned pAllocationAlignment = 0,
+                         bool pEnableTailFolding = false);
 
 llvm::FunctionPass *
 createRSInvariantPass();
@@ -37,18 +47,43 @@ createRSInvokeHelperPass();
 
 llvm::ModulePass * createRSEmbedInfoPass();
 
-llvm::ModulePass * createRSGlobalInfoPass(bool pSkipConstants);
+llvm::ModulePass * createRSGlobalInfoPass(bool pSkipConstants,
+                                          bool pRelativeOffsets = false);
+
+llvm::ModulePass * createRSKernelStatsPass();
+
+llvm::ModulePass * createRSEntryTablePass();
+
+llvm::ModulePass * createRSEvaluateInitPass();
+
+llvm::ModulePass * createRSForEachFusionPass();
+
+llvm::ModulePass * createRSParallelizeInvokablesPass();
+
+llvm::ModulePass * createRSBoundsCheckHoistingPass();
+
+llvm::ModulePass *
+createRSLocalBindingPass(const std::set<std::string> &pExportedSymbols);
 
 llvm::ModulePass * createRSScreenFunctionsPass();
 
+llvm::ModulePass * createRSShareRuntimePass();
+
+llvm::ModulePass *
+createRSVectorizeExpandedLoopsPass(llvm::TargetIRAnalysis pTIRA,
+                                   const llvm::TargetLibraryInfoImpl *pTLII);
+
 llvm::ModulePass * createRSIsThreadablePass();
 
 llvm::ModulePass * createRSX86_64CallConvPass();
 
-llvm::ModulePass * createRSAddDebugInfoPass();
+llvm::ModulePass * createRSAddDebugInfoPass(bool pLineTablesOnly = false);
 
 llvm::FunctionPass *createRSX86TranslateGEPPass();
 
+llvm::ModulePass * createRSKernelTuningPass(TuningDatabase *pDatabase,
+                                            const std::string &pCPU);
+
 } // end namespace bcc
 
 #endif // BCC_RS_TRANSFORMS_H
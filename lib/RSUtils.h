@@ -21,6 +21,8 @@
 
 #include <llvm/IR/Type.h>
 #include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/GlobalAlias.h>
+#include <llvm/IR/Module.h>
 #include <llvm/ADT/StringRef.h>
 
 #include <string>
@@ -113,4 +115,27 @@ static inline std::string nameReduceCombinerFromAccumulator(llvm::StringRef accu
   return std::string(accumName) + ".combiner";
 }
 
+// The named metadata listing the runtime symbols that were linked into a
+// script to be inlined and are resolved against a runtime afterwards (see
+// RSShareRuntimePass).
+static const char kRsRuntimeSymbolsMetadataName[] = "#rs_runtime_symbols";
+
+// Returns a symbol for the definition GV that binds within the script, so
+// that references to it are resolved when the script's shared object is
+// linked rather than by a dynamic relocation.  That is GV itself if it is
+// local or hidden, and otherwise a private alias of GV (created on first use).
+// Declarations can't be aliased and are returned unchanged.
+static inline llvm::GlobalValue *getLocalBindingSymbol(llvm::GlobalValue &GV) {
+  if (GV.hasLocalLinkage() || GV.hasHiddenVisibility() || GV.isDeclaration()) {
+    return &GV;
+  }
+
+  const std::string AliasName = std::string(GV.getName()) + ".rs.local";
+  if (llvm::GlobalAlias *Alias = GV.getParent()->getNamedAlias(AliasName)) {
+    return Alias;
+  }
+  return llvm::GlobalAlias::create(llvm::GlobalValue::PrivateLinkage,
+                                   AliasName, &GV);
+}
+
 #endif // BCC_RS_UTILS_H
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2026, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "RSTransforms.h"
+
+#include <llvm/Analysis/TargetLibraryInfo.h>
+#include <llvm/Analysis/TargetTransformInfo.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Pass.h>
+#include <llvm/Transforms/Scalar.h>
+#include <llvm/Transforms/Vectorize.h>
+
+#include <memory>
+
+namespace {
+
+/* RSVectorizeExpandedLoopsPass: Vectorizes the loops of the expanded kernels
+ * ("<NAME>.expand") whose accesses to small vector and struct elements
+ * RSKernelExpandPass split into per-field accesses.
+ *
+ * The inlined kernel bodies are scalarized, so that the loop vectorizer can
+ * treat the fields as interleaved access groups, then the SLP vectorizer
+ * rebuilds vector code where the loop vectorizer gave up.  Only the expanded
+ * kernels are touched: invokables and the remaining helpers keep the code
+ * LTO produced for them.
+ *
+ * Runs after LTO, once the kernel bodies have been inlined into the loops.
+ */
+class RSVectorizeExpandedLoopsPass : public llvm::ModulePass {
+private:
+  static char ID;
+
+  llvm::TargetIRAnalysis mTIRA;
+  std::unique_ptr<llvm::TargetLibraryInfoImpl> mTLII;
+
+public:
+  RSVectorizeExpandedLoopsPass(
+      llvm::TargetIRAnalysis pTIRA = llvm::TargetIRAnalysis(),
+      const llvm::TargetLibraryInfoImpl *pTLII = nullptr)
+    : ModulePass(ID), mTIRA(std::move(pTIRA)) {
+    if (pTLII != nullptr) {
+      mTLII.reset(new llvm::TargetLibraryInfoImpl(*pTLII));
+    }
+  }
+
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
+    // The inner pass manager computes the analyses it needs itself.
+  }
+
+  bool runOnModule(llvm::Module &Module) override {
+    llvm::legacy::FunctionPassManager FPM(&Module);
+    FPM.add(llvm::createTargetTransformInfoWrapperPass(mTIRA));
+    if (mTLII) {
+      FPM.add(new llvm::TargetLibraryInfoWrapperPass(*mTLII));
+    }
+    FPM.add(llvm::createScalarizerPass());
+    FPM.add(llvm::createLoopVectorizePass());
+    FPM.add(llvm::createInstructionCombiningPass());
+    FPM.add(llvm::createCFGSimplificationPass());
+    FPM.add(llvm::createSLPVectorizerPass());
+    FPM.add(llvm::createDeadCodeEliminationPass());
+
+    bool Changed = false;
+    FPM.doInitialization();
+    for (llvm::Function &Function : Module) {
+      if (Function.isDeclaration() || !Function.getName().endswith(".expand")) {
+        continue;
+      }
+      Changed |= FPM.run(Function);
+    }
+    FPM.doFinalization();
+    return Changed;
+  }
+
+  virtual const char *getPassName() const override {
+    return "Vectorize the loops of the expanded kernels";
+  }
+};
+
+}  // end anonymous namespace
+
+char RSVectorizeExpandedLoopsPass::ID = 0;
+
+static llvm::RegisterPass<RSVectorizeExpandedLoopsPass>
+X("rs-vectorize-expanded-loops",
+  "Vectorize the per-field accesses of the expanded kernel loops");
+
+namespace bcc {
+
+llvm::ModulePass *
+createRSVectorizeExpandedLoopsPass(llvm::TargetIRAnalysis pTIRA,
+                                   const llvm::TargetLibraryInfoImpl *pTLII) {
+  return new RSVectorizeExpandedLoopsPass(std::move(pTIRA), pTLII);
+}
+
+}  // end namespace bcc
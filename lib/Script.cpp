@@ -18,23 +18,36 @@
 
 #include "Assert.h"
 #include "Log.h"
+#include "RSUtils.h"
 
 #include "bcc/CompilerConfig.h"
 #include "bcc/Source.h"
 
 #include "bcinfo/MetadataExtractor.h"
 
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Metadata.h>
 #include <llvm/IR/Module.h>
 
+#include <string>
+#include <vector>
+
 using namespace bcc;
 
 Script::Script(Source *pSource)
     : mSource(pSource),
       mOptimizationLevel(llvm::CodeGenOpt::Aggressive),
       mLinkRuntimeCallback(nullptr), mEmbedInfo(false), mEmbedGlobalInfo(false),
-      mEmbedGlobalInfoSkipConstant(false) {}
+      mEmbedGlobalInfoSkipConstant(false), mTuningDatabase(nullptr),
+      mMinimizeRelocations(false), mEmbedEntryTable(false),
+      mEmbedKernelStats(false),
+      mEnableInterleavedAccess(false), mFuseForEach(false),
+      mParallelizeInvokables(false), mEvaluateInit(false),
+      mShareRuntime(false), mAllocationAlignment(0),
+      mHoistBoundsChecks(false), mDeferRuntime(false),
+      mLineTablesOnly(false), mVectorizeKernels(false) {}
 
-bool Script::LinkRuntime(const char *core_lib) {
+Source *Script::LoadRuntime(const char *core_lib) {
   bccAssert(core_lib != nullptr);
 
   // Using the same context with the source.
@@ -43,7 +56,7 @@ bool Script::LinkRuntime(const char *core_lib) {
   Source *libclcore_source = Source::CreateFromFile(context, core_lib);
   if (libclcore_source == nullptr) {
     ALOGE("Failed to load Renderscript library '%s' to link!", core_lib);
-    return false;
+    return nullptr;
   }
 
   if (mLinkRuntimeCallback != nullptr) {
@@ -78,12 +91,69 @@ bool Script::LinkRuntime(const char *core_lib) {
       libclcore_module.getNamedMetadata(bcinfo::MetadataExtractor::kWrapperMetadataName);
   bccAssert(wrapperMDNode != nullptr);
   libclcore_module.eraseNamedMetadata(wrapperMDNode);
+
+  return libclcore_source;
+}
+
+bool Script::LinkRuntime(const char *core_lib) {
+  Source *libclcore_source = LoadRuntime(core_lib);
+  if (libclcore_source == nullptr) {
+    return false;
+  }
+  llvm::Module &libclcore_module = libclcore_source->getModule();
+
+  // The runtime is linked in as usual, so that the inliner makes the same
+  // decisions.  The references that remain after LTO are resolved against the
+  // shared runtime object, which has to be built from the same library, or
+  // against the copy linked into a combined object (see RSShareRuntimePass).
+  std::vector<std::string> runtime_symbols;
+  if (mShareRuntime || mDeferRuntime) {
+    auto collect = [&runtime_symbols](const llvm::GlobalObject &GO) {
+      if (!GO.isDeclaration() && GO.hasExternalLinkage() && !GO.hasComdat()) {
+        runtime_symbols.push_back(GO.getName());
+      }
+    };
+    for (const llvm::Function &F : libclcore_module) {
+      if (!F.isIntrinsic()) {
+        collect(F);
+      }
+    }
+    for (const llvm::GlobalVariable &GV : libclcore_module.globals()) {
+      collect(GV);
+    }
+  }
+
   if (!mSource->merge(*libclcore_source)) {
     ALOGE("Failed to link Renderscript library '%s'!", core_lib);
     delete libclcore_source;
     return false;
   }
 
+  // Record the runtime symbols with the types they have in the linked module.
+  if (!runtime_symbols.empty()) {
+    llvm::Module &module = mSource->getModule();
+    llvm::LLVMContext &ctx = module.getContext();
+    llvm::NamedMDNode *symbols =
+        module.getOrInsertNamedMetadata(kRsRuntimeSymbolsMetadataName);
+    for (const std::string &name : runtime_symbols) {
+      llvm::GlobalValue *GV = module.getNamedValue(name);
+      if (GV == nullptr) {
+        continue;
+      }
+      llvm::CallingConv::ID cc = llvm::CallingConv::C;
+      if (const llvm::Function *F = llvm::dyn_cast<llvm::Function>(GV)) {
+        cc = F->getCallingConv();
+      }
+      llvm::Metadata *operands[] = {
+        llvm::MDString::get(ctx, name),
+        llvm::ConstantAsMetadata::get(llvm::UndefValue::get(GV->getType())),
+        llvm::ConstantAsMetadata::get(
+            llvm::ConstantInt::get(llvm::Type::getInt32Ty(ctx), cc))
+      };
+      symbols->addOperand(llvm::MDNode::get(ctx, operands));
+    }
+  }
+
   return true;
 }
 
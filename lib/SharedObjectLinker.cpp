@@ -0,0 +1,1241 @@
+/*
+ * Copyright 2026, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SharedObjectLinker.h"
+
+#include "Assert.h"
+
+#include <llvm/Support/ELF.h>
+#include <llvm/Support/Endian.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/MathExtras.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace llvm::ELF;
+using llvm::support::endian::read32le;
+using llvm::support::endian::write32le;
+using llvm::support::endian::write64le;
+
+namespace {
+
+// Size of a PLT stub.  The stubs jump through the GOT slot of their symbol,
+// which the dynamic linker fills in at load time (there is no lazy binding).
+const uint64_t kPltEntrySize = 16;
+
+// PT_LOAD (RX), PT_LOAD (RW), PT_DYNAMIC and PT_GNU_STACK.
+const unsigned kNumProgramHeaders = 4;
+
+enum RelocKind {
+  kRelocNone,        // No-op.
+  kRelocAbsolute,    // 64-bit address; becomes a dynamic relocation.
+  kRelocLocal,       // Position-relative; the symbol must be defined.
+  kRelocCall,        // Branch; goes through the PLT for undefined symbols.
+  kRelocGot,         // Position-relative reference to the GOT slot.
+  kRelocUnsupported
+};
+
+struct OutputSection {
+  std::string Name;
+  uint32_t Type;
+  uint64_t Flags;
+  uint64_t Addr;
+  uint64_t Offset;
+  uint64_t Size;
+  uint32_t Link;
+  uint32_t Info;
+  uint64_t Align;
+  uint64_t EntSize;
+  // Index of the input section, or -1 for a section created by the linker.
+  int Input;
+};
+
+uint32_t hashSysV(llvm::StringRef Name) {
+  uint32_t H = 0;
+  for (char C : Name) {
+    H = (H << 4) + static_cast<uint8_t>(C);
+    uint32_t G = H & 0xf0000000;
+    if (G != 0) {
+      H ^= G >> 24;
+    }
+    H &= ~G;
+  }
+  return H;
+}
+
+uint64_t getPage(uint64_t Addr) {
+  return Addr & ~static_cast<uint64_t>(0xfff);
+}
+
+// Encode the immediate of an AArch64 ADR/ADRP instruction.
+uint32_t encodeAdr(uint32_t Insn, uint64_t Imm) {
+  Insn &= ~((0x3u << 29) | (0x7ffffu << 5));
+  return Insn | ((Imm & 0x3) << 29) | (((Imm >> 2) & 0x7ffff) << 5);
+}
+
+// Encode the 12-bit unsigned immediate of an AArch64 ADD/LDR/STR instruction.
+uint32_t encodeImm12(uint32_t Insn, uint64_t Imm) {
+  return (Insn & ~(0xfffu << 10)) | ((Imm & 0xfff) << 10);
+}
+
+// Return the init/fini array priority encoded in a section name, e.g. 100 for
+// .init_array.00100.  Sections without one run last.
+unsigned getArrayPriority(llvm::StringRef Name) {
+  size_t Dot = Name.rfind('.');
+  unsigned Priority;
+  if (Dot == 0 || Name.substr(Dot + 1).getAsInteger(10, Priority)) {
+    return 65536;
+  }
+  return Priority;
+}
+
+class Linker {
+private:
+  llvm::StringRef mObject;
+  std::string &mError;
+
+  const Elf64_Ehdr *mHeader;
+  const Elf64_Shdr *mSections;
+  unsigned mNumSections;
+  llvm::StringRef mShStrTab;
+  const Elf64_Sym *mSymbols;
+  unsigned mNumSymbols;
+  llvm::StringRef mStrTab;
+
+  uint64_t mPageSize;
+  uint32_t mRelativeReloc;
+  uint32_t mGlobDatReloc;
+  uint32_t mAbsoluteReloc;
+
+  // Indexed by input section.
+  std::vector<uint64_t> mSectionAddr;
+  std::vector<unsigned> mSectionIndex;  // Output section, 0 if dropped.
+
+  // Indexed by input symbol.
+  std::vector<uint64_t> mSymbolAddr;
+  std::vector<unsigned> mDynSymIndex;   // 0 if not in .dynsym.
+  std::vector<int> mGotSlot;            // -1 if none.
+  std::vector<int> mPltSlot;            // -1 if none.
+
+  // Input symbols of the .dynsym entries (after the null one), the GOT slots
+  // and the PLT stubs.  Undefined symbols come first in .dynsym.
+  std::vector<unsigned> mDynSymbols;
+  std::vector<unsigned> mGotSymbols;
+  std::vector<unsigned> mPltSymbols;
+
+  size_t mNumDynRelocs;
+  std::vector<Elf64_Rela> mDynRelocs;
+
+  // Output sections; the index of .got and .plt is 0 if there are none.
+  std::vector<OutputSection> mOutput;
+  unsigned mGotIndex;
+  unsigned mPltIndex;
+
+  bool fail(const std::string &Msg) {
+    mError = Msg;
+    return false;
+  }
+
+  template <typename T>
+  const T *getArray(uint64_t Offset, uint64_t Count) const {
+    if ((Offset > mObject.size()) ||
+        (Count > (mObject.size() - Offset) / sizeof(T))) {
+      return nullptr;
+    }
+    return reinterpret_cast<const T *>(mObject.data() + Offset);
+  }
+
+  bool getSectionContents(unsigned Index, llvm::StringRef &Contents) const {
+    const Elf64_Shdr &Section = mSections[Index];
+    if (Section.sh_type == SHT_NOBITS) {
+      Contents = llvm::StringRef();
+      return true;
+    }
+    const char *Data = getArray<char>(Section.sh_offset, Section.sh_size);
+    if (Data == nullptr) {
+      return false;
+    }
+    Contents = llvm::StringRef(Data, Section.sh_size);
+    return true;
+  }
+
+  static llvm::StringRef getString(llvm::StringRef Table, uint32_t Offset) {
+    return Table.substr(Offset).split('\0').first;
+  }
+
+  llvm::StringRef getSectionName(unsigned Index) const {
+    return getString(mShStrTab, mSections[Index].sh_name);
+  }
+
+  llvm::StringRef getSymbolName(unsigned Index) const {
+    return getString(mStrTab, mSymbols[Index].st_name);
+  }
+
+  bool isAllocated(unsigned Index) const {
+    return (Index < mNumSections) && (mSections[Index].sh_flags & SHF_ALLOC);
+  }
+
+  bool isUndefined(unsigned Sym) const {
+    return (Sym != 0) && (mSymbols[Sym].st_shndx == SHN_UNDEF);
+  }
+
+  bool isExported(unsigned Sym) const {
+    const Elf64_Sym &Symbol = mSymbols[Sym];
+    unsigned char Binding = Symbol.getBinding();
+    unsigned char Type = Symbol.getType();
+    unsigned char Visibility = Symbol.st_other & 0x3;
+    return !isUndefined(Sym) &&
+           ((Binding == STB_GLOBAL) || (Binding == STB_WEAK)) &&
+           ((Visibility == STV_DEFAULT) || (Visibility == STV_PROTECTED)) &&
+           (Type != STT_SECTION) && (Type != STT_FILE);
+  }
+
+  RelocKind classify(uint32_t Type) const {
+    if (mHeader->e_machine == EM_X86_64) {
+      switch (Type) {
+      case R_X86_64_NONE:
+        return kRelocNone;
+      case R_X86_64_64:
+        return kRelocAbsolute;
+      case R_X86_64_PC32:
+      case R_X86_64_PC64:
+        return kRelocLocal;
+      case R_X86_64_PLT32:
+        return kRelocCall;
+      case R_X86_64_GOTPCREL:
+      case R_X86_64_GOTPCRELX:
+      case R_X86_64_REX_GOTPCRELX:
+        return kRelocGot;
+      default:
+        return kRelocUnsupported;
+      }
+    }
+
+    // R_AARCH64_NONE used to be 256.
+    if ((Type == 0) || (Type == 256)) {
+      return kRelocNone;
+    }
+    switch (Type) {
+    case R_AARCH64_ABS64:
+      return kRelocAbsolute;
+    case R_AARCH64_PREL32:
+    case R_AARCH64_PREL64:
+    case R_AARCH64_CONDBR19:
+    case R_AARCH64_TSTBR14:
+    case R_AARCH64_ADR_PREL_LO21:
+    case R_AARCH64_ADR_PREL_PG_HI21:
+    case R_AARCH64_ADR_PREL_PG_HI21_NC:
+    case R_AARCH64_ADD_ABS_LO12_NC:
+    case R_AARCH64_LDST8_ABS_LO12_NC:
+    case R_AARCH64_LDST16_ABS_LO12_NC:
+    case R_AARCH64_LDST32_ABS_LO12_NC:
+    case R_AARCH64_LDST64_ABS_LO12_NC:
+    case R_AARCH64_LDST128_ABS_LO12_NC:
+      return kRelocLocal;
+    case R_AARCH64_CALL26:
+    case R_AARCH64_JUMP26:
+      return kRelocCall;
+    case R_AARCH64_ADR_GOT_PAGE:
+    case R_AARCH64_LD64_GOT_LO12_NC:
+      return kRelocGot;
+    default:
+      return kRelocUnsupported;
+    }
+  }
+
+  uint64_t getRelocSize(uint32_t Type) const {
+    if (mHeader->e_machine == EM_X86_64) {
+      return ((Type == R_X86_64_64) || (Type == R_X86_64_PC64)) ? 8 : 4;
+    }
+    return ((Type == R_AARCH64_ABS64) || (Type == R_AARCH64_PREL64)) ? 8 : 4;
+  }
+
+  bool parse();
+  bool scanRelocations();
+  void addGotSlot(unsigned Sym);
+  unsigned addSection(llvm::StringRef Name, uint32_t Type, uint64_t Flags,
+                      uint64_t Size, uint64_t Align, int Input,
+                      uint64_t &Addr, uint64_t &Offset);
+  bool applyRelocations(uint8_t *Buf);
+  bool applyRelocation(uint32_t Type, uint8_t *Loc, uint64_t S, int64_t A,
+                       uint64_t P);
+  void writePltEntry(uint8_t *Loc, uint64_t EntryAddr, uint64_t GotSlotAddr);
+
+public:
+  Linker(llvm::StringRef pObject, std::string &pError)
+    : mObject(pObject), mError(pError), mHeader(nullptr), mSections(nullptr),
+      mNumSections(0), mSymbols(nullptr), mNumSymbols(0), mPageSize(0),
+      mRelativeReloc(0), mGlobDatReloc(0), mAbsoluteReloc(0),
+      mNumDynRelocs(0), mGotIndex(0), mPltIndex(0) {
+  }
+
+  bool link(const std::string &pSOName,
+            const std::vector<std::string> &pNeeded,
+            llvm::SmallVectorImpl<char> &pResult);
+};
+
+bool Linker::parse() {
+  if (!llvm::sys::IsLittleEndianHost) {
+    return fail("big-endian hosts are not supported");
+  }
+
+  mHeader = getArray<Elf64_Ehdr>(0, 1);
+  if ((mHeader == nullptr) || !mHeader->checkMagic() ||
+      (mHeader->getFileClass() != ELFCLASS64) ||
+      (mHeader->getDataEncoding() != ELFDATA2LSB) ||
+      (mHeader->e_type != ET_REL)) {
+    return fail("not a little-endian ELF64 relocatable object");
+  }
+
+  switch (mHeader->e_machine) {
+  case EM_X86_64:
+    mPageSize = 0x1000;
+    mRelativeReloc = R_X86_64_RELATIVE;
+    mGlobDatReloc = R_X86_64_GLOB_DAT;
+    mAbsoluteReloc = R_X86_64_64;
+    break;
+  case EM_AARCH64:
+    // Support kernels with 64KB pages.
+    mPageSize = 0x10000;
+    mRelativeReloc = R_AARCH64_RELATIVE;
+    mGlobDatReloc = R_AARCH64_GLOB_DAT;
+    mAbsoluteReloc = R_AARCH64_ABS64;
+    break;
+  default:
+    return fail("unsupported machine " + std::to_string(mHeader->e_machine));
+  }
+
+  mNumSections = mHeader->e_shnum;
+  mSections = getArray<Elf64_Shdr>(mHeader->e_shoff, mNumSections);
+  if ((mSections == nullptr) || (mNumSections == 0) ||
+      (mHeader->e_shstrndx >= mNumSections) ||
+      !getSectionContents(mHeader->e_shstrndx, mShStrTab)) {
+    return fail("malformed section header table");
+  }
+
+  for (unsigned i = 0; i < mNumSections; ++i) {
+    const Elf64_Shdr &Section = mSections[i];
+    if (Section.sh_type == SHT_SYMTAB) {
+      if (mSymbols != nullptr) {
+        return fail("more than one symbol table");
+      }
+      mNumSymbols = Section.sh_size / sizeof(Elf64_Sym);
+      mSymbols = getArray<Elf64_Sym>(Section.sh_offset, mNumSymbols);
+      if ((mSymbols == nullptr) || (Section.sh_link >= mNumSections) ||
+          !getSectionContents(Section.sh_link, mStrTab)) {
+        return fail("malformed symbol table");
+      }
+    }
+
+    if ((Section.sh_type == SHT_REL) && isAllocated(Section.sh_info)) {
+      return fail("REL relocations are not supported");
+    }
+
+    if (!(Section.sh_flags & SHF_ALLOC)) {
+      continue;
+    }
+
+    llvm::StringRef Name = getSectionName(i);
+    if (Section.sh_flags & SHF_TLS) {
+      return fail("thread-local section " + Name.str() + " is not supported");
+    }
+    if (Name.startswith(".ctors") || Name.startswith(".dtors")) {
+      return fail(Name.str() + " is not supported, use .init_array instead");
+    }
+
+    switch (Section.sh_type) {
+    case SHT_PROGBITS:
+    case SHT_INIT_ARRAY:
+    case SHT_FINI_ARRAY:
+    case SHT_NOTE:
+    case SHT_X86_64_UNWIND:
+      break;
+    case SHT_NOBITS:
+      if (!(Section.sh_flags & SHF_WRITE)) {
+        return fail("read-only SHT_NOBITS section " + Name.str());
+      }
+      break;
+    default:
+      return fail("section " + Name.str() + " has unsupported type " +
+                  std::to_string(Section.sh_type));
+    }
+
+    llvm::StringRef Contents;
+    if ((Section.sh_addralign > mPageSize) ||
+        !getSectionContents(i, Contents)) {
+      return fail("malformed section " + Name.str());
+    }
+  }
+
+  if (mSymbols == nullptr) {
+    return fail("missing symbol table");
+  }
+
+  return true;
+}
+
+void Linker::addGotSlot(unsigned Sym) {
+  if (mGotSlot[Sym] < 0) {
+    mGotSlot[Sym] = mGotSymbols.size();
+    mGotSymbols.push_back(Sym);
+    // Every GOT slot gets a GLOB_DAT or RELATIVE dynamic relocation.
+    ++mNumDynRelocs;
+  }
+}
+
+bool Linker::scanRelocations() {
+  mDynSymIndex.assign(mNumSymbols, 0);
+  mGotSlot.assign(mNumSymbols, -1);
+  mPltSlot.assign(mNumSymbols, -1);
+  std::vector<bool> Imported(mNumSymbols, false);
+
+  for (unsigned i = 0; i < mNumSections; ++i) {
+    const Elf64_Shdr &RelSection = mSections[i];
+    if ((RelSection.sh_type != SHT_RELA) || !isAllocated(RelSection.sh_info)) {
+      continue;
+    }
+
+    const Elf64_Shdr &Target = mSections[RelSection.sh_info];
+    llvm::StringRef TargetName = getSectionName(RelSection.sh_info);
+    size_t NumRelocs = RelSection.sh_size / sizeof(Elf64_Rela);
+    const Elf64_Rela *Relocs =
+        getArray<Elf64_Rela>(RelSection.sh_offset, NumRelocs);
+    if ((Relocs == nullptr) || (Target.sh_type == SHT_NOBITS)) {
+      return fail("malformed relocation section " + getSectionName(i).str());
+    }
+
+    for (size_t r = 0; r < NumRelocs; ++r) {
+      const Elf64_Rela &Reloc = Relocs[r];
+      uint32_t Type = Reloc.getType();
+      uint32_t Sym = Reloc.getSymbol();
+      if ((Sym >= mNumSymbols) ||
+          (Reloc.r_offset + getRelocSize(Type) > Target.sh_size)) {
+        return fail("malformed relocation in " + TargetName.str());
+      }
+
+      RelocKind Kind = classify(Type);
+      if (Kind == kRelocUnsupported) {
+        return fail("unsupported relocation type " + std::to_string(Type) +
+                    " in " + TargetName.str());
+      }
+      if (Kind == kRelocNone) {
+        continue;
+      }
+
+      const bool Undefined = isUndefined(Sym);
+      if ((Sym != 0) && !Undefined) {
+        uint16_t Shndx = mSymbols[Sym].st_shndx;
+        if ((Shndx != SHN_ABS) && (Shndx != SHN_COMMON) &&
+            ((Shndx >= SHN_LORESERVE) || !isAllocated(Shndx))) {
+          return fail("relocation in " + TargetName.str() +
+                      " against a symbol in a non-allocated section");
+        }
+      }
+
+      switch (Kind) {
+      case kRelocAbsolute:
+        if (!(Target.sh_flags & SHF_WRITE)) {
+          return fail("text relocation in " + TargetName.str());
+        }
+        if (Undefined) {
+          Imported[Sym] = true;
+        }
+        ++mNumDynRelocs;
+        break;
+      case kRelocLocal:
+        if (Undefined) {
+          return fail("position-dependent reference to external symbol " +
+                      getSymbolName(Sym).str());
+        }
+        break;
+      case kRelocCall:
+        if (Undefined && (mPltSlot[Sym] < 0)) {
+          Imported[Sym] = true;
+          addGotSlot(Sym);
+          mPltSlot[Sym] = mPltSymbols.size();
+          mPltSymbols.push_back(Sym);
+        }
+        break;
+      case kRelocGot:
+        if ((Sym == 0) || ((mHeader->e_machine == EM_AARCH64) &&
+                           (Reloc.r_addend != 0))) {
+          return fail("unsupported GOT reference in " + TargetName.str());
+        }
+        if (Undefined) {
+          Imported[Sym] = true;
+        }
+        addGotSlot(Sym);
+        break;
+      default:
+        bccAssert(false && "Unexpected relocation kind!");
+      }
+    }
+  }
+
+  // .dynsym has no local symbols: undefined symbols first, then the
+  // definitions visible to the runtime.
+  for (unsigned i = 1; i < mNumSymbols; ++i) {
+    if (Imported[i]) {
+      mDynSymbols.push_back(i);
+      mDynSymIndex[i] = mDynSymbols.size();
+    }
+  }
+  for (unsigned i = 1; i < mNumSymbols; ++i) {
+    if (isExported(i)) {
+      mDynSymbols.push_back(i);
+      mDynSymIndex[i] = mDynSymbols.size();
+    }
+  }
+
+  return true;
+}
+
+unsigned Linker::addSection(llvm::StringRef Name, uint32_t Type,
+                            uint64_t Flags, uint64_t Size, uint64_t Align,
+                            int Input, uint64_t &Addr, uint64_t &Offset) {
+  // Addr and Offset are congruent modulo the page size, so the same padding
+  // aligns both.
+  Align = std::max<uint64_t>(Align, 1);
+  uint64_t Padding = llvm::alignTo(Addr, Align) - Addr;
+  Addr += Padding;
+  Offset += Padding;
+
+  OutputSection Section = OutputSection();
+  Section.Name = Name.str();
+  Section.Type = Type;
+  Section.Flags = Flags;
+  Section.Addr = Addr;
+  Section.Offset = Offset;
+  Section.Size = Size;
+  Section.Align = Align;
+  Section.Input = Input;
+  mOutput.push_back(Section);
+
+  const unsigned Index = mOutput.size() - 1;
+  if (Input >= 0) {
+    mSectionAddr[Input] = Addr;
+    mSectionIndex[Input] = Index;
+    mOutput.back().EntSize = mSections[Input].sh_entsize;
+  }
+
+  Addr += Size;
+  if (Type != SHT_NOBITS) {
+    Offset += Size;
+  }
+  return Index;
+}
+
+bool Linker::applyRelocation(uint32_t Type, uint8_t *Loc, uint64_t S,
+                             int64_t A, uint64_t P) {
+  const int64_t V = static_cast<int64_t>(S + A - P);
+
+  if (mHeader->e_machine == EM_X86_64) {
+    if (Type == R_X86_64_PC64) {
+      write64le(Loc, V);
+      return true;
+    }
+    // PC32, PLT32 and the GOTPCREL variants.
+    if (!llvm::isInt<32>(V)) {
+      return fail("relocation out of range");
+    }
+    write32le(Loc, V);
+    return true;
+  }
+
+  uint32_t Insn = read32le(Loc);
+  switch (Type) {
+  case R_AARCH64_PREL64:
+    write64le(Loc, V);
+    return true;
+  case R_AARCH64_PREL32:
+    if (!llvm::isInt<32>(V)) {
+      return fail("relocation out of range");
+    }
+    write32le(Loc, V);
+    return true;
+  case R_AARCH64_CALL26:
+  case R_AARCH64_JUMP26:
+    if (!llvm::isInt<28>(V)) {
+      return fail("branch out of range");
+    }
+    Insn = (Insn & ~0x3ffffffu) | ((V >> 2) & 0x3ffffff);
+    break;
+  case R_AARCH64_CONDBR19:
+    if (!llvm::isInt<21>(V)) {
+      return fail("branch out of range");
+    }
+    Insn = (Insn & ~(0x7ffffu << 5)) | (((V >> 2) & 0x7ffff) << 5);
+    break;
+  case R_AARCH64_TSTBR14:
+    if (!llvm::isInt<16>(V)) {
+      return fail("branch out of range");
+    }
+    Insn = (Insn & ~(0x3fffu << 5)) | (((V >> 2) & 0x3fff) << 5);
+    break;
+  case R_AARCH64_ADR_PREL_LO21:
+    if (!llvm::isInt<21>(V)) {
+      return fail("relocation out of range");
+    }
+    Insn = encodeAdr(Insn, V);
+    break;
+  case R_AARCH64_ADR_PREL_PG_HI21:
+  case R_AARCH64_ADR_PREL_PG_HI21_NC:
+  case R_AARCH64_ADR_GOT_PAGE: {
+    int64_t PageDelta = static_cast<int64_t>(getPage(S + A) - getPage(P));
+    if ((Type != R_AARCH64_ADR_PREL_PG_HI21_NC) && !llvm::isInt<33>(PageDelta)) {
+      return fail("relocation out of range");
+    }
+    Insn = encodeAdr(Insn, PageDelta >> 12);
+    break;
+  }
+  case R_AARCH64_ADD_ABS_LO12_NC:
+  case R_AARCH64_LDST8_ABS_LO12_NC:
+    Insn = encodeImm12(Insn, (S + A) & 0xfff);
+    break;
+  case R_AARCH64_LDST16_ABS_LO12_NC:
+    Insn = encodeImm12(Insn, ((S + A) & 0xfff) >> 1);
+    break;
+  case R_AARCH64_LDST32_ABS_LO12_NC:
+    Insn = encodeImm12(Insn, ((S + A) & 0xfff) >> 2);
+    break;
+  case R_AARCH64_LDST64_ABS_LO12_NC:
+  case R_AARCH64_LD64_GOT_LO12_NC:
+    Insn = encodeImm12(Insn, ((S + A) & 0xfff) >> 3);
+    break;
+  case R_AARCH64_LDST128_ABS_LO12_NC:
+    Insn = encodeImm12(Insn, ((S + A) & 0xfff) >> 4);
+    break;
+  default:
+    return fail("unsupported relocation type " + std::to_string(Type));
+  }
+  write32le(Loc, Insn);
+  return true;
+}
+
+bool Linker::applyRelocations(uint8_t *Buf) {
+  const uint64_t GotAddr = mOutput[mGotIndex].Addr;
+  const uint64_t PltAddr = mOutput[mPltIndex].Addr;
+
+  for (unsigned i = 0; i < mNumSections; ++i) {
+    const Elf64_Shdr &RelSection = mSections[i];
+    if ((RelSection.sh_type != SHT_RELA) || !isAllocated(RelSection.sh_info)) {
+      continue;
+    }
+
+    const unsigned Target = RelSection.sh_info;
+    uint8_t *Base = Buf + mOutput[mSectionIndex[Target]].Offset;
+    const Elf64_Rela *Relocs = getArray<Elf64_Rela>(
+        RelSection.sh_offset, RelSection.sh_size / sizeof(Elf64_Rela));
+
+    for (size_t r = 0; r < RelSection.sh_size / sizeof(Elf64_Rela); ++r) {
+      const Elf64_Rela &Reloc = Relocs[r];
+      const uint32_t Type = Reloc.getType();
+      const uint32_t Sym = Reloc.getSymbol();
+      const int64_t A = Reloc.r_addend;
+      const uint64_t P = mSectionAddr[Target] + Reloc.r_offset;
+      uint8_t *Loc = Base + Reloc.r_offset;
+      uint64_t S = mSymbolAddr[Sym];
+
+      switch (classify(Type)) {
+      case kRelocNone:
+        continue;
+      case kRelocAbsolute: {
+        Elf64_Rela DynReloc = Elf64_Rela();
+        DynReloc.r_offset = P;
+        if (isUndefined(Sym)) {
+          DynReloc.setSymbolAndType(mDynSymIndex[Sym], mAbsoluteReloc);
+          DynReloc.r_addend = A;
+          write64le(Loc, 0);
+        } else {
+          DynReloc.setSymbolAndType(0, mRelativeReloc);
+          DynReloc.r_addend = S + A;
+          write64le(Loc, S + A);
+        }
+        mDynRelocs.push_back(DynReloc);
+        continue;
+      }
+      case kRelocCall:
+        if (mPltSlot[Sym] >= 0) {
+          S = PltAddr + mPltSlot[Sym] * kPltEntrySize;
+        }
+        break;
+      case kRelocGot:
+        S = GotAddr + mGotSlot[Sym] * 8;
+        break;
+      default:
+        break;
+      }
+
+      if (!applyRelocation(Type, Loc, S, A, P)) {
+        mError += " in " + getSectionName(Target).str() + " against " +
+                  getSymbolName(Sym).str();
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+void Linker::writePltEntry(uint8_t *Loc, uint64_t EntryAddr,
+                           uint64_t GotSlotAddr) {
+  if (mHeader->e_machine == EM_X86_64) {
+    // jmp *GotSlot(%rip)
+    Loc[0] = 0xff;
+    Loc[1] = 0x25;
+    write32le(Loc + 2, GotSlotAddr - (EntryAddr + 6));
+    memset(Loc + 6, 0xcc, kPltEntrySize - 6);
+    return;
+  }
+
+  // adrp x16, GotSlot
+  // ldr  x17, [x16, :lo12:GotSlot]
+  // br   x17
+  // nop
+  write32le(Loc, encodeAdr(0x90000010,
+                           (getPage(GotSlotAddr) - getPage(EntryAddr)) >> 12));
+  write32le(Loc + 4, encodeImm12(0xf9400211, (GotSlotAddr & 0xfff) >> 3));
+  write32le(Loc + 8, 0xd61f0220);
+  write32le(Loc + 12, 0xd503201f);
+}
+
+bool Linker::link(const std::string &pSOName,
+                  const std::vector<std::string> &pNeeded,
+                  llvm::SmallVectorImpl<char> &pResult) {
+  if (!parse() || !scanRelocations()) {
+    return false;
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Dynamic string table
+  //===--------------------------------------------------------------------===//
+  std::string DynStr(1, '\0');
+  auto AddDynStr = [&DynStr](llvm::StringRef Str) -> uint32_t {
+    uint32_t Offset = DynStr.size();
+    DynStr.append(Str.begin(), Str.end());
+    DynStr.push_back('\0');
+    return Offset;
+  };
+
+  const uint32_t SONameOffset = AddDynStr(pSOName);
+  std::vector<uint32_t> NeededOffsets;
+  for (const std::string &Needed : pNeeded) {
+    NeededOffsets.push_back(AddDynStr(Needed));
+  }
+  std::vector<uint32_t> DynSymNameOffsets;
+  for (unsigned Sym : mDynSymbols) {
+    DynSymNameOffsets.push_back(AddDynStr(getSymbolName(Sym)));
+  }
+
+  const size_t NumDynSyms = mDynSymbols.size() + 1;
+  const size_t NumBuckets = NumDynSyms;
+
+  //===--------------------------------------------------------------------===//
+  // Init/fini arrays, sorted by priority so that each set is contiguous
+  //===--------------------------------------------------------------------===//
+  std::vector<unsigned> InitArrays;
+  std::vector<unsigned> FiniArrays;
+  for (unsigned i = 0; i < mNumSections; ++i) {
+    if (!isAllocated(i)) {
+      continue;
+    }
+    if (mSections[i].sh_type == SHT_INIT_ARRAY) {
+      InitArrays.push_back(i);
+    } else if (mSections[i].sh_type == SHT_FINI_ARRAY) {
+      FiniArrays.push_back(i);
+    }
+  }
+  auto ByPriority = [this](unsigned L, unsigned R) {
+    return getArrayPriority(getSectionName(L)) <
+           getArrayPriority(getSectionName(R));
+  };
+  std::stable_sort(InitArrays.begin(), InitArrays.end(), ByPriority);
+  std::stable_sort(FiniArrays.begin(), FiniArrays.end(), ByPriority);
+
+  size_t NumDynamic = pNeeded.size() + 1 /* SONAME */ + 5 /* HASH, STRTAB,
+      SYMTAB, STRSZ, SYMENT */ + 2 /* FLAGS, FLAGS_1 */ + 1 /* NULL */;
+  if (mNumDynRelocs != 0) {
+    NumDynamic += 3;
+  }
+  if (!InitArrays.empty()) {
+    NumDynamic += 2;
+  }
+  if (!FiniArrays.empty()) {
+    NumDynamic += 2;
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Layout
+  //===--------------------------------------------------------------------===//
+  mSectionAddr.assign(mNumSections, 0);
+  mSectionIndex.assign(mNumSections, 0);
+  mOutput.push_back(OutputSection());
+  mOutput.back().Input = -1;
+
+  // The RX segment starts at address 0 with the headers.
+  uint64_t Offset = sizeof(Elf64_Ehdr) + kNumProgramHeaders * sizeof(Elf64_Phdr);
+  uint64_t Addr = Offset;
+
+  const unsigned HashIndex = addSection(
+      ".hash", SHT_HASH, SHF_ALLOC,
+      (2 + NumBuckets + NumDynSyms) * sizeof(uint32_t), 8, -1, Addr, Offset);
+  const unsigned DynSymIndex = addSection(
+      ".dynsym", SHT_DYNSYM, SHF_ALLOC, NumDynSyms * sizeof(Elf64_Sym), 8, -1,
+      Addr, Offset);
+  const unsigned DynStrIndex = addSection(
+      ".dynstr", SHT_STRTAB, SHF_ALLOC, DynStr.size(), 1, -1, Addr, Offset);
+  unsigned RelaDynIndex = 0;
+  if (mNumDynRelocs != 0) {
+    RelaDynIndex = addSection(".rela.dyn", SHT_RELA, SHF_ALLOC,
+                              mNumDynRelocs * sizeof(Elf64_Rela), 8, -1,
+                              Addr, Offset);
+  }
+
+  for (unsigned i = 0; i < mNumSections; ++i) {
+    const Elf64_Shdr &Section = mSections[i];
+    if (isAllocated(i) && !(Section.sh_flags & SHF_WRITE) &&
+        (Section.sh_type != SHT_INIT_ARRAY) &&
+        (Section.sh_type != SHT_FINI_ARRAY)) {
+      addSection(getSectionName(i), Section.sh_type, Section.sh_flags,
+                 Section.sh_size, Section.sh_addralign, i, Addr, Offset);
+    }
+  }
+
+  if (!mPltSymbols.empty()) {
+    mPltIndex = addSection(".plt", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR,
+                          mPltSymbols.size() * kPltEntrySize, 16, -1,
+                          Addr, Offset);
+  }
+  const uint64_t RXEnd = Offset;
+
+  // The RW segment starts on a new page, at an address congruent to its file
+  // offset.
+  Offset = llvm::alignTo(Offset, 8);
+  Addr = llvm::alignTo(Addr, mPageSize) + (Offset % mPageSize);
+  const uint64_t RWOffset = Offset;
+  const uint64_t RWAddr = Addr;
+
+  const unsigned DynamicIndex = addSection(
+      ".dynamic", SHT_DYNAMIC, SHF_ALLOC | SHF_WRITE,
+      NumDynamic * sizeof(Elf64_Dyn), 8, -1, Addr, Offset);
+  if (!mGotSymbols.empty()) {
+    mGotIndex = addSection(".got", SHT_PROGBITS, SHF_ALLOC | SHF_WRITE,
+                          mGotSymbols.size() * 8, 8, -1, Addr, Offset);
+  }
+
+  for (const std::vector<unsigned> *Arrays : {&InitArrays, &FiniArrays}) {
+    for (unsigned i : *Arrays) {
+      const Elf64_Shdr &Section = mSections[i];
+      if ((Section.sh_addralign > 8) || (Section.sh_size % 8 != 0)) {
+        return fail("malformed section " + getSectionName(i).str());
+      }
+      addSection(getSectionName(i), Section.sh_type, Section.sh_flags,
+                 Section.sh_size, 8, i, Addr, Offset);
+    }
+  }
+
+  for (uint32_t Type : {SHT_PROGBITS, SHT_NOBITS}) {
+    for (unsigned i = 0; i < mNumSections; ++i) {
+      const Elf64_Shdr &Section = mSections[i];
+      if (isAllocated(i) && (Section.sh_flags & SHF_WRITE) &&
+          (Section.sh_type != SHT_INIT_ARRAY) &&
+          (Section.sh_type != SHT_FINI_ARRAY) &&
+          ((Section.sh_type == SHT_NOBITS) == (Type == SHT_NOBITS))) {
+        addSection(getSectionName(i), Section.sh_type, Section.sh_flags,
+                   Section.sh_size, Section.sh_addralign, i, Addr, Offset);
+      }
+    }
+  }
+
+  // Common symbols are allocated at the end of .bss.
+  mSymbolAddr.assign(mNumSymbols, 0);
+  uint64_t CommonSize = 0;
+  uint64_t CommonAlign = 1;
+  for (unsigned i = 1; i < mNumSymbols; ++i) {
+    const Elf64_Sym &Symbol = mSymbols[i];
+    if (Symbol.st_shndx == SHN_COMMON) {
+      uint64_t Align = std::max<uint64_t>(Symbol.st_value, 1);
+      if (Align > mPageSize) {
+        return fail("malformed common symbol " + getSymbolName(i).str());
+      }
+      CommonSize = llvm::alignTo(CommonSize, Align);
+      mSymbolAddr[i] = CommonSize;
+      CommonSize += Symbol.st_size;
+      CommonAlign = std::max(CommonAlign, Align);
+    }
+  }
+  unsigned CommonIndex = 0;
+  if (CommonSize != 0) {
+    CommonIndex = addSection(".bss.common", SHT_NOBITS, SHF_ALLOC | SHF_WRITE,
+                             CommonSize, CommonAlign, -1, Addr, Offset);
+  }
+  const uint64_t RWFileEnd = Offset;
+  const uint64_t RWEnd = Addr;
+
+  // The function and object symbols go into a symbol table, so that
+  // profilers can name the code that isn't exported, such as the expanded
+  // and fused kernels.  The symbols that aren't visible outside of the
+  // shared object are local to it, and come first.
+  std::vector<unsigned> StaticSymbols;
+  std::vector<uint32_t> StaticSymNameOffsets;
+  std::string StrTab(1, '\0');
+  unsigned NumLocalSymbols = 1;
+  auto IsLocal = [this](unsigned Sym) {
+    const Elf64_Sym &Symbol = mSymbols[Sym];
+    unsigned char Visibility = Symbol.st_other & 0x3;
+    return (Symbol.getBinding() == STB_LOCAL) ||
+           (Visibility == STV_HIDDEN) || (Visibility == STV_INTERNAL);
+  };
+  for (bool Local : {true, false}) {
+    for (unsigned i = 1; i < mNumSymbols; ++i) {
+      const Elf64_Sym &Symbol = mSymbols[i];
+      unsigned char Type = Symbol.getType();
+      if ((IsLocal(i) != Local) ||
+          ((Type != STT_FUNC) && (Type != STT_OBJECT)) ||
+          (Symbol.st_shndx >= mNumSections) ||
+          (mSectionIndex[Symbol.st_shndx] == 0) ||
+          getSymbolName(i).empty()) {
+        continue;
+      }
+      StaticSymbols.push_back(i);
+      StaticSymNameOffsets.push_back(StrTab.size());
+      StrTab += getSymbolName(i);
+      StrTab.push_back('\0');
+    }
+    if (Local) {
+      NumLocalSymbols = StaticSymbols.size() + 1;
+    }
+  }
+
+  // Non-allocated sections: the symbol table, its names and the section
+  // names, followed by the section header table.
+  const unsigned SymTabIndex = mOutput.size();
+  mOutput.push_back(OutputSection());
+  mOutput.back().Name = ".symtab";
+  mOutput.back().Type = SHT_SYMTAB;
+  mOutput.back().Offset = llvm::alignTo(RWFileEnd, 8);
+  mOutput.back().Size = (StaticSymbols.size() + 1) * sizeof(Elf64_Sym);
+  mOutput.back().Align = 8;
+  mOutput.back().EntSize = sizeof(Elf64_Sym);
+  mOutput.back().Info = NumLocalSymbols;
+  mOutput.back().Input = -1;
+
+  const unsigned StrTabIndex = mOutput.size();
+  mOutput.push_back(OutputSection());
+  mOutput.back().Name = ".strtab";
+  mOutput.back().Type = SHT_STRTAB;
+  mOutput.back().Offset = mOutput[SymTabIndex].Offset +
+                          mOutput[SymTabIndex].Size;
+  mOutput.back().Size = StrTab.size();
+  mOutput.back().Align = 1;
+  mOutput.back().Input = -1;
+  mOutput[SymTabIndex].Link = StrTabIndex;
+
+  const unsigned ShStrTabIndex = mOutput.size();
+  std::string ShStrTab(1, '\0');
+  mOutput.push_back(OutputSection());
+  mOutput.back().Name = ".shstrtab";
+  mOutput.back().Type = SHT_STRTAB;
+  mOutput.back().Align = 1;
+  mOutput.back().Input = -1;
+  std::vector<uint32_t> SectionNameOffsets(mOutput.size(), 0);
+  for (size_t i = 1; i < mOutput.size(); ++i) {
+    SectionNameOffsets[i] = ShStrTab.size();
+    ShStrTab += mOutput[i].Name;
+    ShStrTab.push_back('\0');
+  }
+  mOutput[ShStrTabIndex].Offset = mOutput[StrTabIndex].Offset + StrTab.size();
+  mOutput[ShStrTabIndex].Size = ShStrTab.size();
+  const uint64_t ShOff = llvm::alignTo(
+      mOutput[ShStrTabIndex].Offset + ShStrTab.size(), 8);
+
+  mOutput[HashIndex].Link = DynSymIndex;
+  mOutput[HashIndex].EntSize = sizeof(uint32_t);
+  mOutput[DynSymIndex].Link = DynStrIndex;
+  mOutput[DynSymIndex].Info = 1;
+  mOutput[DynSymIndex].EntSize = sizeof(Elf64_Sym);
+  if (RelaDynIndex != 0) {
+    mOutput[RelaDynIndex].Link = DynSymIndex;
+    mOutput[RelaDynIndex].EntSize = sizeof(Elf64_Rela);
+  }
+  mOutput[DynamicIndex].Link = DynStrIndex;
+  mOutput[DynamicIndex].EntSize = sizeof(Elf64_Dyn);
+  if (mGotIndex != 0) {
+    mOutput[mGotIndex].EntSize = 8;
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Symbol addresses
+  //===--------------------------------------------------------------------===//
+  for (unsigned i = 1; i < mNumSymbols; ++i) {
+    const Elf64_Sym &Symbol = mSymbols[i];
+    if (Symbol.st_shndx == SHN_ABS) {
+      mSymbolAddr[i] = Symbol.st_value;
+    } else if (Symbol.st_shndx == SHN_COMMON) {
+      mSymbolAddr[i] += mOutput[CommonIndex].Addr;
+    } else if ((Symbol.st_shndx != SHN_UNDEF) &&
+               (Symbol.st_shndx < mNumSections) &&
+               (mSectionIndex[Symbol.st_shndx] != 0)) {
+      mSymbolAddr[i] = mSectionAddr[Symbol.st_shndx] + Symbol.st_value;
+    }
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Contents
+  //===--------------------------------------------------------------------===//
+  pResult.assign(ShOff + mOutput.size() * sizeof(Elf64_Shdr), 0);
+  uint8_t *Buf = reinterpret_cast<uint8_t *>(pResult.data());
+
+  for (const OutputSection &Section : mOutput) {
+    if ((Section.Input >= 0) && (Section.Type != SHT_NOBITS)) {
+      memcpy(Buf + Section.Offset,
+             mObject.data() + mSections[Section.Input].sh_offset,
+             Section.Size);
+    }
+  }
+
+  if (!applyRelocations(Buf)) {
+    return false;
+  }
+
+  if (mGotIndex != 0) {
+    const OutputSection &Got = mOutput[mGotIndex];
+    for (size_t i = 0; i < mGotSymbols.size(); ++i) {
+      const unsigned Sym = mGotSymbols[i];
+      Elf64_Rela DynReloc = Elf64_Rela();
+      DynReloc.r_offset = Got.Addr + i * 8;
+      if (isUndefined(Sym)) {
+        DynReloc.setSymbolAndType(mDynSymIndex[Sym], mGlobDatReloc);
+      } else {
+        DynReloc.setSymbolAndType(0, mRelativeReloc);
+        DynReloc.r_addend = mSymbolAddr[Sym];
+        write64le(Buf + Got.Offset + i * 8, mSymbolAddr[Sym]);
+      }
+      mDynRelocs.push_back(DynReloc);
+    }
+  }
+
+  if (mPltIndex != 0) {
+    const OutputSection &Plt = mOutput[mPltIndex];
+    for (size_t i = 0; i < mPltSymbols.size(); ++i) {
+      writePltEntry(Buf + Plt.Offset + i * kPltEntrySize,
+                    Plt.Addr + i * kPltEntrySize,
+                    mOutput[mGotIndex].Addr + mGotSlot[mPltSymbols[i]] * 8);
+    }
+  }
+
+  bccAssert(mDynRelocs.size() == mNumDynRelocs);
+  if (RelaDynIndex != 0) {
+    memcpy(Buf + mOutput[RelaDynIndex].Offset, mDynRelocs.data(),
+           mDynRelocs.size() * sizeof(Elf64_Rela));
+  }
+
+  // .dynsym
+  for (size_t i = 0; i < mDynSymbols.size(); ++i) {
+    const unsigned Sym = mDynSymbols[i];
+    const Elf64_Sym &Symbol = mSymbols[Sym];
+    Elf64_Sym DynSym = Elf64_Sym();
+    DynSym.st_name = DynSymNameOffsets[i];
+    DynSym.st_info = Symbol.st_info;
+    DynSym.st_other = Symbol.st_other & 0x3;
+    if (!isUndefined(Sym)) {
+      DynSym.st_value = mSymbolAddr[Sym];
+      DynSym.st_size = Symbol.st_size;
+      if (Symbol.st_shndx == SHN_ABS) {
+        DynSym.st_shndx = SHN_ABS;
+      } else if (Symbol.st_shndx == SHN_COMMON) {
+        DynSym.st_shndx = CommonIndex;
+        DynSym.setBindingAndType(Symbol.getBinding(), STT_OBJECT);
+      } else {
+        DynSym.st_shndx = mSectionIndex[Symbol.st_shndx];
+      }
+    }
+    memcpy(Buf + mOutput[DynSymIndex].Offset + (i + 1) * sizeof(Elf64_Sym),
+           &DynSym, sizeof(DynSym));
+  }
+
+  // .dynstr
+  memcpy(Buf + mOutput[DynStrIndex].Offset, DynStr.data(), DynStr.size());
+
+  // .symtab
+  for (size_t i = 0; i < StaticSymbols.size(); ++i) {
+    const unsigned Sym = StaticSymbols[i];
+    const Elf64_Sym &Symbol = mSymbols[Sym];
+    Elf64_Sym StaticSym = Elf64_Sym();
+    StaticSym.st_name = StaticSymNameOffsets[i];
+    StaticSym.setBindingAndType(IsLocal(Sym) ? STB_LOCAL : Symbol.getBinding(),
+                                Symbol.getType());
+    StaticSym.st_other = Symbol.st_other & 0x3;
+    StaticSym.st_shndx = mSectionIndex[Symbol.st_shndx];
+    StaticSym.st_value = mSymbolAddr[Sym];
+    StaticSym.st_size = Symbol.st_size;
+    memcpy(Buf + mOutput[SymTabIndex].Offset + (i + 1) * sizeof(Elf64_Sym),
+           &StaticSym, sizeof(StaticSym));
+  }
+
+  // .strtab
+  memcpy(Buf + mOutput[StrTabIndex].Offset, StrTab.data(), StrTab.size());
+
+  // .hash
+  {
+    std::vector<uint32_t> Hash(2 + NumBuckets + NumDynSyms, 0);
+    Hash[0] = NumBuckets;
+    Hash[1] = NumDynSyms;
+    uint32_t *Buckets = &Hash[2];
+    uint32_t *Chains = &Hash[2 + NumBuckets];
+    for (size_t i = 1; i < NumDynSyms; ++i) {
+      uint32_t Bucket = hashSysV(getSymbolName(mDynSymbols[i - 1])) %
+                        NumBuckets;
+      Chains[i] = Buckets[Bucket];
+      Buckets[Bucket] = i;
+    }
+    for (size_t i = 0; i < Hash.size(); ++i) {
+      write32le(Buf + mOutput[HashIndex].Offset + i * sizeof(uint32_t),
+                Hash[i]);
+    }
+  }
+
+  // .dynamic
+  {
+    std::vector<Elf64_Dyn> Dynamic;
+    auto AddDynamic = [&Dynamic](int64_t Tag, uint64_t Value) {
+      Elf64_Dyn Entry = Elf64_Dyn();
+      Entry.d_tag = Tag;
+      Entry.d_un.d_val = Value;
+      Dynamic.push_back(Entry);
+    };
+    for (uint32_t NeededOffset : NeededOffsets) {
+      AddDynamic(DT_NEEDED, NeededOffset);
+    }
+    AddDynamic(DT_SONAME, SONameOffset);
+    AddDynamic(DT_HASH, mOutput[HashIndex].Addr);
+    AddDynamic(DT_STRTAB, mOutput[DynStrIndex].Addr);
+    AddDynamic(DT_SYMTAB, mOutput[DynSymIndex].Addr);
+    AddDynamic(DT_STRSZ, DynStr.size());
+    AddDynamic(DT_SYMENT, sizeof(Elf64_Sym));
+    if (RelaDynIndex != 0) {
+      AddDynamic(DT_RELA, mOutput[RelaDynIndex].Addr);
+      AddDynamic(DT_RELASZ, mOutput[RelaDynIndex].Size);
+      AddDynamic(DT_RELAENT, sizeof(Elf64_Rela));
+    }
+    if (!InitArrays.empty()) {
+      const OutputSection &First = mOutput[mSectionIndex[InitArrays.front()]];
+      const OutputSection &Last = mOutput[mSectionIndex[InitArrays.back()]];
+      AddDynamic(DT_INIT_ARRAY, First.Addr);
+      AddDynamic(DT_INIT_ARRAYSZ, Last.Addr + Last.Size - First.Addr);
+    }
+    if (!FiniArrays.empty()) {
+      const OutputSection &First = mOutput[mSectionIndex[FiniArrays.front()]];
+      const OutputSection &Last = mOutput[mSectionIndex[FiniArrays.back()]];
+      AddDynamic(DT_FINI_ARRAY, First.Addr);
+      AddDynamic(DT_FINI_ARRAYSZ, Last.Addr + Last.Size - First.Addr);
+    }
+    AddDynamic(DT_FLAGS, DF_BIND_NOW);
+    AddDynamic(DT_FLAGS_1, DF_1_NOW);
+    AddDynamic(DT_NULL, 0);
+    bccAssert(Dynamic.size() == NumDynamic);
+    memcpy(Buf + mOutput[DynamicIndex].Offset, Dynamic.data(),
+           Dynamic.size() * sizeof(Elf64_Dyn));
+  }
+
+  // .shstrtab and the section header table.
+  memcpy(Buf + mOutput[ShStrTabIndex].Offset, ShStrTab.data(), ShStrTab.size());
+  for (size_t i = 1; i < mOutput.size(); ++i) {
+    const OutputSection &Section = mOutput[i];
+    Elf64_Shdr Header = Elf64_Shdr();
+    Header.sh_name = SectionNameOffsets[i];
+    Header.sh_type = Section.Type;
+    Header.sh_flags = Section.Flags;
+    Header.sh_addr = Section.Addr;
+    Header.sh_offset = Section.Offset;
+    Header.sh_size = Section.Size;
+    Header.sh_link = Section.Link;
+    Header.sh_info = Section.Info;
+    Header.sh_addralign = Section.Align;
+    Header.sh_entsize = Section.EntSize;
+    memcpy(Buf + ShOff + i * sizeof(Elf64_Shdr), &Header, sizeof(Header));
+  }
+
+  // Program headers.
+  Elf64_Phdr Phdrs[kNumProgramHeaders];
+  memset(Phdrs, 0, sizeof(Phdrs));
+  Phdrs[0].p_type = PT_LOAD;
+  Phdrs[0].p_flags = PF_R | PF_X;
+  Phdrs[0].p_filesz = RXEnd;
+  Phdrs[0].p_memsz = RXEnd;
+  Phdrs[0].p_align = mPageSize;
+
+  Phdrs[1].p_type = PT_LOAD;
+  Phdrs[1].p_flags = PF_R | PF_W;
+  Phdrs[1].p_offset = RWOffset;
+  Phdrs[1].p_vaddr = RWAddr;
+  Phdrs[1].p_paddr = RWAddr;
+  Phdrs[1].p_filesz = RWFileEnd - RWOffset;
+  Phdrs[1].p_memsz = RWEnd - RWAddr;
+  Phdrs[1].p_align = mPageSize;
+
+  Phdrs[2].p_type = PT_DYNAMIC;
+  Phdrs[2].p_flags = PF_R | PF_W;
+  Phdrs[2].p_offset = mOutput[DynamicIndex].Offset;
+  Phdrs[2].p_vaddr = mOutput[DynamicIndex].Addr;
+  Phdrs[2].p_paddr = mOutput[DynamicIndex].Addr;
+  Phdrs[2].p_filesz = mOutput[DynamicIndex].Size;
+  Phdrs[2].p_memsz = mOutput[DynamicIndex].Size;
+  Phdrs[2].p_align = 8;
+
+  Phdrs[3].p_type = PT_GNU_STACK;
+  Phdrs[3].p_flags = PF_R | PF_W;
+
+  memcpy(Buf + sizeof(Elf64_Ehdr), Phdrs, sizeof(Phdrs));
+
+  // ELF header.
+  Elf64_Ehdr Header = *mHeader;
+  Header.e_type = ET_DYN;
+  Header.e_entry = 0;
+  Header.e_phoff = sizeof(Elf64_Ehdr);
+  Header.e_shoff = ShOff;
+  Header.e_ehsize = sizeof(Elf64_Ehdr);
+  Header.e_phentsize = sizeof(Elf64_Phdr);
+  Header.e_phnum = kNumProgramHeaders;
+  Header.e_shentsize = sizeof(Elf64_Shdr);
+  Header.e_shnum = mOutput.size();
+  Header.e_shstrndx = ShStrTabIndex;
+  memcpy(Buf, &Header, sizeof(Header));
+
+  return true;
+}
+
+}  // end anonymous namespace
+
+namespace bcc {
+
+bool linkSharedObject(llvm::StringRef pObject, const std::string &pSOName,
+                      const std::vector<std::string> &pNeeded,
+                      llvm::SmallVectorImpl<char> &pResult,
+                      std::string &pError) {
+  Linker linker(pObject, pError);
+  if (!linker.link(pSOName, pNeeded, pResult)) {
+    pResult.clear();
+    return false;
+  }
+  return true;
+}
+
+}  // end namespace bcc
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2026, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BCC_SHARED_OBJECT_LINKER_H
+#define BCC_SHARED_OBJECT_LINKER_H
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringRef.h>
+
+#include <string>
+#include <vector>
+
+namespace bcc {
+
+/// @brief Link a single relocatable object into a loadable shared object.
+///
+/// This is a minimal static linker for the objects the Compiler emits for one
+/// script: it lays out the allocated sections, resolves the relocations
+/// within the object, creates the dynamic symbol table for the defined
+/// default-visibility symbols and records pNeeded as DT_NEEDED entries.
+/// References to undefined symbols go through a GOT that is bound eagerly
+/// (DF_BIND_NOW), with a PLT stub per called function.  The function and
+/// object symbols are kept in a symbol table for profilers.
+///
+/// Only position-independent ELF64 objects for x86_64 and aarch64 are
+/// supported.
+///
+/// @param pObject The relocatable object.
+/// @param pSOName The DT_SONAME of the shared object.
+/// @param pNeeded The libraries the shared object depends on.
+/// @param pResult The shared object, on success.
+/// @param pError The reason for the failure, on failure.
+/// @return True, if the object was linked. False, if it uses a feature that
+/// isn't supported, in which case the caller should fall back to an external
+/// linker.
+bool linkSharedObject(llvm::StringRef pObject, const std::string &pSOName,
+                      const std::vector<std::string> &pNeeded,
+                      llvm::SmallVectorImpl<char> &pResult,
+                      std::string &pError);
+
+}  // end namespace bcc
+
+#endif  // BCC_SHARED_OBJECT_LINKER_H
@@ -56,6 +56,37 @@ static inline std::unique_ptr<llvm::Module> helper_load_bitcode(llvm::LLVMContex
   return std::move(moduleOrError.get());
 }
 
+// Helper function to decompress a compressed bitcode payload. The returned
+// buffer holds the raw bitcode and is handed over to the lazily loaded module,
+// so it lives exactly as long as materialization may need it. Return nullptr
+// on error.
+static std::unique_ptr<llvm::MemoryBuffer>
+helper_decompress_bitcode(const bcinfo::BitcodeWrapper &wrapper,
+                          const char *pName) {
+  // Don't trust the uncompressed size in the header for the allocation.
+  if (!wrapper.hasValidCompressedPayload()) {
+    ALOGE("Invalid compressed bitcode `%s'!", pName);
+    return nullptr;
+  }
+
+  std::unique_ptr<llvm::MemoryBuffer> output =
+      llvm::MemoryBuffer::getNewUninitMemBuffer(wrapper.getUncompressedSize(),
+                                                pName);
+  if (output == nullptr) {
+    ALOGE("Out of memory when decompressing bitcode `%s'!", pName);
+    return nullptr;
+  }
+
+  // The buffer was freshly allocated for us, so it is safe to write to it.
+  if (!wrapper.decompress(const_cast<char *>(output->getBufferStart()),
+                          output->getBufferSize())) {
+    ALOGE("Unable to decompress bitcode `%s'!", pName);
+    return nullptr;
+  }
+
+  return output;
+}
+
 static void helper_get_module_metadata_from_bitcode_wrapper(
     uint32_t *compilerVersion, uint32_t *optimizationLevel,
     const bcinfo::BitcodeWrapper &wrapper) {
@@ -104,9 +135,15 @@ Source *Source::CreateFromBuffer(BCCContext &pContext,
                                  const char *pName,
                                  const char *pBitcode,
                                  size_t pBitcodeSize) {
-  llvm::StringRef input_data(pBitcode, pBitcodeSize);
-  std::unique_ptr<llvm::MemoryBuffer> input_memory =
-      llvm::MemoryBuffer::getMemBuffer(input_data, "", false);
+  bcinfo::BitcodeWrapper wrapper(pBitcode, pBitcodeSize);
+
+  std::unique_ptr<llvm::MemoryBuffer> input_memory;
+  if (wrapper.isCompressed()) {
+    input_memory = helper_decompress_bitcode(wrapper, pName);
+  } else {
+    llvm::StringRef input_data(pBitcode, pBitcodeSize);
+    input_memory = llvm::MemoryBuffer::getMemBuffer(input_data, "", false);
+  }
 
   if (input_memory == nullptr) {
     ALOGE("Unable to load bitcode `%s' from buffer!", pName);
@@ -125,7 +162,7 @@ Source *Source::CreateFromBuffer(BCCContext &pContext,
 
   uint32_t compilerVersion, optimizationLevel;
   helper_get_module_metadata_from_bitcode_wrapper(&compilerVersion, &optimizationLevel,
-                                                  bcinfo::BitcodeWrapper(pBitcode, pBitcodeSize));
+                                                  wrapper);
   Source *result = CreateFromModule(pContext, pName, *module,
                                     compilerVersion, optimizationLevel,
                                     /* pNoDelete */false);
@@ -148,11 +185,21 @@ Source *Source::CreateFromFile(BCCContext &pContext, const std::string &pPath) {
   std::unique_ptr<llvm::MemoryBuffer> input_data = std::move(mb_or_error.get());
 
   uint32_t compilerVersion, optimizationLevel;
+  bcinfo::BitcodeWrapper wrapper(input_data->getBufferStart(),
+                                 input_data->getBufferSize());
   helper_get_module_metadata_from_bitcode_wrapper(&compilerVersion, &optimizationLevel,
-                                                  bcinfo::BitcodeWrapper(input_data->getBufferStart(),
-                                                                         input_data->getBufferSize()));
-
-  std::unique_ptr<llvm::MemoryBuffer> input_memory(input_data.release());
+                                                  wrapper);
+
+  std::unique_ptr<llvm::MemoryBuffer> input_memory;
+  if (wrapper.isCompressed()) {
+    // The compressed file contents are no longer needed once decompressed.
+    input_memory = helper_decompress_bitcode(wrapper, pPath.c_str());
+    if (input_memory == nullptr) {
+      return nullptr;
+    }
+  } else {
+    input_memory.reset(input_data.release());
+  }
   auto managedModule = helper_load_bitcode(pContext.mImpl->mLLVMContext,
                                            std::move(input_memory));
 
@@ -209,9 +256,12 @@ Source::~Source() {
   delete mMetadata;
 }
 
-bool Source::merge(Source &pSource) {
+bool Source::merge(Source &pSource, bool pOnlyNeeded) {
+  unsigned flags = pOnlyNeeded ? llvm::Linker::Flags::LinkOnlyNeeded
+                               : llvm::Linker::Flags::None;
   // TODO(srhines): Add back logging of actual diagnostics from linking.
-  if (llvm::Linker::linkModules(*mModule, std::unique_ptr<llvm::Module>(&pSource.getModule())) != 0) {
+  if (llvm::Linker::linkModules(*mModule, std::unique_ptr<llvm::Module>(&pSource.getModule()),
+                                flags) != 0) {
     ALOGE("Failed to link source `%s' with `%s'!",
           getIdentifier().c_str(), pSource.getIdentifier().c_str());
     return false;
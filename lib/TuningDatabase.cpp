@@ -0,0 +1,219 @@
+/*
+ * Copyright 2026, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "bcc/TuningDatabase.h"
+
+#include "Log.h"
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/IR/DebugInfo.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/ValueMap.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/LineIterator.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/ValueMapper.h>
+
+#include <memory>
+#include <vector>
+
+using namespace bcc;
+
+bool TuningDatabase::load(const char *pPath) {
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> mb_or_error =
+      llvm::MemoryBuffer::getFile(pPath);
+  if (std::error_code ec = mb_or_error.getError()) {
+    ALOGE("Unable to read tuning database %s! (%s)", pPath,
+          ec.message().c_str());
+    return false;
+  }
+
+  // line_iterator skips blank lines and lines starting with '#'.
+  for (llvm::line_iterator line(*mb_or_error.get(), /* SkipBlanks */true, '#');
+       !line.is_at_eof(); ++line) {
+    llvm::SmallVector<llvm::StringRef, 6> fields;
+    line->split(fields, ' ', -1, /* KeepEmpty */false);
+
+    Entry entry;
+    KernelTuningParams &params = entry.mParams;
+    if ((fields.size() < 5) || (fields.size() > 6) ||
+        fields[2].getAsInteger(10, params.mUnrollCount) ||
+        fields[3].getAsInteger(10, params.mVectorizeWidth) ||
+        fields[4].getAsInteger(10, params.mInterleaveCount)) {
+      ALOGE("Malformed entry in tuning database %s at line %d: '%s'", pPath,
+            static_cast<int>(line.line_number()), line->str().c_str());
+      return false;
+    }
+    if (fields.size() == 6) {
+      entry.mKernelName = fields[5].str();
+    }
+
+    mEntries[Key(fields[0].str(), fields[1].str())] = entry;
+  }
+
+  return true;
+}
+
+bool TuningDatabase::save(const char *pPath) const {
+  std::error_code ec;
+  llvm::raw_fd_ostream out(pPath, ec, llvm::sys::fs::F_Text);
+  if (ec) {
+    ALOGE("Unable to open %s for write! (%s)", pPath, ec.message().c_str());
+    return false;
+  }
+
+  out << "# <cpu> <ir-hash> <unroll> <vectorize-width> <interleave> "
+         "[<kernel-name>]\n";
+  for (const auto &I : mEntries) {
+    const KernelTuningParams &params = I.second.mParams;
+    out << I.first.first << ' ' << I.first.second << ' '
+        << params.mUnrollCount << ' ' << params.mVectorizeWidth << ' '
+        << params.mInterleaveCount;
+    if (!I.second.mKernelName.empty()) {
+      out << ' ' << I.second.mKernelName;
+    }
+    out << '\n';
+  }
+
+  return !out.has_error();
+}
+
+KernelTuningParams TuningDatabase::lookup(const std::string &pCPU,
+                                          const std::string &pHash,
+                                          const std::string &pKernelName) {
+  auto I = mEntries.find(Key(pCPU, pHash));
+  if (I != mEntries.end()) {
+    return I->second.mParams;
+  }
+
+  // Remember the kernel so that it shows up as a tuning candidate.
+  Entry &entry = mEntries[Key(pCPU, pHash)];
+  entry.mKernelName = pKernelName;
+  mDirty = true;
+  return entry.mParams;
+}
+
+void TuningDatabase::insert(const std::string &pCPU, const std::string &pHash,
+                            const std::string &pKernelName,
+                            const KernelTuningParams &pParams) {
+  Entry &entry = mEntries[Key(pCPU, pHash)];
+  entry.mParams = pParams;
+  entry.mKernelName = pKernelName;
+  mDirty = true;
+}
+
+namespace {
+
+// Declares the globals a cloned kernel refers to in the module it is cloned
+// into, as they are reached, so that nothing else of the script is visited.
+class DeclarationMaterializer final : public llvm::ValueMaterializer {
+  llvm::Module &mModule;
+
+public:
+  explicit DeclarationMaterializer(llvm::Module &pModule) : mModule(pModule) {}
+
+  llvm::Value *materialize(llvm::Value *V) override {
+    auto *GV = llvm::dyn_cast<llvm::GlobalValue>(V);
+    if (GV == nullptr) {
+      return nullptr;
+    }
+
+    llvm::Type *Ty = GV->getValueType();
+    if (auto *FTy = llvm::dyn_cast<llvm::FunctionType>(Ty)) {
+      llvm::Function *F = llvm::Function::Create(
+          FTy, llvm::GlobalValue::ExternalLinkage, GV->getName(), &mModule);
+      if (auto *Orig = llvm::dyn_cast<llvm::Function>(GV)) {
+        F->setAttributes(Orig->getAttributes());
+        F->setCallingConv(Orig->getCallingConv());
+      }
+      return F;
+    }
+
+    auto *Orig = llvm::dyn_cast<llvm::GlobalVariable>(GV);
+    return new llvm::GlobalVariable(
+        mModule, Ty, Orig != nullptr && Orig->isConstant(),
+        llvm::GlobalValue::ExternalLinkage, nullptr, GV->getName(), nullptr,
+        GV->getThreadLocalMode(), GV->getType()->getAddressSpace());
+  }
+};
+
+}  // end anonymous namespace
+
+std::string TuningDatabase::hashKernel(const llvm::Function &pKernel) {
+  // The attribute group, metadata and debug location numbers in the IR of the
+  // kernel depend on the rest of the script, so print a copy of the kernel
+  // alone in a module of its own, along with declarations of the globals it
+  // refers to, without debug info.
+  const llvm::Module *M = pKernel.getParent();
+  llvm::Module Canonical("", pKernel.getContext());
+  Canonical.setDataLayout(M->getDataLayout());
+  Canonical.setTargetTriple(M->getTargetTriple());
+
+  llvm::Function *Kernel = llvm::Function::Create(
+      pKernel.getFunctionType(), pKernel.getLinkage(), pKernel.getName(),
+      &Canonical);
+  llvm::ValueToValueMapTy VMap;
+  VMap[&pKernel] = Kernel;
+  auto NewArg = Kernel->arg_begin();
+  for (const llvm::Argument &Arg : pKernel.args()) {
+    NewArg->setName(Arg.getName());
+    VMap[&Arg] = &*NewArg++;
+  }
+  // The debug info is stripped below; don't copy the script's along.
+  if (const llvm::DISubprogram *SP = pKernel.getSubprogram()) {
+    if (const llvm::DICompileUnit *CU = SP->getUnit()) {
+      VMap.MD()[CU].reset(const_cast<llvm::DICompileUnit *>(CU));
+    }
+  }
+
+  DeclarationMaterializer Materializer(Canonical);
+  llvm::SmallVector<llvm::ReturnInst *, 4> Returns;
+  llvm::CloneFunctionInto(Kernel, &pKernel, VMap,
+                          /* ModuleLevelChanges */true, Returns, "", nullptr,
+                          nullptr, &Materializer);
+  llvm::StripDebugInfo(Canonical);
+
+  // Drop what only the debug info referred to.
+  std::vector<llvm::GlobalValue *> Unused;
+  for (llvm::Function &F : Canonical) {
+    if (F.isDeclaration() && F.use_empty()) {
+      Unused.push_back(&F);
+    }
+  }
+  for (llvm::GlobalValue *GV : Unused) {
+    GV->eraseFromParent();
+  }
+
+  std::string text;
+  llvm::raw_string_ostream os(text);
+  Canonical.print(os, nullptr);
+  os.flush();
+
+  llvm::MD5 hasher;
+  hasher.update(text);
+  llvm::MD5::MD5Result result;
+  hasher.final(result);
+
+  llvm::SmallString<32> hash;
+  llvm::MD5::stringifyResult(result, hash);
+  return hash.str();
+}
@@ -32,6 +32,7 @@ LOCAL_CFLAGS_arm64 += -DFORCE_ARM64_CODEGEN -DARCH_ARM_HAVE_NEON -DARCH_ARM_HAVE
 
 LOCAL_CFLAGS_x86 += -DFORCE_X86_CODEGEN
 LOCAL_CFLAGS_x86_64 += -DFORCE_X86_64_CODEGEN
+LOCAL_CFLAGS_riscv64 += -DFORCE_RISCV64_CODEGEN
 
 ifeq ($(BUILD_ARM_FOR_X86),true)
 LOCAL_CFLAGS_x86 += -DPROVIDE_ARM_CODEGEN -DFORCE_BUILD_ARM
@@ -39,7 +40,7 @@ LOCAL_CFLAGS_x86_64 += -DPROVIDE_ARM_CODEGEN -DFORCE_BUILD_ARM -DPROVIDE_ARM64_C
 endif
 
 
-ifeq (,$(filter $(TARGET_ARCH),arm64 arm x86 x86_64))
+ifeq (,$(filter $(TARGET_ARCH),arm64 arm x86 x86_64 riscv64))
   $(error Unsupported architecture $(TARGET_ARCH))
 endif
 
@@ -0,0 +1,73 @@
+; This checks that RSForEachExpand versions the loop of an expanded kernel on
+; the alignment of its allocations when the module records an allocation
+; alignment contract: an aligned copy of the loop that assumes the alignment,
+; and an unaligned fallback copy. The loop is left alone when versioning is
+; turned off, as the compiler driver does at -O0.
+
+; RUN: opt -load libbcc.so -kernelexp -S < %s | FileCheck %s
+; RUN: opt -load libbcc.so -kernelexp -rs-alignment-versioning=false -S < %s \
+; RUN:   | FileCheck %s --check-prefix=NOVERSION
+
+target datalayout = "e-m:e-i64:64-i128:128-n32:64-S128"
+target triple = "aarch64-none-linux-gnueabi"
+
+; Declarations expected by the expansion pass.
+declare void @_Z14rsGetElementAt13rs_allocationj()
+declare void @_Z14rsGetElementAt13rs_allocationjj()
+declare void @_Z14rsGetElementAt13rs_allocationjjj()
+declare void @_Z14rsSetElementAt13rs_allocationPvj()
+declare void @_Z14rsSetElementAt13rs_allocationPvjj()
+declare void @_Z14rsSetElementAt13rs_allocationPvjjj()
+declare void @_Z25rsGetElementAtYuv_uchar_Y13rs_allocationjj()
+declare void @_Z25rsGetElementAtYuv_uchar_U13rs_allocationjj()
+declare void @_Z25rsGetElementAtYuv_uchar_V13rs_allocationjj()
+
+define <4 x float> @scale(<4 x float> %in) {
+  %1 = fmul <4 x float> %in, <float 2.0, float 2.0, float 2.0, float 2.0>
+  ret <4 x float> %1
+}
+
+; CHECK: define void @scale.expand(%RsExpandKernelDriverInfoPfx* %p, i32 %x1, i32 %x2, i32 %arg_outstep)
+; CHECK: br i1 %{{[0-9]+}}, label %Loop.guard, label %Exit
+; CHECK: Loop.guard:
+; CHECK: %misalignment = and i64 %{{[0-9]+}}, 63
+; CHECK: %is_aligned = icmp eq i64 %misalignment, 0
+; CHECK: br i1 %is_aligned, label %Loop.aligned, label %Loop.unaligned
+; CHECK: Loop.aligned:
+; CHECK: call void @llvm.assume(
+; CHECK: call void @llvm.assume(
+; CHECK: br label %Loop
+; CHECK: Loop:
+; CHECK: call <4 x float> @scale(<4 x float> %input)
+; CHECK: br i1 %{{[0-9]+}}, label %Loop, label %Exit
+; CHECK: Loop.unaligned:
+; CHECK: call <4 x float> @scale(<4 x float> %input.unaligned)
+; CHECK: br i1 %{{[0-9]+}}, label %Loop.unaligned, label %Exit
+
+; NOVERSION: define void @scale.expand(
+; NOVERSION-NOT: llvm.assume
+; NOVERSION-NOT: Loop.unaligned
+; NOVERSION: call <4 x float> @scale(<4 x float> %input)
+; NOVERSION-NOT: llvm.assume
+; NOVERSION-NOT: Loop.unaligned
+
+!llvm.ident = !{!0}
+!\23pragma = !{!1, !2}
+!\23rs_export_foreach_name = !{!3}
+!\23rs_export_foreach = !{!4}
+!\23rs_allocation_alignment = !{!6}
+
+; The following named metadata would not be present in a bitcode file,
+; but instead synthesized by bcc from the bitcode wrapper.  However,
+; for this test case, we're not running bcc, but instead opt, and so
+; we never get the opportunity to synthesize this named metadata.
+!\23rs_wrapper = !{!5}
+
+!0 = !{!"clang version 3.6 "}
+!1 = !{!"version", !"1"}
+!2 = !{!"java_package_name", !"foo"}
+!3 = !{!"scale"}
+; In | Out | Kernel
+!4 = !{!"35"}
+!5 = !{!"0", !"3"}
+!6 = !{!"64"}
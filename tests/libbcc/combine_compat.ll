@@ -0,0 +1,69 @@
+; This checks that bcc_compat -combine compiles each input bitcode file as a
+; separate script into a single object: the symbols of each script, including
+; its .rs.info, are prefixed with the name of its file followed by '.'.  Two
+; scripts with the same name are rejected, since their symbols would clash.
+; The symbol names are matched up to the end of the line with a '<' appended
+; by sed, as in test_reduce_general_cleanup.ll.
+
+; RUN: rm -rf %T/combine_compat && mkdir -p %T/combine_compat/dup
+; RUN: llvm-rs-as %s -o %T/combine_compat/first.bc
+; RUN: llvm-rs-as %s -o %T/combine_compat/second.bc
+; RUN: bcc_compat -combine -rt-path libclcore.bc \
+; RUN:     -mtriple aarch64-none-linux-gnueabi \
+; RUN:     -o %T/combine_compat/combined.o \
+; RUN:     %T/combine_compat/first.bc %T/combine_compat/second.bc
+; RUN: llvm-objdump -t %T/combine_compat/combined.o | sed -e 's!$!<!' \
+; RUN:     > %T/combine_compat/combined.syms
+; RUN: FileCheck %s < %T/combine_compat/combined.syms
+; RUN: FileCheck %s --check-prefix=UNPREFIXED \
+; RUN:     < %T/combine_compat/combined.syms
+
+; RUN: cp %T/combine_compat/first.bc %T/combine_compat/dup/first.bc
+; RUN: not bcc_compat -combine -rt-path libclcore.bc \
+; RUN:     -mtriple aarch64-none-linux-gnueabi \
+; RUN:     -o %T/combine_compat/dup.o \
+; RUN:     %T/combine_compat/first.bc %T/combine_compat/dup/first.bc 2>&1 \
+; RUN:     | FileCheck %s --check-prefix=DUP
+; RUN: test ! -e %T/combine_compat/dup.o
+
+; CHECK-DAG: {{[[:space:]]}}first..rs.info<
+; CHECK-DAG: {{[[:space:]]}}second..rs.info<
+; CHECK-DAG: {{[[:space:]]}}first.gScale<
+; CHECK-DAG: {{[[:space:]]}}second.gScale<
+; CHECK-DAG: {{[[:space:]]}}first.scale.expand<
+; CHECK-DAG: {{[[:space:]]}}second.scale.expand<
+
+; UNPREFIXED-NOT: {{[[:space:]]}}.rs.info<
+; UNPREFIXED-NOT: {{[[:space:]]}}gScale<
+; UNPREFIXED-NOT: {{[[:space:]]}}scale.expand<
+
+; DUP: More than one script is named `first' (from `{{.*}}dup/first.bc')!
+
+target datalayout = "e-m:e-i64:64-i128:128-n32:64-S128"
+target triple = "aarch64-none-linux-gnueabi"
+
+@gScale = global float 2.0, align 4
+
+define <4 x float> @scale(<4 x float> %in) {
+  %1 = load float, float* @gScale, align 4
+  %2 = insertelement <4 x float> undef, float %1, i32 0
+  %3 = shufflevector <4 x float> %2, <4 x float> undef, <4 x i32> zeroinitializer
+  %4 = fmul <4 x float> %in, %3
+  ret <4 x float> %4
+}
+
+!llvm.ident = !{!0}
+!\23pragma = !{!1, !2}
+!\23rs_export_var = !{!3}
+!\23rs_export_foreach_name = !{!4, !5}
+!\23rs_export_foreach = !{!6, !7}
+
+!0 = !{!"clang version 3.6 "}
+!1 = !{!"version", !"1"}
+!2 = !{!"java_package_name", !"foo"}
+!3 = !{!"gScale", !"2"}
+!4 = !{!"root"}
+!5 = !{!"scale"}
+!6 = !{!"0"}
+; In | Out | Kernel
+!7 = !{!"35"}
@@ -0,0 +1,55 @@
+; This checks that bitcode with a zstd-compressed payload reads back the same
+; as the uncompressed bitcode, through bcinfo and through bcc, and that a
+; wrapper whose uncompressed size doesn't match the payload is rejected
+; before anything is allocated for it.
+
+; RUN: llvm-rs-as %s -o %t
+; RUN: bcinfo --compress %t.zst %t
+; RUN: bcinfo %t.zst | FileCheck %s
+; RUN: bcc -o compressed_bitcode -output_path %T -bclib libclcore.bc \
+; RUN:     -mtriple aarch64-none-linux-gnueabi -emit-llvm %t.zst
+; RUN: FileCheck %s --check-prefix=IR < %T/compressed_bitcode.o.ll
+
+; The uncompressed size is at offset 52 of the compressed wrapper.
+; RUN: cp %t.zst %t.huge
+; RUN: printf '\377\377\377\177' \
+; RUN:     | dd of=%t.huge bs=1 seek=52 conv=notrunc 2>/dev/null
+; RUN: not bcinfo %t.huge 2>&1 | FileCheck %s --check-prefix=BAD
+; RUN: not bcc -o compressed_bitcode-huge -output_path %T -bclib libclcore.bc \
+; RUN:     -mtriple aarch64-none-linux-gnueabi %t.huge
+; RUN: cp %t.zst %t.small
+; RUN: printf '\020\000\000\000' \
+; RUN:     | dd of=%t.small bs=1 seek=52 conv=notrunc 2>/dev/null
+; RUN: not bcinfo %t.small 2>&1 | FileCheck %s --check-prefix=BAD
+; RUN: not bcc -o compressed_bitcode-small -output_path %T \
+; RUN:     -bclib libclcore.bc -mtriple aarch64-none-linux-gnueabi %t.small
+
+; CHECK: Found bitcodeWrapper
+; CHECK: compression: 1 (uncompressed size
+; CHECK: exportForEachSignatureList[1]: twice - 0x00000023 - 1
+
+; IR: define void @twice.expand(
+
+; BAD: failed to translate bitcode
+
+target datalayout = "e-m:e-i64:64-i128:128-n32:64-S128"
+target triple = "aarch64-none-linux-gnueabi"
+
+define i32 @twice(i32 %in) {
+  %1 = shl i32 %in, 1
+  ret i32 %1
+}
+
+!llvm.ident = !{!0}
+!\23pragma = !{!1, !2}
+!\23rs_export_foreach_name = !{!3, !4}
+!\23rs_export_foreach = !{!5, !6}
+
+!0 = !{!"clang version 3.6 "}
+!1 = !{!"version", !"1"}
+!2 = !{!"java_package_name", !"foo"}
+!3 = !{!"root"}
+!4 = !{!"twice"}
+!5 = !{!"0"}
+; In | Out | Kernel
+!6 = !{!"35"}
@@ -0,0 +1,56 @@
+; This checks that RSEntryTablePass lays out .rs.entry_table in the order of
+; the export lists, followed by init and .rs.dtor, with null entries for the
+; symbols that are absent from the module.
+
+; RUN: opt -load libbcc.so -embed-rs-entry-table -S < %s | FileCheck %s
+
+target datalayout = "e-m:e-i64:64-i128:128-n32:64-S128"
+target triple = "aarch64-none-linux-gnueabi"
+
+%RsExpandKernelDriverInfoPfx = type opaque
+
+@gScale = global float 1.000000e+00, align 4
+
+; CHECK: @.rs.entry_table = constant [7 x i8*] [i8* bitcast (float* @gScale to i8*), i8* bitcast (void ()* @scale to i8*), i8* null, i8* null, i8* bitcast (void (%RsExpandKernelDriverInfoPfx*, i32, i32, i32)* @invert.expand to i8*), i8* bitcast (void ()* @init to i8*), i8* null]
+
+define void @scale() {
+  ret void
+}
+
+define <4 x i8> @invert(<4 x i8> %in) {
+  %1 = xor <4 x i8> %in, <i8 -1, i8 -1, i8 -1, i8 0>
+  ret <4 x i8> %1
+}
+
+define void @invert.expand(%RsExpandKernelDriverInfoPfx* %p, i32 %x1, i32 %x2, i32 %arg_outstep) {
+  ret void
+}
+
+define void @init() {
+  ret void
+}
+
+!llvm.ident = !{!0}
+!\23pragma = !{!1, !2}
+!\23rs_export_var = !{!3}
+!\23rs_export_func = !{!4, !5}
+!\23rs_export_foreach_name = !{!6, !7}
+!\23rs_export_foreach = !{!8, !9}
+
+; The following named metadata would not be present in a bitcode file,
+; but instead synthesized by bcc from the bitcode wrapper.  However,
+; for this test case, we're not running bcc, but instead opt, and so
+; we never get the opportunity to synthesize this named metadata.
+!\23rs_wrapper = !{!10}
+
+!0 = !{!"clang version 3.6 "}
+!1 = !{!"version", !"1"}
+!2 = !{!"java_package_name", !"foo"}
+!3 = !{!"gScale", !"1"}
+!4 = !{!"scale"}
+!5 = !{!"missing"}
+!6 = !{!"root"}
+!7 = !{!"invert"}
+!8 = !{!"0"}
+!9 = !{!"35"}
+!10 = !{!"0", !"3"}
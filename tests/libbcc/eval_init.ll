@@ -0,0 +1,44 @@
+; This checks that RSEvaluateInitPass bakes a table computed by init()
+; through a loop and a helper function into the initializer of the global,
+; and removes init().
+
+; RUN: opt -load libbcc.so -rs-eval-init -S < %s | FileCheck %s
+
+target datalayout = "e-m:e-i64:64-i128:128-n32:64-S128"
+target triple = "aarch64-none-linux-gnueabi"
+
+; CHECK: @lut = global [8 x i32] [i32 0, i32 1, i32 4, i32 9, i32 16, i32 25, i32 36, i32 49]
+@lut = global [8 x i32] zeroinitializer, align 4
+
+; CHECK: @gain = global float 2.500000e+00
+@gain = global float 1.000000e+00, align 4
+
+; CHECK-NOT: define void @init()
+; CHECK-NOT: init.eval
+
+define internal i32 @square(i32 %x) {
+entry:
+  %mul = mul nsw i32 %x, %x
+  ret i32 %mul
+}
+
+define void @init() {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i32 [ 0, %entry ], [ %inc, %for.body ]
+  %sq = call i32 @square(i32 %i)
+  %idx = sext i32 %i to i64
+  %arrayidx = getelementptr inbounds [8 x i32], [8 x i32]* @lut, i64 0, i64 %idx
+  store i32 %sq, i32* %arrayidx, align 4
+  %inc = add nuw nsw i32 %i, 1
+  %cmp = icmp slt i32 %inc, 8
+  br i1 %cmp, label %for.body, label %for.end
+
+for.end:
+  %g = load float, float* @gain, align 4
+  %g2 = fmul float %g, 2.500000e+00
+  store float %g2, float* @gain, align 4
+  ret void
+}
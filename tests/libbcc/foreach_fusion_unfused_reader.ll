@@ -0,0 +1,126 @@
+; This checks that RSForEachFusionPass only treats an intermediate allocation
+; as unobservable if every chain reading it is fused: the chain in @convert
+; can't be fused, since @scale doesn't take what @brighten returns, so it
+; still reads @tmp, and the chain through @tmp in @process is left alone too.
+
+; RUN: opt -load libbcc.so -rs-foreach-fusion -S < %s | FileCheck %s
+
+target datalayout = "e-m:e-i64:64-i128:128-n32:64-S128"
+target triple = "aarch64-none-linux-gnueabi"
+
+%struct.rs_allocation = type { i64*, i64*, i64*, i64* }
+%struct.rs_script_call = type opaque
+
+@gIn = global %struct.rs_allocation zeroinitializer, align 8
+@gOut = global %struct.rs_allocation zeroinitializer, align 8
+@gOutF = global %struct.rs_allocation zeroinitializer, align 8
+@tmp = internal global %struct.rs_allocation zeroinitializer, align 8
+
+declare void @_Z17rsForEachInternaliP14rs_script_calliiP13rs_allocation(i32, %struct.rs_script_call*, i32, i32, %struct.rs_allocation*)
+declare void @_Z26rsCreateAllocation_uchar4jj(%struct.rs_allocation* sret, i32, i32)
+declare void @_Z11rsSetObjectP13rs_allocationS_(%struct.rs_allocation*, %struct.rs_allocation*)
+declare void @_Z13rsClearObjectP13rs_allocation(%struct.rs_allocation*)
+declare void @llvm.memcpy.p0i8.p0i8.i64(i8*, i8*, i64, i32, i1)
+
+define <4 x i8> @brighten(<4 x i8> %in) #0 {
+  %1 = shl <4 x i8> %in, <i8 1, i8 1, i8 1, i8 1>
+  ret <4 x i8> %1
+}
+
+define <4 x i8> @invert(<4 x i8> %in) #0 {
+  %1 = xor <4 x i8> %in, <i8 -1, i8 -1, i8 -1, i8 -1>
+  ret <4 x i8> %1
+}
+
+define <4 x float> @scale(<4 x float> %in) #0 {
+  %1 = fmul <4 x float> %in, <float 2.0, float 2.0, float 2.0, float 2.0>
+  ret <4 x float> %1
+}
+
+define void @init() {
+  %t = alloca %struct.rs_allocation, align 8
+  call void @_Z26rsCreateAllocation_uchar4jj(%struct.rs_allocation* sret %t, i32 64, i32 64)
+  call void @_Z11rsSetObjectP13rs_allocationS_(%struct.rs_allocation* @tmp, %struct.rs_allocation* %t)
+  call void @_Z13rsClearObjectP13rs_allocation(%struct.rs_allocation* %t)
+  ret void
+}
+
+; CHECK-LABEL: define void @process()
+; CHECK: call void @_Z17rsForEachInternaliP14rs_script_calliiP13rs_allocation(i32 1,
+; CHECK: call void @_Z17rsForEachInternaliP14rs_script_calliiP13rs_allocation(i32 2,
+define void @process() {
+  %a1 = alloca [2 x %struct.rs_allocation], align 8
+  %a2 = alloca [2 x %struct.rs_allocation], align 8
+  %a1.in = getelementptr inbounds [2 x %struct.rs_allocation], [2 x %struct.rs_allocation]* %a1, i64 0, i64 0
+  %a1.out = getelementptr inbounds [2 x %struct.rs_allocation], [2 x %struct.rs_allocation]* %a1, i64 0, i64 1
+  %1 = bitcast %struct.rs_allocation* %a1.in to i8*
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %1, i8* bitcast (%struct.rs_allocation* @gIn to i8*), i64 32, i32 8, i1 false)
+  %2 = bitcast %struct.rs_allocation* %a1.out to i8*
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %2, i8* bitcast (%struct.rs_allocation* @tmp to i8*), i64 32, i32 8, i1 false)
+  call void @_Z17rsForEachInternaliP14rs_script_calliiP13rs_allocation(i32 1, %struct.rs_script_call* null, i32 1, i32 1, %struct.rs_allocation* %a1.in)
+  %a2.in = getelementptr inbounds [2 x %struct.rs_allocation], [2 x %struct.rs_allocation]* %a2, i64 0, i64 0
+  %a2.out = getelementptr inbounds [2 x %struct.rs_allocation], [2 x %struct.rs_allocation]* %a2, i64 0, i64 1
+  %3 = bitcast %struct.rs_allocation* %a2.in to i8*
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %3, i8* bitcast (%struct.rs_allocation* @tmp to i8*), i64 32, i32 8, i1 false)
+  %4 = bitcast %struct.rs_allocation* %a2.out to i8*
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %4, i8* bitcast (%struct.rs_allocation* @gOut to i8*), i64 32, i32 8, i1 false)
+  call void @_Z17rsForEachInternaliP14rs_script_calliiP13rs_allocation(i32 2, %struct.rs_script_call* null, i32 1, i32 1, %struct.rs_allocation* %a2.in)
+  ret void
+}
+
+; CHECK-LABEL: define void @convert()
+; CHECK: call void @_Z17rsForEachInternaliP14rs_script_calliiP13rs_allocation(i32 1,
+; CHECK: call void @_Z17rsForEachInternaliP14rs_script_calliiP13rs_allocation(i32 3,
+define void @convert() {
+  %a1 = alloca [2 x %struct.rs_allocation], align 8
+  %a2 = alloca [2 x %struct.rs_allocation], align 8
+  %a1.in = getelementptr inbounds [2 x %struct.rs_allocation], [2 x %struct.rs_allocation]* %a1, i64 0, i64 0
+  %a1.out = getelementptr inbounds [2 x %struct.rs_allocation], [2 x %struct.rs_allocation]* %a1, i64 0, i64 1
+  %1 = bitcast %struct.rs_allocation* %a1.in to i8*
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %1, i8* bitcast (%struct.rs_allocation* @gIn to i8*), i64 32, i32 8, i1 false)
+  %2 = bitcast %struct.rs_allocation* %a1.out to i8*
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %2, i8* bitcast (%struct.rs_allocation* @tmp to i8*), i64 32, i32 8, i1 false)
+  call void @_Z17rsForEachInternaliP14rs_script_calliiP13rs_allocation(i32 1, %struct.rs_script_call* null, i32 1, i32 1, %struct.rs_allocation* %a1.in)
+  %a2.in = getelementptr inbounds [2 x %struct.rs_allocation], [2 x %struct.rs_allocation]* %a2, i64 0, i64 0
+  %a2.out = getelementptr inbounds [2 x %struct.rs_allocation], [2 x %struct.rs_allocation]* %a2, i64 0, i64 1
+  %3 = bitcast %struct.rs_allocation* %a2.in to i8*
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %3, i8* bitcast (%struct.rs_allocation* @tmp to i8*), i64 32, i32 8, i1 false)
+  %4 = bitcast %struct.rs_allocation* %a2.out to i8*
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %4, i8* bitcast (%struct.rs_allocation* @gOutF to i8*), i64 32, i32 8, i1 false)
+  call void @_Z17rsForEachInternaliP14rs_script_calliiP13rs_allocation(i32 3, %struct.rs_script_call* null, i32 1, i32 1, %struct.rs_allocation* %a2.in)
+  ret void
+}
+
+; The kernel fused for @process before @convert turned out not to be fusable
+; is dropped again.
+; CHECK-NOT: fused
+; CHECK: !\23rs_export_foreach_name = !{!{{[0-9]+}}, !{{[0-9]+}}, !{{[0-9]+}}, !{{[0-9]+}}}
+; CHECK: !\23rs_export_foreach = !{!{{[0-9]+}}, !{{[0-9]+}}, !{{[0-9]+}}, !{{[0-9]+}}}
+
+attributes #0 = { nounwind readnone }
+
+!llvm.ident = !{!0}
+!\23pragma = !{!1, !2}
+!\23rs_export_var = !{!3, !4, !11}
+!\23rs_export_foreach_name = !{!5, !6, !7, !12}
+!\23rs_export_foreach = !{!8, !9, !9, !9}
+
+; The following named metadata would not be present in a bitcode file,
+; but instead synthesized by bcc from the bitcode wrapper.  However,
+; for this test case, we're not running bcc, but instead opt, and so
+; we never get the opportunity to synthesize this named metadata.
+!\23rs_wrapper = !{!10}
+
+!0 = !{!"clang version 3.6 "}
+!1 = !{!"version", !"1"}
+!2 = !{!"java_package_name", !"foo"}
+!3 = !{!"gIn", !"20"}
+!4 = !{!"gOut", !"20"}
+!5 = !{!"root"}
+!6 = !{!"brighten"}
+!7 = !{!"invert"}
+!8 = !{!"0"}
+!9 = !{!"35"}
+!10 = !{!"0", !"3"}
+!11 = !{!"gOutF", !"20"}
+!12 = !{!"scale"}
@@ -0,0 +1,161 @@
+; This checks that RSBoundsCheckHoistingPass replaces the checked element
+; accesses of the debug runtime at affine indices of a kernel with a check
+; of the whole launch before its expanded loop, falling back to the checked
+; loop, and that it leaves a kernel none of whose accesses can be checked alone.
+
+; RUN: opt -load libbcc.so -rs-hoist-bounds-checks -S < %s | FileCheck %s
+
+target datalayout = "e-m:e-i64:64-i128:128-n32:64-S128"
+target triple = "aarch64-none-linux-gnueabi"
+
+%struct.rs_allocation = type { i64*, i64*, i64*, i64* }
+%struct.rs_element = type { i64*, i64*, i64*, i64* }
+%RsExpandKernelDriverInfoPfx = type opaque
+
+@gIn = global %struct.rs_allocation zeroinitializer, align 8
+@gOut = global %struct.rs_allocation zeroinitializer, align 8
+@gOffset = global i32 0, align 4
+
+declare void @llvm.memcpy.p0i8.p0i8.i64(i8*, i8*, i64, i32, i1)
+
+; The checked accessors of the debug runtime.
+declare void @_Z24rsGetElementAtImpl_float13rs_allocationPfjjj(%struct.rs_allocation*, float*, i32, i32, i32)
+declare void @_Z24rsSetElementAtImpl_float13rs_allocationPfjjj(%struct.rs_allocation*, float*, i32, i32, i32)
+
+define float @_Z20rsGetElementAt_float13rs_allocationj(%struct.rs_allocation* %a, i32 %x) {
+  %tmp = alloca float, align 4
+  call void @_Z24rsGetElementAtImpl_float13rs_allocationPfjjj(%struct.rs_allocation* %a, float* %tmp, i32 %x, i32 0, i32 0)
+  %1 = load float, float* %tmp, align 4
+  ret float %1
+}
+
+define void @_Z20rsSetElementAt_float13rs_allocationfj(%struct.rs_allocation* %a, float %v, i32 %x) {
+  %tmp = alloca float, align 4
+  store float %v, float* %tmp, align 4
+  call void @_Z24rsSetElementAtImpl_float13rs_allocationPfjjj(%struct.rs_allocation* %a, float* %tmp, i32 %x, i32 0, i32 0)
+  ret void
+}
+
+; The runtime functions the launch-time check is built from.
+define i8* @_Z14rsGetElementAt13rs_allocationjjj(%struct.rs_allocation* %a, i32 %x, i32 %y, i32 %z) {
+  ret i8* null
+}
+
+define i32 @_Z19rsAllocationGetDimX13rs_allocation(%struct.rs_allocation* %a) {
+  ret i32 0
+}
+
+define i32 @_Z19rsAllocationGetDimY13rs_allocation(%struct.rs_allocation* %a) {
+  ret i32 0
+}
+
+define i32 @_Z19rsAllocationGetDimZ13rs_allocation(%struct.rs_allocation* %a) {
+  ret i32 0
+}
+
+define void @_Z22rsAllocationGetElement13rs_allocation(%struct.rs_element* noalias sret %agg.result, %struct.rs_allocation* %a) {
+  ret void
+}
+
+define i32 @_Z20rsElementGetDataType10rs_element(%struct.rs_element* %e) {
+  ret i32 0
+}
+
+define i32 @_Z22rsElementGetVectorSize10rs_element(%struct.rs_element* %e) {
+  ret i32 0
+}
+
+; out[x] = (in[x] + in[x + 1]) / 2
+define void @blur(i32 %x) {
+  %in = alloca %struct.rs_allocation, align 8
+  %out = alloca %struct.rs_allocation, align 8
+  %1 = bitcast %struct.rs_allocation* %in to i8*
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %1, i8* bitcast (%struct.rs_allocation* @gIn to i8*), i64 32, i32 8, i1 false)
+  %2 = call float @_Z20rsGetElementAt_float13rs_allocationj(%struct.rs_allocation* %in, i32 %x)
+  %next = add i32 %x, 1
+  %3 = call float @_Z20rsGetElementAt_float13rs_allocationj(%struct.rs_allocation* %in, i32 %next)
+  %sum = fadd float %2, %3
+  %avg = fmul float %sum, 5.000000e-01
+  %4 = bitcast %struct.rs_allocation* %out to i8*
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %4, i8* bitcast (%struct.rs_allocation* @gOut to i8*), i64 32, i32 8, i1 false)
+  call void @_Z20rsSetElementAt_float13rs_allocationfj(%struct.rs_allocation* %out, float %avg, i32 %x)
+  ret void
+}
+
+; CHECK-LABEL: define void @blur.expand(%RsExpandKernelDriverInfoPfx* %p, i32 %x1, i32 %x2)
+; CHECK: br i1 %{{[0-9]+}}, label %Loop.bounds, label %Exit
+; CHECK: Loop.bounds:
+; CHECK: br i1 %{{[0-9]+}}, label %Loop.bounds.check, label %Loop.checked
+; CHECK: Loop.bounds.check:
+; CHECK: call void @_Z22rsAllocationGetElement13rs_allocation(%struct.rs_element* %bounds.element, %struct.rs_allocation* @gIn)
+; CHECK: call i32 @_Z20rsElementGetDataType10rs_element(
+; CHECK-NOT: rsElementGetDataType
+; CHECK: call i32 @_Z19rsAllocationGetDimX13rs_allocation(%struct.rs_allocation* @gIn)
+; CHECK: call void @_Z22rsAllocationGetElement13rs_allocation(%struct.rs_element* %bounds.element{{[0-9]+}}, %struct.rs_allocation* @gOut)
+; CHECK: call i32 @_Z19rsAllocationGetDimX13rs_allocation(%struct.rs_allocation* @gOut)
+; CHECK: br i1 %in_bounds, label %Loop, label %Loop.checked
+; CHECK: Loop:
+; CHECK: call void @blur.unchecked(i32 %X)
+; CHECK: Loop.checked:
+; CHECK: call void @blur(i32 %X.checked)
+; CHECK: br i1 %{{[0-9.a-z]+}}, label %Loop.checked, label %Exit
+define void @blur.expand(%RsExpandKernelDriverInfoPfx* %p, i32 %x1, i32 %x2) {
+Begin:
+  %rsIndex = alloca i32, align 4
+  store i32 %x1, i32* %rsIndex, align 4
+  %0 = icmp ult i32 %x1, %x2
+  br i1 %0, label %Loop, label %Exit
+
+Loop:
+  %X = load i32, i32* %rsIndex, align 4
+  call void @blur(i32 %X)
+  %1 = add nuw i32 %X, 1
+  store i32 %1, i32* %rsIndex, align 4
+  %2 = icmp ult i32 %1, %x2
+  br i1 %2, label %Loop, label %Exit
+
+Exit:
+  ret void
+}
+
+; out[x] = in[offset], after making out refer to in: the index into in is
+; read from memory, and the allocation of out changes during the launch, so
+; neither access can be checked up front.
+define void @gather(i32 %x) {
+  %offset = load i32, i32* @gOffset, align 4
+  %1 = call float @_Z20rsGetElementAt_float13rs_allocationj(%struct.rs_allocation* @gIn, i32 %offset)
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* bitcast (%struct.rs_allocation* @gOut to i8*), i8* bitcast (%struct.rs_allocation* @gIn to i8*), i64 32, i32 8, i1 false)
+  call void @_Z20rsSetElementAt_float13rs_allocationfj(%struct.rs_allocation* @gOut, float %1, i32 %x)
+  ret void
+}
+
+; CHECK-LABEL: define void @gather.expand(
+; CHECK-NOT: Loop.bounds
+; CHECK: call void @gather(i32 %X)
+; CHECK-NOT: gather.unchecked
+define void @gather.expand(%RsExpandKernelDriverInfoPfx* %p, i32 %x1, i32 %x2) {
+Begin:
+  %rsIndex = alloca i32, align 4
+  store i32 %x1, i32* %rsIndex, align 4
+  %0 = icmp ult i32 %x1, %x2
+  br i1 %0, label %Loop, label %Exit
+
+Loop:
+  %X = load i32, i32* %rsIndex, align 4
+  call void @gather(i32 %X)
+  %1 = add nuw i32 %X, 1
+  store i32 %1, i32* %rsIndex, align 4
+  %2 = icmp ult i32 %1, %x2
+  br i1 %2, label %Loop, label %Exit
+
+Exit:
+  ret void
+}
+
+; CHECK-LABEL: define internal void @blur.unchecked(i32 %x)
+; CHECK-NOT: rsGetElementAt_float
+; CHECK: call i8* @_Z14rsGetElementAt13rs_allocationjjj(%struct.rs_allocation* %in, i32 %x, i32 0, i32 0)
+; CHECK: load float, float* %element.ptr, align 4
+; CHECK: call i8* @_Z14rsGetElementAt13rs_allocationjjj(%struct.rs_allocation* %in, i32 %next, i32 0, i32 0)
+; CHECK: call i8* @_Z14rsGetElementAt13rs_allocationjjj(%struct.rs_allocation* %out, i32 %x, i32 0, i32 0)
+; CHECK: store float %avg, float* %element.ptr{{[0-9]+}}, align 4
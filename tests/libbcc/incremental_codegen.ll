@@ -0,0 +1,71 @@
+; This checks incremental code generation: the objects generated for the
+; parts of the module are merged into one whose symbols and relocations
+; resolve across the parts, the local aliases of -rs-minimize-relocs are
+; emitted along with what they alias, an unchanged module reuses every cached
+; object, and editing a function only invalidates the object of its part.
+
+; RUN: rm -rf %t.cache
+; RUN: llvm-as %s -o %t.bc
+; RUN: bcc -o incremental -output_path %T -bclib libclcore.bc \
+; RUN:     -mtriple aarch64-none-linux-gnueabi -rs-global-info \
+; RUN:     -rs-minimize-relocs -rs-incremental-cache %t.cache %t.bc \
+; RUN:     2> %t.stderr
+; RUN: echo END >> %t.stderr
+; RUN: FileCheck %s --check-prefix=NOFALLBACK < %t.stderr
+; RUN: llvm-objdump -t -r %T/incremental.o | FileCheck %s
+; RUN: ls %t.cache > %t.first
+
+; Nothing changed, so no object is added to the cache.
+; RUN: bcc -o incremental -output_path %T -bclib libclcore.bc \
+; RUN:     -mtriple aarch64-none-linux-gnueabi -rs-global-info \
+; RUN:     -rs-minimize-relocs -rs-incremental-cache %t.cache %t.bc
+; RUN: ls %t.cache | diff %t.first -
+
+; Only the object of step() is generated again.
+; RUN: sed -e 's/add nsw i32 %x, 1/add nsw i32 %x, 2/' %s | llvm-as -o %t.edited.bc
+; RUN: bcc -o incremental-edited -output_path %T -bclib libclcore.bc \
+; RUN:     -mtriple aarch64-none-linux-gnueabi -rs-global-info \
+; RUN:     -rs-minimize-relocs -rs-incremental-cache %t.cache %t.edited.bc
+; RUN: ls %t.cache | comm -13 %t.first - | wc -l \
+; RUN:   | FileCheck %s --check-prefix=EDITED
+
+; NOFALLBACK-NOT: Falling back to whole-module code generation
+; NOFALLBACK: END
+
+; CHECK: SYMBOL TABLE:
+; CHECK-DAG: .text{{.*}} increment{{$}}
+; CHECK-DAG: .text{{.*}} step{{$}}
+; CHECK-DAG: {{.*}} gCount.rs.local{{$}}
+; CHECK: RELOCATION RECORDS FOR
+; CHECK-DAG: R_AARCH64_CALL26 step
+; CHECK-DAG: R_AARCH64_{{.*}} gCount.rs.local
+
+; EDITED: {{^ *1$}}
+
+target datalayout = "e-m:e-i64:64-i128:128-n32:64-S128"
+target triple = "aarch64-none-linux-gnueabi"
+
+@gCount = global i32 0, align 4
+
+define internal i32 @step(i32 %x) noinline {
+  %1 = add nsw i32 %x, 1
+  ret i32 %1
+}
+
+define void @increment() {
+  %1 = load i32, i32* @gCount, align 4
+  %2 = call i32 @step(i32 %1)
+  store i32 %2, i32* @gCount, align 4
+  ret void
+}
+
+!llvm.ident = !{!0}
+!\23pragma = !{!1, !2}
+!\23rs_export_var = !{!3}
+!\23rs_export_func = !{!4}
+
+!0 = !{!"clang version 3.6 "}
+!1 = !{!"version", !"1"}
+!2 = !{!"java_package_name", !"foo"}
+!3 = !{!"gCount", !"6"}
+!4 = !{!"increment"}
@@ -0,0 +1,77 @@
+; This checks that RSForEachExpand splits the accesses to the small vector
+; elements of an expanded kernel loop into per-field accesses when asked to,
+; as the compiler driver does for -rs-interleaved-access, and that the
+; vectorization that follows only scalarizes the expanded kernels, not the
+; functions they call.
+
+; RUN: opt -load libbcc.so -kernelexp -rs-split-field-accesses -S < %s \
+; RUN:   | FileCheck %s
+; RUN: opt -load libbcc.so -kernelexp -S < %s \
+; RUN:   | FileCheck %s --check-prefix=NOSPLIT
+; RUN: opt -load libbcc.so -kernelexp -rs-split-field-accesses -inline \
+; RUN:   -rs-vectorize-expanded-loops -S < %s \
+; RUN:   | FileCheck %s --check-prefix=SCOPE
+
+target datalayout = "e-m:e-i64:64-i128:128-n32:64-S128"
+target triple = "aarch64-none-linux-gnueabi"
+
+; Declarations expected by the expansion pass.
+declare void @_Z14rsGetElementAt13rs_allocationj()
+declare void @_Z14rsGetElementAt13rs_allocationjj()
+declare void @_Z14rsGetElementAt13rs_allocationjjj()
+declare void @_Z14rsSetElementAt13rs_allocationPvj()
+declare void @_Z14rsSetElementAt13rs_allocationPvjj()
+declare void @_Z14rsSetElementAt13rs_allocationPvjjj()
+declare void @_Z25rsGetElementAtYuv_uchar_Y13rs_allocationjj()
+declare void @_Z25rsGetElementAtYuv_uchar_U13rs_allocationjj()
+declare void @_Z25rsGetElementAtYuv_uchar_V13rs_allocationjj()
+
+define <4 x i8> @invert(<4 x i8> %in) {
+  %1 = xor <4 x i8> %in, <i8 -1, i8 -1, i8 -1, i8 -1>
+  ret <4 x i8> %1
+}
+
+; CHECK: define void @invert.expand(
+; CHECK: Loop:
+; CHECK: getelementptr inbounds i8, i8* %{{.*}}, i32 3
+; CHECK: %input.field{{[0-9]*}} = load i8, i8*
+; CHECK: %input = insertelement <4 x i8> %{{.*}}, i8 %input.field{{[0-9]*}}, i32 3
+; CHECK: call <4 x i8> @invert(<4 x i8> %input)
+; CHECK: extractelement <4 x i8> %{{.*}}, i32 0
+; CHECK: store i8
+; CHECK: extractelement <4 x i8> %{{.*}}, i32 3
+; CHECK: store i8
+; CHECK-NOT: store <4 x i8>
+; CHECK: br i1 %{{[0-9]+}}, label %Loop, label %Exit
+
+; NOSPLIT: define void @invert.expand(
+; NOSPLIT: Loop:
+; NOSPLIT-NOT: .field
+; NOSPLIT: %input = load <4 x i8>, <4 x i8>*
+; NOSPLIT: call <4 x i8> @invert(<4 x i8> %input)
+; NOSPLIT: store <4 x i8>
+
+; SCOPE-LABEL: define <4 x i8> @invert(
+; SCOPE-NEXT: xor <4 x i8> %in, <i8 -1, i8 -1, i8 -1, i8 -1>
+; SCOPE-LABEL: define void @invert.expand(
+; SCOPE-NOT: call <4 x i8> @invert(
+; SCOPE: ret void
+
+!llvm.ident = !{!0}
+!\23pragma = !{!1, !2}
+!\23rs_export_foreach_name = !{!3}
+!\23rs_export_foreach = !{!4}
+
+; The following named metadata would not be present in a bitcode file,
+; but instead synthesized by bcc from the bitcode wrapper.  However,
+; for this test case, we're not running bcc, but instead opt, and so
+; we never get the opportunity to synthesize this named metadata.
+!\23rs_wrapper = !{!5}
+
+!0 = !{!"clang version 3.6 "}
+!1 = !{!"version", !"1"}
+!2 = !{!"java_package_name", !"foo"}
+!3 = !{!"invert"}
+; In | Out | Kernel
+!4 = !{!"35"}
+!5 = !{!"0", !"3"}
@@ -0,0 +1,80 @@
+; This checks that RSKernelStatsPass embeds a table of counters for the
+; expanded kernels and invokables of a script, and that each instrumented
+; function reads the counter on entry and adds its invocation, element and
+; tick counts to its own entry on return.
+
+; RUN: opt -load libbcc.so -embed-rs-kernel-stats -S < %s | FileCheck %s
+
+target datalayout = "e-m:e-i64:64-i128:128-n32:64-S128"
+target triple = "aarch64-none-linux-gnueabi"
+
+%RsExpandKernelDriverInfoPfx = type opaque
+
+; CHECK: @.rs.kernel_stats_entries = constant i32 2
+; CHECK: @.rs.kernel_stats_name_str_0 = private unnamed_addr constant [14 x i8] c"invert.expand\00"
+; CHECK: @.rs.kernel_stats_name_str_1 = private unnamed_addr constant [6 x i8] c"scale\00"
+; CHECK: @.rs.kernel_stats_names = constant [2 x i8*] [i8* {{.*}}@.rs.kernel_stats_name_str_0{{.*}}, i8* {{.*}}@.rs.kernel_stats_name_str_1{{.*}}]
+; CHECK: @.rs.kernel_stats = global [2 x %RsKernelStats] zeroinitializer
+
+define <4 x i8> @invert(<4 x i8> %in) {
+  %1 = xor <4 x i8> %in, <i8 -1, i8 -1, i8 -1, i8 0>
+  ret <4 x i8> %1
+}
+
+; CHECK-LABEL: define void @invert.expand(
+; CHECK: %ticks = call i64 asm sideeffect "mrs $0, cntvct_el0", "=r"()
+; CHECK: %[[COUNT:[0-9]+]] = sub i32 %x2, %x1
+; CHECK: %elements = zext i32 %[[COUNT]] to i64
+; CHECK: Exit:
+; CHECK: %[[END:ticks[0-9]+]] = call i64 asm sideeffect "mrs $0, cntvct_el0", "=r"()
+; CHECK: %[[TICKS:[0-9]+]] = sub i64 %[[END]], %ticks
+; CHECK: atomicrmw add i64* getelementptr inbounds ([2 x %RsKernelStats], [2 x %RsKernelStats]* @.rs.kernel_stats, i32 0, i32 0, i32 0), i64 1 monotonic
+; CHECK: atomicrmw add i64* getelementptr inbounds ([2 x %RsKernelStats], [2 x %RsKernelStats]* @.rs.kernel_stats, i32 0, i32 0, i32 1), i64 %elements monotonic
+; CHECK: atomicrmw add i64* getelementptr inbounds ([2 x %RsKernelStats], [2 x %RsKernelStats]* @.rs.kernel_stats, i32 0, i32 0, i32 2), i64 %[[TICKS]] monotonic
+; CHECK-NEXT: ret void
+define void @invert.expand(%RsExpandKernelDriverInfoPfx* %p, i32 %x1, i32 %x2, i32 %arg_outstep) {
+Begin:
+  %0 = icmp ult i32 %x1, %x2
+  br i1 %0, label %Loop, label %Exit
+
+Loop:
+  %X = phi i32 [ %x1, %Begin ], [ %1, %Loop ]
+  %1 = add nuw i32 %X, 1
+  %2 = icmp ult i32 %1, %x2
+  br i1 %2, label %Loop, label %Exit
+
+Exit:
+  ret void
+}
+
+; An invokable doesn't process any cells.
+; CHECK-LABEL: define void @scale()
+; CHECK: %ticks = call i64 asm sideeffect "mrs $0, cntvct_el0", "=r"()
+; CHECK: atomicrmw add i64* getelementptr inbounds ([2 x %RsKernelStats], [2 x %RsKernelStats]* @.rs.kernel_stats, i32 0, i32 1, i32 0), i64 1 monotonic
+; CHECK: atomicrmw add i64* getelementptr inbounds ([2 x %RsKernelStats], [2 x %RsKernelStats]* @.rs.kernel_stats, i32 0, i32 1, i32 1), i64 0 monotonic
+define void @scale() {
+  ret void
+}
+
+!llvm.ident = !{!0}
+!\23pragma = !{!1, !2}
+!\23rs_export_func = !{!3, !4}
+!\23rs_export_foreach_name = !{!5, !6}
+!\23rs_export_foreach = !{!7, !8}
+
+; The following named metadata would not be present in a bitcode file,
+; but instead synthesized by bcc from the bitcode wrapper.  However,
+; for this test case, we're not running bcc, but instead opt, and so
+; we never get the opportunity to synthesize this named metadata.
+!\23rs_wrapper = !{!9}
+
+!0 = !{!"clang version 3.6 "}
+!1 = !{!"version", !"1"}
+!2 = !{!"java_package_name", !"foo"}
+!3 = !{!"scale"}
+!4 = !{!"missing"}
+!5 = !{!"root"}
+!6 = !{!"invert"}
+!7 = !{!"0"}
+!8 = !{!"35"}
+!9 = !{!"0", !"3"}
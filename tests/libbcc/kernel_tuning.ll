@@ -0,0 +1,69 @@
+; This checks that -rs-tuning-db records the kernels missing from the tuning
+; database, under a hash that doesn't change with the rest of the script, and
+; that the parameters recorded for a kernel end up as hints on the loop of the
+; expanded kernel.
+
+; RUN: rm -f %t.db
+; RUN: llvm-as %s -o %t.bc
+; RUN: sed -e 's/^; EXTRA: //' %s | llvm-as -o %t.extra.bc
+; RUN: bcc -o kernel_tuning -output_path %T -bclib libclcore.bc \
+; RUN:     -mtriple aarch64-none-linux-gnueabi -rs-tuning-db %t.db %t.bc
+; RUN: FileCheck %s --check-prefix=RECORDED < %t.db
+; RUN: bcc -o kernel_tuning -output_path %T -bclib libclcore.bc \
+; RUN:     -mtriple aarch64-none-linux-gnueabi -rs-tuning-db %t.db %t.extra.bc
+; RUN: FileCheck %s --check-prefix=RECORDED < %t.db
+; RUN: sed -i -e 's/ 0 0 0 scale$/ 0 1 0 scale/' %t.db
+; RUN: bcc -o kernel_tuning -output_path %T -bclib libclcore.bc \
+; RUN:     -mtriple aarch64-none-linux-gnueabi -rs-tuning-db %t.db \
+; RUN:     -emit-llvm %t.extra.bc
+; RUN: FileCheck %s --check-prefix=TUNED < %T/kernel_tuning.o.ll
+; RUN: FileCheck %s --check-prefix=APPLIED < %t.db
+
+; RECORDED: # <cpu> <ir-hash>
+; RECORDED-NEXT: {{^[^ ]+ [0-9a-f]+ 0 0 0 scale$}}
+; RECORDED-NOT: scale
+
+; TUNED: define void @scale.expand(
+; TUNED: br i1 {{.*}}, !llvm.loop [[LOOP:![0-9]+]]
+; TUNED: [[LOOP]] = distinct !{[[LOOP]], [[ENABLE:![0-9]+]], [[WIDTH:![0-9]+]]
+; TUNED-DAG: [[ENABLE]] = !{!"llvm.loop.vectorize.enable", i1 false}
+; TUNED-DAG: [[WIDTH]] = !{!"llvm.loop.vectorize.width", i32 1}
+
+; APPLIED: {{^[^ ]+ [0-9a-f]+ 0 1 0 scale$}}
+; APPLIED-NOT: scale
+
+target datalayout = "e-m:e-i64:64-i128:128-n32:64-S128"
+target triple = "aarch64-none-linux-gnueabi"
+
+@gScale = global float 2.000000e+00, align 4
+
+define float @scale(float %in) {
+  %1 = load float, float* @gScale, align 4
+  %2 = fmul float %in, %1
+  ret float %2
+}
+
+; The rest of the script doesn't change the hash of the kernel.
+; EXTRA: @gOffset = global float 1.000000e+00, align 4
+; EXTRA: define void @offset() {
+; EXTRA:   %1 = load float, float* @gOffset, align 4
+; EXTRA:   %2 = fadd float %1, 1.000000e+00
+; EXTRA:   store float %2, float* @gScale, align 4
+; EXTRA:   ret void
+; EXTRA: }
+
+!llvm.ident = !{!0}
+!\23pragma = !{!1, !2}
+!\23rs_export_var = !{!7}
+!\23rs_export_foreach_name = !{!3, !4}
+!\23rs_export_foreach = !{!5, !6}
+
+!0 = !{!"clang version 3.6 "}
+!1 = !{!"version", !"1"}
+!2 = !{!"java_package_name", !"foo"}
+!3 = !{!"root"}
+!4 = !{!"scale"}
+!5 = !{!"0"}
+; In | Out | Kernel
+!6 = !{!"35"}
+!7 = !{!"gScale", !"2"}
@@ -0,0 +1,86 @@
+; This checks that RSAddDebugInfoPass only leaves line tables in
+; line-tables-only mode: the expanded kernel gets a subprogram and a line per
+; basic block, the variable locations of the script are dropped, and its
+; compile unit only asks for line tables.
+
+; RUN: opt -load libbcc.so -kernelexp -addrsdi -addrsdi-line-tables-only -S < %s \
+; RUN:   | FileCheck %s
+
+target datalayout = "e-m:e-i64:64-i128:128-n32:64-S128"
+target triple = "aarch64-none-linux-gnueabi"
+
+; Declarations expected by the expansion pass.
+declare void @_Z14rsGetElementAt13rs_allocationj()
+declare void @_Z14rsGetElementAt13rs_allocationjj()
+declare void @_Z14rsGetElementAt13rs_allocationjjj()
+declare void @_Z14rsSetElementAt13rs_allocationPvj()
+declare void @_Z14rsSetElementAt13rs_allocationPvjj()
+declare void @_Z14rsSetElementAt13rs_allocationPvjjj()
+declare void @_Z25rsGetElementAtYuv_uchar_Y13rs_allocationjj()
+declare void @_Z25rsGetElementAtYuv_uchar_U13rs_allocationjj()
+declare void @_Z25rsGetElementAtYuv_uchar_V13rs_allocationjj()
+
+; CHECK-NOT: call void @llvm.dbg.value
+; CHECK: define <4 x float> @scale(<4 x float> %in) !dbg [[SCALE:![0-9]+]]
+define <4 x float> @scale(<4 x float> %in) !dbg !6 {
+  call void @llvm.dbg.value(metadata <4 x float> %in, i64 0, metadata !9, metadata !10), !dbg !11
+  %1 = fmul <4 x float> %in, <float 2.0, float 2.0, float 2.0, float 2.0>, !dbg !12
+  ret <4 x float> %1, !dbg !12
+}
+
+declare void @llvm.dbg.value(metadata, i64, metadata, metadata)
+
+; The blocks of the expanded kernel are laid out as entry, Exit, Loop.
+; CHECK: define void @scale.expand({{.*}}) !dbg [[EXPAND:![0-9]+]]
+; CHECK-NOT: call void @llvm.dbg.declare
+; CHECK: br i1 %{{[0-9]+}}, label %Loop, label %Exit, !dbg [[ENTRY:![0-9]+]]
+; CHECK: Exit:
+; CHECK: ret void, !dbg [[EXIT:![0-9]+]]
+; CHECK: Loop:
+; CHECK: call <4 x float> @scale(<4 x float> %input), !dbg [[LOOP:![0-9]+]]
+; CHECK-NOT: call void @llvm.dbg.value
+
+; CHECK-NOT: emissionKind: FullDebug
+; CHECK-DAG: [[SCALE]] = distinct !DISubprogram(name: "scale",{{.*}} unit: [[SCRIPT_CU:![0-9]+]]
+; CHECK-DAG: [[SCRIPT_CU]] = distinct !DICompileUnit(language: DW_LANG_C99,{{.*}} emissionKind: LineTablesOnly
+; CHECK-DAG: [[EXPAND]] = distinct !DISubprogram(name: "scale.expand",{{.*}} unit: [[GENERATED_CU:![0-9]+]]
+; CHECK-DAG: [[GENERATED_CU]] = distinct !DICompileUnit(language: DW_LANG_GOOGLE_RenderScript,{{.*}} emissionKind: LineTablesOnly
+; CHECK-DAG: [[ENTRY]] = !DILocation(line: 1, column: 1, scope: [[EXPAND]])
+; CHECK-DAG: [[EXIT]] = !DILocation(line: 2, column: 1, scope: [[EXPAND]])
+; CHECK-DAG: [[LOOP]] = !DILocation(line: 3, column: 1, scope: [[EXPAND]])
+; CHECK-NOT: emissionKind: FullDebug
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!13, !14}
+!llvm.ident = !{!15}
+!\23pragma = !{!16, !17}
+!\23rs_export_foreach_name = !{!18}
+!\23rs_export_foreach = !{!19}
+
+; The following named metadata would not be present in a bitcode file,
+; but instead synthesized by bcc from the bitcode wrapper.  However,
+; for this test case, we're not running bcc, but instead opt, and so
+; we never get the opportunity to synthesize this named metadata.
+!\23rs_wrapper = !{!20}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "clang version 3.6 ", isOptimized: true, runtimeVersion: 0, emissionKind: FullDebug, enums: !2, retainedTypes: !3)
+!1 = !DIFile(filename: "scale.rs", directory: "/tmp")
+!2 = !{}
+!3 = !{!4}
+!4 = !DIBasicType(name: "float", size: 32, align: 32, encoding: DW_ATE_float)
+!5 = !DISubroutineType(types: !3)
+!6 = distinct !DISubprogram(name: "scale", scope: !1, file: !1, line: 3, type: !5, isLocal: false, isDefinition: true, scopeLine: 3, isOptimized: true, unit: !0, variables: !7)
+!7 = !{!9}
+!9 = !DILocalVariable(name: "in", arg: 1, scope: !6, file: !1, line: 3, type: !4)
+!10 = !DIExpression()
+!11 = !DILocation(line: 3, column: 29, scope: !6)
+!12 = !DILocation(line: 4, column: 3, scope: !6)
+!13 = !{i32 2, !"Dwarf Version", i32 4}
+!14 = !{i32 2, !"Debug Info Version", i32 3}
+!15 = !{!"clang version 3.6 "}
+!16 = !{!"version", !"1"}
+!17 = !{!"java_package_name", !"foo"}
+!18 = !{!"scale"}
+; In | Out | Kernel
+!19 = !{!"35"}
+!20 = !{!"0", !"3"}
@@ -0,0 +1,40 @@
+; This checks that with -rs-minimize-relocs the relative offset of an
+; exported variable in .rs.global_address_offsets still refers to its local
+; alias once the whole pipeline has run, so that it can be resolved when the
+; script is linked, at -O0 as well as with LTO.
+
+; RUN: llvm-as %s -o %t.bc
+; RUN: bcc -o minimize_relocs -output_path %T -bclib libclcore.bc \
+; RUN:     -mtriple aarch64-none-linux-gnueabi -rs-global-info \
+; RUN:     -rs-minimize-relocs -emit-llvm %t.bc
+; RUN: FileCheck %s < %T/minimize_relocs.o.ll
+; RUN: bcc -o minimize_relocs-O0 -output_path %T -bclib libclcore.bc \
+; RUN:     -mtriple aarch64-none-linux-gnueabi -O0 -rs-global-info \
+; RUN:     -rs-minimize-relocs -emit-llvm %t.bc
+; RUN: FileCheck %s < %T/minimize_relocs-O0.o.ll
+
+; CHECK: @.rs.global_address_offsets = constant {{.*}} ptrtoint (i32* @gCount.rs.local to i64)
+; CHECK: @gCount.rs.local = private alias i32, i32* @gCount
+
+target datalayout = "e-m:e-i64:64-i128:128-n32:64-S128"
+target triple = "aarch64-none-linux-gnueabi"
+
+@gCount = global i32 0, align 4
+
+define void @increment() {
+  %1 = load i32, i32* @gCount, align 4
+  %2 = add nsw i32 %1, 1
+  store i32 %2, i32* @gCount, align 4
+  ret void
+}
+
+!llvm.ident = !{!0}
+!\23pragma = !{!1, !2}
+!\23rs_export_var = !{!3}
+!\23rs_export_func = !{!4}
+
+!0 = !{!"clang version 3.6 "}
+!1 = !{!"version", !"1"}
+!2 = !{!"java_package_name", !"foo"}
+!3 = !{!"gCount", !"6"}
+!4 = !{!"increment"}
@@ -0,0 +1,128 @@
+; This checks that RSParallelizeInvokablesPass outlines a loop of an invokable
+; that only accesses its allocations at the induction variable into a kernel,
+; launched over the range of the loop when it is long enough, and that it
+; leaves a loop that reads the cell written by the previous iteration alone.
+
+; RUN: opt -load libbcc.so -rs-parallelize-invokables -S < %s | FileCheck %s
+
+target datalayout = "e-m:e-i64:64-i128:128-n32:64-S128"
+target triple = "aarch64-none-linux-gnueabi"
+
+%struct.rs_allocation = type { i64*, i64*, i64*, i64* }
+
+@gIn = global %struct.rs_allocation zeroinitializer, align 8
+@gOut = global %struct.rs_allocation zeroinitializer, align 8
+
+declare float @_Z20rsGetElementAt_float13rs_allocationj(%struct.rs_allocation*, i32)
+declare void @_Z20rsSetElementAt_float13rs_allocationfj(%struct.rs_allocation*, float, i32)
+declare void @llvm.memcpy.p0i8.p0i8.i64(i8*, i8*, i64, i32, i1)
+
+define void @root(float* %out) {
+  ret void
+}
+
+; CHECK-LABEL: define void @scale(float %gain, i32 %n)
+; CHECK: %par.options = alloca [15 x i32]
+; CHECK: br i1 %par.profitable, label %par.launch, label %for.body
+; CHECK: par.launch:
+; CHECK: store float %gain, float* @scale.loop.gain
+; CHECK: call void @_Z17rsForEachInternaliP14rs_script_calliiP13rs_allocation(i32 1, %struct.rs_script_call* %{{[0-9]+}}, i32 0, i32 0, %struct.rs_allocation* null)
+; CHECK-NEXT: br label %for.end.loopexit
+; CHECK: for.body:
+; CHECK: call float @_Z20rsGetElementAt_float13rs_allocationj(%struct.rs_allocation* %in, i32 %i)
+define void @scale(float %gain, i32 %n) {
+entry:
+  %in = alloca %struct.rs_allocation, align 8
+  %out = alloca %struct.rs_allocation, align 8
+  %cmp.guard = icmp eq i32 %n, 0
+  br i1 %cmp.guard, label %for.end, label %for.body.preheader
+
+for.body.preheader:
+  br label %for.body
+
+for.body:
+  %i = phi i32 [ 0, %for.body.preheader ], [ %inc, %for.body ]
+  %0 = bitcast %struct.rs_allocation* %in to i8*
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %0, i8* bitcast (%struct.rs_allocation* @gIn to i8*), i64 32, i32 8, i1 false)
+  %v = call float @_Z20rsGetElementAt_float13rs_allocationj(%struct.rs_allocation* %in, i32 %i)
+  %mul = fmul float %v, %gain
+  %1 = bitcast %struct.rs_allocation* %out to i8*
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %1, i8* bitcast (%struct.rs_allocation* @gOut to i8*), i64 32, i32 8, i1 false)
+  call void @_Z20rsSetElementAt_float13rs_allocationfj(%struct.rs_allocation* %out, float %mul, i32 %i)
+  %inc = add nuw i32 %i, 1
+  %cmp = icmp ult i32 %inc, %n
+  br i1 %cmp, label %for.body, label %for.end.loopexit
+
+for.end.loopexit:
+  br label %for.end
+
+for.end:
+  ret void
+}
+
+; CHECK-LABEL: define void @prefix(i32 %n)
+; CHECK-NOT: rsForEachInternal
+; CHECK: ret void
+define void @prefix(i32 %n) {
+entry:
+  %out = alloca %struct.rs_allocation, align 8
+  %cmp.guard = icmp ult i32 %n, 2
+  br i1 %cmp.guard, label %for.end, label %for.body.preheader
+
+for.body.preheader:
+  br label %for.body
+
+for.body:
+  %i = phi i32 [ 1, %for.body.preheader ], [ %inc, %for.body ]
+  %0 = bitcast %struct.rs_allocation* %out to i8*
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %0, i8* bitcast (%struct.rs_allocation* @gOut to i8*), i64 32, i32 8, i1 false)
+  %prev = add i32 %i, -1
+  %p = call float @_Z20rsGetElementAt_float13rs_allocationj(%struct.rs_allocation* %out, i32 %prev)
+  %c = call float @_Z20rsGetElementAt_float13rs_allocationj(%struct.rs_allocation* %out, i32 %i)
+  %sum = fadd float %p, %c
+  call void @_Z20rsSetElementAt_float13rs_allocationfj(%struct.rs_allocation* %out, float %sum, i32 %i)
+  %inc = add nuw i32 %i, 1
+  %cmp = icmp ult i32 %inc, %n
+  br i1 %cmp, label %for.body, label %for.end.loopexit
+
+for.end.loopexit:
+  br label %for.end
+
+for.end:
+  ret void
+}
+
+; CHECK-LABEL: define void @scale.loop(i32 %x)
+; CHECK: %in = alloca %struct.rs_allocation
+; CHECK: %gain = load float, float* @scale.loop.gain
+; CHECK: %out = alloca %struct.rs_allocation
+; CHECK: call float @_Z20rsGetElementAt_float13rs_allocationj(%struct.rs_allocation* %in, i32 %x)
+; CHECK: call void @_Z20rsSetElementAt_float13rs_allocationfj(%struct.rs_allocation* %out, float %mul, i32 %x)
+; CHECK-NOT: icmp
+; CHECK: ret void
+
+; CHECK: !\23rs_export_foreach_name = !{!{{[0-9]+}}, ![[NAME:[0-9]+]]}
+; CHECK: !\23rs_export_foreach = !{!{{[0-9]+}}, ![[SIG:[0-9]+]]}
+; CHECK-DAG: ![[NAME]] = !{!"scale.loop"}
+; CHECK-DAG: ![[SIG]] = !{!"40"}
+
+!llvm.ident = !{!0}
+!\23pragma = !{!1, !2}
+!\23rs_export_func = !{!3, !4}
+!\23rs_export_foreach_name = !{!5}
+!\23rs_export_foreach = !{!6}
+
+; The following named metadata would not be present in a bitcode file,
+; but instead synthesized by bcc from the bitcode wrapper.  However,
+; for this test case, we're not running bcc, but instead opt, and so
+; we never get the opportunity to synthesize this named metadata.
+!\23rs_wrapper = !{!7}
+
+!0 = !{!"clang version 3.6 "}
+!1 = !{!"version", !"1"}
+!2 = !{!"java_package_name", !"foo"}
+!3 = !{!"scale"}
+!4 = !{!"prefix"}
+!5 = !{!"root"}
+!6 = !{!"0"}
+!7 = !{!"0", !"3"}
@@ -0,0 +1,48 @@
+; This checks that -rs-perf-map writes a perf map of the shared object next
+; to it, with the functions (including the local expanded kernel) at the
+; addresses they were linked at, and the source locations that the line
+; tables give for them.
+
+; RUN: llvm-as %s -o %t.bc
+; RUN: bcc -o perf_map -output_path %T -bclib libclcore.bc \
+; RUN:     -mtriple aarch64-none-linux-gnueabi -rs-shared-object \
+; RUN:     -rs-line-tables-only -rs-perf-map %t.bc
+; RUN: (llvm-objdump -t %T/perf_map.so; cat %T/perf_map.so.map) \
+; RUN:     | FileCheck %s
+
+; CHECK: {{^0*}}[[ADDR:[1-9a-f][0-9a-f]*]] {{.*}}.text{{[[:space:]]+0*}}[[SIZE:[1-9a-f][0-9a-f]*]] {{(\.hidden )?}}scale.expand{{$}}
+; CHECK: {{^}}[[ADDR]] [[SIZE]] scale.expand ({{.*}}.rs:{{[0-9]+}}){{$}}
+
+target datalayout = "e-m:e-i64:64-i128:128-n32:64-S128"
+target triple = "aarch64-none-linux-gnueabi"
+
+define <4 x float> @scale(<4 x float> %in) !dbg !6 {
+  %1 = fmul <4 x float> %in, <float 2.0, float 2.0, float 2.0, float 2.0>, !dbg !8
+  ret <4 x float> %1, !dbg !8
+}
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!9, !10}
+!llvm.ident = !{!11}
+!\23pragma = !{!12, !13}
+!\23rs_export_foreach_name = !{!14, !15}
+!\23rs_export_foreach = !{!16, !17}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "clang version 3.6 ", isOptimized: true, runtimeVersion: 0, emissionKind: FullDebug, enums: !2, retainedTypes: !3)
+!1 = !DIFile(filename: "scale.rs", directory: "/tmp")
+!2 = !{}
+!3 = !{!4}
+!4 = !DIBasicType(name: "float", size: 32, align: 32, encoding: DW_ATE_float)
+!5 = !DISubroutineType(types: !3)
+!6 = distinct !DISubprogram(name: "scale", scope: !1, file: !1, line: 3, type: !5, isLocal: false, isDefinition: true, scopeLine: 3, isOptimized: true, unit: !0, variables: !2)
+!8 = !DILocation(line: 4, column: 3, scope: !6)
+!9 = !{i32 2, !"Dwarf Version", i32 4}
+!10 = !{i32 2, !"Debug Info Version", i32 3}
+!11 = !{!"clang version 3.6 "}
+!12 = !{!"version", !"1"}
+!13 = !{!"java_package_name", !"foo"}
+!14 = !{!"root"}
+!15 = !{!"scale"}
+!16 = !{!"0"}
+; In | Out | Kernel
+!17 = !{!"35"}
@@ -0,0 +1,88 @@
+; This checks that RSShareRuntimePass turns the runtime functions that are
+; still called after LTO into declarations with their original calling
+; convention, and the runtime variables that are still referenced into
+; external ones, and drops the rest.  Since the runtime is internalized like
+; the script, a runtime function that is only called once is still inlined
+; thanks to being the last call to a static function.
+
+; RUN: opt -load libbcc.so -internalize \
+; RUN:     -internalize-public-api-list=root,gSeed,gTable -globalopt -inline \
+; RUN:     -rs-share-runtime -globaldce -S < %s | FileCheck %s
+
+target datalayout = "e-m:e-i64:64-i128:128-n32:64-S128"
+target triple = "aarch64-none-linux-gnueabi"
+
+; The variables of the runtime aren't internalized.
+@gSeed = global i32 1, align 4
+@gTable = constant [4 x i32] [i32 0, i32 1, i32 4, i32 9], align 4
+
+; CHECK: @gSeed = external global i32, align 4
+; CHECK-NOT: @gTable
+; CHECK-NOT: @_Z6rsRandv
+; CHECK: declare float @_Z3bigf(float)
+
+declare void @rsdRandomize(i32*)
+
+; Too big to be inlined, if it weren't the last call to a static function.
+define i32 @_Z6rsRandv() {
+  call void @rsdRandomize(i32* @gSeed)
+  call void @rsdRandomize(i32* @gSeed)
+  call void @rsdRandomize(i32* @gSeed)
+  call void @rsdRandomize(i32* @gSeed)
+  call void @rsdRandomize(i32* @gSeed)
+  call void @rsdRandomize(i32* @gSeed)
+  call void @rsdRandomize(i32* @gSeed)
+  call void @rsdRandomize(i32* @gSeed)
+  call void @rsdRandomize(i32* @gSeed)
+  call void @rsdRandomize(i32* @gSeed)
+  call void @rsdRandomize(i32* @gSeed)
+  call void @rsdRandomize(i32* @gSeed)
+  call void @rsdRandomize(i32* @gSeed)
+  call void @rsdRandomize(i32* @gSeed)
+  call void @rsdRandomize(i32* @gSeed)
+  call void @rsdRandomize(i32* @gSeed)
+  call void @rsdRandomize(i32* @gSeed)
+  call void @rsdRandomize(i32* @gSeed)
+  call void @rsdRandomize(i32* @gSeed)
+  call void @rsdRandomize(i32* @gSeed)
+  call void @rsdRandomize(i32* @gSeed)
+  call void @rsdRandomize(i32* @gSeed)
+  call void @rsdRandomize(i32* @gSeed)
+  call void @rsdRandomize(i32* @gSeed)
+  %1 = load i32, i32* @gSeed, align 4
+  ret i32 %1
+}
+
+define float @_Z3bigf(float %x) noinline {
+  %1 = fmul float %x, %x
+  ret float %1
+}
+
+define float @_Z6unusedf(float %x) {
+  ret float %x
+}
+
+; CHECK-LABEL: define float @root(float %in)
+; CHECK-NOT: call i32 @_Z6rsRandv
+; CHECK: call void @rsdRandomize(i32* @gSeed)
+; CHECK: load i32, i32* @gSeed
+; CHECK: call float @_Z3bigf(float %{{[0-9]+}})
+define float @root(float %in) {
+  %1 = call i32 @_Z6rsRandv()
+  %2 = sitofp i32 %1 to float
+  %3 = fadd float %in, %2
+  %4 = call float @_Z3bigf(float %3)
+  ret float %4
+}
+
+; CHECK-NOT: @_Z6rsRandv
+; CHECK-NOT: @_Z6unusedf
+; CHECK-NOT: !\23rs_runtime_symbols
+
+!\23rs_runtime_symbols = !{!0, !1, !2, !3, !4}
+
+!0 = !{!"gSeed", i32* undef, i32 0}
+!1 = !{!"gTable", [4 x i32]* undef, i32 0}
+!2 = !{!"_Z6rsRandv", i32 ()* undef, i32 0}
+!3 = !{!"_Z3bigf", float (float)* undef, i32 0}
+!4 = !{!"_Z6unusedf", float (float)* undef, i32 0}
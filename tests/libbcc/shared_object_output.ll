@@ -0,0 +1,34 @@
+; This checks that -rs-shared-object removes the relocatable object left by
+; a previous build of the script, so that only the shared object remains.
+
+; RUN: llvm-as %s -o %t.bc
+; RUN: rm -f %T/shared_object_output.o %T/shared_object_output.so
+; RUN: bcc -o shared_object_output -output_path %T -bclib libclcore.bc \
+; RUN:     -mtriple aarch64-none-linux-gnueabi %t.bc
+; RUN: test -f %T/shared_object_output.o
+; RUN: bcc -o shared_object_output -output_path %T -bclib libclcore.bc \
+; RUN:     -mtriple aarch64-none-linux-gnueabi -rs-shared-object %t.bc
+; RUN: test -f %T/shared_object_output.so
+; RUN: test ! -e %T/shared_object_output.o
+
+target datalayout = "e-m:e-i64:64-i128:128-n32:64-S128"
+target triple = "aarch64-none-linux-gnueabi"
+
+define i32 @twice(i32 %in) {
+  %1 = shl i32 %in, 1
+  ret i32 %1
+}
+
+!llvm.ident = !{!0}
+!\23pragma = !{!1, !2}
+!\23rs_export_foreach_name = !{!3, !4}
+!\23rs_export_foreach = !{!5, !6}
+
+!0 = !{!"clang version 3.6 "}
+!1 = !{!"version", !"1"}
+!2 = !{!"java_package_name", !"foo"}
+!3 = !{!"root"}
+!4 = !{!"twice"}
+!5 = !{!"0"}
+; In | Out | Kernel
+!6 = !{!"35"}
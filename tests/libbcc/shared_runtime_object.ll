@@ -0,0 +1,50 @@
+; This checks that -rs-emit-shared-runtime builds the shared runtime object
+; that scripts compiled with -rs-share-runtime resolve their runtime calls
+; against, and that the shared objects of these scripts (and only these) have
+; it among their DT_NEEDED entries.
+
+; RUN: bcc -rs-emit-shared-runtime -output_path %T -bclib libclcore.bc \
+; RUN:     -mtriple aarch64-none-linux-gnueabi
+; RUN: llvm-objdump -t %T/libRSSharedRuntime.so \
+; RUN:     | FileCheck %s --check-prefix=RUNTIME
+; RUN: llvm-as %s -o %t.bc
+; RUN: bcc -o shared_runtime_object -output_path %T -bclib libclcore.bc \
+; RUN:     -mtriple aarch64-none-linux-gnueabi -rs-shared-object \
+; RUN:     -rs-share-runtime %t.bc
+; RUN: grep -ao libRSSharedRuntime.so %T/shared_runtime_object.so \
+; RUN:     | FileCheck %s --check-prefix=NEEDED
+; RUN: bcc -o shared_runtime_object-own -output_path %T -bclib libclcore.bc \
+; RUN:     -mtriple aarch64-none-linux-gnueabi -rs-shared-object %t.bc
+; RUN: (grep -ao libRSSharedRuntime.so %T/shared_runtime_object-own.so; \
+; RUN:  echo END) | FileCheck %s --check-prefix=OWN
+
+; RUNTIME: .text{{.*}} _Z3sinf
+
+; NEEDED: libRSSharedRuntime.so
+
+; OWN-NOT: libRSSharedRuntime.so
+; OWN: END
+
+target datalayout = "e-m:e-i64:64-i128:128-n32:64-S128"
+target triple = "aarch64-none-linux-gnueabi"
+
+declare float @_Z3sinf(float)
+
+define float @wave(float %in) {
+  %1 = tail call float @_Z3sinf(float %in)
+  ret float %1
+}
+
+!llvm.ident = !{!0}
+!\23pragma = !{!1, !2}
+!\23rs_export_foreach_name = !{!3, !4}
+!\23rs_export_foreach = !{!5, !6}
+
+!0 = !{!"clang version 3.6 "}
+!1 = !{!"version", !"1"}
+!2 = !{!"java_package_name", !"foo"}
+!3 = !{!"root"}
+!4 = !{!"wave"}
+!5 = !{!"0"}
+; In | Out | Kernel
+!6 = !{!"35"}
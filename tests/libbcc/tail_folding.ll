@@ -0,0 +1,63 @@
+; This checks that RSForEachExpand asks the loop vectorizer to fold the tail
+; of an expanded kernel loop into a predicated vector iteration when tail
+; folding is turned on, as the compiler driver does for targets with scalable
+; vectors, giving each copy of a loop versioned on alignment its own loop ID.
+; Only the hint is checked: the loop vectorizer of the LLVM in this tree
+; doesn't support tail folding or scalable vectors, and ignores it.
+
+; RUN: opt -load libbcc.so -kernelexp -rs-tail-folding -S < %s | FileCheck %s
+; RUN: opt -load libbcc.so -kernelexp -S < %s \
+; RUN:   | FileCheck %s --check-prefix=NOFOLD
+
+target datalayout = "e-m:e-i64:64-i128:128-n32:64-S128"
+target triple = "aarch64-none-linux-gnueabi"
+
+; Declarations expected by the expansion pass.
+declare void @_Z14rsGetElementAt13rs_allocationj()
+declare void @_Z14rsGetElementAt13rs_allocationjj()
+declare void @_Z14rsGetElementAt13rs_allocationjjj()
+declare void @_Z14rsSetElementAt13rs_allocationPvj()
+declare void @_Z14rsSetElementAt13rs_allocationPvjj()
+declare void @_Z14rsSetElementAt13rs_allocationPvjjj()
+declare void @_Z25rsGetElementAtYuv_uchar_Y13rs_allocationjj()
+declare void @_Z25rsGetElementAtYuv_uchar_U13rs_allocationjj()
+declare void @_Z25rsGetElementAtYuv_uchar_V13rs_allocationjj()
+
+define <4 x float> @scale(<4 x float> %in) {
+  %1 = fmul <4 x float> %in, <float 2.0, float 2.0, float 2.0, float 2.0>
+  ret <4 x float> %1
+}
+
+; CHECK: define void @scale.expand(
+; CHECK: Loop:
+; CHECK: br i1 %{{[0-9]+}}, label %Loop, label %Exit, !llvm.loop [[ALIGNED:![0-9]+]]
+; CHECK: Loop.unaligned:
+; CHECK: br i1 %{{[0-9]+}}, label %Loop.unaligned, label %Exit, !llvm.loop [[UNALIGNED:![0-9]+]]
+; CHECK-DAG: [[ALIGNED]] = distinct !{[[ALIGNED]], [[PREDICATE:![0-9]+]]}
+; CHECK-DAG: [[UNALIGNED]] = distinct !{[[UNALIGNED]], [[PREDICATE]]}
+; CHECK-DAG: [[PREDICATE]] = !{!"llvm.loop.vectorize.predicate.enable", i1 true}
+
+; NOFOLD: define void @scale.expand(
+; NOFOLD-NOT: !llvm.loop
+; NOFOLD-NOT: llvm.loop.vectorize.predicate.enable
+
+!llvm.ident = !{!0}
+!\23pragma = !{!1, !2}
+!\23rs_export_foreach_name = !{!3}
+!\23rs_export_foreach = !{!4}
+!\23rs_allocation_alignment = !{!6}
+
+; The following named metadata would not be present in a bitcode file,
+; but instead synthesized by bcc from the bitcode wrapper.  However,
+; for this test case, we're not running bcc, but instead opt, and so
+; we never get the opportunity to synthesize this named metadata.
+!\23rs_wrapper = !{!5}
+
+!0 = !{!"clang version 3.6 "}
+!1 = !{!"version", !"1"}
+!2 = !{!"java_package_name", !"foo"}
+!3 = !{!"scale"}
+; In | Out | Kernel
+!4 = !{!"35"}
+!5 = !{!"0", !"3"}
+!6 = !{!"64"}
@@ -0,0 +1,61 @@
+; This checks that with -rs-vectorize-kernels the loop vectorizer widens the
+; calls an expanded kernel loop makes to a math function of the runtime into
+; calls to its float4 overload, that the calls to it from elsewhere are still
+; inlined, and that nothing is vectorized without the option.
+
+; RUN: llvm-as %s -o %t.bc
+; RUN: bcc -o vector_math -output_path %T -bclib libclcore.bc \
+; RUN:     -mtriple aarch64-none-linux-gnueabi -rs-vectorize-kernels \
+; RUN:     -emit-llvm %t.bc
+; RUN: FileCheck %s < %T/vector_math.o.ll
+; RUN: bcc -o vector_math-novec -output_path %T -bclib libclcore.bc \
+; RUN:     -mtriple aarch64-none-linux-gnueabi -emit-llvm %t.bc
+; RUN: FileCheck %s --check-prefix=NOVEC < %T/vector_math-novec.o.ll
+
+; CHECK-LABEL: define void @compute()
+; CHECK-NOT: call float @_Z3sinf
+; CHECK: ret void
+; CHECK-LABEL: define void @wave.expand(
+; CHECK: call <4 x float> @_Z3sinDv4_f(<4 x float>
+; CHECK: call float @_Z3sinf(float
+
+; NOVEC-NOT: @_Z3sinDv4_f(
+
+target datalayout = "e-m:e-i64:64-i128:128-n32:64-S128"
+target triple = "aarch64-none-linux-gnueabi"
+
+declare float @_Z3sinf(float)
+
+@gIn = global float 0.000000e+00, align 4
+@gOut = global float 0.000000e+00, align 4
+
+define float @wave(float %in) {
+  %1 = tail call float @_Z3sinf(float %in)
+  ret float %1
+}
+
+define void @compute() {
+  %1 = load float, float* @gIn, align 4
+  %2 = tail call float @_Z3sinf(float %1)
+  store float %2, float* @gOut, align 4
+  ret void
+}
+
+!llvm.ident = !{!0}
+!\23pragma = !{!1, !2}
+!\23rs_export_var = !{!7, !8}
+!\23rs_export_func = !{!9}
+!\23rs_export_foreach_name = !{!3, !4}
+!\23rs_export_foreach = !{!5, !6}
+
+!0 = !{!"clang version 3.6 "}
+!1 = !{!"version", !"1"}
+!2 = !{!"java_package_name", !"foo"}
+!3 = !{!"root"}
+!4 = !{!"wave"}
+!5 = !{!"0"}
+; In | Out | Kernel
+!6 = !{!"35"}
+!7 = !{!"gIn", !"2"}
+!8 = !{!"gOut", !"2"}
+!9 = !{!"compute"}
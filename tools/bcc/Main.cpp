@@ -43,6 +43,7 @@
 #include <bcc/Initialization.h>
 #include <bcc/RSCompilerDriver.h>
 #include <bcc/Source.h>
+#include <bcc/TuningDatabase.h>
 
 #ifdef __ANDROID__
 #include <vndksupport/linker.h>
@@ -59,7 +60,7 @@ using namespace bcc;
 namespace {
 
 llvm::cl::list<std::string>
-OptInputFilenames(llvm::cl::Positional, llvm::cl::OneOrMore,
+OptInputFilenames(llvm::cl::Positional, llvm::cl::ZeroOrMore,
                   llvm::cl::desc("<input bitcode files>"));
 
 llvm::cl::list<std::string>
@@ -119,6 +120,95 @@ OptRSGlobalInfoSkipConstant("rs-global-info-skip-constant",
     llvm::cl::desc("Skip embedding information about constant global "
                    "variables in the code"));
 
+llvm::cl::opt<bool>
+OptRSSharedObject("rs-shared-object",
+    llvm::cl::desc("Link the output into a shared object (.so) with the "
+                   "built-in linker, keeping the .o if that isn't possible"));
+
+llvm::cl::opt<bool>
+OptRSMinimizeRelocs("rs-minimize-relocs",
+    llvm::cl::desc("Minimize dynamic relocations and symbols: emit relative "
+                   ".rs.global_* tables and bind non-exported symbols "
+                   "locally"));
+
+llvm::cl::opt<bool>
+OptRSEntryTable("rs-entry-table",
+    llvm::cl::desc("Embed a table of all script entry points as "
+                   ".rs.entry_table"));
+
+llvm::cl::opt<bool>
+OptRSKernelStats("rs-kernel-stats",
+    llvm::cl::desc("Instrument kernels and invokables with runtime counters "
+                   "exported as .rs.kernel_stats"));
+
+llvm::cl::opt<bool>
+OptRSInterleavedAccess("rs-interleaved-access",
+    llvm::cl::desc("Vectorize kernels over small vector and struct elements "
+                   "using interleaved loads and stores"));
+
+llvm::cl::opt<bool>
+OptRSShareRuntime("rs-share-runtime",
+    llvm::cl::desc("Keep runtime functions that aren't inlined as "
+                   "references to a shared runtime object"));
+
+llvm::cl::opt<bool>
+OptRSPerfMap("rs-perf-map",
+    llvm::cl::desc("Write a perf map of the shared object produced with "
+                   "-rs-shared-object to {name}.so.map"));
+
+llvm::cl::opt<bool>
+OptRSEmitSharedRuntime("rs-emit-shared-runtime",
+    llvm::cl::desc("Compile the runtime given by -bclib into the shared "
+                   "runtime object for -rs-share-runtime, in -output_path"));
+
+llvm::cl::opt<bool>
+OptRSEvaluateInit("rs-eval-init",
+    llvm::cl::desc("Evaluate init() at compile time when it only "
+                   "computes constant data into globals"));
+
+llvm::cl::opt<bool>
+OptRSLineTablesOnly("rs-line-tables-only",
+    llvm::cl::desc("Optimize fully and emit only line tables as debug "
+                   "info, for sample profilers"));
+
+llvm::cl::opt<bool>
+OptRSVectorizeKernels("rs-vectorize-kernels",
+    llvm::cl::desc("Run the loop vectorizer on the expanded kernel loops, "
+                   "widening calls to the runtime math functions"));
+
+llvm::cl::opt<bool>
+OptRSFuseForEach("rs-fuse-foreach",
+    llvm::cl::desc("Fuse consecutive forEach launches in invokables "
+                   "into one launch of a fused kernel"));
+
+llvm::cl::opt<bool>
+OptArm64SVE("arm64-sve",
+    llvm::cl::desc("Generate SVE code for aarch64 targets, with predicated "
+                   "vector loops for the kernels"));
+
+llvm::cl::opt<unsigned>
+OptRSAllocationAlignment("rs-allocation-alignment",
+    llvm::cl::desc("Alignment guaranteed by the runtime for allocation base "
+                   "addresses, to version kernel loops on"),
+    llvm::cl::value_desc("bytes"), llvm::cl::init(0));
+
+llvm::cl::opt<bool>
+OptRSParallelizeInvokables("rs-parallelize-invokables",
+    llvm::cl::desc("Outline data-parallel loops over allocations in "
+                   "invokables into kernels launched through the runtime"));
+
+llvm::cl::opt<std::string>
+OptRSIncrementalCache("rs-incremental-cache",
+    llvm::cl::desc("Cache the machine code of every function in the given "
+                   "directory, and reuse it for unchanged functions"),
+    llvm::cl::value_desc("dir"));
+
+llvm::cl::opt<std::string>
+OptRSTuningDatabase("rs-tuning-db",
+    llvm::cl::desc("Apply per-kernel codegen parameters from the given tuning "
+                   "database, and record kernels missing from it"),
+    llvm::cl::value_desc("filename"));
+
 llvm::cl::opt<std::string>
 OptChecksum("build-checksum",
             llvm::cl::desc("Embed a checksum of this compiler invocation for"
@@ -227,6 +317,16 @@ bool compileScriptGroup(BCCContext& Context, RSCompilerDriver& RSCD) {
   return success;
 }
 
+TuningDatabase TuningDB;
+
+// Write back the tuning database if compilation recorded new kernels in it.
+bool SaveTuningDatabase() {
+  if (OptRSTuningDatabase.empty() || !TuningDB.isDirty()) {
+    return true;
+  }
+  return TuningDB.save(OptRSTuningDatabase.c_str());
+}
+
 } // end anonymous namespace
 
 static inline
@@ -260,6 +360,10 @@ bool ConfigCompiler(RSCompilerDriver &pRSCD) {
     }
   }
 
+  if (OptArm64SVE) {
+    config->setEnableSVE(true);
+  }
+
   pRSCD.setConfig(config);
   Compiler::ErrorCode result = RSC->config(*config);
 
@@ -275,6 +379,75 @@ bool ConfigCompiler(RSCompilerDriver &pRSCD) {
     pRSCD.setEmbedGlobalInfoSkipConstant(true);
   }
 
+  if (OptRSSharedObject) {
+    pRSCD.setEmitSharedObject(true);
+  }
+
+  if (OptRSPerfMap) {
+    pRSCD.setEmitPerfMap(true);
+  }
+
+  if (OptRSMinimizeRelocs) {
+    pRSCD.setMinimizeRelocations(true);
+  }
+
+  if (OptRSEntryTable) {
+    pRSCD.setEmbedEntryTable(true);
+  }
+
+  if (OptRSKernelStats) {
+    pRSCD.setEmbedKernelStats(true);
+  }
+
+  if (OptRSInterleavedAccess) {
+    pRSCD.setEnableInterleavedAccess(true);
+  }
+
+  if (OptRSFuseForEach) {
+    pRSCD.setFuseForEach(true);
+  }
+
+  if (OptRSParallelizeInvokables) {
+    pRSCD.setParallelizeInvokables(true);
+  }
+
+  if (OptRSEvaluateInit) {
+    pRSCD.setEvaluateInit(true);
+  }
+
+  if (OptRSShareRuntime) {
+    pRSCD.setShareRuntime(true);
+  }
+
+  if (OptRSLineTablesOnly) {
+    pRSCD.setLineTablesOnly(true);
+  }
+
+  if (OptRSVectorizeKernels) {
+    pRSCD.setVectorizeKernels(true);
+  }
+
+  if (OptRSAllocationAlignment != 0) {
+    if ((OptRSAllocationAlignment & (OptRSAllocationAlignment - 1)) != 0) {
+      llvm::errs() << "Allocation alignment must be a power of 2!\n";
+      return false;
+    }
+    pRSCD.setAllocationAlignment(OptRSAllocationAlignment);
+  }
+
+  if (!OptRSIncrementalCache.empty()) {
+    pRSCD.setIncrementalCacheDir(OptRSIncrementalCache);
+  }
+
+  if (!OptRSTuningDatabase.empty()) {
+    // A missing database is fine; it gets created with the kernels we see.
+    if (llvm::sys::fs::exists(OptRSTuningDatabase) &&
+        !TuningDB.load(OptRSTuningDatabase.c_str())) {
+      return false;
+    }
+    pRSCD.setTuningDatabase(&TuningDB);
+  }
+
   if (result != Compiler::kSuccess) {
     llvm::errs() << "Failed to configure the compiler! (detail: "
                  << Compiler::GetErrorString(result) << ")\n";
@@ -327,10 +500,23 @@ int main(int argc, char **argv) {
     rscdi(&RSCD);
   }
 
+  if (OptRSEmitSharedRuntime) {
+    if (!RSCD.buildSharedRuntime(context, OptOutputPath.c_str(),
+                                 OptBCLibFilename.c_str())) {
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+
+  if (OptInputFilenames.empty()) {
+    ALOGE("Failed to compile bitcode, no input file was specified");
+    return EXIT_FAILURE;
+  }
+
   if (OptMergePlans.size() > 0) {
     bool success = compileScriptGroup(context, RSCD);
 
-    if (!success) {
+    if (!success || !SaveTuningDatabase()) {
       return EXIT_FAILURE;
     }
 
@@ -391,5 +577,9 @@ int main(int argc, char **argv) {
     }
   }
 
+  if (!SaveTuningDatabase()) {
+    return EXIT_FAILURE;
+  }
+
   return EXIT_SUCCESS;
 }
@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -79,6 +81,13 @@ OptOptLevel("O", llvm::cl::desc("Optimization level. [-O0, -O1, -O2, or -O3] "
 llvm::cl::opt<bool>
 OptC("c", llvm::cl::desc("Compile and assemble, but do not link."));
 
+llvm::cl::opt<bool>
+OptCombine("combine", llvm::cl::desc("Compile each input bitcode file as a "
+                                     "separate script into a single object, "
+                                     "prefixing the symbols of each script "
+                                     "with the name of its file followed by "
+                                     "'.'"));
+
 //===----------------------------------------------------------------------===//
 // Linker Options
 //===----------------------------------------------------------------------===//
@@ -143,6 +152,42 @@ Script *PrepareScript(BCCContext &pContext,
   return result;
 }
 
+// Load every input bitcode file as a script of its own, named after the file
+// without its extension.
+bool PrepareCombinedScripts(BCCContext &pContext,
+                            const llvm::cl::list<std::string> &pBitcodeFiles,
+                            std::vector<std::unique_ptr<Script>> &pScripts,
+                            std::vector<std::string> &pNames) {
+  for (const std::string &input_bitcode : pBitcodeFiles) {
+    Source *source = Source::CreateFromFile(pContext, input_bitcode);
+    if (source == nullptr) {
+      llvm::errs() << "Failed to load llvm module from file `" << input_bitcode
+                   << "'!\n";
+      return false;
+    }
+
+    std::string name = llvm::sys::path::stem(input_bitcode);
+    if (std::find(pNames.begin(), pNames.end(), name) != pNames.end()) {
+      llvm::errs() << "More than one script is named `" << name
+                   << "' (from `" << input_bitcode << "')!\n";
+      delete source;
+      return false;
+    }
+
+    Script *script = new (std::nothrow) Script(source);
+    if (script == nullptr) {
+      llvm::errs() << "Out of memory when create script for file `"
+                   << input_bitcode << "'!\n";
+      delete source;
+      return false;
+    }
+    pScripts.emplace_back(script);
+    pNames.push_back(name);
+  }
+
+  return true;
+}
+
 static inline
 bool ConfigCompiler(RSCompilerDriver &pCompilerDriver) {
   Compiler *compiler = pCompilerDriver.getCompiler();
@@ -270,6 +315,27 @@ int main(int argc, char **argv) {
     return EXIT_FAILURE;
   }
 
+  if (OptCombine) {
+    std::vector<std::unique_ptr<Script>> scripts;
+    std::vector<std::string> names;
+    if (!PrepareCombinedScripts(context, OptInputFilenames, scripts, names)) {
+      return EXIT_FAILURE;
+    }
+
+    std::vector<Script *> script_ptrs;
+    for (const std::unique_ptr<Script> &script : scripts) {
+      script_ptrs.push_back(script.get());
+    }
+    if (!rscd.buildCombinedForCompatLib(context, script_ptrs, names,
+                                        OutputFilename.c_str(), nullptr,
+                                        OptRuntimePath.c_str())) {
+      fprintf(stderr, "Failed to compile scripts!");
+      return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+  }
+
   std::unique_ptr<Script> s(PrepareScript(context, OptInputFilenames));
   if (!rscd.buildForCompatLib(*s, OutputFilename.c_str(), nullptr, OptRuntimePath.c_str(), false)) {
     fprintf(stderr, "Failed to compile script!");